@@ -76,9 +76,10 @@ void flitr::VideoHub::cleanup()
 }
 
 //====
-bool flitr::VideoHub::createVideoFileProducer(const std::string &name, const std::string &filename)
+bool flitr::VideoHub::createVideoFileProducer(const std::string &name, const std::string &filename,
+                                              const ImageFormat::PixelFormat pixelFormat)
 {
-    std::shared_ptr<flitr::FFmpegProducer> ip(new flitr::FFmpegProducer(filename, flitr::ImageFormat::FLITR_PIX_FMT_RGB_8, 2));
+    std::shared_ptr<flitr::FFmpegProducer> ip(new flitr::FFmpegProducer(filename, pixelFormat, 2));
     
     if (!ip->init())
     {
@@ -93,9 +94,10 @@ bool flitr::VideoHub::createVideoFileProducer(const std::string &name, const std
 }
 
 //====
-bool flitr::VideoHub::createRTSPProducer(const std::string &name, const std::string &url)
+bool flitr::VideoHub::createRTSPProducer(const std::string &name, const std::string &url,
+                                         const ImageFormat::PixelFormat pixelFormat)
 {
-    std::shared_ptr<flitr::FFmpegProducer> ip(new flitr::FFmpegProducer(url, flitr::ImageFormat::FLITR_PIX_FMT_RGB_8, 2));
+    std::shared_ptr<flitr::FFmpegProducer> ip(new flitr::FFmpegProducer(url, pixelFormat, 2));
     
     if (!ip->init())
     {
@@ -471,8 +473,9 @@ flitr::VideoHubImageFormat flitr::VideoHub::getImageFormat(const std::string &pr
         const ImageFormat flitrImgFrmt=it->second->getFormat();
         imgFrmt._width=flitrImgFrmt.getWidth();
         imgFrmt._height=flitrImgFrmt.getHeight();
-        imgFrmt._pixelFormat=ImageFormat::FLITR_PIX_FMT_RGB_8;
-        imgFrmt._bytesPerPixel=3;
+        imgFrmt._pixelFormat=flitrImgFrmt.getPixelFormat();
+        imgFrmt._bytesPerPixel=flitrImgFrmt.getBytesPerPixel();
+        imgFrmt._bytesPerImage=flitrImgFrmt.getBytesPerImage();
     }
     
     return imgFrmt;
@@ -36,13 +36,15 @@ namespace flitr
         int32_t _width;//!< Width of the image in pixels.
         int32_t _height;//!< Height of the image in pixels.
         ImageFormat::PixelFormat _pixelFormat;
-        int32_t _bytesPerPixel;//!< Bytes per pixel.
+        int32_t _bytesPerPixel;//!< Bytes per pixel. Of the Y plane for planar YUV formats.
+        int32_t _bytesPerImage;//!< Bytes per image, including all planes.
         
         VideoHubImageFormat() :
         _width(-1),
         _height(-1),
         _pixelFormat(ImageFormat::FLITR_PIX_FMT_ANY),
-        _bytesPerPixel(0)
+        _bytesPerPixel(0),
+        _bytesPerImage(0)
         {}
     };
     
@@ -62,14 +64,18 @@ namespace flitr
         /** Create and image producer to play back a video file.
          \param name The name of the new processor/producer.
          \param filename The name of video file.
+         \param pixelFormat The produced pixel format. FLITR_PIX_FMT_YUV420P passes the decoded frames through unconverted.
          */
-        bool createVideoFileProducer(const std::string &name, const std::string &filename);
+        bool createVideoFileProducer(const std::string &name, const std::string &filename,
+                                     const ImageFormat::PixelFormat pixelFormat=ImageFormat::FLITR_PIX_FMT_RGB_8);
         
         /** Create and image producer to play an RTSP stream.
          \param name The name of the new processor/producer.
          \param url The rtsp url.
+         \param pixelFormat The produced pixel format. FLITR_PIX_FMT_YUV420P passes the decoded frames through unconverted.
          */
-        bool createRTSPProducer(const std::string &name, const std::string &url);
+        bool createRTSPProducer(const std::string &name, const std::string &url,
+                                const ImageFormat::PixelFormat pixelFormat=ImageFormat::FLITR_PIX_FMT_RGB_8);
         
         /** Create and image producer to open and get images from a v4l device.
          \param name The name of the new processor/producer.
@@ -38,7 +38,7 @@ int main(int argc, char *argv[])
         videoHub.createImageBufferConsumer("image_output", "istab");
         //videoHub.createImageBufferConsumer("image_output", "imotion");
         const flitr::VideoHubImageFormat imageBufferFormat=videoHub.getImageFormat("input");
-        uint8_t * const imageBuffer=new uint8_t[imageBufferFormat._width * imageBufferFormat._height *  imageBufferFormat._bytesPerPixel];
+        uint8_t * const imageBuffer=new uint8_t[imageBufferFormat._bytesPerImage];
         uint64_t imageBufferSeqNumber=0;
         videoHub.imageBufferConsumerSetBuffer("image_output", imageBuffer, &imageBufferSeqNumber);
         
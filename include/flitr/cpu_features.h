@@ -0,0 +1,93 @@
+/* Framework for Live Image Transformation (FLITr)
+ * Copyright (c) 2010 CSIR
+ *
+ * This file is part of FLITr.
+ *
+ * FLITr is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * FLITr is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with FLITr. If not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef CPU_FEATURES_H
+#define CPU_FEATURES_H 1
+
+#include <flitr/flitr_export.h>
+
+#include <string>
+
+/// FLITR_TARGET(isa) compiles one function for the given x86 instruction set, e.g.
+/// FLITR_TARGET("avx2"), whatever the flags of the rest of the file. Such functions
+/// may only be called once getSimdLevel() says the CPU has the instruction set.
+#if (defined(__x86_64__) || defined(__i386__)) && defined(__GNUC__)
+#define FLITR_X86_SIMD 1
+#define FLITR_TARGET(isa) __attribute__((target(isa)))
+#elif defined(_MSC_VER) && (defined(_M_X64) || defined(_M_IX86))
+#define FLITR_X86_SIMD 1
+#define FLITR_TARGET(isa)
+#else
+#define FLITR_TARGET(isa)
+#endif
+
+#if defined(__ARM_NEON) || defined(__ARM_NEON__)
+#define FLITR_NEON_SIMD 1
+#endif
+
+namespace flitr {
+
+    /*! Instruction sets that kernels are specialised for.
+     *
+     * The x86 levels include the ones before them. NEON is the only ARM level.
+     *@sa isSimdLevelEnabled */
+    enum SimdLevel {
+        FLITR_SIMD_SCALAR=0,
+        FLITR_SIMD_SSE2,
+        FLITR_SIMD_SSSE3,
+        FLITR_SIMD_SSE42,
+        FLITR_SIMD_AVX2,
+        FLITR_SIMD_AVX512,
+        FLITR_SIMD_NEON
+    };
+
+    /*! Get the best level that the CPU and the operating system support. Detected once.*/
+    FLITR_EXPORT SimdLevel detectSimdLevel();
+
+    /*! Get the level that kernels are chosen for.
+     *
+     * This is detectSimdLevel(), unless the FLITR_SIMD_LEVEL environment variable or
+     * setSimdLevel() asks for a lower one, e.g. FLITR_SIMD_LEVEL=sse2 or
+     * FLITR_SIMD_LEVEL=scalar to compare kernels.*/
+    FLITR_EXPORT SimdLevel getSimdLevel();
+
+    /*! Set the level that kernels are chosen for, limited to detectSimdLevel().
+     *
+     * Objects choose their kernels when they are constructed, so this only affects
+     * objects made afterwards. Meant for tests and benchmarks.*/
+    FLITR_EXPORT void setSimdLevel(SimdLevel level);
+
+    /*! True if kernels for the given level may be used, i.e. it is part of getSimdLevel().*/
+    FLITR_EXPORT bool isSimdLevelEnabled(SimdLevel level);
+
+    /*! True if AVX-512 kernels may be used and the CPU also has AVX-512 VBMI, whose byte
+     * permutes look up 128 entry tables. Not a level of its own, as few CPUs have it.*/
+    FLITR_EXPORT bool isAvx512VbmiEnabled();
+
+    /*! Get the name of a level, as used by FLITR_SIMD_LEVEL.*/
+    FLITR_EXPORT const char* getSimdLevelName(SimdLevel level);
+
+    /*! Parse a level name, e.g. "avx2".
+     *@return False if the name is not known.*/
+    FLITR_EXPORT bool parseSimdLevel(const std::string& name, SimdLevel& level);
+
+}
+
+#endif //CPU_FEATURES_H
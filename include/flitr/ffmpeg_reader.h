@@ -211,6 +211,8 @@ class FLITR_EXPORT FFmpegReader {
     AVFrame* DecodedFrame_;
     /// Frame containing the image data converted to output format.
     AVFrame* ConvertedFrame_;
+    /// True if the decoded frames are already in the output format and size.
+    bool PassThrough_;
 
     uint32_t FrameRate_;
     /// Output format.
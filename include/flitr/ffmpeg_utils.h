@@ -80,6 +80,16 @@ ImageFormat::PixelFormat PixelFormatFFmpegToFLITr(AVPixelFormat in_fmt);
  */
 AVFrame *allocFFmpegFrame(AVPixelFormat pix_fmt, int width, int height);
 
+/**
+ * Points the planes of an FFmpeg frame at image data laid out as the
+ * FLITr format describes, including its row padding.
+ *
+ * \param frame The frame to point at the data.
+ * \param data The image data.
+ * \param format The FLITr format of the data.
+ */
+void fillFFmpegFrame(AVFrame *frame, uint8_t *data, const ImageFormat& format);
+
 }
 
 #endif //FFMPEG_UTILS_H
@@ -321,6 +321,8 @@ private:
     /// Holds the frame converted to the format required by the codec.
     AVFrame* SaveFrame_;
     AVPixelFormat SaveFrameFormat_;
+    /// True if the input frames are encoded without converting them.
+    bool PassThrough_;
 
     /// Format of the output video
     AVOutputFormat *OutputFormat_;
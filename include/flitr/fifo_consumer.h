@@ -18,7 +18,7 @@ namespace flitr
     {
     public:
         FifoConsumer(flitr::ImageProducer& producer, const std::string fifo_name) :
-        flitr::ImageConsumer(producer),
+        flitr::ImageConsumer(producer, flitr::SharedImageBuffer::OVERFLOW_LATEST_ONLY),
         total_frame_size_((producer.getFormat().getBytesPerImage())),
         should_exit_(false),
         fifo_name_(fifo_name),
@@ -34,26 +34,6 @@ namespace flitr
             write_thread_.join();
         }
         
-        // just prevent overflow by discarding images
-        void clearQueue()
-        {
-            std::vector<flitr::Image**> imv;
-            uint8_t ims_per_slot = 1;
-            // sync access to the buffer
-            uint32_t num_avail = getNumReadSlotsAvailable();
-            // discard all but...
-            uint32_t num_to_leave = 1;
-            if (num_avail > num_to_leave) {
-                for (uint32_t i=0; i<(num_avail-num_to_leave); i++) {
-                    imv = reserveReadSlot();
-                    if (imv.size() >= ims_per_slot) {
-                        //fprintf(stderr, "discarded frame...\n");
-                        releaseReadSlot();
-                    }
-                }
-            }
-        }
-        
         //    "( videotestsrc ! video/x-raw-yuv,width=320,height=240,framerate=10/1 ! x264enc ! queue ! rtph264pay name=pay0 pt=96 ! audiotestsrc ! audio/x-raw-int,rate=8000 ! alawenc ! rtppcmapay name=pay1 pt=97 )"
         
         void writeThread()
@@ -66,7 +46,6 @@ namespace flitr
                 fd = open(fifo_name_.c_str(), O_WRONLY | O_NONBLOCK);
                 if (fd == -1) {
                     usleep(1000);
-                    clearQueue();
                     continue;
                 }
                 //int fl = fcntl(fd, F_GETFL, 0);
@@ -76,8 +55,7 @@ namespace flitr
                 
                 uint8_t count=0;
                 while(!should_exit_) {
-                    clearQueue();
-                    // get an image
+                    // get the newest image, older ones are dropped by the buffer
                     std::vector<flitr::Image**> imv = reserveReadSlot();
                     flitr::Image *imp;
                     if (imv.size()!=0) {
@@ -97,7 +75,6 @@ namespace flitr
                         if ((num_w = write(fd, (char*)&(im_.data()[total_w]), total_frame_size_-total_w)) == -1) {
                             if (errno == EAGAIN) {
                                 usleep(100);
-                                clearQueue();
                                 continue;
                             } else {
                                 flitr::logMessage(flitr::LOG_DEBUG) << "Write error on " << fifo_name_ << "\n";
@@ -0,0 +1,102 @@
+/* Framework for Live Image Transformation (FLITr)
+ * Copyright (c) 2010 CSIR
+ *
+ * This file is part of FLITr.
+ *
+ * FLITr is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * FLITr is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with FLITr. If not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef GAUSSIAN_PYRAMID_H
+#define GAUSSIAN_PYRAMID_H 1
+
+#include <flitr/flitr_export.h>
+#include <flitr/flitr_stdint.h>
+
+#include <cstddef>
+#include <vector>
+
+namespace flitr {
+
+    /*! Scale space stack of Y_F32 images, each half the size of the one above, with
+     * optional Scharr gradient images per level.
+     *
+     * Level 0 is written by the user and update() computes the other levels and the
+     * gradients from it. Level n is (width>>n) by (height>>n) pixels. The downsampling
+     * kernel has an even number of taps and output pixel x is centred between input
+     * pixels 2x and 2x+1. Rows are filtered vertically into one row of scratch per band
+     * and then horizontally, so no full size scratch image is needed, and rows past the
+     * edges repeat the edge. Bands of rows are processed on ParallelRowsPool::instance().
+     *
+     * The gradients are zero in the one pixel border of each level.
+     *@sa FIPGaussianPyramid*/
+    class FLITR_EXPORT GaussianPyramid
+    {
+    public:
+        /*! Constructor that allocates the levels.
+         *@param width Width of level 0.
+         *@param height Height of level 0.
+         *@param num_levels Number of levels including level 0. Zero for getMaxLevels().
+         *@param gradients Also compute the x and y gradient images of every level.
+         *@param kernel Even number of downsampling taps. Empty for binomialKernel().*/
+        GaussianPyramid(size_t width, size_t height, size_t num_levels = 0, bool gradients = true,
+                        const std::vector<float>& kernel = std::vector<float>());
+
+        /*! The 12 tap binomial kernel (1 11 55 165 330 462 462 330 165 55 11 1)/2048.*/
+        static std::vector<float> binomialKernel();
+
+        /*! Number of levels of which the smallest is at least 2 by 2 pixels.*/
+        static size_t getMaxLevels(size_t width, size_t height);
+
+        /*! Downsample in to out, which is (in_width>>1) by (in_height>>1) pixels.
+         *@param max_bands Upper limit on the number of row bands. Zero for one per thread of the pool.*/
+        static void downsample(float const * in, size_t in_width, size_t in_height, float * out,
+                               float const * kernel, size_t kernel_width, uint32_t max_bands = 0);
+
+        /*! Scharr gradients of in. The one pixel border of dx and dy is set to zero.*/
+        static void gradients(float const * in, size_t width, size_t height,
+                              float * dx, float * dy, uint32_t max_bands = 0);
+
+        size_t getNumLevels() const { return Levels_.size(); }
+        bool hasGradients() const { return !Dx_.empty(); }
+        const std::vector<float>& getKernel() const { return Kernel_; }
+
+        size_t getLevelWidth(size_t level) const { return Width_ >> level; }
+        size_t getLevelHeight(size_t level) const { return Height_ >> level; }
+
+        /*! Level image, written by the user for level 0.*/
+        float * getLevel(size_t level) { return &Levels_[level][0]; }
+        float const * getLevel(size_t level) const { return &Levels_[level][0]; }
+
+        /*! Gradient images. Null if the pyramid has no gradients.*/
+        float const * getDx(size_t level) const { return Dx_.empty() ? 0 : &Dx_[level][0]; }
+        float const * getDy(size_t level) const { return Dy_.empty() ? 0 : &Dy_[level][0]; }
+
+        /*! Compute levels 1 and up, and the gradients, from level 0.
+         *@param max_bands Upper limit on the number of row bands. Zero for one per thread of the pool.*/
+        void update(uint32_t max_bands = 0);
+
+    private:
+        size_t Width_;
+        size_t Height_;
+        std::vector<float> Kernel_;
+
+        std::vector< std::vector<float> > Levels_;
+        std::vector< std::vector<float> > Dx_;
+        std::vector< std::vector<float> > Dy_;
+    };
+
+}
+
+#endif //GAUSSIAN_PYRAMID_H
@@ -32,6 +32,8 @@
 
 namespace flitr {
 
+class ImageProcessorExecutor;
+
 // Private namespace for internal usage in FLITr.
 namespace Private {
 class GraphManagerPrivate;
@@ -75,6 +77,10 @@ typedef std::function<bool(std::string category, AttributeVector attributes, std
  * Creation of graphs can also happen during run time, given the manager is aware of the
  * elements and the paths that form part of the required graph.
  *
+ * By default every image processor runs its own trigger thread. If an executor is set with
+ * setExecutor(), image processors created for a graph are attached to the executor
+ * instead, so that a large graph shares a fixed number of worker threads.
+ *
  * The manager is a singleton object so that it can be accessed from anywhere in the
  * application.
  * This class is not thread safe.
@@ -330,6 +336,21 @@ public:
         return registerGraphElementCategoryImp(category, receiver, callbackMember);
     }
 
+    /**
+     * Set the executor that image processors created for graphs are attached to.
+     *
+     * Only affects graphs created after the call. Any trigger thread that the creation
+     * callback started for a flitr::ImageProcessor is stopped and the processor is
+     * attached to the executor instead. Set to nullptr to leave processors as created.
+     * \param[in] executor The executor to use.
+     */
+    void setExecutor(const std::shared_ptr<flitr::ImageProcessorExecutor>& executor);
+
+    /**
+     * Get the executor set with setExecutor().
+     */
+    std::shared_ptr<flitr::ImageProcessorExecutor> executor() const;
+
     /**
      * Get the name of a given producer.
      *
@@ -23,6 +23,7 @@
 
 #include <flitr/image_format.h>
 #include <flitr/image_metadata.h>
+#include <flitr/image_buffer_pool.h>
 #include <flitr/log_message.h>
 
 extern "C" {
@@ -32,10 +33,19 @@ extern "C" {
 #undef PixelFormat
 
 
+#include <atomic>
 #include <cstdlib>
 
 namespace flitr {
 
+/**
+ * An image with reference counted data storage.
+ *
+ * Images can share their data with shareDataFrom() instead of
+ * copying. An image whose data is shared must call makeWritable()
+ * before writing to it. SharedImageBuffer does this when a write slot
+ * is reserved, so producers always write to data nobody else reads.
+ */
 class Image {
   public:
     /*! Constructor for image from an image format
@@ -43,34 +53,39 @@ class Image {
      *  @param zero_mem Flag to control zero-ing of memory once allocated.
      */
     Image(const ImageFormat& image_format, const bool zero_mem = false) :
-        Format_(image_format)
+        Format_(image_format),
+        ZeroMem_(zero_mem),
+        StorageSize_(0),
+        Data_(0)
     {
-        Data_ = (uint8_t*)av_malloc(Format_.getBytesPerImage());
-        if (!Data_)
-        {
-            outOfMem();
-        } else
-        {
-            if (zero_mem)
-            {
-                memset(Data_, 0, Format_.getBytesPerImage());
-            }
-        }
+        allocate(Format_.getBytesPerImage());
+    };
+
+    /*! Constructor for image with storage from a pool.
+     *  @param image_format The image format of the image to allocate.
+     *  @param pool The pool to obtain data buffers from. Its buffers must be large enough for the format.
+     */
+    Image(const ImageFormat& image_format, std::shared_ptr<ImageBufferPool> pool) :
+        Format_(image_format),
+        Pool_(pool),
+        ZeroMem_(false),
+        StorageSize_(0),
+        Data_(0)
+    {
+        allocate(Format_.getBytesPerImage());
     };
     
     ~Image()
     {
-        av_free(Data_);
     }
     
     //! Copy constructor
-    Image(const Image& rh)
+    Image(const Image& rh) :
+        ZeroMem_(false),
+        StorageSize_(0),
+        Data_(0)
     {
-        Data_ = (uint8_t*)av_malloc(rh.Format_.getBytesPerImage());
-        if (!Data_)
-        {
-            outOfMem();
-        }
+        allocate(rh.Format_.getBytesPerImage());
         deepCopy(rh);
     }
     
@@ -81,17 +96,10 @@ class Image {
         {
             return *this;
         }
-       
-        uint8_t* new_data = (uint8_t*)av_malloc(rh.Format_.getBytesPerImage());
-        
-        if (new_data != 0)
-        {
-            av_free(Data_);
-            Data_ = new_data;
-        } else
-        {
-            outOfMem();
-        }
+
+        // Only reallocate if our storage cannot be reused.
+        Format_ = rh.Format_;
+        makeWritable();
 
         deepCopy(rh);
         return *this;
@@ -110,12 +118,97 @@ class Image {
     void setMetadata(std::shared_ptr<ImageMetadata> md) { Metadata_ = md; }
 
     //!Get a pointer to the image data for reading and writing.
-    uint8_t * data() { return &(Data_[0]); }
+    uint8_t * data() { return Data_; }
     
     //!Get a pointer to const image data for reading.
-    uint8_t const * data() const { return &(Data_[0]); }
+    uint8_t const * data() const { return Data_; }
+
+    //!Get a pointer to the start of row y. Rows are ImageFormat::getBytesPerLine() apart.
+    uint8_t * line(const uint32_t y) { return Data_ + size_t(y)*Format_.getBytesPerLine(); }
+
+    //!Get a pointer to the start of const row y.
+    uint8_t const * line(const uint32_t y) const { return Data_ + size_t(y)*Format_.getBytesPerLine(); }
+
+    //!Get a pointer to the start of a plane of a planar format. Plane 0 is data().
+    uint8_t * plane(const uint32_t p) { return Data_ + Format_.getPlaneOffset(p); }
+
+    //!Get a pointer to the start of a const plane of a planar format.
+    uint8_t const * plane(const uint32_t p) const { return Data_ + Format_.getPlaneOffset(p); }
+
+    /*! Let this image refer to the data of another image instead of copying it.
+     *  The format of this image is kept, so a contiguous part of the other image can be referred to.
+     *  If our format has the bytes per line of rh, any rectangle of rh can be referred to,
+     *  with byte_offset pointing at its top left pixel.
+     *  @param rh The image whose data to share.
+     *  @param byte_offset Offset into the data of rh where our data starts.
+     *  @return False if our image does not fit in the data of rh. Nothing is changed then.
+     */
+    bool shareDataFrom(const Image& rh, const size_t byte_offset = 0)
+    {
+        // The padding after our last row need not be in rh. Planar
+        // images must have all their planes in rh.
+        const size_t height = Format_.getHeight();
+        const size_t spanned = Format_.isPlanar() ? Format_.getBytesPerImage() :
+            ((height == 0) ? 0 : ((height - 1)*Format_.getBytesPerLine() + Format_.getWidth()*Format_.getBytesPerPixel()));
+
+        const size_t rh_offset = rh.Data_ - rh.Storage_.get();
+        if ((rh_offset + byte_offset + spanned) > rh.StorageSize_)
+        {
+            return false;
+        }
+
+        Storage_ = rh.Storage_;
+        StorageSize_ = rh.StorageSize_;
+        Data_ = rh.Data_ + byte_offset;
+        return true;
+    }
+
+    //! Returns true if other images refer to our data.
+    bool isDataShared() const
+    {
+        return Storage_.use_count() > 1;
+    }
+
+    /*! Make sure no other image refers to our data, so that it can be written.
+     *  If the data is shared, new storage is obtained and the data is not preserved. */
+    void makeWritable()
+    {
+        const size_t bytes = Format_.getBytesPerImage();
+        if ((Storage_.use_count() == 1) && (StorageSize_ >= bytes))
+        {
+            // Synchronise with the reference drop of the last image
+            // that shared the data, so its reads are complete.
+            std::atomic_thread_fence(std::memory_order_acquire);
+            Data_ = Storage_.get();
+            return;
+        }
+        allocate(bytes);
+    }
 
   private:
+    void allocate(const size_t bytes)
+    {
+        if (Pool_ && (Pool_->getBufferSize() >= bytes))
+        {
+            Storage_ = Pool_->acquire();
+            StorageSize_ = Pool_->getBufferSize();
+        } else
+        {
+            Storage_ = std::shared_ptr<uint8_t>((uint8_t*)av_malloc(bytes), av_free);
+            StorageSize_ = bytes;
+            if (Storage_ && ZeroMem_)
+            {
+                memset(Storage_.get(), 0, bytes);
+            }
+        }
+
+        if (!Storage_)
+        {
+            outOfMem();
+        }
+        Data_ = Storage_.get();
+    }
+
     void deepCopy(const Image& rh)
     {
         Format_ = rh.Format_;
@@ -142,6 +235,16 @@ class Image {
 
     ImageFormat Format_;
     std::shared_ptr<ImageMetadata> Metadata_;
+
+    /// Pool to obtain storage from. Null to allocate directly.
+    std::shared_ptr<ImageBufferPool> Pool_;
+    /// Zero directly allocated storage.
+    bool ZeroMem_;
+    /// The data buffer, possibly shared with other images.
+    std::shared_ptr<uint8_t> Storage_;
+    /// Size in bytes of the data buffer.
+    size_t StorageSize_;
+    /// Start of our data in the buffer.
     uint8_t* Data_;
 };
 
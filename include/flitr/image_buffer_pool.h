@@ -0,0 +1,89 @@
+/* Framework for Live Image Transformation (FLITr) 
+ * Copyright (c) 2010 CSIR
+ * 
+ * This file is part of FLITr.
+ *
+ * FLITr is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ * 
+ * FLITr is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ * 
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with FLITr. If not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef FLITR_IMAGE_BUFFER_POOL_H
+#define FLITR_IMAGE_BUFFER_POOL_H 1
+
+#include <flitr/flitr_export.h>
+#include <flitr/flitr_stdint.h>
+
+#include <cstddef>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+namespace flitr {
+
+/**
+ * \brief Pool of equally sized image data buffers.
+ *
+ * Buffers are handed out as reference counted pointers. When the last
+ * reference is dropped the buffer goes back to the pool instead of
+ * being freed, so images can share their data without copying and
+ * without allocating a new frame every time.
+ *
+ * The pool must be owned by a std::shared_ptr. Buffers that are still
+ * in use keep the pool alive.
+ */
+class FLITR_EXPORT ImageBufferPool : public std::enable_shared_from_this<ImageBufferPool> {
+  public:
+    /**
+     * Creates an empty pool. Buffers are allocated on demand.
+     *
+     * \param buffer_size Size in bytes of every buffer in the pool.
+     *
+     * \param zero_mem Zero newly allocated buffers. Recycled buffers
+     * keep the data that was last written to them.
+     */
+    ImageBufferPool(size_t buffer_size, bool zero_mem = false);
+
+    ~ImageBufferPool();
+
+    /**
+     * Obtain a buffer, reusing a returned one if available.
+     *
+     * \return The buffer, or an empty pointer if out of memory.
+     */
+    std::shared_ptr<uint8_t> acquire();
+
+    /// Size in bytes of the buffers in the pool.
+    size_t getBufferSize() const { return BufferSize_; }
+
+    /// Number of buffers allocated by the pool, in use or free.
+    size_t getNumAllocated();
+
+    /// Number of buffers waiting in the pool to be reused.
+    size_t getNumFree();
+
+  private:
+    /// Called when the last reference to a buffer is dropped.
+    void release(uint8_t *buffer);
+
+    const size_t BufferSize_;
+    const bool ZeroMem_;
+
+    std::mutex PoolMutex_;
+    std::vector<uint8_t*> FreeBuffers_;
+    size_t NumAllocated_;
+};
+
+}
+
+#endif //FLITR_IMAGE_BUFFER_POOL_H
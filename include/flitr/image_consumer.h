@@ -45,8 +45,11 @@ namespace flitr {
          * Construct a consumer.
          *
          * \param producer The producer we are connecting to. The producer's method to add a consumer is protected, and can only be called via this consumer contructor.
+         *
+         * \param overflow_policy What happens to our unread slots if we fall behind the producer.
          */
-        ImageConsumer(ImageProducer& producer);
+        ImageConsumer(ImageProducer& producer,
+                      SharedImageBuffer::OverflowPolicy overflow_policy = SharedImageBuffer::OVERFLOW_LOSSLESS);
         
         virtual ~ImageConsumer();
         
@@ -95,6 +98,60 @@ namespace flitr {
         {
             ProducerImageBuffer_->releaseReadSlot(*this);
         }
+
+        /**
+         * Reserve up to max_slots written slots for reading with one
+         * lock and no allocation.
+         *
+         * \return The reserved slots, oldest first. Empty if no slot
+         * could be obtained.
+         */
+        virtual SlotSpan reserveReadSlots(uint32_t max_slots)
+        {
+            return ProducerImageBuffer_->reserveReadSlots(*this, max_slots);
+        }
+
+        /**
+         * Release the oldest num_slots reserved read slots in one go.
+         */
+        virtual void releaseReadSlots(uint32_t num_slots)
+        {
+            ProducerImageBuffer_->releaseReadSlots(*this, num_slots);
+        }
+
+        /**
+         * Block until a read slot can be reserved or the timeout
+         * expires. Used instead of polling getNumReadSlotsAvailable().
+         *
+         * \param timeout_us Maximum time to wait in microseconds.
+         *
+         * \return True if a read slot is available.
+         */
+        virtual bool waitForReadSlot(uint32_t timeout_us = FLITR_SHARED_BUFFER_WAIT_TIMEOUT_US)
+        {
+            return ProducerImageBuffer_->waitForReadSlot(*this, timeout_us);
+        }
+
+        /**
+         * Obtain the overflow policy we were added to the producer with.
+         *
+         * \return The overflow policy.
+         */
+        virtual SharedImageBuffer::OverflowPolicy getOverflowPolicy()
+        {
+            return ProducerImageBuffer_->getOverflowPolicy(*this);
+        }
+
+        /**
+         * Obtain the number of slots that were dropped before we read
+         * them because of our overflow policy.
+         *
+         * \return The number of dropped slots.
+         */
+        virtual uint64_t getNumDroppedSlots()
+        {
+            return ProducerImageBuffer_->getNumDroppedSlots(*this);
+        }
         
         virtual bool init() { return true; }
         
@@ -106,6 +163,9 @@ namespace flitr {
     protected:
         /// Called once we get added as a consumer.
         void setSharedImageBuffer(SharedImageBuffer& b) { ProducerImageBuffer_ = &b; }
+
+        /// The shared buffer of the producer we are connected to.
+        SharedImageBuffer* getProducerImageBuffer() const { return ProducerImageBuffer_; }
         
     private:
         // \todo good place for observer pointers
@@ -113,6 +173,8 @@ namespace flitr {
         ImageProducer *ImageProducer_;
         /// Pointer to the shared buffer. The buffer resides in the producer.
         SharedImageBuffer *ProducerImageBuffer_;
+        /// Index of our cursor in a lock-free shared buffer. -1 if not allocated.
+        int32_t SharedImageBufferIndex_;
     };
     
 }
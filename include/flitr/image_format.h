@@ -25,11 +25,27 @@
 #include <flitr/flitr_stdint.h>
 
 
+/// Row alignment in bytes used by ImageFormat::setRowAlignment() unless
+/// another is given. Suits aligned loads of the widest vector registers.
+#define FLITR_DEFAULT_ROW_ALIGNMENT 64
+
 namespace flitr {
     
     /**
      * This class contains information about the format (width, height,
      * pixel type) of an image.
+     *
+     * Rows are packed by default, i.e. getBytesPerLine() is the width
+     * times the bytes per pixel. A format can instead pad its rows to
+     * an alignment with setRowAlignment(), or take the line size of an
+     * external buffer with setBytesPerLine(). Code that indexes pixels
+     * as y*width only works with packed formats; see isPacked().
+     *
+     * The YUV formats of video codecs and cameras can be kept as they
+     * are. For the planar ones the Y plane comes first and is laid out
+     * like a FLITR_PIX_FMT_Y_8 image, so the bytes per pixel and line
+     * refer to it. The chroma planes follow; see getNumPlanes() and
+     * getPlaneOffset().
      */
     class ImageFormat {
     public:
@@ -44,7 +60,10 @@ namespace flitr {
             FLITR_PIX_FMT_BGRA = 6,//should really be FLITR_PIX_FMT_BGRA_8
             FLITR_PIX_FMT_Y_F32 = 7,
             FLITR_PIX_FMT_RGB_F32 = 8,
-            FLITR_PIX_FMT_RGBA = 9
+            FLITR_PIX_FMT_RGBA = 9,
+            FLITR_PIX_FMT_YUV420P = 10,//I420: Y plane, then U and V planes of half the width and height.
+            FLITR_PIX_FMT_NV12 = 11,//Y plane, then one plane of interleaved U and V of half the width and height.
+            FLITR_PIX_FMT_YUYV = 12//Packed 4:2:2 as Y0 U Y1 V, two bytes per pixel.
         };
         
         enum DataType {
@@ -57,6 +76,8 @@ namespace flitr {
         Width_(w),
         Height_(h),
         PixelFormat_(pix_fmt),
+        RowAlignment_(1),
+        BytesPerLine_(0),
         flipV_(flipV),
         flipH_(flipH)
         {
@@ -75,7 +96,82 @@ namespace flitr {
         
         inline DataType getDataType() const { return DataType_;}
         
-        inline uint32_t getBytesPerImage() const { return Width_ * Height_ * BytesPerPixel_; }
+        /// Distance in bytes from the start of one row to the next.
+        inline uint32_t getBytesPerLine() const
+        {
+            if (BytesPerLine_ != 0)
+            {
+                return BytesPerLine_;
+            }
+            const uint32_t packed = Width_ * BytesPerPixel_;
+            return ((packed + RowAlignment_ - 1) / RowAlignment_) * RowAlignment_;
+        }
+        
+        inline uint32_t getRowAlignment() const { return RowAlignment_; }
+        
+        /// True if there is no padding between rows.
+        inline bool isPacked() const { return getBytesPerLine() == (Width_ * BytesPerPixel_); }
+        
+        /// The number of planes. One for packed formats.
+        inline uint32_t getNumPlanes() const
+        {
+            switch (PixelFormat_)
+            {
+                case FLITR_PIX_FMT_YUV420P:
+                    return 3;
+                case FLITR_PIX_FMT_NV12:
+                    return 2;
+                default:
+                    return 1;
+            }
+        }
+        
+        inline bool isPlanar() const { return getNumPlanes() > 1; }
+        
+        /// The number of rows in a plane. Chroma planes are subsampled vertically.
+        inline uint32_t getPlaneHeight(uint32_t plane) const
+        {
+            return (plane == 0) ? Height_ : ((Height_ + 1) / 2);
+        }
+        
+        /// Distance in bytes from the start of one row of a plane to the next.
+        inline uint32_t getPlaneBytesPerLine(uint32_t plane) const
+        {
+            if (plane == 0)
+            {
+                return getBytesPerLine();
+            }
+            
+            const uint32_t chromaWidth = (Width_ + 1) / 2;
+            const uint32_t packed = (PixelFormat_ == FLITR_PIX_FMT_NV12) ? (chromaWidth * 2) : chromaWidth;
+            if (BytesPerLine_ != 0)
+            {// The usual convention of external buffers.
+                return (PixelFormat_ == FLITR_PIX_FMT_NV12) ? BytesPerLine_ : ((BytesPerLine_ + 1) / 2);
+            }
+            return ((packed + RowAlignment_ - 1) / RowAlignment_) * RowAlignment_;
+        }
+        
+        /// Offset in bytes of the start of a plane. getPlaneOffset(getNumPlanes()) is the size of the image.
+        inline uint32_t getPlaneOffset(uint32_t plane) const
+        {
+            uint32_t offset = 0;
+            for (uint32_t p = 0; p < plane; p++)
+            {
+                offset += getPlaneBytesPerLine(p) * getPlaneHeight(p);
+            }
+            return offset;
+        }
+        
+        inline uint32_t getBytesPerImage() const { return getPlaneOffset(getNumPlanes()); }
+        
+        /// The format of the Y plane as a FLITR_PIX_FMT_Y_8 image, for the formats that have one.
+        inline ImageFormat getLumaFormat() const
+        {
+            ImageFormat luma(Width_, Height_, FLITR_PIX_FMT_Y_8, flipV_, flipH_);
+            luma.RowAlignment_ = RowAlignment_;
+            luma.BytesPerLine_ = getBytesPerLine();
+            return luma;
+        }
         
         inline bool getFlipVertical() { return flipV_; }
         
@@ -85,6 +181,16 @@ namespace flitr {
         
         inline void setHeight(uint32_t h) { Height_ = h; }
         
+        /// Pad rows to a multiple of alignment bytes. One packs the rows. Clears setBytesPerLine().
+        inline void setRowAlignment(uint32_t alignment = FLITR_DEFAULT_ROW_ALIGNMENT)
+        {
+            RowAlignment_ = (alignment != 0) ? alignment : 1;
+            BytesPerLine_ = 0;
+        }
+        
+        /// Use a fixed line size, e.g. the linesize of an FFmpeg frame. Zero goes back to the row alignment.
+        inline void setBytesPerLine(uint32_t bytes_per_line) { BytesPerLine_ = bytes_per_line; }
+        
         inline void setPixelFormat(PixelFormat pix_fmt)
         {
             PixelFormat_ = pix_fmt;
@@ -506,6 +612,18 @@ namespace flitr {
                     ComponentsPerPixel_ = 3;
                     DataType_=FLITR_PIX_DT_FLOAT32;
                     break;
+                case FLITR_PIX_FMT_YUV420P:
+                case FLITR_PIX_FMT_NV12:
+                    // The Y plane.
+                    BytesPerPixel_ = 1;
+                    ComponentsPerPixel_ = 1;
+                    DataType_=FLITR_PIX_DT_UINT8;
+                    break;
+                case FLITR_PIX_FMT_YUYV:
+                    BytesPerPixel_ = 2;
+                    ComponentsPerPixel_ = 2;
+                    DataType_=FLITR_PIX_DT_UINT8;
+                    break;
                 default:
                     //! @todo maybe return error
                     BytesPerPixel_ = 1;
@@ -522,6 +640,11 @@ namespace flitr {
         uint32_t ComponentsPerPixel_;
         DataType DataType_;
         
+        /// Rows are padded to a multiple of this many bytes.
+        uint32_t RowAlignment_;
+        /// Fixed line size in bytes. Zero if computed from RowAlignment_.
+        uint32_t BytesPerLine_;
+        
         bool flipV_;
         bool flipH_;
     };
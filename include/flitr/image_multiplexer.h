@@ -24,14 +24,20 @@
 #include <flitr/image.h>
 #include <flitr/image_consumer.h>
 #include <flitr/image_producer.h>
+#include <flitr/image_resampler.h>
 #include <flitr/stats_collector.h>
 
 #include <flitr/flitr_thread.h>
 
+#include <functional>
+
 namespace flitr {
 
 class ImageMultiplexer;
 
+/*! Function that returns the capture time of an image, e.g. from its metadata, in nanoseconds.*/
+typedef std::function<uint64_t(const Image&)> ImageTimestampFunction;
+
 /*! Helper/Service thread class for ImageMultiplexer that consumes and produces images as they become available from the upstream producers.*/
 class ImageMultiplexerThread : public FThread
 {
@@ -118,6 +124,29 @@ public:
         PlexerSource_=-1;
     }
 
+    /*! Set the filter used to scale upstream images to the downstream size. Nearest by default.*/
+    void setResampleFilter(ImageResampler::Filter filter) { ResampleFilter_=filter; }
+    ImageResampler::Filter getResampleFilter() const { return ResampleFilter_; }
+
+    /*! Set the largest number of row bands an image is scaled in. Zero, the default, uses every thread of ParallelRowsPool::instance().*/
+    void setMaxResampleBands(uint32_t max_bands) { MaxResampleBands_=max_bands; }
+
+    /*! Produce the upstream images in the order of their timestamps instead of taking the sources in turn.
+     *
+     * The oldest frame is produced once every source has a frame waiting, or once it has
+     * waited max_wait_us for the sources that do not, so that a stalled source does not
+     * stop the others. Call before the trigger thread is started.
+     *@param timestamp_function Function that returns the timestamp of an upstream image.
+     *@param max_wait_us The longest time a frame waits for the other sources, in microseconds.*/
+    void setTimestampSelection(ImageTimestampFunction timestamp_function, uint32_t max_wait_us = 20000)
+    {
+        TimestampFunction_=timestamp_function;
+        MaxTimestampWaitUS_=max_wait_us;
+    }
+
+    /*! Take the upstream sources in turn, the default. Call before the trigger thread is started.*/
+    void setRoundRobinSelection() { TimestampFunction_=nullptr; }
+
 protected:
     const uint32_t ImagesPerSlot_;
     const uint32_t buffer_size_;
@@ -136,6 +165,27 @@ private:
     uint32_t DownstreamWidth_;
     uint32_t DownstreamHeight_;
     ImageFormat::PixelFormat DownstreamPixFmt_;
+
+    /*! Reserve the next frame of every source that has none waiting, and pick the source
+     * whose frame should be produced next by timestamp.
+     *@return The source index, or -1 if nothing should be produced yet.*/
+    int32_t selectOldestSource();
+
+    /*! Get the resampler for an upstream and downstream image, made again when the formats change.*/
+    const ImageResampler& getResampler(uint32_t consumer_index, uint32_t img_index);
+
+    ImageResampler::Filter ResampleFilter_;
+    uint32_t MaxResampleBands_;
+
+    /*! One per upstream image, indexed by consumer_index*ImagesPerSlot_ + img_index.*/
+    std::vector<std::shared_ptr<ImageResampler> > Resamplers_;
+
+    ImageTimestampFunction TimestampFunction_;
+    uint32_t MaxTimestampWaitUS_;
+
+    /*! Reserved read slot of every source in timestamp order, empty if none, and when it was reserved.*/
+    std::vector<std::vector<Image**> > PendingRead_;
+    std::vector<uint64_t> PendingSinceNS_;
 };
 
 
@@ -29,12 +29,17 @@
 #include <flitr/stats_collector.h>
 
 #include <flitr/flitr_thread.h>
+#include <flitr/parallel_rows.h>
 
+#include <atomic>
+#include <deque>
+#include <memory>
 #include <mutex>
 
 namespace flitr {
     
     class ImageProcessor;
+    class ImageProcessorExecutor;
     
     /*! Helper/Service thread class for ImageProcessor that consumes and produces images as they become available from the upstream producer.*/
     class ImageProcessorThread : public FThread
@@ -61,6 +66,31 @@ namespace flitr {
         bool ShouldExit_;
     };
     
+    /*! Thread class for stateless ImageProcessors that processes one frame at a time, concurrently with its sibling threads.
+     *@sa ImageProcessor::setNumFrameWorkers */
+    class ImageProcessorFrameThread : public FThread
+    {
+    public:
+        
+        /*! Constructor given a pointer to the ImageProcessor object and the index of the thread.*/
+        ImageProcessorFrameThread(ImageProcessor *ip, uint32_t index);
+        
+        /*! The thread's run method.*/
+        void run();
+        
+        /*! Method to notify the thread to exit.*/
+        void setExit() { ShouldExit_ = true; }
+        
+    private:
+        /*! A pointer to the ImageProcessor object being serviced.*/
+        ImageProcessor *IP_;
+        
+        /*! Measures the time this thread takes per frame. StatsCollector is not thread safe.*/
+        StatsCollector Stats_;
+        
+        std::atomic<bool> ShouldExit_;
+    };
+    
     /*! A processor class inheriting from both ImageConsumer and ImageProducer. Consumes flitr images as input and then produces flitr images as output.
      *
      * Derived classes should make sure to pass metadata from the upstream images to the
@@ -69,6 +99,8 @@ namespace flitr {
     class FLITR_EXPORT ImageProcessor : public ImageConsumer, public ImageProducer, virtual public Parameters
     {
         friend class ImageProcessorThread;
+        friend class ImageProcessorFrameThread;
+        friend class ImageProcessorExecutor;
     public:
         
         /*! Constructor given the upstream producer.
@@ -95,8 +127,37 @@ namespace flitr {
          * CPU affinity for the trigger thread. See the FThread::startThread() and
          * FThread::applyAffinity() functions for more information. */
         virtual bool startTriggerThread(int32_t cpu_affinity = -1);
+
+        /*! Stop the trigger thread, or detach from the executor if attached to one.*/
         virtual bool stopTriggerThread();
-        virtual bool isTriggerThreadStarted() const {return Thread_!=0;}
+        virtual bool isTriggerThreadStarted() const {return (Thread_!=0) || !FrameThreads_.empty();}
+
+        /*! Set the number of frames that the trigger threads process at the same time.
+         *
+         * Only stateless processors support more than one. With @a num_workers threads,
+         * each thread reserves its own read/write slot pair and calls processFrame() on it.
+         * Frames may finish out of order but their slots are released in order, so the
+         * downstream consumers see the frames in the order they were produced. Must be
+         * called before startTriggerThread(). Processors attached to an executor process
+         * one frame at a time regardless.
+         *@return False if the processor is not stateless or the trigger thread is started.
+         *@sa isStateless() */
+        virtual bool setNumFrameWorkers(uint32_t num_workers);
+
+        virtual uint32_t getNumFrameWorkers() const { return NumFrameWorkers_; }
+
+        /*! Returns true if the processor implements processFrame() and keeps no state from one frame to the next.*/
+        virtual bool isStateless() const { return false; }
+
+        /*! Run trigger() on a shared executor instead of a dedicated trigger thread.
+         *
+         * Must be called after init(). Fails if the trigger thread is started or the
+         * processor is already attached to an executor. Many processors attached to one
+         * executor share its worker threads.
+         *@sa ImageProcessorExecutor */
+        virtual bool attachToExecutor(std::shared_ptr<ImageProcessorExecutor> executor);
+        virtual bool detachFromExecutor();
+        virtual bool isAttachedToExecutor() const {return Executor_!=nullptr;}
         
         /*! Synchronous trigger method. Called automatically by the trigger thread if started.
          *@sa ImageProcessor::startTriggerThread() */
@@ -142,7 +203,64 @@ namespace flitr {
             PassMetadataFunction_ = f;
         }
 
+        /*! Set how the downstream shared image buffer synchronises this producer with its consumers.
+         *
+         * Must be called before init(), which creates the buffer. The lock-free mode requires that
+         * trigger() is only ever called from one thread at a time, which is the case when the trigger
+         * thread is used.
+         *@sa SharedImageBuffer::SyncMode */
+        virtual void setSharedImageBufferSyncMode(SharedImageBuffer::SyncMode sync_mode)
+        {
+            SharedImageBufferSyncMode_ = sync_mode;
+        }
+
+        /*! Set the largest number of bands that parallelRows() splits a frame into.
+         *
+         * Zero, the default, uses every thread of ParallelRowsPool::instance(). One processes
+         * frames on the trigger thread only, which can be better when many processors
+         * already keep all cores busy. */
+        virtual void setMaxRowBands(uint32_t max_bands)
+        {
+            MaxRowBands_ = max_bands;
+        }
+
+        virtual uint32_t getMaxRowBands() const
+        {
+            return MaxRowBands_;
+        }
+
     protected:
+        /*! Process one reserved slot of a stateless processor.
+         *
+         * Called by triggerFrame() and by the frame worker threads, which may call it for
+         * different slots concurrently. Must only read from @a imvRead, write to @a imvWrite
+         * and pass the metadata if needed.
+         *@sa setNumFrameWorkers() */
+        virtual void processFrame(const std::vector<Image**>& imvRead, const std::vector<Image**>& imvWrite) {}
+
+        /*! Implementation of trigger() for stateless processors.
+         *
+         * Reserves a read/write slot pair if available, processes it with processFrame()
+         * and releases it.
+         *@return True if a frame was processed. */
+        bool triggerFrame();
+
+        /*! Process the rows [0, height) of a frame in parallel bands. Returns once all bands are done.
+         *
+         * For use in trigger(). The function is called concurrently for different bands and
+         * must only write its own rows. Neighbourhood filters that read rows around their band
+         * pass the reach of the filter as @a halo and find the rows they may read in
+         * RowBand::HaloBegin and RowBand::HaloEnd.
+         *@param height The number of rows.
+         *@param grain_size The smallest band worth giving to a thread, in rows.
+         *@param fn The function that processes a band.
+         *@param halo The number of rows above and below its band that a band reads.
+         *@sa ParallelRowsPool */
+        void parallelRows(size_t height, size_t grain_size, const RowBandFunction& fn, size_t halo = 0) const
+        {
+            ParallelRowsPool::instance().run(height, grain_size, halo, fn, MaxRowBands_);
+        }
+
         const uint32_t ImagesPerSlot_;
         const uint32_t buffer_size_;
         
@@ -160,9 +278,41 @@ namespace flitr {
          *
          * @sa setPassMetadataFunction() */
         PassMetadataFunction PassMetadataFunction_;
+
+        /*! The synchronisation mode the downstream shared image buffer is created with in init(). */
+        SharedImageBuffer::SyncMode SharedImageBufferSyncMode_;
+
+        /*! Limit on the number of bands of parallelRows(). Zero for no limit. */
+        uint32_t MaxRowBands_;
         
     private:
+        /*! Frame worker version of triggerFrame(). Safe to call from many threads.*/
+        bool triggerFrameConcurrent(StatsCollector& stats);
+
+        /*! Block until the trigger threads may have something to do.*/
+        void waitForTriggerSlots();
+
         ImageProcessorThread *Thread_;
+
+        /*! The number of frames processed at the same time.*/
+        uint32_t NumFrameWorkers_;
+        /*! The trigger threads when NumFrameWorkers_ is more than one.*/
+        std::vector<ImageProcessorFrameThread*> FrameThreads_;
+        /*! Serialises the reserve and release calls of the frame workers.*/
+        std::mutex FrameMutex_;
+        /*! Done flags of the reserved slot pairs, oldest first.*/
+        std::deque<bool> FramesDone_;
+        /*! Sequence number of the oldest reserved slot pair.*/
+        uint64_t OldestFrame_;
+        /*! Sequence number of the next slot pair to reserve.*/
+        uint64_t NextFrame_;
+
+        /*! The executor we are attached to, if any.*/
+        std::shared_ptr<ImageProcessorExecutor> Executor_;
+        /*! Scheduling state owned by the executor.*/
+        std::atomic<uint32_t> ExecutorState_;
+        /*! Set while detaching so that the executor stops triggering us.*/
+        std::atomic<bool> ExecutorDetaching_;
         
     protected:
         mutable std::mutex triggerMutex_;
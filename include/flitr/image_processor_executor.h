@@ -0,0 +1,144 @@
+/* Framework for Live Image Transformation (FLITr)
+ * Copyright (c) 2010 CSIR
+ *
+ * This file is part of FLITr.
+ *
+ * FLITr is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * FLITr is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with FLITr. If not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef IMAGE_PROCESSOR_EXECUTOR_H
+#define IMAGE_PROCESSOR_EXECUTOR_H 1
+
+#include <flitr/flitr_export.h>
+#include <flitr/flitr_stdint.h>
+#include <flitr/flitr_thread.h>
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+namespace flitr {
+
+    class ImageProcessor;
+    class ImageProcessorExecutor;
+
+    /*! Worker thread of an ImageProcessorExecutor. */
+    class ImageProcessorExecutorThread : public FThread
+    {
+    public:
+
+        /*! Constructor given the executor and the index of the worker.*/
+        ImageProcessorExecutorThread(ImageProcessorExecutor *executor, uint32_t index) :
+        Executor_(executor),
+        Index_(index) {}
+
+        /*! The thread's run method.*/
+        void run();
+
+    private:
+        ImageProcessorExecutor *Executor_;
+        uint32_t Index_;
+    };
+
+    /*! Runs the trigger() method of many image processors on a fixed pool of worker threads.
+     *
+     * Attached processors do not get a trigger thread of their own. The executor listens
+     * to the shared image buffers around each processor and queues the processor whenever
+     * its upstream producer has written a slot or its downstream consumers have read one.
+     * A processor is only ever queued or running once, so its triggers stay in order and
+     * never overlap, while independent branches of a graph and successive frames in a
+     * chain run in parallel.
+     *
+     * Each worker keeps its own queue. A worker takes the most recently queued processor
+     * from its own queue, which keeps a frame on the core that produced it, and steals
+     * the oldest processor from another worker's queue when its own is empty. A processor
+     * that still has work after a trigger() goes to the far end of its worker's queue, so
+     * that a busy processor does not starve the others on the same worker.
+     *
+     * A processor whose trigger() returns false while slots are available is only
+     * retried on the next buffer event.
+     *@sa ImageProcessor::attachToExecutor() */
+    class FLITR_EXPORT ImageProcessorExecutor
+    {
+        friend class ImageProcessorExecutorThread;
+    public:
+
+        /*! Constructor that starts the worker threads.
+         *@param num_threads The number of worker threads. Zero uses one per hardware thread.
+         *@param cpu_affinities Optional CPU affinity per worker, applied with FThread::applyAffinity().
+         *       Worker i uses entry i modulo the number of entries. Empty leaves the workers unpinned.*/
+        ImageProcessorExecutor(uint32_t num_threads = 0,
+                               const std::vector<int32_t>& cpu_affinities = std::vector<int32_t>());
+
+        /*! Destructor. Stops the worker threads. Processors should be detached first.*/
+        virtual ~ImageProcessorExecutor();
+
+        /*! Get the number of worker threads.*/
+        uint32_t getNumThreads() const { return uint32_t(Threads_.size()); }
+
+        /*! Start running the trigger() of a processor on the workers.
+         *
+         * The processor must have been initialised so that its downstream buffer exists.
+         * Prefer ImageProcessor::attachToExecutor(), which calls this.
+         *@return False if the processor is not initialised.*/
+        bool attach(ImageProcessor& processor);
+
+        /*! Stop running the trigger() of a processor. Blocks until a running trigger() has returned.*/
+        void detach(ImageProcessor& processor);
+
+        /*! Queue a processor to have its trigger() called. Does nothing if it is already queued.*/
+        void schedule(ImageProcessor& processor);
+
+    private:
+        /*! Queue of one worker.*/
+        struct WorkerQueue {
+            std::mutex Mutex;
+            std::deque<ImageProcessor*> Processors;
+        };
+
+        /*! The worker loop. Called by the worker threads.*/
+        void runWorker(uint32_t index);
+
+        /*! Take a processor from our own queue or steal one. Returns 0 if all are empty.*/
+        ImageProcessor* takeProcessor(uint32_t index);
+
+        /*! Trigger a processor until it has nothing to do, then hand it back.*/
+        void runProcessor(ImageProcessor* processor, uint32_t index);
+
+        /*! Put a processor on a queue and wake a worker.
+         *@param requeue True to put the processor behind everything else the owning worker has queued.*/
+        void push(ImageProcessor* processor, uint32_t index, bool requeue = false);
+
+        std::vector<std::unique_ptr<WorkerQueue> > Queues_;
+        std::vector<std::unique_ptr<ImageProcessorExecutorThread> > Threads_;
+
+        /*! Round-robin queue for processors scheduled from outside the workers.*/
+        std::atomic<uint32_t> NextQueue_;
+        /*! The total number of queued processors.*/
+        std::atomic<uint32_t> NumQueued_;
+        /*! The number of workers blocked on IdleCondition_.*/
+        std::atomic<uint32_t> NumIdle_;
+        std::atomic<bool> ShouldExit_;
+
+        std::mutex IdleMutex_;
+        std::condition_variable IdleCondition_;
+    };
+
+}
+
+#endif //IMAGE_PROCESSOR_EXECUTOR_H
@@ -43,20 +43,36 @@ namespace flitr {
     {
     public:
         
-        IntegralImage() {}
+        IntegralImage() :
+        maxRowBands_(0)
+        {}
         
         /*! destructor */
         ~IntegralImage() {}
         
         //! Copy constructor
-        IntegralImage(const IntegralImage& rh) {}
+        IntegralImage(const IntegralImage& rh) :
+        maxRowBands_(rh.maxRowBands_)
+        {}
         
         //! Assignment operator
         IntegralImage& operator=(const IntegralImage& rh)
         {
+            maxRowBands_=rh.maxRowBands_;
             return *this;
         }
         
+        //!Set the largest number of row bands an image is split into. Zero, the default, uses every thread of ParallelRowsPool::instance().
+        void setMaxRowBands(const uint32_t maxBands)
+        {
+            maxRowBands_=maxBands;
+        }
+        
+        uint32_t getMaxRowBands() const
+        {
+            return maxRowBands_;
+        }
+        
         /*!Synchronous process method for float pixel format.*/
         template<typename T>
         bool process(double * const dataWriteDS, T const * const dataReadUS, const size_t width, const size_t height)
@@ -147,6 +163,24 @@ namespace flitr {
             
             return true;
         }
+        
+        /*! Integral images with exact integer sums, computed in parallel bands of rows.
+         *
+         *  The sums are kept modulo 2^32 or 2^64. A box sum taken as A - B - C + D in the same unsigned
+         *  type is exact whenever the box sum itself fits, e.g. any box of up to 2^24 pixels of 8 bit data,
+         *  whatever the size of the image. The integral image is packed, and lineStride is that of the
+         *  input in elements, zero meaning packed rows.*/
+        bool process(uint32_t * const dataWriteDS, uint8_t const * const dataReadUS,
+                     const size_t width, const size_t height, const size_t lineStride=0);
+        
+        bool processRGB(uint32_t * const dataWriteDS, uint8_t const * const dataReadUS,
+                        const size_t width, const size_t height, const size_t lineStride=0);
+        
+        bool process(uint64_t * const dataWriteDS, uint16_t const * const dataReadUS,
+                     const size_t width, const size_t height, const size_t lineStride=0);
+        
+    private:
+        uint32_t maxRowBands_;
     };
     
     
@@ -194,25 +228,33 @@ namespace flitr {
             return kernelWidth_;
         }
         
+        /*! The filter methods below read and write images whose rows are lineStride
+         *  elements (not pixels) apart, e.g. ImageFormat::getBytesPerLine() divided by the
+         *  size of an element. Zero means packed rows. The scratch image is always packed.*/
+        
         /*!Synchronous process method for float pixel format.*/
         bool filter(float * const dataWriteDS, float const * const dataReadUS,
                     const size_t width, const size_t height,
-                    float * const dataScratch);
+                    float * const dataScratch,
+                    const size_t lineStride=0);
         
         /*!Synchronous process method for float RGB pixel format.*/
         bool filterRGB(float * const dataWriteDS, float const * const dataReadUS,
                        const size_t width, const size_t height,
-                       float * const dataScratch);
+                       float * const dataScratch,
+                       const size_t lineStride=0);
         
         /*!Synchronous process method for uint8_t pixel format.*/
         bool filter(uint8_t * const dataWriteDS, uint8_t const * const dataReadUS,
                     const size_t width, const size_t height,
-                    uint8_t * const dataScratch);
+                    uint8_t * const dataScratch,
+                    const size_t lineStride=0);
         
         /*!Synchronous process method for uint8_t RGB pixel format.*/
         bool filterRGB(uint8_t * const dataWriteDS, uint8_t const * const dataReadUS,
                        const size_t width, const size_t height,
-                       uint8_t * const dataScratch);
+                       uint8_t * const dataScratch,
+                       const size_t lineStride=0);
         
     private:
         size_t kernelWidth_;
@@ -234,7 +276,8 @@ namespace flitr {
         
         //! Copy constructor
         BoxFilterII(const BoxFilterII& rh) :
-        kernelWidth_(rh.kernelWidth_)
+        kernelWidth_(rh.kernelWidth_),
+        maxRowBands_(rh.maxRowBands_)
         {}
         
         //! Assignment operator
@@ -246,6 +289,7 @@ namespace flitr {
             }
             
             kernelWidth_=rh.kernelWidth_;
+            maxRowBands_=rh.maxRowBands_;
             
             return *this;
         }
@@ -265,6 +309,17 @@ namespace flitr {
             return kernelWidth_;
         }
         
+        //!Set the largest number of row bands an image is split into. Zero, the default, uses every thread of ParallelRowsPool::instance().
+        void setMaxRowBands(const uint32_t maxBands)
+        {
+            maxRowBands_=maxBands;
+        }
+        
+        uint32_t getMaxRowBands() const
+        {
+            return maxRowBands_;
+        }
+        
         /*!Synchronous process method for float pixel format..*/
         bool filter(float * const dataWriteDS, float const * const dataReadUS,
                     const size_t width, const size_t height,
@@ -289,8 +344,22 @@ namespace flitr {
                        double * const IIDoubleScratch,
                        const bool recalcIntegralImage);
         
+        /*!Synchronous process method for uint8_t pixel format with an exact 32 bit integral image,
+         half the size of the double one. The kernel area may be up to 2^23 pixels.*/
+        bool filter(uint8_t * const dataWriteDS, uint8_t const * const dataReadUS,
+                    const size_t width, const size_t height,
+                    uint32_t * const IIScratch,
+                    const bool recalcIntegralImage);
+        
+        /*!Synchronous process method for uint8_t RGB pixel format with an exact 32 bit integral image.*/
+        bool filterRGB(uint8_t * const dataWriteDS, uint8_t const * const dataReadUS,
+                       const size_t width, const size_t height,
+                       uint32_t * const IIScratch,
+                       const bool recalcIntegralImage);
+        
     private:
         size_t kernelWidth_;
+        uint32_t maxRowBands_;
         
         IntegralImage integralImage_;
     };
@@ -385,7 +454,8 @@ namespace flitr {
         GaussianFilter(const GaussianFilter& rh) :
         kernel1D_(nullptr),
         filterRadius_(rh.filterRadius_),
-        kernelWidth_(rh.kernelWidth_)
+        kernelWidth_(rh.kernelWidth_),
+        maxRowBands_(rh.maxRowBands_)
         {
             updateKernel1D();
         }
@@ -400,6 +470,7 @@ namespace flitr {
             
             filterRadius_=rh.filterRadius_;
             kernelWidth_=rh.kernelWidth_;
+            maxRowBands_=rh.maxRowBands_;
             updateKernel1D();
             
             return *this;
@@ -419,25 +490,47 @@ namespace flitr {
             return filterRadius_ * 0.5f;
         }
         
+        //!Set the largest number of row bands an image is split into. Zero, the default, uses every thread of ParallelRowsPool::instance().
+        void setMaxRowBands(const uint32_t maxBands)
+        {
+            maxRowBands_=maxBands;
+        }
+        
+        uint32_t getMaxRowBands() const
+        {
+            return maxRowBands_;
+        }
+        
+        /*! The lineStride of the filter methods is the same as that of BoxFilter.
+         *
+         *  Only the pixels at least kernelWidth/2 from the edges are written. The rows are
+         *  filtered in cache sized column strips on ParallelRowsPool::instance() with the
+         *  kernels of getSimdLevel(), so dataScratch is not used any more and may be null.
+         *  The uint8_t methods use 14 bit fixed point weights. dataWriteDS may equal dataReadUS.*/
+        
         /*!Synchronous process method for float pixel format..*/
         bool filter(float * const dataWriteDS, float const * const dataReadUS,
                     const size_t width, const size_t height,
-                    float * const dataScratch);
+                    float * const dataScratch,
+                    const size_t lineStride=0);
         
         /*!Synchronous process method for float RGB pixel format..*/
         bool filterRGB(float * const dataWriteDS, float const * const dataReadUS,
                        const size_t width, const size_t height,
-                       float * const dataScratch);
+                       float * const dataScratch,
+                       const size_t lineStride=0);
         
         /*!Synchronous process method for uint8_t pixel format.*/
         bool filter(uint8_t * const dataWriteDS, uint8_t const * const dataReadUS,
                     const size_t width, const size_t height,
-                    uint8_t * const dataScratch);
+                    uint8_t * const dataScratch,
+                    const size_t lineStride=0);
         
         /*!Synchronous process method for uint8_t RGB pixel format.*/
         bool filterRGB(uint8_t * const dataWriteDS, uint8_t const * const dataReadUS,
                        const size_t width, const size_t height,
-                       uint8_t * const dataScratch);
+                       uint8_t * const dataScratch,
+                       const size_t lineStride=0);
         
         
     private:
@@ -445,8 +538,96 @@ namespace flitr {
         
         float *kernel1D_;
         
+        //! kernel1D_ in fixed point, summing to exactly 1<<14.
+        std::vector<uint16_t> kernel1DFixed_;
+        
         float filterRadius_;
         size_t kernelWidth_;
+        uint32_t maxRowBands_;
+    };
+    
+    
+    /*! Recursive (IIR) Gaussian filter of Young and van Vliet, whose cost does not depend on the radius.
+     *
+     *  Every row and then every column is filtered by a third order recursion running forward and then
+     *  backward. Pixels beyond the edges take the value of the nearest edge pixel, so the whole image is
+     *  written. Away from the edges the result is within a few percent of the signal range of
+     *  GaussianFilter with a wide enough kernel, and closer for large radii, so it is meant for
+     *  large scale smoothing.*/
+    class FLITR_EXPORT RecursiveGaussianFilter
+    {
+    public:
+        
+        RecursiveGaussianFilter(const float filterRadius);//filterRadius = standardDeviation * 2.0. At least 1.0.
+        
+        //!Sets the radius of the Gaussian.
+        void setFilterRadius(const float filterRadius);
+        
+        //!Get the radius of the Gaussian.
+        float getFilterRadius() const
+        {
+            return filterRadius_;
+        }
+        
+        float getStandardDeviation() const
+        {
+            return filterRadius_ * 0.5f;
+        }
+        
+        //!Set the largest number of row bands an image is split into. Zero, the default, uses every thread of ParallelRowsPool::instance().
+        void setMaxRowBands(const uint32_t maxBands)
+        {
+            maxRowBands_=maxBands;
+        }
+        
+        uint32_t getMaxRowBands() const
+        {
+            return maxRowBands_;
+        }
+        
+        /*! The lineStride of the filter methods is the same as that of BoxFilter. dataWriteDS may
+         *  equal dataReadUS. The uint8_t methods keep a float copy of the image, so one filter
+         *  object should not run them from two threads at once.*/
+        
+        /*!Synchronous process method for float pixel format.*/
+        bool filter(float * const dataWriteDS, float const * const dataReadUS,
+                    const size_t width, const size_t height,
+                    const size_t lineStride=0);
+        
+        /*!Synchronous process method for float RGB pixel format.*/
+        bool filterRGB(float * const dataWriteDS, float const * const dataReadUS,
+                       const size_t width, const size_t height,
+                       const size_t lineStride=0);
+        
+        /*!Synchronous process method for uint8_t pixel format.*/
+        bool filter(uint8_t * const dataWriteDS, uint8_t const * const dataReadUS,
+                    const size_t width, const size_t height,
+                    const size_t lineStride=0);
+        
+        /*!Synchronous process method for uint8_t RGB pixel format.*/
+        bool filterRGB(uint8_t * const dataWriteDS, uint8_t const * const dataReadUS,
+                       const size_t width, const size_t height,
+                       const size_t lineStride=0);
+        
+    private:
+        void updateCoefficients();
+        
+        //! Filters a float image in place.
+        void filterInPlace(float * const data, const size_t width, const size_t height,
+                           const size_t channels, const size_t stride) const;
+        
+        float filterRadius_;
+        
+        /*! Gain of the input and weights of the three previous outputs, all divided by b0.*/
+        float B_;
+        float b1_;
+        float b2_;
+        float b3_;
+        
+        uint32_t maxRowBands_;
+        
+        //! Float copy of 8 bit images.
+        std::vector<float> floatScratch_;
     };
     
     
@@ -494,6 +675,9 @@ namespace flitr {
         //!Set the width of the convolution kernel.
         void setKernelWidth(const int kernelWidth);
         
+        /*! Uses GaussianPyramid::downsample(), which fills the whole output image and
+         *  filters bands of rows in parallel, so dataScratch is not used any more and may be null.*/
+        
         /*!Synchronous process method for float pixel format..*/
         bool downsample(float * const dataWriteDS, float const * const dataReadUS,
                         const size_t widthUS, const size_t heightUS,
@@ -519,7 +703,8 @@ namespace flitr {
     class FLITR_EXPORT MorphologicalFilter
     {
     public:
-        MorphologicalFilter()
+        MorphologicalFilter() :
+        maxRowBands_(0)
         {
 #ifdef FLITR_USE_OPENCL
             cl_uint platformIdCount = 0;
@@ -765,7 +950,24 @@ namespace flitr {
         }
 #endif
         
-        //!Synchronous process method for T pixel format.
+        //!Set the largest number of row bands the CPU erode and dilate split an image into. Zero, the default, uses every thread of ParallelRowsPool::instance().
+        void setMaxRowBands(const uint32_t maxBands)
+        {
+            maxRowBands_=maxBands;
+        }
+        
+        uint32_t getMaxRowBands() const
+        {
+            return maxRowBands_;
+        }
+        
+        /*! Synchronous process method for T pixel format. Each pixel is set to the minimum of the
+         * structElemWidth x structElemWidth square around it, which is made odd.
+         *
+         * Without OpenCL the van Herk/Gil-Werman algorithm is used, whose cost does not depend
+         * on structElemWidth, for uint8_t, uint16_t and float. The whole image is written, with
+         * the squares clipped at the edges. dataScratch holds width*height values and
+         * dataWriteDS may be dataReadUS.*/
         template<typename T>
         bool erode(T * const dataWriteDS, T const * const dataReadUS,
                    size_t structElemWidth,
@@ -774,9 +976,9 @@ namespace flitr {
         {
             structElemWidth=structElemWidth|1;//Make structuring element's width is odd.
             
+#ifdef FLITR_USE_OPENCL
             const size_t halfStructElem=(structElemWidth>>1);
             
-#ifdef FLITR_USE_OPENCL
             const cl_image_format format = { CL_INTENSITY, CL_UNORM_INT8 };
             cl_int error = CL_SUCCESS;
             
@@ -823,204 +1025,30 @@ namespace flitr {
             clReleaseMemObject(inputImage);
             clReleaseMemObject(tempImage);
             clReleaseMemObject(outputImage);
-#else
-            const size_t widthMinusStructElem=width-structElemWidth;
-            const size_t heightMinusStructElem=height-structElemWidth;
-            const size_t widthMinusHalfStructElem=width-halfStructElem;
-
-            //First pass in x.
-            for (size_t y=0; y<height; ++y)
-            {
-                const size_t lineOffsetFS=y * width + halfStructElem;
-                const size_t lineOffsetUS=y * width;
-                
-                T minImgValue;
-                int minTTL=0;
-                
-                for (size_t x=0; x<widthMinusStructElem; ++x)
-                {
-                    //Use the time to live (TTL) of the min/max and only do a full search if min/max's TTL expires.
-                    if (minTTL<=0)
-                    {
-                        size_t offsetUS=lineOffsetUS + x;
-                        minImgValue=dataReadUS[offsetUS];
-                        minTTL=0;
-                        ++offsetUS;
-                        
-                        for (size_t i=1; i<structElemWidth; ++i)
-                        {
-                            const T &imgValue = dataReadUS[offsetUS];
-                            
-                            if (imgValue<minImgValue)
-                            {
-                                minImgValue=imgValue;
-                                minTTL=i;
-                            }
-                            
-                            ++offsetUS;
-                        }
-                    } else
-                    {
-                        const size_t offsetUS=lineOffsetUS + x + (structElemWidth-1);
-                        const T &imgValue = dataReadUS[offsetUS];
-                        
-                        if (imgValue<=minImgValue)
-                        {
-                            minImgValue=imgValue;
-                            minTTL=structElemWidth-1;
-                        } else
-                        {
-                            --minTTL;
-                        }
-                    }
-                    
-                    dataScratch[lineOffsetFS + x]=minImgValue;
-                }
-            }
             
-            //Second pass in y.
-            T *minImgValueArr=new T[width];
-            int *minTTLArr=new int[width];
-            for (size_t x=0; x<width; ++x)
-            {
-                minTTLArr[x]=0;
-            }
-            
-            for (size_t y=0; y<heightMinusStructElem; ++y)
-            {
-                const size_t lineOffsetDS=(y+halfStructElem) * width;
-                const size_t lineOffsetFS=y * width;
-                
-                for (size_t x=halfStructElem; x<widthMinusHalfStructElem; ++x)
-                {
-                    //Use the time to live (TTL) of the min/max and only do a full search if min/max's TTL expires.
-                    if (minTTLArr[x]<=0)
-                    {
-                        size_t offsetFS=lineOffsetFS + x;
-                        minImgValueArr[x]=dataScratch[offsetFS];
-                        minTTLArr[x]=0;
-                        offsetFS+=width;
-                        
-                        for (size_t j=1; j<structElemWidth; ++j)
-                        {
-                            const T &imgValue = dataScratch[offsetFS];
-                            
-                            if (imgValue<minImgValueArr[x])
-                            {
-                                minImgValueArr[x]=imgValue;
-                                minTTLArr[x]=j;
-                            }
-                            
-                            offsetFS+=width;
-                        }
-                    } else
-                    {
-                        const size_t offsetFS=lineOffsetFS + x + (structElemWidth-1)*width;
-                        const T &imgValue = dataScratch[offsetFS];
-                        
-                        if (imgValue<=minImgValueArr[x])
-                        {
-                            minImgValueArr[x]=imgValue;
-                            minTTLArr[x]=structElemWidth-1;
-                        } else
-                        {
-                            --minTTLArr[x];
-                        }
-                    }
-                    
-                    dataWriteDS[lineOffsetDS + x]=minImgValueArr[x];
-                }
-            }
-#endif
             return true;
+#else
+            return vanHerkFilter(dataWriteDS, dataReadUS, structElemWidth, width, height, 1, false, dataScratch);
+#endif
         }
         
-        //!Synchronous process method for T RGB pixel format.
+        //!Synchronous process method for T RGB pixel format. See erode(), but always on the CPU.
         template<typename T>
         bool erodeRGB(T * const dataWriteDS, T const * const dataReadUS,
                       size_t structElemWidth,
                       const size_t width, const size_t height,
                       T * const dataScratch)
         {
-            structElemWidth=structElemWidth|1;//Make structuring element's width is odd.
-            
-            const size_t widthMinusStructElem=width-structElemWidth;
-            const size_t heightMinusStructElem=height-structElemWidth;
-            const size_t halfStructElem=(structElemWidth>>1);
-            const size_t widthMinusHalfStructElem=width-halfStructElem;
-            
-            //First pass in x.
-            for (size_t y=0; y<height; ++y)
-            {
-                const size_t lineOffsetFS=y * width + halfStructElem;
-                const size_t lineOffsetUS=y * width;
-                
-                for (size_t x=0; x<widthMinusStructElem; ++x)
-                {
-                    //!@todo Add TTL optimisation from grayscale version above.
-                    size_t offsetUS=(lineOffsetUS + x)*3;
-                    T minImgValueR=dataReadUS[offsetUS+0];
-                    T minImgValueG=dataReadUS[offsetUS+1];
-                    T minImgValueB=dataReadUS[offsetUS+2];
-                    offsetUS+=3;
-                    
-                    for (size_t i=1; i<structElemWidth; ++i)
-                    {
-                        const T &imgValueR = dataReadUS[offsetUS + 0];
-                        const T &imgValueG = dataReadUS[offsetUS + 1];
-                        const T &imgValueB = dataReadUS[offsetUS + 2];
-                        
-                        if (imgValueR<minImgValueR) minImgValueR=imgValueR;
-                        if (imgValueG<minImgValueG) minImgValueG=imgValueG;
-                        if (imgValueB<minImgValueB) minImgValueB=imgValueB;
-                        
-                        offsetUS+=3;
-                    }
-                    
-                    dataScratch[(lineOffsetFS + x)*3 + 0]=minImgValueR;
-                    dataScratch[(lineOffsetFS + x)*3 + 1]=minImgValueG;
-                    dataScratch[(lineOffsetFS + x)*3 + 2]=minImgValueB;
-                }
-            }
-            
-            //Second pass in y.
-            for (size_t y=0; y<heightMinusStructElem; ++y)
-            {
-                const size_t lineOffsetDS=(y+halfStructElem) * width;
-                const size_t lineOffsetFS=y * width;
-                
-                for (size_t x=halfStructElem; x<widthMinusHalfStructElem; ++x)
-                {
-                    //!@todo Add TTL optimisation from grayscale version above.
-                    size_t offsetFS=(lineOffsetFS + x)*3;
-                    T minImgValueR=dataScratch[offsetFS + 0];
-                    T minImgValueG=dataScratch[offsetFS + 1];
-                    T minImgValueB=dataScratch[offsetFS + 2];
-                    offsetFS+=width*3;
-                    
-                    for (size_t j=1; j<structElemWidth; ++j)
-                    {
-                        const T &imgValueR = dataScratch[offsetFS + 0];
-                        const T &imgValueG = dataScratch[offsetFS + 1];
-                        const T &imgValueB = dataScratch[offsetFS + 2];
-                        
-                        if (imgValueR<minImgValueR) minImgValueR=imgValueR;
-                        if (imgValueG<minImgValueG) minImgValueG=imgValueG;
-                        if (imgValueB<minImgValueB) minImgValueB=imgValueB;
-                        
-                        offsetFS+=(width*3);
-                    }
-                    
-                    dataWriteDS[(lineOffsetDS + x)*3 + 0]=minImgValueR;
-                    dataWriteDS[(lineOffsetDS + x)*3 + 1]=minImgValueG;
-                    dataWriteDS[(lineOffsetDS + x)*3 + 2]=minImgValueB;
-                }
-            }
-            
-            return true;
+            return vanHerkFilter(dataWriteDS, dataReadUS, structElemWidth|1, width, height, 3, false, dataScratch);
         }
         
-        //!Synchronous process method for T pixel format.
+        /*! Synchronous process method for T pixel format. Each pixel is set to the maximum of the
+         * structElemWidth x structElemWidth square around it, which is made odd.
+         *
+         * Without OpenCL the van Herk/Gil-Werman algorithm is used, whose cost does not depend
+         * on structElemWidth, for uint8_t, uint16_t and float. The whole image is written, with
+         * the squares clipped at the edges. dataScratch holds width*height values and
+         * dataWriteDS may be dataReadUS.*/
         template<typename T>
         bool dilate(T * const dataWriteDS, T const * const dataReadUS,
                     size_t structElemWidth,
@@ -1029,9 +1057,9 @@ namespace flitr {
         {
             structElemWidth=structElemWidth|1;//Make structuring element's width is odd.
             
+#ifdef FLITR_USE_OPENCL
             const size_t halfStructElem=(structElemWidth>>1);
             
-#ifdef FLITR_USE_OPENCL
             const cl_image_format format = { CL_INTENSITY, CL_UNORM_INT8 };
             cl_int error = CL_SUCCESS;
             
@@ -1078,205 +1106,25 @@ namespace flitr {
             clReleaseMemObject(inputImage);
             clReleaseMemObject(tempImage);
             clReleaseMemObject(outputImage);
-#else
-            const size_t widthMinusStructElem=width-structElemWidth;
-            const size_t heightMinusStructElem=height-structElemWidth;
-            const size_t widthMinusHalfStructElem=width-halfStructElem;
-
-            //First pass in x.
-            for (size_t y=0; y<height; ++y)
-            {
-                const size_t lineOffsetFS=y * width + halfStructElem;
-                const size_t lineOffsetUS=y * width;
-                
-                T maxImgValue;
-                int maxTTL=0;
-                
-                for (size_t x=0; x<widthMinusStructElem; ++x)
-                {
-                    //Use the time to live (TTL) of the min/max and only do a full search of min/max's TTL expires.
-                    if (maxTTL<=0)
-                    {
-                        size_t offsetUS=lineOffsetUS + x;
-                        maxImgValue=dataReadUS[offsetUS];
-                        maxTTL=0;
-                        ++offsetUS;
-                        
-                        for (size_t i=1; i<structElemWidth; ++i)
-                        {
-                            const T &imgValue = dataReadUS[offsetUS];
-                            
-                            if (imgValue>maxImgValue)
-                            {
-                                maxImgValue=imgValue;
-                                maxTTL=i;
-                            }
-                            
-                            ++offsetUS;
-                        }
-                    } else
-                    {
-                        const size_t offsetUS=lineOffsetUS + x + (structElemWidth-1);
-                        const T &imgValue = dataReadUS[offsetUS];
-                        
-                        if (imgValue>=maxImgValue)
-                        {
-                            maxImgValue=imgValue;
-                            maxTTL=structElemWidth-1;
-                        } else
-                        {
-                            --maxTTL;
-                        }
-                    }
-                    
-                    dataScratch[lineOffsetFS + x]=maxImgValue;
-                }
-            }
-            
-            //Second pass in y.
-            T *maxImgValueArr=new T[width];
-            int *maxTTLArr=new int[width];
-            for (size_t x=0; x<width; ++x)
-            {
-                maxTTLArr[x]=0;
-            }
             
-            for (size_t y=0; y<heightMinusStructElem; ++y)
-            {
-                const size_t lineOffsetDS=(y+halfStructElem) * width;
-                const size_t lineOffsetFS=y * width;
-                
-                for (size_t x=halfStructElem; x<widthMinusHalfStructElem; ++x)
-                {
-                    //Use the time to live (TTL) of the min/max and only do a full search of min/max's TTL expires.
-                    if (maxTTLArr[x]<=0)
-                    {
-                        size_t offsetFS=lineOffsetFS + x;
-                        maxImgValueArr[x]=dataScratch[offsetFS];
-                        maxTTLArr[x]=0;
-                        offsetFS+=width;
-                        
-                        for (size_t j=1; j<structElemWidth; ++j)
-                        {
-                            const T &imgValue = dataScratch[offsetFS];
-                            
-                            if (imgValue>maxImgValueArr[x])
-                            {
-                                maxImgValueArr[x]=imgValue;
-                                maxTTLArr[x]=j;
-                            }
-                            
-                            offsetFS+=width;
-                        }
-                    } else
-                    {
-                        const size_t offsetFS=lineOffsetFS + x + (structElemWidth-1)*width;
-                        const T &imgValue = dataScratch[offsetFS];
-                        
-                        if (imgValue>=maxImgValueArr[x])
-                        {
-                            maxImgValueArr[x]=imgValue;
-                            maxTTLArr[x]=structElemWidth-1;
-                        } else
-                        {
-                            --maxTTLArr[x];
-                        }
-                    }
-                    
-                    dataWriteDS[lineOffsetDS + x]=maxImgValueArr[x];
-                }
-            }
-#endif
             return true;
+#else
+            return vanHerkFilter(dataWriteDS, dataReadUS, structElemWidth, width, height, 1, true, dataScratch);
+#endif
         }
         
-        //!Synchronous process method for T RGB pixel format.
+        //!Synchronous process method for T RGB pixel format. See dilate(), but always on the CPU.
         template<typename T>
         bool dilateRGB(T * const dataWriteDS, T const * const dataReadUS,
                        size_t structElemWidth,
                        const size_t width, const size_t height,
                        T * const dataScratch)
         {
-            structElemWidth=structElemWidth|1;//Make structuring element's width is odd.
-            
-            const size_t widthMinusStructElem=width-structElemWidth;
-            const size_t heightMinusStructElem=height-structElemWidth;
-            const size_t halfStructElem=(structElemWidth>>1);
-            const size_t widthMinusHalfStructElem=width-halfStructElem;
-            
-            //First pass in x.
-            for (size_t y=0; y<height; ++y)
-            {
-                const size_t lineOffsetFS=y * width + halfStructElem;
-                const size_t lineOffsetUS=y * width;
-                
-                for (size_t x=0; x<widthMinusStructElem; ++x)
-                {
-                    //!@todo Add TTL optimisation from grayscale version above.
-                    size_t offsetUS=(lineOffsetUS + x)*3;
-                    T maxImgValueR=dataReadUS[offsetUS+0];
-                    T maxImgValueG=dataReadUS[offsetUS+1];
-                    T maxImgValueB=dataReadUS[offsetUS+2];
-                    offsetUS+=3;
-                    
-                    for (size_t i=1; i<structElemWidth; ++i)
-                    {
-                        const T &imgValueR = dataReadUS[offsetUS + 0];
-                        const T &imgValueG = dataReadUS[offsetUS + 1];
-                        const T &imgValueB = dataReadUS[offsetUS + 2];
-                        
-                        if (imgValueR>maxImgValueR) maxImgValueR=imgValueR;
-                        if (imgValueG>maxImgValueG) maxImgValueG=imgValueG;
-                        if (imgValueB>maxImgValueB) maxImgValueB=imgValueB;
-                        
-                        offsetUS+=3;
-                    }
-                    
-                    dataScratch[(lineOffsetFS + x)*3 + 0]=maxImgValueR;
-                    dataScratch[(lineOffsetFS + x)*3 + 1]=maxImgValueG;
-                    dataScratch[(lineOffsetFS + x)*3 + 2]=maxImgValueB;
-                }
-            }
-            
-            //Second pass in y.
-            for (size_t y=0; y<heightMinusStructElem; ++y)
-            {
-                const size_t lineOffsetDS=(y+halfStructElem) * width;
-                const size_t lineOffsetFS=y * width;
-                
-                for (size_t x=halfStructElem; x<widthMinusHalfStructElem; ++x)
-                {
-                    //!@todo Add TTL optimisation from grayscale version above.
-                    size_t offsetFS=(lineOffsetFS + x)*3;
-                    T maxImgValueR=dataScratch[offsetFS + 0];
-                    T maxImgValueG=dataScratch[offsetFS + 1];
-                    T maxImgValueB=dataScratch[offsetFS + 2];
-                    offsetFS+=width*3;
-                    
-                    for (size_t j=1; j<structElemWidth; ++j)
-                    {
-                        const T &imgValueR = dataScratch[offsetFS + 0];
-                        const T &imgValueG = dataScratch[offsetFS + 1];
-                        const T &imgValueB = dataScratch[offsetFS + 2];
-                        
-                        if (imgValueR>maxImgValueR) maxImgValueR=imgValueR;
-                        if (imgValueG>maxImgValueG) maxImgValueG=imgValueG;
-                        if (imgValueB>maxImgValueB) maxImgValueB=imgValueB;
-                        
-                        offsetFS+=(width*3);
-                    }
-                    
-                    dataWriteDS[(lineOffsetDS + x)*3 + 0]=maxImgValueR;
-                    dataWriteDS[(lineOffsetDS + x)*3 + 1]=maxImgValueG;
-                    dataWriteDS[(lineOffsetDS + x)*3 + 2]=maxImgValueB;
-                }
-            }
-            
-            return true;
+            return vanHerkFilter(dataWriteDS, dataReadUS, structElemWidth|1, width, height, 3, true, dataScratch);
         }
         
         
-        //!Synchronous process method for T pixel format.
+        //!Synchronous process method for T pixel format. Computes |A-B|, exactly for any T.
         template<typename T>
         bool difference(T * const dataWriteDS,
                         T const * const dataReadUS_A,//Will implement A-B
@@ -1289,7 +1137,7 @@ namespace flitr {
                 
                 for (size_t x=0; x<width; ++x)
                 {
-                    dataWriteDS[lineOffset+x] = std::abs(int16_t(dataReadUS_A[lineOffset+x]) - int16_t(dataReadUS_B[lineOffset+x]));
+                    dataWriteDS[lineOffset+x] = absDifference(dataReadUS_A[lineOffset+x], dataReadUS_B[lineOffset+x]);
                 }
             }
             
@@ -1309,9 +1157,9 @@ namespace flitr {
                 
                 for (size_t x=0; x<width; ++x)
                 {
-                    dataWriteDS[offset + 0] = std::abs(int16_t(dataReadUS_A[offset + 0]) - int16_t(dataReadUS_B[offset + 0]));
-                    dataWriteDS[offset + 1] = std::abs(int16_t(dataReadUS_A[offset + 1]) - int16_t(dataReadUS_B[offset + 1]));
-                    dataWriteDS[offset + 2] = std::abs(int16_t(dataReadUS_A[offset + 2]) - int16_t(dataReadUS_B[offset + 2]));
+                    dataWriteDS[offset + 0] = absDifference(dataReadUS_A[offset + 0], dataReadUS_B[offset + 0]);
+                    dataWriteDS[offset + 1] = absDifference(dataReadUS_A[offset + 1], dataReadUS_B[offset + 1]);
+                    dataWriteDS[offset + 2] = absDifference(dataReadUS_A[offset + 2], dataReadUS_B[offset + 2]);
                     
                     offset+=3;
                 }
@@ -1373,6 +1221,24 @@ namespace flitr {
         }
         
     private:
+        template<typename T>
+        static T absDifference(const T a, const T b)
+        {
+            return (a>b) ? T(a-b) : T(b-a);
+        }
+        
+        //! The CPU erode and dilate, for 1 or 3 channels. See image_processor_utils.cpp.
+        bool vanHerkFilter(uint8_t * const dataWriteDS, uint8_t const * const dataReadUS,
+                           const size_t structElemWidth, const size_t width, const size_t height,
+                           const size_t channels, const bool dilate, uint8_t * const dataScratch) const;
+        bool vanHerkFilter(uint16_t * const dataWriteDS, uint16_t const * const dataReadUS,
+                           const size_t structElemWidth, const size_t width, const size_t height,
+                           const size_t channels, const bool dilate, uint16_t * const dataScratch) const;
+        bool vanHerkFilter(float * const dataWriteDS, float const * const dataReadUS,
+                           const size_t structElemWidth, const size_t width, const size_t height,
+                           const size_t channels, const bool dilate, float * const dataScratch) const;
+        
+        uint32_t maxRowBands_;
         
 #ifdef FLITR_USE_OPENCL
         cl_context _clContext;
@@ -1391,6 +1257,62 @@ namespace flitr {
 #endif
     };
     
+    
+    /*! Median filter over a square window of (2*radius+1) x (2*radius+1) pixels.
+     *
+     *  Pixels beyond the edges take the value of the nearest edge pixel, so the whole image is
+     *  written. Radii 1 and 2 use sorting networks. Larger radii keep histograms of the window:
+     *  for 8 bit images a histogram per column is slid down the image and the window histogram
+     *  is slid along each row by adding one column histogram and removing another (Perreault and
+     *  Hebert), so the cost per pixel does not depend on the radius. 16 bit images have too many
+     *  values for column histograms, so their window histogram is updated pixel by pixel and the
+     *  cost grows linearly with the radius. Bands of rows run in parallel.*/
+    class FLITR_EXPORT MedianFilter
+    {
+    public:
+        
+        MedianFilter(const size_t radius);
+        
+        //!Sets the radius of the window, at most MaxRadius.
+        void setRadius(const size_t radius);
+        
+        size_t getRadius() const
+        {
+            return radius_;
+        }
+        
+        //!The window histograms count up to 65535 pixels.
+        static const size_t MaxRadius=127;
+        
+        //!Set the largest number of row bands an image is split into. Zero, the default, uses every thread of ParallelRowsPool::instance().
+        void setMaxRowBands(const uint32_t maxBands)
+        {
+            maxRowBands_=maxBands;
+        }
+        
+        uint32_t getMaxRowBands() const
+        {
+            return maxRowBands_;
+        }
+        
+        /*! The lineStride of the filter methods is the same as that of BoxFilter. dataWriteDS may
+         *  equal dataReadUS.*/
+        
+        /*!Synchronous process method for uint8_t pixel format.*/
+        bool filter(uint8_t * const dataWriteDS, uint8_t const * const dataReadUS,
+                    const size_t width, const size_t height,
+                    const size_t lineStride=0);
+        
+        /*!Synchronous process method for uint16_t pixel format.*/
+        bool filter(uint16_t * const dataWriteDS, uint16_t const * const dataReadUS,
+                    const size_t width, const size_t height,
+                    const size_t lineStride=0);
+        
+    private:
+        size_t radius_;
+        uint32_t maxRowBands_;
+    };
+    
 }
 
 #endif //IMAGE_PROCESSOR_UTILS_H
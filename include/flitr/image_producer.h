@@ -83,6 +83,19 @@ class FLITR_EXPORT ImageProducer : virtual public Parameters {
         return SharedImageBuffer_->getNumWriteSlotsReserved();
     }
 
+    /**
+     * Block until a write slot can be reserved or the timeout
+     * expires. Used instead of polling getNumWriteSlotsAvailable().
+     *
+     * \param timeout_us Maximum time to wait in microseconds.
+     *
+     * \return True if a write slot is available.
+     */
+    virtual bool waitForWriteSlot(uint32_t timeout_us = FLITR_SHARED_BUFFER_WAIT_TIMEOUT_US)
+    {
+        return SharedImageBuffer_->waitForWriteSlot(timeout_us);
+    }
+
     /** 
      * Typically implemented to tell an asynchronous producer to create an image.
      * 
@@ -134,12 +147,15 @@ class FLITR_EXPORT ImageProducer : virtual public Parameters {
      * Called when a new consumer is added.
      * 
      * \param consumer Consumer that was added.
+     *
+     * \param overflow_policy What to do when the consumer falls behind.
      * 
      * \return Whether the add was successful.
      */
-    virtual bool addConsumer(ImageConsumer& consumer)
+    virtual bool addConsumer(ImageConsumer& consumer,
+                             SharedImageBuffer::OverflowPolicy overflow_policy = SharedImageBuffer::OVERFLOW_LOSSLESS)
     {
-        return SharedImageBuffer_->addConsumer(consumer);
+        return SharedImageBuffer_->addConsumer(consumer, overflow_policy);
     }
 
     /**
@@ -179,6 +195,24 @@ class FLITR_EXPORT ImageProducer : virtual public Parameters {
         SharedImageBuffer_->releaseWriteSlot();
     }
 
+    /** 
+     * Reserve up to max_slots slots for writing with one lock and no
+     * allocation. Used by producers that write bursts of images.
+     * 
+     * \return The reserved slots, oldest first. Empty if no slot
+     * could be obtained.
+     */
+    virtual SlotSpan reserveWriteSlots(uint32_t max_slots) {
+        return SharedImageBuffer_->reserveWriteSlots(max_slots);
+    }
+
+    /** 
+     * Release the oldest num_slots reserved write slots in one go.
+     */
+    virtual void releaseWriteSlots(uint32_t num_slots) {
+        SharedImageBuffer_->releaseWriteSlots(num_slots);
+    }
+
     /// A vector of the formats of the images is produced per slot.
     std::vector<ImageFormat> ImageFormat_;
     
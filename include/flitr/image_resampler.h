@@ -0,0 +1,104 @@
+/* Framework for Live Image Transformation (FLITr)
+ * Copyright (c) 2010 CSIR
+ *
+ * This file is part of FLITr.
+ *
+ * FLITr is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * FLITr is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with FLITr. If not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef IMAGE_RESAMPLER_H
+#define IMAGE_RESAMPLER_H 1
+
+#include <flitr/flitr_export.h>
+#include <flitr/flitr_stdint.h>
+#include <flitr/image.h>
+#include <flitr/image_format.h>
+#include <flitr/pixel_format_converter.h>
+
+#include <vector>
+
+namespace flitr {
+
+    /*! Scales images from one size and pixel format to another.
+     *
+     * The source coordinates and weights of every output row and column are computed once,
+     * when the resampler is constructed, so a frame only does table lookups. Pixels are
+     * resampled in the input pixel format and the rows are then converted with a
+     * PixelFormatConverter. Bands of output rows are processed on ParallelRowsPool::instance().
+     *
+     * A resampler is not changed by resample(), so one may be used by many threads. */
+    class FLITR_EXPORT ImageResampler
+    {
+    public:
+        enum Filter {
+            /*! The input pixel under the top left corner of the output pixel.*/
+            FILTER_NEAREST=0,
+            /*! Linear interpolation between the four nearest input pixels.*/
+            FILTER_BILINEAR,
+            /*! Mean of the input pixels covered by the output pixel. Best for shrinking.*/
+            FILTER_AREA
+        };
+
+        /*! Constructor that computes the coordinate tables.
+         *@param in_format Format of the images to resample.
+         *@param out_format Format of the resampled images.
+         *@param filter The resampling filter.*/
+        ImageResampler(const ImageFormat& in_format, const ImageFormat& out_format, Filter filter = FILTER_NEAREST);
+
+        /*! True if the pixel formats can be converted.*/
+        bool isSupported() const { return Converter_.isSupported(); }
+
+        /*! True if this resampler was made for the given formats and filter.*/
+        bool matches(const ImageFormat& in_format, const ImageFormat& out_format, Filter filter) const;
+
+        Filter getFilter() const { return Filter_; }
+
+        /*! Resample in to out. The images must have the formats given to the constructor.
+         *@param max_bands Upper limit on the number of row bands. Zero for one per thread of the pool.*/
+        void resample(const Image& in, Image& out, uint32_t max_bands = 0) const;
+
+    private:
+        /*! Source pixels of output columns or rows. Nearest uses Begin. Bilinear blends Begin
+         * and End with Weight on End. Area averages [Begin, End) with Weight being one over the count.*/
+        struct Axis {
+            std::vector<uint32_t> Begin;
+            std::vector<uint32_t> End;
+            std::vector<float> Weight;
+        };
+
+        static void buildAxis(Axis& axis, uint32_t in_size, uint32_t out_size, Filter filter);
+
+        template<typename T>
+        void resampleRows(const Image& in, Image& out, size_t begin, size_t end) const;
+
+        template<typename T>
+        void horizontalPass(T const * in, float * out) const;
+
+        ImageFormat InFormat_;
+        ImageFormat OutFormat_;
+        Filter Filter_;
+        PixelFormatConverter Converter_;
+
+        /*! Channels per pixel and bytes per channel of the input format.*/
+        uint32_t Channels_;
+        uint32_t BytesPerChannel_;
+
+        Axis Columns_;
+        Axis Rows_;
+    };
+
+}
+
+#endif //IMAGE_RESAMPLER_H
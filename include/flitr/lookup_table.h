@@ -0,0 +1,119 @@
+/* Framework for Live Image Transformation (FLITr)
+ * Copyright (c) 2010 CSIR
+ *
+ * This file is part of FLITr.
+ *
+ * FLITr is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * FLITr is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with FLITr. If not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef LOOKUP_TABLE_H
+#define LOOKUP_TABLE_H 1
+
+#include <flitr/flitr_export.h>
+#include <flitr/flitr_stdint.h>
+#include <flitr/image.h>
+#include <flitr/image_format.h>
+
+#include <cstddef>
+#include <vector>
+
+namespace flitr {
+
+    class PointOpChain;
+
+    /*! Maps every value of integer images through a table.
+     *
+     * Any point operation on 8 or 16 bit values, e.g. a tone map, a gain or a histogram
+     * stretch or match, becomes a table build and one memory bound pass. The tables have
+     * 256 entries for Y_8, RGB_8 and BGR images, whose channels all use the same table,
+     * and 65536 entries for Y_16 images.
+     *
+     * The row kernel is chosen once, when the table is constructed. 8 bit tables are looked
+     * up with AVX-512 VBMI byte permutes or NEON table lookups and 16 bit tables with AVX2
+     * gathers, picked for the CPU at run time. Bands of rows are processed on
+     * ParallelRowsPool::instance().
+     *@sa isAvx512VbmiEnabled
+     *
+     * apply() does not change the table, so one may be used by many threads.*/
+    class FLITR_EXPORT LookupTable
+    {
+    public:
+        /*! Function that looks up n values.*/
+        typedef void (*Row8Function)(uint8_t const * in, uint8_t * out, size_t n, uint8_t const * table);
+        typedef void (*Row16Function)(uint16_t const * in, uint16_t * out, size_t n, uint16_t const * table);
+
+        /*! Constructor that chooses the row kernel and sets the identity table.
+         *@param pix_fmt The pixel format of the images, which is the same for input and output.*/
+        LookupTable(ImageFormat::PixelFormat pix_fmt);
+
+        /*! True if the pixel format has a table.*/
+        bool isSupported() const { return getNumEntries() != 0; }
+
+        ImageFormat::PixelFormat getFormat() const { return Format_; }
+
+        /*! The number of entries of the table: 256, 65536 or zero if the format is not supported.*/
+        size_t getNumEntries() const { return (Row8_ != 0) ? 256 : ((Row16_ != 0) ? 65536 : 0); }
+
+        /*! Name of the chosen row kernel, e.g. "avx512vbmi" or "scalar". Empty if not supported.*/
+        const char* getKernelName() const { return KernelName_; }
+
+        /*! Set the table of an 8 bit format.
+         *@return False if the format is not 8 bit or the table does not have 256 entries.*/
+        bool setTable(const std::vector<uint8_t>& table);
+
+        /*! Set the table of a 16 bit format.
+         *@return False if the format is not 16 bit or the table does not have 65536 entries.*/
+        bool setTable(const std::vector<uint16_t>& table);
+
+        /*! Set the table to the result of a chain of point operations on every value.
+         *@return False if the chain does not convert the format of this table to itself.*/
+        bool setTable(const PointOpChain& chain);
+
+        /*! The 8 bit table. Empty for 16 bit formats.*/
+        const std::vector<uint8_t>& getTable8() const { return Table8_; }
+
+        /*! The 16 bit table, with one more entry than getNumEntries() for the row kernels. Empty for 8 bit formats.*/
+        const std::vector<uint16_t>& getTable16() const { return Table16_; }
+
+        /*! Look up one row of width pixels. The rows may be the same, but may not overlap otherwise.*/
+        void applyRow(uint8_t const * in, uint8_t * out, size_t width) const;
+
+        /*! Look up height rows of width pixels, with the given distances in bytes between rows.
+         *@param max_bands Upper limit on the number of row bands. Zero for one per thread of the pool.*/
+        void apply(uint8_t const * in, size_t in_bytes_per_line,
+                   uint8_t * out, size_t out_bytes_per_line,
+                   size_t width, size_t height, uint32_t max_bands = 0) const;
+
+        /*! Look up an image, writing another of the same size and format, or itself.
+         *@return False if the formats do not match the table or the sizes differ.*/
+        bool apply(const Image& in, Image& out, uint32_t max_bands = 0) const;
+
+    private:
+        ImageFormat::PixelFormat Format_;
+
+        /*! Values per pixel.*/
+        size_t ValuesPerPixel_;
+
+        Row8Function Row8_;
+        Row16Function Row16_;
+        const char* KernelName_;
+
+        std::vector<uint8_t> Table8_;
+        std::vector<uint16_t> Table16_;
+    };
+
+}
+
+#endif //LOOKUP_TABLE_H
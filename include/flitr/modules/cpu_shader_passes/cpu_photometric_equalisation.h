@@ -2,9 +2,11 @@
 #define CPU_PHOTOMETRIC_EQUALISATION_SHADER 1
 
 #include <flitr/flitr_export.h>
+#include <flitr/lookup_table.h>
 #include <flitr/modules/cpu_shader_passes/cpu_shader_pass.h>
 #include <flitr/stats_collector.h>
 #include <memory>
+#include <vector>
 
 
 namespace flitr {
@@ -45,7 +47,6 @@ namespace flitr {
                 uint64_t sum1 = 0;
 
                 const uint32_t numElements = numPixels*numComponents;
-                const uint32_t numElementsDiv2 = numElements >> 1;
 
 
 
@@ -65,7 +66,7 @@ namespace flitr {
 
 
                 //=== set up lookup table for equalisation ===
-                unsigned char remap[256];
+                std::vector<uint8_t> remap(256);
                 for (int i = 0; i<256; i++)
                 {
                     const double equalisedValue = i*ef + 0.5;
@@ -73,25 +74,11 @@ namespace flitr {
                 }
                 //=== ===
 
-
-#pragma omp parallel sections
-            {
-#pragma omp section
-                {
-                    for (uint32_t i = 0; i<numElementsDiv2; i++)
-                    {
-                        data[i] = remap[data[i]];
-                    }
-                }
-
-#pragma omp section
-                {
-                    for (uint32_t i = numElementsDiv2; i<numElements; i++)
-                    {
-                        data[i] = remap[data[i]];
-                    }
-                }
-            }
+                // The components of a row are looked up as one row of grey pixels, in bands of rows.
+                LookupTable lut(ImageFormat::FLITR_PIX_FMT_Y_8);
+                lut.setTable(remap);
+                const size_t rowElements = width*numComponents;
+                lut.apply(data, rowElements, data, rowElements, rowElements, height);
 
             Image_->dirty();
 
@@ -141,7 +141,9 @@ namespace flitr {
         uint8_t *_noiseFilteredInputData;
         
         uint8_t *_scratchData;
-        double *_integralImageScratchData;
+        
+        //!Integral image. Double sums for float images, exact 32 bit sums for 8 bit ones.
+        uint8_t *_integralImageScratchData;
         
         BoxFilterII _boxFilter; //No significant state associated with this.
         
@@ -25,7 +25,13 @@
 
 namespace flitr {
     
-    /*! Calculates the average image on the CPU. The performance is independent of the number of frames. */
+    /*! Calculates the average image on the CPU. The performance is independent of the number of frames.
+     *
+     * The average is a running sum of the window: every frame adds the new image and subtracts the
+     * image that leaves the window, which is kept in a history ring buffer. Y_8, RGB_8, BGR, BGRA,
+     * RGBA and Y_16 images keep their history in their own precision and an exact integer sum, and
+     * the average is rounded to the nearest integer. Y_F32 and RGB_F32 images keep a float sum, which
+     * is recomputed from the history every getRecomputeInterval() frames so that it does not drift. */
     class FLITR_EXPORT FIPAverageImage : public ImageProcessor
     {
     public:
@@ -33,6 +39,7 @@ namespace flitr {
         /*! Constructor given the upstream producer.
          *@param upStreamProducer The upstream image producer.
          *@param images_per_slot The number of images per image slot from the upstream producer.
+         *@param base2WindowLength Log2 of the number of frames in the window. At most 16 for Y_16 and 24 for 8 bit images.
          *@param buffer_size The size of the shared image buffer of the downstream producer.*/
         FIPAverageImage(ImageProducer& upStreamProducer, uint32_t images_per_slot,
                         uint8_t base2WindowLength,
@@ -54,19 +61,47 @@ namespace flitr {
             return Title_;
         }
         
+        /*! Set the number of frames after which the float sums are recomputed from the history.
+         *  Every frame recomputes one row in recomputeInterval, so the cost is spread evenly.
+         *  Zero never recomputes. Defaults to 16 window lengths, which costs about as much
+         *  as reading one more image every 16 frames.*/
+        void setRecomputeInterval(size_t recomputeInterval)
+        {
+            recomputeInterval_=recomputeInterval;
+        }
+        
+        size_t getRecomputeInterval() const
+        {
+            return recomputeInterval_;
+        }
+        
     private:
+        /*! Update the float sum and history of image imgNum and write the average.*/
+        void updateAverageF32(size_t imgNum, Image const * const imRead, Image * const imWrite);
+        
+        /*! Update the integer sum and history of image imgNum and write the average.
+         *  P is the type of a component and S that of the sum.*/
+        template<typename P, typename S>
+        void updateAverage(size_t imgNum, Image const * const imRead, Image * const imWrite);
+        
         const uint8_t base2WindowLength_;
         const size_t windowLength_;
         const float recipWindowLength_;
         std::string Title_;
-
-        /*! The sum images per slot. */
-        std::vector<float *> sumImageVec_;
         
-        /*! The history ring buffer/vector for each image in the slot. */
-        std::vector<std::vector<float * > > historyImageVecVec_;
+        size_t recomputeInterval_;
+        
+        /*! The sum images per slot. float for float images, uint16_t or uint32_t for integer ones. */
+        std::vector<uint8_t *> sumImageVec_;
+        
+        /*! The history ring buffer for each image in the slot, in the precision of the image.
+         *  One image per ring buffer slot, one after the other in memory. */
+        std::vector<uint8_t *> historyImageVec_;
         
         size_t oldestHistorySlot_;
+        
+        //! Number of frames processed, which selects the rows to recompute.
+        size_t triggerCount_;
     };
     
 }
@@ -25,19 +25,40 @@
 
 namespace flitr {
     
-    /*! Calculates the beat image on the CPU. The performance is independent of the number of frames. */
+    /*! Calculates the beat image on the CPU. The performance is independent of the number of frames.
+     *
+     * Each output image is the power of one bin of the DFT of the last 2^base2WindowLength frames
+     * of every pixel, times 2.625 plus 0.5. The bins are updated with a sliding DFT: a new frame
+     * replaces the oldest one in the history, and the difference between the two is added to every
+     * bin with the twiddle factor of the history slot. Every frame also recomputes one row in
+     * windowLength directly from the history, so that rounding errors do not build up.
+     *
+     * The slot holds one image per bin for every upstream image, see getBeatImageIndex(). The
+     * channels of RGB_F32 images are processed independently. */
     class FLITR_EXPORT FIPBeatImage : public ImageProcessor
     {
     public:
         
-        /*! Constructor given the upstream producer.
+        /*! Constructor given the upstream producer. Outputs bin 2 of every upstream image.
          *@param upStreamProducer The upstream image producer.
          *@param images_per_slot The number of images per image slot from the upstream producer.
+         *@param base2WindowLength Log2 of the number of frames in the window.
          *@param buffer_size The size of the shared image buffer of the downstream producer.*/
         FIPBeatImage(ImageProducer& upStreamProducer, uint32_t images_per_slot,
                         uint8_t base2WindowLength,
                         uint32_t buffer_size=FLITR_DEFAULT_SHARED_BUFFER_NUM_SLOTS);
         
+        /*! Constructor given the upstream producer and the bins to output.
+         *@param upStreamProducer The upstream image producer.
+         *@param images_per_slot The number of images per image slot from the upstream producer.
+         *@param base2WindowLength Log2 of the number of frames in the window.
+         *@param beatBins The DFT bins to output, each less than the window length. Bin k beats k times per window.
+         *@param buffer_size The size of the shared image buffer of the downstream producer.*/
+        FIPBeatImage(ImageProducer& upStreamProducer, uint32_t images_per_slot,
+                        uint8_t base2WindowLength,
+                        const std::vector<size_t>& beatBins,
+                        uint32_t buffer_size=FLITR_DEFAULT_SHARED_BUFFER_NUM_SLOTS);
+        
         /*! Virtual destructor */
         virtual ~FIPBeatImage();
         
@@ -49,82 +70,36 @@ namespace flitr {
          *@sa ImageProcessor::startTriggerThread*/
         virtual bool trigger();
         
-    private:
+        const std::vector<size_t>& getBeatBins() const
+        {
+            return beatBins_;
+        }
         
-        /*! Replaces data[1..2*nn] by its discrete Fourier transform, if isign is input as 1; or 
-         replaces data[1..2*nn] by nn times its inverse discrete Fourier transform, if isign is 
-         input as −1. data is a complex array of length nn or, equivalently, a real array of length 
-         2*nn. nn MUST be an integer power of 2 (this is not checked for!). */
-        void four1(float * const data, uint32_t nn, int32_t isign)
+        /*! Index in the slot of the image of bin beatBins[binIndex] of upstream image imgNum.*/
+        size_t getBeatImageIndex(size_t imgNum, size_t binIndex) const
         {
-            unsigned long n,mmax,m,j,istep,i;
-            double wtemp,wr,wpr,wpi,wi,theta;
-            float tempr,tempi;
-            
-            n=nn << 1;
-            j=1;
-            
-            for (i=1;i<n;i+=2)
-            {
-                if (j > i)
-                {
-                    std::swap(data[j],data[i]);
-                    std::swap(data[j+1],data[i+1]);
-                }
-                m=nn;
-                while (m >= 2 && j > m)
-                {
-                    j -= m;
-                    m >>= 1;
-                }
-                
-                j += m;
-            }
-            
-            mmax=2;
-            
-            while (n > mmax)
-            {
-                istep=mmax << 1; theta=isign*(6.28318530717959/mmax); wtemp=sin(0.5*theta);
-                wpr = -2.0*wtemp*wtemp;
-                
-                wpi=sin(theta);
-                wr=1.0;
-                wi=0.0;
-                
-                for (m=1;m<mmax;m+=2)
-                {
-                    for (i=m;i<=n;i+=istep)
-                    {
-                        j=i+mmax;
-                        tempr=wr*data[j]-wi*data[j+1];
-                        tempi=wr*data[j+1]+wi*data[j];
-                        data[j]=data[i]-tempr;
-                        data[j+1]=data[i+1]-tempi;
-                        data[i] += tempr;
-                        data[i+1] += tempi;
-                    }
-                    
-                    wr=(wtemp=wr)*wpr-wi*wpi+wr;
-                    wi=wi*wpr+wtemp*wpi+wi;
-                }
-                
-                mmax=istep;
-            }
+            return imgNum*beatBins_.size() + binIndex;
         }
         
+    private:
         const uint8_t base2WindowLength_;
         const size_t windowLength_;
+        const std::vector<size_t> beatBins_;
+        const uint32_t numSources_;
         
-        /*! The history ring buffer/vector for each image in the slot. Ring buffer slots next to each other in memory!*/
+        /*! The history ring buffer/vector for each image in the slot. One image per ring buffer slot, one after the other in memory.*/
         std::vector<float * > historyImageVec_;
         
-        /*! The beat ring buffer/vector for each image in the slot. */
+        /*! The bins for each image in the slot. The real and then the imaginary image of every bin, one after the other in memory.*/
         std::vector<float * > beatImageVec_;
         
+        /*! cos and sin of 2*pi*bin*slot/windowLength for every bin and ring buffer slot.*/
+        std::vector<float> twiddleCos_;
+        std::vector<float> twiddleSin_;
+        
         size_t oldestHistorySlot_;
     };
     
 }
 
-#endif //FIP_AVERAGE_IMAGE_H
+#endif //FIP_BEAT_IMAGE_H
@@ -22,6 +22,7 @@
 #define FIP_CNVRT_TO_RGB8_H 1
 
 #include <flitr/image_processor.h>
+#include <flitr/pixel_format_converter.h>
 
 namespace flitr {
     
@@ -52,6 +53,9 @@ namespace flitr {
     private:
         const float scaleFactor_;
 	std::string Title_;
+        
+        //! The converter of each image, chosen in init() for its upstream pixel format.
+        std::vector<PixelFormatConverter> Converters_;
     };
     
 }
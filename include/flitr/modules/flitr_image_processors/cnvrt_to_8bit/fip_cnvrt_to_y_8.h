@@ -22,6 +22,7 @@
 #define FIP_CNVRT_TO_Y8_H 1
 
 #include <flitr/image_processor.h>
+#include <flitr/pixel_format_converter.h>
 
 namespace flitr {
     
@@ -49,9 +50,18 @@ namespace flitr {
          *@sa ImageProcessor::startTriggerThread*/
         virtual bool trigger();
         
+        /*! Frames are processed independently, so setNumFrameWorkers() may be used.*/
+        virtual bool isStateless() const { return true; }
+        
+    protected:
+        virtual void processFrame(const std::vector<Image**>& imvRead, const std::vector<Image**>& imvWrite);
+        
     private:
         const float scaleFactor_;
 	std::string Title_;
+        
+        //! The converter of each image, chosen in init() for its upstream pixel format.
+        std::vector<PixelFormatConverter> Converters_;
     };
     
 }
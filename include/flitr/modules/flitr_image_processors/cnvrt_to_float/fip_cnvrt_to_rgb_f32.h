@@ -22,6 +22,7 @@
 #define FIP_CNVRT_TO_RGBF32_H 1
 
 #include <flitr/image_processor.h>
+#include <flitr/pixel_format_converter.h>
 
 namespace flitr {
     
@@ -56,6 +57,9 @@ namespace flitr {
         
     private:
         std::string Title_;
+        
+        //! The converter of each image, chosen in init() for its upstream pixel format.
+        std::vector<PixelFormatConverter> Converters_;
     };
     
 }
@@ -22,6 +22,7 @@
 #define FIP_CNVRT_TO_YF32_H 1
 
 #include <flitr/image_processor.h>
+#include <flitr/pixel_format_converter.h>
 
 namespace flitr {
     
@@ -49,6 +50,9 @@ namespace flitr {
         virtual bool trigger();
         
     private:
+        
+        //! The converter of each image, chosen in init() for its upstream pixel format.
+        std::vector<PixelFormatConverter> Converters_;
     };
     
 }
@@ -23,6 +23,8 @@
 
 #include <flitr/image_processor_utils.h>
 #include <flitr/image_processor.h>
+#include <flitr/gaussian_pyramid.h>
+#include <flitr/modules/flitr_image_processors/gaussian_pyramid/fip_gaussian_pyramid.h>
 
 #include <mutex>
 
@@ -42,6 +44,17 @@ namespace flitr {
                     const float avrgImageLongevity,
                     uint32_t buffer_size=FLITR_DEFAULT_SHARED_BUFFER_NUM_SLOTS);
         
+        /*! Constructor that uses the finest five levels and the gradients of an upstream
+         *  FIPGaussianPyramid instead of computing its own pyramid. The first image of the
+         *  pyramid's slots is dewarped. The levels are used as they are, without the light
+         *  Gaussian filter and 2x2 averaging of the processor's own pyramid.
+         *@param upStreamPyramid The upstream pyramid producer, which must have gradients and at least five levels.
+         *@param avrgImageLongevity Filter constant for how strong the averaging of the reference image is.
+         *@param buffer_size The size of the shared image buffer of the downstream producer.*/
+        FIPLKDewarp(FIPGaussianPyramid& upStreamPyramid,
+                    const float avrgImageLongevity,
+                    uint32_t buffer_size=FLITR_DEFAULT_SHARED_BUFFER_NUM_SLOTS);
+        
         /*! Virtual destructor */
         virtual ~FIPLKDewarp();
         
@@ -147,14 +160,15 @@ namespace flitr {
         
         const size_t numLevels_;
         
-        //!Scale space stack of input images - Gaussian filter downsampled.
-        std::vector<float *> imgVec_;
+        //!Upstream pyramid producer, or null if the pyramid is computed here.
+        FIPGaussianPyramid * const upstreamPyramid_;
+        
+        //!Scale space stack of input images - Gaussian filter downsampled. Used if there is no upstream pyramid.
+        GaussianPyramid *pyramid_;
         
         //!Scale space stack of average reference images.
         std::vector<float *> refImgVec_;
         
-        std::vector<float *> dxVec_;
-        std::vector<float *> dyVec_;
         std::vector<float *> dSqRecipVec_;
         
         std::vector<float *> hxVec_;
@@ -164,7 +178,6 @@ namespace flitr {
         //float *avrgHyData_;
         
         GaussianFilter gaussianFilter_;
-        GaussianDownsample gaussianDownsample_;
 
         GaussianFilter gaussianReguFilter_;
         
@@ -55,9 +55,6 @@ namespace flitr {
         virtual bool trigger();
         
     private:
-        /*! The result of the first pass of the seperable Gaussian downsample. */
-        float *xFiltData_;
-        
         GaussianDownsample gaussianDownsample_;
     };
     
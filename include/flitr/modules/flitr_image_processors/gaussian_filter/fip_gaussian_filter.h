@@ -53,9 +53,25 @@ namespace flitr {
          @sa getStandardDeviation */
         virtual void setKernelWidth(const int kernelWidth);
         
+        /*!Use RecursiveGaussianFilter instead of the kernel or box filters. Its cost does not depend on the
+         filter radius, so it suits large radii. The kernel width and approxIterations are then ignored.*/
+        void setUseRecursiveFilter(const bool useRecursive)
+        {
+            _useRecursive=useRecursive;
+        }
+        
+        bool getUseRecursiveFilter() const
+        {
+            return _useRecursive;
+        }
+        
         //Returns the Gaussian standard deviation or approximate boxfilter Gaussian.
         float getStandardDeviation() const
         {
+            if (_useRecursive)
+            {
+                return _recursiveFilter.getStandardDeviation();
+            } else
             if (_approxIterations==0)
             {
                 return _gaussianFilter.getStandardDeviation();
@@ -181,12 +197,16 @@ namespace flitr {
         uint8_t *_scratchData;
         
         GaussianFilter _gaussianFilter; //No significant state associated with this.
+        
+        bool _useRecursive;
+        RecursiveGaussianFilter _recursiveFilter;
 
 
 #define APPROX_GAUSS_FILT_USE_INTEGRAL_IMAGES
 
 #ifdef APPROX_GAUSS_FILT_USE_INTEGRAL_IMAGES
-        double *_intImageScratchData;
+        //!Integral image. Double sums for float images, exact 32 bit sums for 8 bit ones.
+        uint8_t *_intImageScratchData;
         BoxFilterII _boxFilter;//No significant state associated with this.
 #else
         BoxFilterRS _boxFilter;//No significant state associated with this.
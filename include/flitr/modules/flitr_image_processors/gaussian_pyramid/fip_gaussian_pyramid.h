@@ -0,0 +1,97 @@
+/* Framework for Live Image Transformation (FLITr)
+ * Copyright (c) 2010 CSIR
+ *
+ * This file is part of FLITr.
+ *
+ * FLITr is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * FLITr is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with FLITr. If not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef FIP_GAUSSIAN_PYRAMID_H
+#define FIP_GAUSSIAN_PYRAMID_H 1
+
+#include <flitr/image_processor.h>
+#include <flitr/gaussian_pyramid.h>
+
+namespace flitr {
+
+    /*! Computes the Gaussian pyramid of every image once, for all the processors downstream.
+     *
+     * For every upstream image the slot holds the upstream image itself, shared and not
+     * copied, followed by the Y_F32 image of every level and, if gradients are enabled,
+     * its x and y Scharr gradients. Use getSourceIndex() and getLevelIndex() to find them.
+     * RGB_F32 images are converted using the green channel, as the LK processors do.
+     *
+     * Level 0 is the centre of the upstream image cropped to a multiple of 2^(numLevels-1)
+     * pixels, so that every level is exactly half the size of the one above.
+     *@sa GaussianPyramid, FIPLKStabilise, FIPLKDewarp */
+    class FLITR_EXPORT FIPGaussianPyramid : public ImageProcessor
+    {
+    public:
+        enum class Plane : uint8_t { IMAGE = 0, DX = 1, DY = 2 };
+
+        /*! Constructor given the upstream producer.
+         *@param upStreamProducer The upstream image producer.
+         *@param images_per_slot The number of images per image slot from the upstream producer.
+         *@param numLevels Number of levels including level 0. Zero for GaussianPyramid::getMaxLevels().
+         *@param gradients Also produce the gradient images of every level.
+         *@param buffer_size The size of the shared image buffer of the downstream producer.*/
+        FIPGaussianPyramid(ImageProducer& upStreamProducer, uint32_t images_per_slot,
+                           size_t numLevels=0,
+                           bool gradients=true,
+                           uint32_t buffer_size=FLITR_DEFAULT_SHARED_BUFFER_NUM_SLOTS);
+
+        /*! Virtual destructor */
+        virtual ~FIPGaussianPyramid();
+
+        size_t getNumLevels() const { return NumLevels_; }
+        bool hasGradients() const { return PlanesPerLevel_==3; }
+
+        /*! Index in the slot of upstream image imgNum.*/
+        size_t getSourceIndex(size_t imgNum) const { return imgNum*ImagesPerSource_; }
+
+        /*! Index in the slot of a level of upstream image imgNum.*/
+        size_t getLevelIndex(size_t imgNum, size_t level, Plane plane=Plane::IMAGE) const
+        {
+            return getSourceIndex(imgNum) + 1 + level*PlanesPerLevel_ + static_cast<size_t>(plane);
+        }
+
+        /*! Set the downsampling kernel before init(). Defaults to GaussianPyramid::binomialKernel().*/
+        void setKernel(const std::vector<float>& kernel) { Kernel_=kernel; }
+
+        /*! Method to initialise the object.
+         *@return Boolean result flag. True indicates successful initialisation.*/
+        virtual bool init();
+
+        /*!Synchronous trigger method. Called automatically by the trigger thread in ImageProcessor base class if started.
+         *@sa ImageProcessor::startTriggerThread*/
+        virtual bool trigger();
+
+        /*! Frames are processed independently, so setNumFrameWorkers() may be used.*/
+        virtual bool isStateless() const { return true; }
+
+    protected:
+        virtual void processFrame(const std::vector<Image**>& imvRead, const std::vector<Image**>& imvWrite);
+
+    private:
+        const uint32_t NumSources_;
+        const size_t NumLevels_;
+        const size_t PlanesPerLevel_;
+        const size_t ImagesPerSource_;
+        std::vector<float> Kernel_;
+    };
+
+}
+
+#endif //FIP_GAUSSIAN_PYRAMID_H
@@ -0,0 +1,92 @@
+/* Framework for Live Image Transformation (FLITr)
+ * Copyright (c) 2010 CSIR
+ *
+ * This file is part of FLITr.
+ *
+ * FLITr is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * FLITr is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with FLITr. If not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef FIP_LOOKUP_TABLE_H
+#define FIP_LOOKUP_TABLE_H 1
+
+#include <flitr/image_processor.h>
+#include <flitr/lookup_table.h>
+#include <flitr/point_op_chain.h>
+
+#include <memory>
+#include <mutex>
+
+namespace flitr {
+
+    /*! Maps the values of Y_8, RGB_8, BGR and Y_16 images through a table.
+     *
+     * The tables start as the identity and may be changed while the processor runs, e.g.
+     * to the stretch or match maps of MultiCPUHistogramConsumer every few frames. A frame
+     * uses the tables that were set when its processing started.
+     *@sa LookupTable */
+    class FLITR_EXPORT FIPLookupTable : public ImageProcessor
+    {
+    public:
+
+        /*! Constructor given the upstream producer.
+         *@param upStreamProducer The upstream image producer.
+         *@param images_per_slot The number of images per image slot from the upstream producer.
+         *@param buffer_size The size of the shared image buffer of the downstream producer.*/
+        FIPLookupTable(ImageProducer& upStreamProducer, uint32_t images_per_slot,
+                       uint32_t buffer_size=FLITR_DEFAULT_SHARED_BUFFER_NUM_SLOTS);
+
+        /*! Virtual destructor */
+        virtual ~FIPLookupTable();
+
+        /*! Set the 256 entry table of the 8 bit images.
+         *@return False if no image is 8 bit or the table does not have 256 entries.*/
+        bool setTable(const std::vector<uint8_t>& table);
+
+        /*! Set the 65536 entry table of the 16 bit images.
+         *@return False if no image is 16 bit or the table does not have 65536 entries.*/
+        bool setTable(const std::vector<uint16_t>& table);
+
+        /*! Set the tables to the results of a chain of point operations.
+         *@return False if no image has the chain's input and output format.*/
+        bool setTable(const PointOpChain& chain);
+
+        /*! Method to initialise the object.
+         *@return Boolean result flag. True indicates successful initialisation.*/
+        virtual bool init();
+
+        /*!Synchronous trigger method. Called automatically by the trigger thread in ImageProcessor base class if started.
+         *@sa ImageProcessor::startTriggerThread*/
+        virtual bool trigger();
+
+        /*! Frames are processed independently, so setNumFrameWorkers() may be used.*/
+        virtual bool isStateless() const { return true; }
+
+    protected:
+        virtual void processFrame(const std::vector<Image**>& imvRead, const std::vector<Image**>& imvWrite);
+
+    private:
+        /*! Replace the tables of the images for which set() succeeds on a copy.*/
+        template<typename F>
+        bool updateTables(F set);
+
+        /*! One table per image of a slot. Replaced, never changed, so that frames being
+         * processed keep the table they started with.*/
+        std::vector< std::shared_ptr<const LookupTable> > Tables_;
+        std::mutex TablesMutex_;
+    };
+
+}
+
+#endif //FIP_LOOKUP_TABLE_H
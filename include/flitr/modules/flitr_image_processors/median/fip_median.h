@@ -22,17 +22,21 @@
 #define FIP_MEDIAN_H 1
 
 #include <flitr/image_processor.h>
+#include <flitr/image_processor_utils.h>
 
 namespace flitr {
     
     
-    /*! Compute Median of image. Currently assumes 8-bit mono input! */
+    /*! Median filter, e.g. to remove impulse noise. Supports Y_8 and Y_16 and filters every image of a slot.
+     *  The window is (2*filterSize-1) x (2*filterSize-1) pixels. Other pixel formats are copied unchanged.
+     *@sa MedianFilter */
     class FLITR_EXPORT FIPMedian : public ImageProcessor
     {
     public:
         
         /*! Constructor given the upstream producer.
          *@param producer The upstream image producer.
+         *@param filterSize Half the window width, rounded up. 1 passes images through.
          *@param images_per_slot The number of images per image slot from the upstream producer.
          *@param buffer_size The size of the shared image buffer of the downstream producer.*/
         FIPMedian(ImageProducer& upStreamProducer, uint32_t filterSize,
@@ -52,8 +56,10 @@ namespace flitr {
         
     private:
         uint32_t filterSize_;
+        
+        MedianFilter medianFilter_;
     };
     
 }
 
-#endif //FIP_DPT_H
+#endif //FIP_MEDIAN_H
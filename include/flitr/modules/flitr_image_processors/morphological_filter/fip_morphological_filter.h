@@ -27,7 +27,9 @@
 
 namespace flitr {
     
-    /*! Applies Gaussian filter with radius approx. 5 pixels. */
+    /*! Applies a sequence of morphological passes, e.g. erode then dilate then subtract from the source
+     * for a top-hat filter. Supports Y_8, Y_16, Y_F32, RGB_8 and RGB_F32. Without OpenCL, erode and
+     * dilate cost the same whatever the structuring element size. */
     class FLITR_EXPORT FIPMorphologicalFilter : public ImageProcessor
     {
     public:
@@ -76,7 +78,7 @@ namespace flitr {
             {
                 const MorphoPass morphoPass=morphoPassVec_[morphoPassNum];
                 
-                T * tempWriteDS=(morphoPassNum==(numMorphoPasses-1)) ? dataWriteDS : ((T *)passScratchData_[morphoPassNum]);
+                T * tempWriteDS=(morphoPassNum==(numMorphoPasses-1)) ? dataWriteDS : ((T *)passScratchData_[morphoPassNum&1]);
                 
                 switch (morphoPass)
                 {
@@ -125,7 +127,7 @@ namespace flitr {
             {
                 const MorphoPass morphoPass=morphoPassVec_[morphoPassNum];
                 
-                T * tempWriteDS=(morphoPassNum==(numMorphoPasses-1)) ? dataWriteDS : ((T *)passScratchData_[morphoPassNum]);
+                T * tempWriteDS=(morphoPassNum==(numMorphoPasses-1)) ? dataWriteDS : ((T *)passScratchData_[morphoPassNum&1]);
                 
                 switch (morphoPass)
                 {
@@ -144,6 +146,7 @@ namespace flitr {
                                                            dataReadUS,//source
                                                            tempReadUS,//previous result
                                                            width, height);
+                        break;
                     case MorphoPass::MINUS_SOURCE:
                         morphologicalFilter_.differenceRGB(tempWriteDS,
                                                            tempReadUS,//previous result
@@ -23,21 +23,134 @@
 
 #include <flitr/image_processor.h>
 #include <flitr/image_processor_utils.h>
+#include <flitr/image_metadata.h>
 #include <math.h>
 
+#include <memory>
+#include <sstream>
+#include <vector>
+
 namespace flitr {
     
-    /*! Applies Gaussian filter. */
+    /*! A group of connected detection cells of FIPMotionDetect. */
+    struct MotionBlob {
+        //! Bounding box in pixels.
+        uint32_t Left;
+        uint32_t Top;
+        uint32_t Width;
+        uint32_t Height;
+        
+        //! Number of pixels in the blob's cells that moved in this frame.
+        uint32_t Area;
+    };
+    
+    /*! Metadata that FIPMotionDetect attaches to its output images.
+     *
+     * Wraps the metadata passed on from the upstream image, which is streamed after the motion
+     * data. The streamed size has to be the same for every frame, so only the MaxStreamedBlobs
+     * largest blobs are streamed. */
+    class FLITR_EXPORT MotionDetectMetadata : public ImageMetadata {
+    public:
+        static const uint32_t MaxStreamedBlobs=16;
+        
+        MotionDetectMetadata() : ImageMetadata(), MotionScore_(0.0f) {}
+        
+        virtual ~MotionDetectMetadata() {}
+        
+        virtual bool writeToStream(std::ostream& s) const
+        {
+            const uint32_t numBlobs=(Blobs_.size()<MaxStreamedBlobs) ? uint32_t(Blobs_.size()) : MaxStreamedBlobs;
+            s.write((char *)&MotionScore_, sizeof(MotionScore_));
+            s.write((char *)&numBlobs, sizeof(numBlobs));
+            for (uint32_t i=0; i<MaxStreamedBlobs; ++i)
+            {
+                const MotionBlob blob=(i<numBlobs) ? Blobs_[i] : MotionBlob();
+                s.write((char *)&blob, sizeof(blob));
+            }
+            return Upstream_ ? Upstream_->writeToStream(s) : true;
+        }
+        
+        virtual bool readFromStream(std::istream& s) const
+        {
+            //readFromStream() is const in ImageMetadata, but has to fill in the metadata.
+            MotionDetectMetadata& self=const_cast<MotionDetectMetadata&>(*this);
+            uint32_t numBlobs=0;
+            s.read((char *)&self.MotionScore_, sizeof(MotionScore_));
+            s.read((char *)&numBlobs, sizeof(numBlobs));
+            self.Blobs_.clear();
+            for (uint32_t i=0; i<MaxStreamedBlobs; ++i)
+            {
+                MotionBlob blob;
+                s.read((char *)&blob, sizeof(blob));
+                if (i<numBlobs) self.Blobs_.push_back(blob);
+            }
+            return Upstream_ ? Upstream_->readFromStream(s) : true;
+        }
+        
+        virtual MotionDetectMetadata* clone() const
+        {
+            MotionDetectMetadata* metadata=new MotionDetectMetadata(*this);
+            if (Upstream_) metadata->Upstream_=std::shared_ptr<ImageMetadata>(Upstream_->clone());
+            return metadata;
+        }
+        
+        virtual uint32_t getSizeInBytes() const
+        {// size when packed in stream.
+            return uint32_t(sizeof(MotionScore_) + sizeof(uint32_t) + MaxStreamedBlobs*sizeof(MotionBlob)) +
+                   (Upstream_ ? Upstream_->getSizeInBytes() : 0);
+        }
+        
+        virtual std::string getString() const
+        {
+            std::stringstream rValueStream;
+            rValueStream << "Motion score: " << MotionScore_ << " Blobs: " << Blobs_.size() << "\n";
+            for (size_t i=0; i<Blobs_.size(); ++i)
+            {
+                rValueStream << " " << Blobs_[i].Left << "," << Blobs_[i].Top << " " << Blobs_[i].Width << "x" << Blobs_[i].Height
+                             << " area " << Blobs_[i].Area << "\n";
+            }
+            if (Upstream_) rValueStream << Upstream_->getString();
+            rValueStream.flush();
+            return rValueStream.str();
+        }
+        
+        /// Fraction of the pixels of the image that moved in this frame.
+        float MotionScore_;
+        
+        /// The detected blobs, largest area first.
+        std::vector<MotionBlob> Blobs_;
+        
+        /// The metadata passed on from the upstream image. May be null.
+        std::shared_ptr<ImageMetadata> Upstream_;
+    };
+    
+    /*! Detects moving objects against a background model.
+     *
+     * Each pixel keeps a running mean and variance of every component, in fixed point and learnt
+     * at a rate of 2^-getLearningShift() per frame. A pixel moves when a component differs from
+     * the mean by more than the motion threshold times its standard deviation, tested as squares
+     * so that no square roots are needed. The image is divided into cells of CellSize pixels,
+     * and a cell in which pixels moved for more than the detection threshold frames in a row is
+     * detected. Connected detected cells form the blobs published in MotionDetectMetadata.
+     *
+     * A frame has motion if any of its images has a blob. If only motion images are produced,
+     * frames without motion are not passed downstream. Y_8, RGB_8 and BGR images are supported.
+     * Bands of cell rows are processed in parallel. */
     class FLITR_EXPORT FIPMotionDetect : public ImageProcessor
     {
     public:
+        //! Width and height in pixels of the detection cells.
+        static const uint32_t CellSize=16;
         
         /*! Constructor given the upstream producer.
          *@param upStreamProducer The upstream image producer.
          *@param images_per_slot The number of images per image slot from the upstream producer.
-         *@param buffer_size The size of the shared image buffer of the downstream producer.
+         *@param showOverlays Brighten the detected cells in the output images.
+         *@param produceOnlyMotionImages Only pass frames with motion downstream.
+         *@param forceRGBOutput Output Y_8 images as RGB_8, so that the overlays are coloured.
          *@param motionThreshold Motion above this threshold would result in a plot.
          *@param detectionThreshold A stable plot count above this threshold would result in a detection.
+         *@param buffer_size The size of the shared image buffer of the downstream producer.
          */
         FIPMotionDetect(ImageProducer& upStreamProducer, uint32_t images_per_slot,
                         const bool showOverlays, const bool produceOnlyMotionImages, const bool forceRGBOutput,
@@ -79,6 +192,17 @@ namespace flitr {
             return _detectionThreshold;
         }
 
+        //!Set the background learning rate to 2^-learningShift per frame. Larger values are more sensitive to slow moving objects.
+        void setLearningShift(const uint8_t learningShift)
+        {
+            _learningShift=(learningShift<1) ? 1 : ((learningShift>12) ? 12 : learningShift);
+        }
+        //!Get the background learning rate as 2^-learningShift per frame.
+        uint8_t getLearningShift() const
+        {
+            return _learningShift;
+        }
+
         //!Set if the pass should add the detection overlays to the output image.
         void setShowOverlays(const bool showOverlays)
         {
@@ -207,15 +331,35 @@ namespace flitr {
         }
     
     private:
+        /*! The background model and detection state of one image in the slot.*/
+        struct ImageState {
+            //! Mean of every component in 8.8 fixed point.
+            std::vector<uint16_t> Mean;
+            //! Variance of every component in grey levels squared, with 8 fractional bits.
+            std::vector<int32_t> Variance;
+            
+            size_t CellsWide;
+            size_t CellsHigh;
+            //! Number of frames in a row in which pixels of the cell moved.
+            std::vector<int> CellDetectionCount;
+            //! Number of pixels of the cell that moved in this frame.
+            std::vector<uint32_t> CellMovingPixels;
+            
+            float MotionScore;
+            std::vector<MotionBlob> Blobs;
+        };
+        
+        /*! Update the background model of image imgNum and find its blobs.*/
+        void detect(size_t imgNum, Image const * const imReadUS);
+        
+        /*! Write image imgNum downstream, with the overlays if there is motion.*/
+        void writeImage(size_t imgNum, Image const * const imReadUS, Image * const imWriteDS, const bool frameMotion);
+        
 		std::string _title;
 
         uint64_t _frameCounter;
-
-        float *_avrgImg;
-        float *_varImg;
         
-        uint8_t *_detectionImg;
-        int *_detectionCountImg;
+        std::vector<ImageState> _imageStates;
         
         bool _showOverlays;
         bool _produceOnlyMotionImages;
@@ -223,6 +367,7 @@ namespace flitr {
         
         float _motionThreshold;
         int _detectionThreshold;
+        uint8_t _learningShift;
     };
     
 }
@@ -23,6 +23,9 @@
 
 #include <flitr/image_processor.h>
 #include <flitr/image_processor_utils.h>
+#include <flitr/gaussian_pyramid.h>
+
+#include <vector>
 
 namespace flitr {
     
@@ -30,7 +33,12 @@ namespace flitr {
     class FLITR_EXPORT FIPMSR : public ImageProcessor
     {
     public:
-        enum class FilterType : uint8_t { GausXY = 1, BoxII = 2, BoxRS = 3};
+        /*! GausIIR uses RecursiveGaussianFilter, whose cost does not grow with the scale.
+         *  Pyramid downsamples the intensity image as a GaussianPyramid, filters each scale with
+         *  RecursiveGaussianFilter at the smallest level that still resolves it, and upsamples the
+         *  log of the surround bilinearly. The surround of large scales then costs a small fraction
+         *  of a full resolution filter.*/
+        enum class FilterType : uint8_t { GausXY = 1, BoxII = 2, BoxRS = 3, GausIIR = 4, Pyramid = 5};
         
         /*! Constructor given the upstream producer.
          *@param upStreamProducer The upstream image producer.
@@ -151,6 +159,9 @@ namespace flitr {
         //!Box filter helper. No significant state.
         GaussianFilter _GFXY;
         
+        //!Recursive Gaussian filter helper. No significant state.
+        RecursiveGaussianFilter _GFIIR;
+        
         //!Box filter helper. No significant state.
         BoxFilterII _GFII;
         
@@ -179,6 +190,17 @@ namespace flitr {
         size_t *_histoBins;
         
         size_t _triggerCount;
+        
+        //!log2 of the intensity image, shared by all scales.
+        float *_logScratchData;
+        
+        //!Levels 1 and up of the intensity image's pyramid. Level 0 is the intensity image.
+        std::vector< std::vector<float> > _pyramidLevels;
+        
+        //!Surround and then its log2 at a pyramid level.
+        std::vector<float> _levelScratchData;
+        
+        const std::vector<float> _pyramidKernel;
     };
     
 }
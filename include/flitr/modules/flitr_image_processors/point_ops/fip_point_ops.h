@@ -0,0 +1,92 @@
+/* Framework for Live Image Transformation (FLITr)
+ * Copyright (c) 2010 CSIR
+ *
+ * This file is part of FLITr.
+ *
+ * FLITr is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * FLITr is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with FLITr. If not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef FIP_POINT_OPS_H
+#define FIP_POINT_OPS_H 1
+
+#include <flitr/image_processor.h>
+#include <flitr/point_op_chain.h>
+
+namespace flitr {
+
+    /*! Applies an ordered list of per pixel operations and a format conversion in one pass.
+     *
+     * Replaces chains such as FIPConvertToYF32, FIPTonemap and FIPConvertToY8, which each
+     * read and write a whole frame and hand it to the next thread, with one processor that
+     * reads and writes every pixel once. Values are floats scaled as by PixelFormatConverter,
+     * e.g. the 8 bit value 128 is 0.5.
+     *
+     * The operations are added before the processor is started.
+     *@sa PointOpChain */
+    class FLITR_EXPORT FIPPointOps : public ImageProcessor
+    {
+    public:
+
+        /*! Constructor given the upstream producer.
+         *@param upStreamProducer The upstream image producer.
+         *@param images_per_slot The number of images per image slot from the upstream producer.
+         *@param out_pix_fmt The pixel format of the images produced.
+         *@param scale_factor Factor applied to float values converted to 8 or 16 bit output.
+         *@param buffer_size The size of the shared image buffer of the downstream producer.*/
+        FIPPointOps(ImageProducer& upStreamProducer, uint32_t images_per_slot,
+                    ImageFormat::PixelFormat out_pix_fmt,
+                    float scale_factor=1.0f,
+                    uint32_t buffer_size=FLITR_DEFAULT_SHARED_BUFFER_NUM_SLOTS);
+
+        /*! Virtual destructor */
+        virtual ~FIPPointOps();
+
+        /*! Append v*gain + offset.*/
+        void addGainOffset(float gain, float offset);
+
+        /*! Append a power law tone map v^power, as FIPTonemap.*/
+        void addPower(float power);
+
+        /*! Append a threshold that sets values of at least threshold to above and the others to below.*/
+        void addThreshold(float threshold, float below=0.0f, float above=1.0f);
+
+        /*! Append a lookup table with entries spread evenly over [minimum, maximum].*/
+        void addLUT(const std::vector<float>& table, float minimum=0.0f, float maximum=1.0f);
+
+        /*! Append a clamp of the values to [minimum, maximum].*/
+        void addClamp(float minimum, float maximum);
+
+        /*! Method to initialise the object.
+         *@return Boolean result flag. True indicates successful initialisation.*/
+        virtual bool init();
+
+        /*!Synchronous trigger method. Called automatically by the trigger thread in ImageProcessor base class if started.
+         *@sa ImageProcessor::startTriggerThread*/
+        virtual bool trigger();
+
+        /*! Frames are processed independently, so setNumFrameWorkers() may be used.*/
+        virtual bool isStateless() const { return true; }
+
+    protected:
+        virtual void processFrame(const std::vector<Image**>& imvRead, const std::vector<Image**>& imvWrite);
+
+    private:
+        /*! One chain per image of a slot, as the upstream formats may differ.*/
+        std::vector<PointOpChain> Chains_;
+    };
+
+}
+
+#endif //FIP_POINT_OPS_H
@@ -50,6 +50,12 @@ namespace flitr {
          *@sa ImageProcessor::startTriggerThread*/
         virtual bool trigger();
         
+        /*! Frames are processed independently, so setNumFrameWorkers() may be used.*/
+        virtual bool isStateless() const { return true; }
+        
+    protected:
+        virtual void processFrame(const std::vector<Image**>& imvRead, const std::vector<Image**>& imvWrite);
+        
     private:
         std::vector<int> rotate90CountVect_;
     };
@@ -22,6 +22,8 @@
 #define FIP_LK_STABILISE_H 1
 
 #include <flitr/image_processor.h>
+#include <flitr/gaussian_pyramid.h>
+#include <flitr/modules/flitr_image_processors/gaussian_pyramid/fip_gaussian_pyramid.h>
 #include <mutex>
 
 namespace flitr {
@@ -42,6 +44,15 @@ public:
                    Mode outputMode,
                    uint32_t buffer_size=FLITR_DEFAULT_SHARED_BUFFER_NUM_SLOTS);
 
+    /*! Constructor that uses the levels and gradients of an upstream FIPGaussianPyramid
+     *  instead of computing its own pyramid. The first image of the pyramid's slots is stabilised.
+         *@param upStreamPyramid The upstream pyramid producer, which must have gradients.
+         *@param Mode Mode of transform applied to the output image.
+         *@param buffer_size The size of the shared image buffer of the downstream producer.*/
+    FIPLKStabilise(FIPGaussianPyramid& upStreamPyramid,
+                   Mode outputMode,
+                   uint32_t buffer_size=FLITR_DEFAULT_SHARED_BUFFER_NUM_SLOTS);
+
     /*! Virtual destructor */
     virtual ~FIPLKStabilise();
 
@@ -152,17 +163,19 @@ private:
 
     std::string Title_;
 
+    //!Upstream pyramid producer, or null if the pyramid is computed here.
+    FIPGaussianPyramid * const upstreamPyramid_;
+
+    //!Scale space pyramid of the cropped input, if there is no upstream pyramid.
+    GaussianPyramid *pyramid_;
+
     size_t numLevels_;
 
-    std::vector<float *> imgVec_;
+    //!Pyramid levels of the previous frame.
     std::vector<float *> refImgVec_;
 
-    std::vector<float *> dxVec_;
-    std::vector<float *> dyVec_;
     std::vector<float *> dSqRecipVec_;
 
-    float *scratchData_;
-
     Mode outputMode_;
 
     mutable std::mutex latestHMutex_;
@@ -22,10 +22,14 @@
 #define FIP_TONEMAP_H 1
 
 #include <flitr/image_processor.h>
+#include <flitr/lookup_table.h>
 
 namespace flitr {
     
-    /*! Applies a power law tone mapping to the image. */
+    /*! Applies a power law tone mapping to the image.
+     *
+     * Y_F32 values are raised to the power directly. Y_8, RGB_8 and Y_16 values are mapped
+     * through a table of the power law, built once per image of a slot.*/
     class FLITR_EXPORT FIPTonemap : public ImageProcessor
     {
     public:
@@ -49,8 +53,17 @@ namespace flitr {
          *@sa ImageProcessor::startTriggerThread*/
         virtual bool trigger();
         
+        /*! Frames are processed independently, so setNumFrameWorkers() may be used.*/
+        virtual bool isStateless() const { return true; }
+        
+    protected:
+        virtual void processFrame(const std::vector<Image**>& imvRead, const std::vector<Image**>& imvWrite);
+        
     private:
         float power_;
+
+        /*! Tables of the integer images, empty for the others.*/
+        std::vector<LookupTable> tables_;
     };
 }
 
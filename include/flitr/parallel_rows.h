@@ -0,0 +1,139 @@
+/* Framework for Live Image Transformation (FLITr)
+ * Copyright (c) 2010 CSIR
+ *
+ * This file is part of FLITr.
+ *
+ * FLITr is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * FLITr is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with FLITr. If not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef PARALLEL_ROWS_H
+#define PARALLEL_ROWS_H 1
+
+#include <flitr/flitr_export.h>
+#include <flitr/flitr_stdint.h>
+#include <flitr/flitr_thread.h>
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+/// Default smallest band, in rows, that is worth handing to another
+/// thread. Smaller bands cost more in wake-ups than they save.
+#define FLITR_PARALLEL_ROWS_GRAIN 16
+
+namespace flitr {
+
+    /*! A band of image rows handed to a RowBandFunction.
+     *
+     * The band must write rows [Begin, End). Rows [HaloBegin, HaloEnd) are the rows it
+     * may read, i.e. the band grown by the halo and clipped to the image. */
+    struct RowBand {
+        size_t Begin;
+        size_t End;
+        size_t HaloBegin;
+        size_t HaloEnd;
+    };
+
+    /*! Function that processes one band of rows. Called concurrently for different bands.*/
+    typedef std::function<void(const RowBand&)> RowBandFunction;
+
+    class ParallelRowsPool;
+
+    /*! Worker thread of a ParallelRowsPool. */
+    class ParallelRowsThread : public FThread
+    {
+    public:
+        ParallelRowsThread(ParallelRowsPool *pool) :
+        Pool_(pool) {}
+
+        /*! The thread's run method.*/
+        void run();
+
+    private:
+        ParallelRowsPool *Pool_;
+    };
+
+    /*! Persistent pool of threads that splits the rows of an image into bands and processes them in parallel.
+     *
+     * The thread calling run() processes bands too and returns once all bands are done,
+     * so a frame is processed at the latency of its slowest band. Many threads may call
+     * run() at the same time, including from inside a band; the calls share the workers.
+     *
+     * Most code uses the process-wide instance(), or ImageProcessor::parallelRows() in
+     * trigger() methods. */
+    class FLITR_EXPORT ParallelRowsPool
+    {
+        friend class ParallelRowsThread;
+    public:
+
+        /*! Constructor that starts the worker threads.
+         *@param num_threads The number of worker threads, not counting the threads calling run().
+         *@param cpu_affinity Optional CPU affinity of the workers. See FThread::applyAffinity().*/
+        ParallelRowsPool(uint32_t num_threads, int32_t cpu_affinity = -1);
+
+        /*! Destructor. Stops the worker threads.*/
+        ~ParallelRowsPool();
+
+        /*! Get the process-wide pool. It has one worker less than the number of hardware threads.*/
+        static ParallelRowsPool& instance();
+
+        /*! Get the number of worker threads.*/
+        uint32_t getNumThreads() const { return uint32_t(Threads_.size()); }
+
+        /*! Process the rows [0, height) in bands.
+         *@param height The number of rows.
+         *@param grain_size The smallest band worth giving to a thread, in rows.
+         *@param halo The number of rows above and below its band that a band reads.
+         *@param fn The function that processes a band.
+         *@param max_bands Upper limit on the number of bands. Zero for one per worker plus the caller.
+         *       A limit above that still splits the rows, and the extra bands are processed in turn.*/
+        void run(size_t height, size_t grain_size, size_t halo, const RowBandFunction& fn,
+                 uint32_t max_bands = 0);
+
+    private:
+        /*! The bands of one run() call.*/
+        struct Job {
+            const RowBandFunction *Function;
+            size_t Height;
+            size_t Halo;
+            uint32_t NumBands;
+            std::atomic<uint32_t> NextBand;
+            std::atomic<uint32_t> NumDone;
+            std::mutex DoneMutex;
+            std::condition_variable DoneCondition;
+        };
+
+        /*! The worker loop. Called by the worker threads.*/
+        void runWorker();
+
+        /*! Claim and process bands of a job until none are left.*/
+        static void processBands(Job& job);
+
+        std::vector<std::unique_ptr<ParallelRowsThread> > Threads_;
+
+        /*! Jobs that still have unclaimed bands.*/
+        std::deque<std::shared_ptr<Job> > Jobs_;
+        std::mutex JobsMutex_;
+        std::condition_variable JobsCondition_;
+        bool ShouldExit_;
+    };
+
+}
+
+#endif //PARALLEL_ROWS_H
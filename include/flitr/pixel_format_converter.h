@@ -0,0 +1,98 @@
+/* Framework for Live Image Transformation (FLITr)
+ * Copyright (c) 2010 CSIR
+ *
+ * This file is part of FLITr.
+ *
+ * FLITr is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * FLITr is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with FLITr. If not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef PIXEL_FORMAT_CONVERTER_H
+#define PIXEL_FORMAT_CONVERTER_H 1
+
+#include <flitr/flitr_export.h>
+#include <flitr/flitr_stdint.h>
+#include <flitr/image.h>
+#include <flitr/image_format.h>
+
+#include <cstddef>
+
+namespace flitr {
+
+    /*! Converts whole rows and images from one pixel format to another.
+     *
+     * The row kernel for the pair of formats is chosen once, when the converter is
+     * constructed, instead of switching on the formats for every pixel as
+     * ImageFormat::cnvrtPixelFormat() does. Vectorised kernels are used for the common
+     * pairs, picked for the CPU at run time.
+     *@sa getSimdLevel
+     *
+     * All pairs of the packed formats Y_8, RGB_8, BGR, BGRA, RGBA, Y_16, Y_F32 and
+     * RGB_F32 are supported, with these rules:
+     * - An 8 bit value v is the float v/256 and the 16 bit value v*256. A 16 bit value v
+     *   is the float v/65536 and the 8 bit value v/256.
+     * - Floats are multiplied by the scale factor, rounded to the nearest integer and
+     *   clamped when converted to 8 or 16 bits.
+     * - Colour to grey is the mean of R, G and B. Grey to colour repeats the grey value.
+     * - Alpha is copied between formats that have it, and set to 255 otherwise.
+     *
+     * The YUV formats are not converted here. */
+    class FLITR_EXPORT PixelFormatConverter
+    {
+    public:
+        /*! Function that converts one row of pixels.*/
+        typedef void (*RowFunction)(uint8_t const * in, uint8_t * out, size_t width, float scale);
+
+        /*! Constructor that chooses the row kernel.
+         *@param in_fmt The pixel format to convert from.
+         *@param out_fmt The pixel format to convert to.
+         *@param scale_factor Factor applied to float values converted to 8 or 16 bits.*/
+        PixelFormatConverter(ImageFormat::PixelFormat in_fmt, ImageFormat::PixelFormat out_fmt,
+                             float scale_factor = 1.0f);
+
+        /*! True if the pair of formats can be converted.*/
+        bool isSupported() const { return Row_ != 0; }
+
+        ImageFormat::PixelFormat getInputFormat() const { return InFormat_; }
+        ImageFormat::PixelFormat getOutputFormat() const { return OutFormat_; }
+
+        /*! Name of the chosen row kernel, e.g. "avx2", "scalar" or "copy". Empty if not supported.*/
+        const char* getKernelName() const { return KernelName_; }
+
+        /*! Convert one row of width pixels. The rows may not overlap.*/
+        void convertRow(uint8_t const * in, uint8_t * out, size_t width) const
+        {
+            Row_(in, out, width, Scale_);
+        }
+
+        /*! Convert height rows of width pixels, with the given distances in bytes between rows.*/
+        void convert(uint8_t const * in, size_t in_bytes_per_line,
+                     uint8_t * out, size_t out_bytes_per_line,
+                     size_t width, size_t height) const;
+
+        /*! Convert an image to another of the same size.
+         *@return False if the formats do not match the converter or the sizes differ.*/
+        bool convert(const Image& in, Image& out) const;
+
+    private:
+        ImageFormat::PixelFormat InFormat_;
+        ImageFormat::PixelFormat OutFormat_;
+        float Scale_;
+        RowFunction Row_;
+        const char* KernelName_;
+    };
+
+}
+
+#endif //PIXEL_FORMAT_CONVERTER_H
@@ -0,0 +1,139 @@
+/* Framework for Live Image Transformation (FLITr)
+ * Copyright (c) 2010 CSIR
+ *
+ * This file is part of FLITr.
+ *
+ * FLITr is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * FLITr is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with FLITr. If not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef POINT_OP_CHAIN_H
+#define POINT_OP_CHAIN_H 1
+
+#include <flitr/flitr_export.h>
+#include <flitr/flitr_stdint.h>
+#include <flitr/image.h>
+#include <flitr/image_format.h>
+#include <flitr/pixel_format_converter.h>
+
+#include <cstddef>
+#include <vector>
+
+namespace flitr {
+
+    /*! An ordered list of per pixel operations that is applied to images in one pass.
+     *
+     * A row is converted to floats a tile of TilePixels pixels at a time, every operation
+     * is applied to the tile in turn while it is in the L1 cache, and the tile is converted
+     * to the output format. Each pixel is therefore read and written once, where a chain of
+     * processors reads and writes the whole frame once per operation. Bands of rows are
+     * processed on ParallelRowsPool::instance().
+     *
+     * The values the operations see are floats scaled as by PixelFormatConverter, e.g. the
+     * 8 bit value 128 is 0.5. Pixels are processed as RGB_F32 if both formats are colour,
+     * otherwise as Y_F32, and the operations apply to every channel.
+     *
+     * The operations are added before the chain is used. apply() does not change the
+     * chain, so one may be used by many threads.*/
+    class FLITR_EXPORT PointOpChain
+    {
+    public:
+        enum OpType {
+            /*! v*gain + offset.*/
+            OP_GAIN_OFFSET=0,
+            /*! v^power. Negative values become zero.*/
+            OP_POWER,
+            /*! above if v>=threshold, otherwise below.*/
+            OP_THRESHOLD,
+            /*! Table lookup with linear interpolation between the entries.*/
+            OP_LUT,
+            /*! v limited to [minimum, maximum].*/
+            OP_CLAMP
+        };
+
+        /*! Pixels converted and operated on at a time. A colour tile is 12KB.*/
+        static const size_t TilePixels=1024;
+
+        /*! Constructor that chooses the conversions to and from floats.
+         *@param in_fmt The pixel format of the input images.
+         *@param out_fmt The pixel format of the output images.
+         *@param scale_factor Factor applied to float values converted to 8 or 16 bit output.*/
+        PointOpChain(ImageFormat::PixelFormat in_fmt, ImageFormat::PixelFormat out_fmt,
+                     float scale_factor = 1.0f);
+
+        /*! Append v*gain + offset.*/
+        void addGainOffset(float gain, float offset);
+
+        /*! Append a power law tone map v^power.*/
+        void addPower(float power);
+
+        /*! Append a threshold that sets values of at least threshold to above and the others to below.*/
+        void addThreshold(float threshold, float below = 0.0f, float above = 1.0f);
+
+        /*! Append a lookup table. The entries are spread evenly over [minimum, maximum]
+         * and values outside the range take the first or the last entry.*/
+        void addLUT(const std::vector<float>& table, float minimum = 0.0f, float maximum = 1.0f);
+
+        /*! Append a clamp of the values to [minimum, maximum].*/
+        void addClamp(float minimum, float maximum);
+
+        /*! Remove all operations. Only the format conversion is left.*/
+        void clear() { Ops_.clear(); }
+
+        size_t getNumOps() const { return Ops_.size(); }
+
+        /*! True if the conversions to and from floats are supported.*/
+        bool isSupported() const { return ToFloat_.isSupported() && FromFloat_.isSupported(); }
+
+        ImageFormat::PixelFormat getInputFormat() const { return ToFloat_.getInputFormat(); }
+        ImageFormat::PixelFormat getOutputFormat() const { return FromFloat_.getOutputFormat(); }
+
+        /*! Apply the chain to one row of width pixels. The rows may not overlap.*/
+        void applyRow(uint8_t const * in, uint8_t * out, size_t width) const;
+
+        /*! Apply the chain to height rows of width pixels, with the given distances in bytes between rows.
+         *@param max_bands Upper limit on the number of row bands. Zero for one per thread of the pool.*/
+        void apply(uint8_t const * in, size_t in_bytes_per_line,
+                   uint8_t * out, size_t out_bytes_per_line,
+                   size_t width, size_t height, uint32_t max_bands = 0) const;
+
+        /*! Apply the chain to an image, writing another of the same size.
+         *@return False if the formats do not match the chain or the sizes differ.*/
+        bool apply(const Image& in, Image& out, uint32_t max_bands = 0) const;
+
+    private:
+        struct PointOp {
+            OpType Type;
+            float A;
+            float B;
+            float C;
+            std::vector<float> Table;
+        };
+
+        void applyOps(float * values, size_t n) const;
+
+        PixelFormatConverter ToFloat_;
+        PixelFormatConverter FromFloat_;
+
+        /*! Floats per pixel, 1 or 3.*/
+        size_t Channels_;
+        size_t InBytesPerPixel_;
+        size_t OutBytesPerPixel_;
+
+        std::vector<PointOp> Ops_;
+    };
+
+}
+
+#endif //POINT_OP_CHAIN_H
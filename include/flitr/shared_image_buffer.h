@@ -24,6 +24,9 @@
 #include <flitr/flitr_export.h>
 #include <flitr/image.h>
 
+#include <atomic>
+#include <condition_variable>
+#include <functional>
 #include <map>
 #include <vector>
 #include <mutex>
@@ -35,6 +38,57 @@ class ImageProducer;
 
 #define FLITR_DEFAULT_SHARED_BUFFER_NUM_SLOTS 32
 
+/// Maximum number of consumers that can be attached to a buffer in the
+/// lock-free mode. The consumer cursors are allocated up front so that
+/// they never move while the producer scans them.
+#define FLITR_SHARED_BUFFER_MAX_LOCK_FREE_CONSUMERS 64
+
+/// Size of the padding used to keep the cursors of different threads
+/// on separate cache lines.
+#define FLITR_CACHE_LINE_SIZE 64
+
+/// Default time in microseconds that the trigger and consumer threads
+/// block waiting for a buffer before re-checking whether they should
+/// exit.
+#define FLITR_SHARED_BUFFER_WAIT_TIMEOUT_US 20000
+
+/// Maximum number of slots that one batch reserve call can return.
+#define FLITR_SLOT_SPAN_CAPACITY 16
+
+/**
+ * \brief Slots reserved together by one batch reserve call.
+ *
+ * Fixed capacity, so returning one does not allocate. Slot s of the
+ * span points at the images of a buffer slot, i.e. span[s][i] is
+ * image i of the slot and &span[s][i] is what reserveReadSlot() or
+ * reserveWriteSlot() would have returned as element i.
+ */
+class SlotSpan {
+  public:
+    SlotSpan() :
+        NumSlots_(0),
+        ImagesPerSlot_(0) {}
+
+    /// The number of slots reserved.
+    uint32_t size() const { return NumSlots_; }
+
+    /// True if no slot could be reserved.
+    bool empty() const { return NumSlots_==0; }
+
+    /// The number of images in each slot.
+    uint32_t getImagesPerSlot() const { return ImagesPerSlot_; }
+
+    /// The images of slot s, oldest slot first.
+    Image** operator[](uint32_t s) const { return Slots_[s]; }
+
+  private:
+    friend class SharedImageBuffer;
+
+    Image** Slots_[FLITR_SLOT_SPAN_CAPACITY];
+    uint32_t NumSlots_;
+    uint32_t ImagesPerSlot_;
+};
+
 /**
  * \brief Class for passing images between producers and consumers. 
  * 
@@ -53,12 +107,56 @@ class ImageProducer;
  * captured at the same time. This allows consumers to obtain a
  * synchronised group of images.
  *
+ * The image data comes from a pool per image in the slot. A processor
+ * can pass an upstream image on with Image::shareDataFrom() instead of
+ * copying it. The storage goes back to the pool once no image refers
+ * to it any more.
+ *
  * Multiple slots can be reserved for reading and writing. This allows
  * a consumer to e.g. keep access to a range of images if it's
- * interested in a time range (history) of images.
+ * interested in a time range (history) of images. The batch calls
+ * reserve or release several slots with one lock and return them in
+ * a SlotSpan instead of a vector.
+ *
+ * The buffer can alternatively be created in a lock-free single
+ * producer / multiple consumer mode (SYNC_LOCK_FREE_SPMC). Each
+ * consumer then owns a cursor on its own cache line and the reserve
+ * and release calls do not take the mutex. Only one thread may call
+ * the producer methods in this mode.
+ *
+ * Each consumer is added with an OverflowPolicy. Lossless consumers
+ * hold back the producer when they fall behind. The other policies
+ * drop that consumer's oldest unread slots instead, so a slow display
+ * or streaming consumer never stalls a recording one, or vice versa.
+ *
+ * Threads that have nothing to do can block in waitForWriteSlot() or
+ * waitForReadSlot() instead of polling. Releasing a write slot wakes
+ * the waiting consumers and releasing a read slot wakes the waiting
+ * producer.
+ *
+ * An executor can instead register slot listeners with
+ * addSlotListener() to be told about the same events.
  */
 class FLITR_EXPORT SharedImageBuffer {
   public:
+    /// The scheme used to synchronise the producer and the consumers.
+    enum SyncMode {
+        /// All reserve/release calls are serialised with one mutex.
+        SYNC_MUTEX = 0,
+        /// Single producer thread, multiple consumer threads. Reserve/release calls are lock-free.
+        SYNC_LOCK_FREE_SPMC = 1
+    };
+
+    /// What happens to a consumer's unread slots when it falls behind the producer.
+    enum OverflowPolicy {
+        /// The producer waits for the consumer. No slots are dropped.
+        OVERFLOW_LOSSLESS = 0,
+        /// The consumer's oldest unread slot is dropped when the producer needs the space.
+        OVERFLOW_DROP_OLDEST = 1,
+        /// As OVERFLOW_DROP_OLDEST, and a read always skips to the newest written slot.
+        OVERFLOW_LATEST_ONLY = 2
+    };
+
     /** 
      * Creates a shared buffer without allocating storage.
      * 
@@ -69,10 +167,14 @@ class FLITR_EXPORT SharedImageBuffer {
      *
      * \param images_per_slot The number of images in a slot (group of
      * synchronised images)
+     *
+     * \param sync_mode How the producer and consumers are
+     * synchronised. See SyncMode.
      */
     SharedImageBuffer(ImageProducer& my_producer, 
                       uint32_t num_slots, 
-                      uint32_t images_per_slot);
+                      uint32_t images_per_slot,
+                      SyncMode sync_mode = SYNC_MUTEX);
 
     virtual ~SharedImageBuffer();
 
@@ -92,6 +194,9 @@ class FLITR_EXPORT SharedImageBuffer {
      * \return True on successful initialisation. 
      */
     bool initWithoutStorage();
+
+    /// Get the synchronisation scheme the buffer was created with.
+    SyncMode getSyncMode() const { return SyncMode_; }
     
     
 //=== Start of the Producer Methods ===//
@@ -127,7 +232,18 @@ class FLITR_EXPORT SharedImageBuffer {
     virtual std::vector<Image**> reserveWriteSlot();
     //virtual std::vector<Image**> getWritable();
 
-    //ToDo: We could also add a reserveWriteSlots(n) method that reserves n slots!
+    /**
+     * Reserve up to max_slots slots for writing in one go. Same as
+     * calling reserveWriteSlot() until it fails or max_slots slots
+     * are reserved, but takes the lock once and does not allocate.
+     *
+     * \param max_slots The most slots to reserve. Limited to
+     * FLITR_SLOT_SPAN_CAPACITY.
+     *
+     * \return The reserved slots, oldest first. Empty if no slot
+     * could be obtained.
+     */
+    virtual SlotSpan reserveWriteSlots(uint32_t max_slots);
     
 
     /** 
@@ -139,7 +255,13 @@ class FLITR_EXPORT SharedImageBuffer {
     virtual void releaseWriteSlot();
     //virtual void pushWritable();
     
-    //ToDo: We could also add a releaseWriteSlots(n) method that releases n slots!
+    /**
+     * Release the oldest num_slots reserved write slots in one go.
+     * Same as calling releaseWriteSlot() num_slots times.
+     *
+     * \param num_slots The number of slots to release.
+     */
+    virtual void releaseWriteSlots(uint32_t num_slots);
 
     
     /** 
@@ -150,6 +272,16 @@ class FLITR_EXPORT SharedImageBuffer {
      */
     virtual uint32_t getLeastNumReadSlotsAvailable();
 
+    /**
+     * Block until a write slot can be reserved or the timeout
+     * expires.
+     *
+     * \param timeout_us Maximum time to wait in microseconds.
+     *
+     * \return True if a write slot is available.
+     */
+    virtual bool waitForWriteSlot(uint32_t timeout_us = FLITR_SHARED_BUFFER_WAIT_TIMEOUT_US);
+
     
     
 //=== Start of the Consumer Methods ===//
@@ -196,7 +328,22 @@ class FLITR_EXPORT SharedImageBuffer {
     virtual std::vector<Image**> reserveReadSlot(const ImageConsumer& consumer);
     //virtual std::vector<Image**> getReadable(const ImageConsumer& consumer);
     
-    //ToDo: We could also add a reserveReadSlots(..., n) method that reserves n slots!
+    /**
+     * Reserve up to max_slots written slots for reading in one go.
+     * Same as calling reserveReadSlot() until it fails or max_slots
+     * slots are reserved, but takes the lock once and does not
+     * allocate.
+     *
+     * \param consumer Reference to the consumer for which the query
+     * is being made.
+     *
+     * \param max_slots The most slots to reserve. Limited to
+     * FLITR_SLOT_SPAN_CAPACITY.
+     *
+     * \return The reserved slots, oldest first. Empty if no slot
+     * could be obtained.
+     */
+    virtual SlotSpan reserveReadSlots(const ImageConsumer& consumer, uint32_t max_slots);
 
     
     /** 
@@ -210,7 +357,30 @@ class FLITR_EXPORT SharedImageBuffer {
     virtual void releaseReadSlot(const ImageConsumer& consumer);
     //virtual void popReadable(const ImageConsumer& consumer);
 
-    //ToDo: We could also add a releaseReadSlots(..., n) method that releases n slots!
+    /**
+     * Release the oldest num_slots reserved read slots of a consumer
+     * in one go. Same as calling releaseReadSlot() num_slots times.
+     *
+     * \param consumer Reference to the consumer that has completed
+     * with the reads.
+     *
+     * \param num_slots The number of slots to release.
+     */
+    virtual void releaseReadSlots(const ImageConsumer& consumer, uint32_t num_slots);
+
+    /**
+     * Block until a read slot can be reserved by the consumer or the
+     * timeout expires.
+     *
+     * \param consumer Reference to the consumer for which the wait
+     * is being made.
+     *
+     * \param timeout_us Maximum time to wait in microseconds.
+     *
+     * \return True if a read slot is available.
+     */
+    virtual bool waitForReadSlot(const ImageConsumer& consumer,
+                                 uint32_t timeout_us = FLITR_SHARED_BUFFER_WAIT_TIMEOUT_US);
     
 	
     /** 
@@ -218,10 +388,15 @@ class FLITR_EXPORT SharedImageBuffer {
      * would be set to the latest image to be written.
      * 
      * \param consumer Reference to the consumer to be added.
+     *
+     * \param overflow_policy What to do when the consumer falls
+     * behind. A consumer that holds reserved slots always holds back
+     * the producer until it releases them.
      * 
      * \return True if successfully added.
      */
-    virtual bool addConsumer(ImageConsumer& consumer);
+    virtual bool addConsumer(ImageConsumer& consumer,
+                             OverflowPolicy overflow_policy = OVERFLOW_LOSSLESS);
     /**
      * Remove a new consumer from this buffer.
      *
@@ -231,10 +406,147 @@ class FLITR_EXPORT SharedImageBuffer {
      */
     virtual bool removeConsumer(ImageConsumer& consumer);
 
+    /**
+     * Obtain the overflow policy a consumer was added with.
+     *
+     * \param consumer Reference to the consumer for which the query
+     * is being made.
+     *
+     * \return The consumer's overflow policy.
+     */
+    virtual OverflowPolicy getOverflowPolicy(const ImageConsumer& consumer);
+
+    /// Buffer state changes that slot listeners can be told about.
+    enum SlotEvent {
+        /// A slot has been written and can be read.
+        SLOT_READABLE = 0,
+        /// A slot has been read or dropped and can be written.
+        SLOT_WRITABLE = 1
+    };
+
+    /// Function called when a SlotEvent happens.
+    typedef std::function<void()> SlotListener;
+
+    /**
+     * Register a function to call whenever a SlotEvent happens. The
+     * listener is called from the thread that caused the event and
+     * must return quickly, e.g. by only queueing work.
+     *
+     * \param event The event to listen for.
+     *
+     * \param owner Identifies the listener for removeSlotListeners().
+     *
+     * \param listener The function to call.
+     */
+    virtual void addSlotListener(SlotEvent event, const void* owner, SlotListener listener);
+
+    /**
+     * Remove all listeners registered with the given owner. No
+     * listener of the owner is running or will run once this returns.
+     *
+     * \param owner The owner passed to addSlotListener().
+     */
+    virtual void removeSlotListeners(const void* owner);
+
+    /**
+     * Obtain the number of slots that were dropped for a consumer
+     * because of its overflow policy.
+     *
+     * \param consumer Reference to the consumer for which the query
+     * is being made.
+     *
+     * \return The number of slots the consumer never read.
+     */
+    virtual uint64_t getNumDroppedSlots(const ImageConsumer& consumer);
+
   private:
+    /// A registered slot listener.
+    struct SlotListenerEntry {
+        SlotEvent Event;
+        const void* Owner;
+        SlotListener Listener;
+    };
+
+    /**
+     * Read position of one consumer in the lock-free mode. Positions
+     * are monotonically increasing sequence numbers; the slot index is
+     * the position modulo the number of slots. Each cursor fills a
+     * whole cache line so that consumers do not false share.
+     *
+     * For consumers that are not lossless the producer drops a slot by
+     * moving ReadHead with a compare-exchange while ReadHead equals
+     * ReadTail. The consumer claims slots with the same
+     * compare-exchange, so a slot is either dropped or read, never
+     * both.
+     */
+    struct ConsumerCursor {
+        /// Position where the consumer is about to read. The producer only moves it to drop a slot.
+        std::atomic<uint64_t> ReadHead;
+        /// One past where the consumer has completed reading. The producer only moves it to drop a slot.
+        std::atomic<uint64_t> ReadTail;
+        /// The number of slots dropped because of the overflow policy.
+        std::atomic<uint64_t> NumDropped;
+        /// The number of read slots reserved.
+        std::atomic<uint32_t> NumReadReserved;
+        /// The consumer's OverflowPolicy. Set before the cursor is activated.
+        std::atomic<uint32_t> Policy;
+        /// False if the cursor is not in use by any consumer.
+        std::atomic<bool> Active;
+        uint8_t Padding[FLITR_CACHE_LINE_SIZE - 3*sizeof(uint64_t) - 2*sizeof(uint32_t) - sizeof(bool)];
+    };
+
     /// Returns true if there is no more space in the buffer for writing.
     bool isFull() const;
 
+    /// Give the images of a reserved write slot storage that is not shared with other images.
+    void makeWritable(uint32_t slot);
+
+    /**
+     * Reserve the next write slot. The caller holds BufferMutex_.
+     *
+     * \param slot Set to the index of the reserved slot.
+     *
+     * \param num_popped Increased by the number of slots dropped to
+     * make space for the next write.
+     *
+     * \return False if the buffer is full.
+     */
+    bool reserveWriteSlotLocked(uint32_t& slot, uint32_t& num_popped);
+
+    /**
+     * Reserve the next read slot of a consumer. The caller holds
+     * BufferMutex_.
+     *
+     * \param num_popped Increased by the number of slots all consumers
+     * are now done with because slots were skipped.
+     *
+     * \return False if no slot is available.
+     */
+    bool reserveReadSlotLocked(const ImageConsumer& consumer, uint32_t& slot, uint32_t& num_popped);
+
+    /// Lock-free mode: Same as reserveWriteSlotLocked(). Only called by the producer.
+    bool reserveWriteSlotLockFree(uint32_t& slot);
+
+    /**
+     * Lock-free mode: Same as reserveReadSlotLocked().
+     *
+     * \param num_skipped Increased by the number of slots skipped.
+     * The caller must then report the popped slots.
+     */
+    bool reserveReadSlotLockFree(const ImageConsumer& consumer, uint32_t& slot, uint32_t& num_skipped);
+
+    /// Returns how far behind the write tail the oldest consumer read tail is.
+    uint32_t getMaxReadGap() const;
+
+    /**
+     * Drop the oldest unread slot of every consumer that is not
+     * lossless and would otherwise stop the next write. Consumers
+     * holding reserved slots are left alone.
+     *
+     * \return The number of slots that all consumers are now done with.
+     */
+    uint32_t dropOverrunSlots();
+
     /// Returns the space 'filled' in the buffer.
     uint32_t getFill() const;
 
@@ -260,11 +572,31 @@ class FLITR_EXPORT SharedImageBuffer {
      */
     uint32_t numAvailable(const ImageConsumer& consumer);
 
+    /// Lock-free mode: Get the cursor of a consumer.
+    ConsumerCursor& cursor(const ImageConsumer& consumer) const;
+
+    /// Lock-free mode: Scan the active consumers for the oldest read tail.
+    uint64_t scanMinReadTail() const;
+
+    /// Lock-free mode: Report the slots all consumers are done with to the producer.
+    void reportPoppedSlots();
+
+    /// Lock-free mode: Same as dropOverrunSlots(). Only called by the producer.
+    void dropOverrunSlotsLockFree();
+
+    /**
+     * Wake the threads blocked on the condition of an event and call
+     * the event's listeners. Cheap when nobody is waiting or listening.
+     *
+     * \param event The event that happened.
+     */
+    void notifyWaiters(SlotEvent event);
+
     /// The producer we are a member of.
     ImageProducer *ImageProducer_;
 		
     /// Protects read and write positions
-    std::mutex BufferMutex_;
+    mutable std::mutex BufferMutex_;
 
     /// The number of slots in the buffer.
     uint32_t NumSlots_;
@@ -284,6 +616,10 @@ class FLITR_EXPORT SharedImageBuffer {
     std::map< const ImageConsumer*, uint32_t > ReadHeads_;
     /// Map of consumers to the number of read slots reserved.
     std::map< const ImageConsumer*, uint32_t > NumReadReserved_;
+    /// Map of consumers to their overflow policies.
+    std::map< const ImageConsumer*, OverflowPolicy > OverflowPolicies_;
+    /// Map of consumers to the number of slots dropped for them.
+    std::map< const ImageConsumer*, uint64_t > NumDropped_;
 
     /// The actual ring buffer. Contains only pointers.
     std::vector< std::vector< Image* > > Buffer_;
@@ -291,6 +627,52 @@ class FLITR_EXPORT SharedImageBuffer {
     /// Indicates whether we have reserved storage for the images in
     /// the buffer.
     bool HasStorage_;
+
+    /// How the producer and consumers are synchronised.
+    const SyncMode SyncMode_;
+
+    // The lock-free members below are grouped by the thread that
+    // writes them, with a cache line of padding between groups.
+
+    uint8_t ProducerPadding_[FLITR_CACHE_LINE_SIZE];
+    /// Lock-free mode: Sequence number where the producer is about to write. Only written by the producer.
+    std::atomic<uint64_t> SeqWriteHead_;
+    /// Lock-free mode: One past where the producer has written. Only written by the producer.
+    std::atomic<uint64_t> SeqWriteTail_;
+    /// Lock-free mode: The number of slots reserved for writing.
+    std::atomic<uint32_t> SeqNumWriteReserved_;
+    /// Lock-free mode: Producer's cached copy of the oldest consumer read tail. Never larger than the true minimum.
+    mutable uint64_t CachedMinReadTail_;
+
+    uint8_t ConsumerPadding_[FLITR_CACHE_LINE_SIZE];
+    /// Lock-free mode: One past the last slot reported to the producer as popped by all consumers.
+    std::atomic<uint64_t> SeqPoppedTail_;
+    uint8_t PoppedPadding_[FLITR_CACHE_LINE_SIZE];
+
+    /// Lock-free mode: One past the highest consumer index handed out. Consumers in [0, NumConsumerIndices_) are scanned.
+    std::atomic<uint32_t> NumConsumerIndices_;
+    /// Lock-free mode: Dense array of consumer cursors, indexed by ImageConsumer::SharedImageBufferIndex_.
+    ConsumerCursor *Cursors_;
+    /// Lock-free mode: Raw allocation backing Cursors_, over-allocated for cache line alignment.
+    uint8_t *CursorStorage_;
+
+    /// Protects the wait conditions. If both are needed, lock WaitMutex_ before BufferMutex_.
+    std::mutex WaitMutex_;
+    /// Signalled when a slot has been written.
+    std::condition_variable ReadableCondition_;
+    /// Signalled when a slot has been read.
+    std::condition_variable WritableCondition_;
+    /// The number of consumer threads blocked in waitForReadSlot().
+    std::atomic<uint32_t> NumReadWaiters_;
+    /// The number of producer threads blocked in waitForWriteSlot().
+    std::atomic<uint32_t> NumWriteWaiters_;
+
+    /// Protects SlotListeners_ and is held while listeners run.
+    std::mutex ListenerMutex_;
+    /// The registered slot listeners.
+    std::vector<SlotListenerEntry> SlotListeners_;
+    /// The size of SlotListeners_, checked without taking ListenerMutex_.
+    std::atomic<uint32_t> NumSlotListeners_;
 };
 
 }
@@ -89,6 +89,8 @@ class V4L2Producer : public flitr::ImageProducer {
     int32_t DeviceWidth_;
     int32_t DeviceHeight_;
     int32_t DeviceChannel_;
+    /// Row size in bytes of the device buffers. Zero if the driver did not say.
+    int32_t DeviceBytesPerLine_;
     struct vc_buffer *DeviceBuffers_;
     int DeviceNumBuffers_;
 
@@ -0,0 +1,227 @@
+/* Framework for Live Image Transformation (FLITr)
+ * Copyright (c) 2010 CSIR
+ *
+ * This file is part of FLITr.
+ *
+ * FLITr is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * FLITr is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with FLITr. If not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+
+#include <flitr/cpu_features.h>
+#include <flitr/flitr_stdint.h>
+#include <flitr/log_message.h>
+
+#include <atomic>
+#include <stdlib.h>
+
+#if defined(FLITR_X86_SIMD)
+#if defined(_MSC_VER)
+#include <intrin.h>
+#include <immintrin.h>
+#else
+#include <cpuid.h>
+#endif
+#endif
+
+using namespace flitr;
+
+namespace {
+
+#if defined(FLITR_X86_SIMD)
+    void cpuid(uint32_t leaf, uint32_t subleaf, uint32_t regs[4])
+    {
+#if defined(_MSC_VER)
+        int r[4];
+        __cpuidex(r, int(leaf), int(subleaf));
+        for (int i=0; i<4; i++) regs[i] = uint32_t(r[i]);
+#else
+        __cpuid_count(leaf, subleaf, regs[0], regs[1], regs[2], regs[3]);
+#endif
+    }
+
+    // The register state the operating system saves on a context switch.
+    uint64_t xgetbv0()
+    {
+#if defined(_MSC_VER)
+        return _xgetbv(0);
+#else
+        uint32_t eax, edx;
+        __asm__ __volatile__ ("xgetbv" : "=a"(eax), "=d"(edx) : "c"(0));
+        return (uint64_t(edx) << 32) | eax;
+#endif
+    }
+
+    SimdLevel detectX86()
+    {
+        uint32_t regs[4];
+        cpuid(0, 0, regs);
+        const uint32_t maxLeaf = regs[0];
+        if (maxLeaf < 1) return FLITR_SIMD_SCALAR;
+
+        cpuid(1, 0, regs);
+        const uint32_t ecx1 = regs[2];
+        const uint32_t edx1 = regs[3];
+
+        if (!(edx1 & (1u << 26))) return FLITR_SIMD_SCALAR;
+        if (!(ecx1 & (1u << 9))) return FLITR_SIMD_SSE2;
+        if (!(ecx1 & (1u << 19)) || !(ecx1 & (1u << 20))) return FLITR_SIMD_SSSE3;
+
+        // AVX needs the OS to save the YMM registers.
+        const bool osxsave = (ecx1 & (1u << 27)) != 0;
+        const bool avx = (ecx1 & (1u << 28)) != 0;
+        const bool fma = (ecx1 & (1u << 12)) != 0;
+        if (!osxsave || !avx || !fma || (maxLeaf < 7)) return FLITR_SIMD_SSE42;
+        const uint64_t xcr0 = xgetbv0();
+        if ((xcr0 & 0x6) != 0x6) return FLITR_SIMD_SSE42;
+
+        cpuid(7, 0, regs);
+        const uint32_t ebx7 = regs[1];
+        if (!(ebx7 & (1u << 5))) return FLITR_SIMD_SSE42;
+
+        // AVX-512 F and BW, with the opmask and ZMM state saved.
+        if (!(ebx7 & (1u << 16)) || !(ebx7 & (1u << 30)) || ((xcr0 & 0xE0) != 0xE0)) return FLITR_SIMD_AVX2;
+
+        return FLITR_SIMD_AVX512;
+    }
+
+    bool detectX86Vbmi()
+    {
+        uint32_t regs[4];
+        cpuid(0, 0, regs);
+        if (regs[0] < 7) return false;
+
+        cpuid(7, 0, regs);
+        return (regs[2] & (1u << 1)) != 0;
+    }
+#endif
+
+    SimdLevel detect()
+    {
+#if defined(FLITR_X86_SIMD)
+        return detectX86();
+#elif defined(FLITR_NEON_SIMD)
+        return FLITR_SIMD_NEON;
+#else
+        return FLITR_SIMD_SCALAR;
+#endif
+    }
+
+    bool includes(SimdLevel available, SimdLevel level)
+    {
+        if (level == FLITR_SIMD_SCALAR) return true;
+        if ((level == FLITR_SIMD_NEON) || (available == FLITR_SIMD_NEON)) return level == available;
+        return level <= available;
+    }
+
+    SimdLevel levelFromEnvironment()
+    {
+        const SimdLevel detected = detectSimdLevel();
+
+        const char* env = getenv("FLITR_SIMD_LEVEL");
+        if (env == 0)
+        {
+            return detected;
+        }
+
+        SimdLevel level;
+        if (!parseSimdLevel(env, level))
+        {
+            logMessage(LOG_CRITICAL) << "FLITR_SIMD_LEVEL=" << env << " is not a known level. Using "
+                                     << getSimdLevelName(detected) << ".\n";
+            return detected;
+        }
+        if (!includes(detected, level))
+        {
+            logMessage(LOG_CRITICAL) << "FLITR_SIMD_LEVEL=" << env << " is not supported by this CPU. Using "
+                                     << getSimdLevelName(detected) << ".\n";
+            return detected;
+        }
+
+        logMessage(LOG_INFO) << "Using " << getSimdLevelName(level) << " kernels, from FLITR_SIMD_LEVEL.\n";
+        return level;
+    }
+
+    std::atomic<int>& levelOverride()
+    {
+        static std::atomic<int> level(-1);
+        return level;
+    }
+}
+
+SimdLevel flitr::detectSimdLevel()
+{
+    static const SimdLevel level = detect();
+    return level;
+}
+
+SimdLevel flitr::getSimdLevel()
+{
+    const int level = levelOverride().load();
+    if (level >= 0)
+    {
+        return SimdLevel(level);
+    }
+
+    static const SimdLevel environmentLevel = levelFromEnvironment();
+    return environmentLevel;
+}
+
+void flitr::setSimdLevel(SimdLevel level)
+{
+    levelOverride().store(includes(detectSimdLevel(), level) ? int(level) : int(detectSimdLevel()));
+}
+
+bool flitr::isSimdLevelEnabled(SimdLevel level)
+{
+    return includes(getSimdLevel(), level);
+}
+
+bool flitr::isAvx512VbmiEnabled()
+{
+#if defined(FLITR_X86_SIMD)
+    // AVX-512 being detected means that the OS saves the ZMM state.
+    static const bool vbmi = (detectSimdLevel() == FLITR_SIMD_AVX512) && detectX86Vbmi();
+    return vbmi && isSimdLevelEnabled(FLITR_SIMD_AVX512);
+#else
+    return false;
+#endif
+}
+
+const char* flitr::getSimdLevelName(SimdLevel level)
+{
+    switch (level)
+    {
+        case FLITR_SIMD_SCALAR: return "scalar";
+        case FLITR_SIMD_SSE2: return "sse2";
+        case FLITR_SIMD_SSSE3: return "ssse3";
+        case FLITR_SIMD_SSE42: return "sse4.2";
+        case FLITR_SIMD_AVX2: return "avx2";
+        case FLITR_SIMD_AVX512: return "avx512";
+        case FLITR_SIMD_NEON: return "neon";
+    }
+    return "unknown";
+}
+
+bool flitr::parseSimdLevel(const std::string& name, SimdLevel& level)
+{
+    for (int l = FLITR_SIMD_SCALAR; l <= FLITR_SIMD_NEON; l++)
+    {
+        if (name == getSimdLevelName(SimdLevel(l)))
+        {
+            level = SimdLevel(l);
+            return true;
+        }
+    }
+    return false;
+}
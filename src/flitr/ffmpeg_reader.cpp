@@ -21,6 +21,10 @@
 #include <flitr/ffmpeg_reader.h>
 #include <flitr/ffmpeg_utils.h>
 
+extern "C" {
+#include <libavutil/imgutils.h>
+}
+
 #include <mutex>
 #include <sstream>
 
@@ -43,6 +47,7 @@ FFmpegReader::FFmpegReader() NOEXCEPT :
     Codec_          = nullptr;
     DecodedFrame_   = nullptr;
     ConvertedFrame_ = nullptr;
+    PassThrough_    = false;
 
     std::map<std::string, std::string> options;
     options["codec_type"] = "AVMEDIA_TYPE_VIDEO";
@@ -196,6 +201,13 @@ bool FFmpegReader::openVideo(const std::string& filename, ImageFormat::PixelForm
         out_ffmpeg_pix_fmt=CodecContext_->pix_fmt;
         out_pix_fmt=PixelFormatFFmpegToFLITr(out_ffmpeg_pix_fmt);
 
+        if ((out_pix_fmt==ImageFormat::FLITR_PIX_FMT_YUV420P) ||
+            (out_pix_fmt==ImageFormat::FLITR_PIX_FMT_NV12) ||
+            (out_pix_fmt==ImageFormat::FLITR_PIX_FMT_YUYV))
+        {//Few consumers can display YUV, so it is only produced when asked for explicitly.
+            out_pix_fmt=ImageFormat::FLITR_PIX_FMT_UNDF;
+        }
+
         if (out_pix_fmt==ImageFormat::FLITR_PIX_FMT_UNDF)
         {//FLITr doesn't understand the ffmpeg pixel format specified by the codec.
             //Therefore, make an output pixelformat selection for the user.
@@ -211,6 +223,11 @@ bool FFmpegReader::openVideo(const std::string& filename, ImageFormat::PixelForm
     }
 
     ImageFormat_ = ImageFormat(CodecContext_->width * scale_factor, CodecContext_->height * scale_factor, out_pix_fmt);
+
+    //If the codec already decodes to the output format, copy the planes instead of converting them.
+    PassThrough_ = (out_ffmpeg_pix_fmt==CodecContext_->pix_fmt) &&
+        (int(ImageFormat_.getWidth())==CodecContext_->width) &&
+        (int(ImageFormat_.getHeight())==CodecContext_->height);
     //=== ===//
 
     // Allocate the image for the single frame sources
@@ -374,11 +391,19 @@ bool FFmpegReader::getImage(Image &out_image, int im_number)
 
     SwscaleStats_->tick();
 #if defined FLITR_USE_SWSCALE
-    ConvertedFrame_->data[0] = out_image.data(); // save a memcpy
+    fillFFmpegFrame(ConvertedFrame_, out_image.data(), *out_image.format()); // save a memcpy
 
-    sws_scale(ConvertFormatCtx_,
-              DecodedFrame_->data, DecodedFrame_->linesize, 0, CodecContext_->height,
-              ConvertedFrame_->data, ConvertedFrame_->linesize);
+    if (PassThrough_)
+    {
+        av_image_copy(ConvertedFrame_->data, ConvertedFrame_->linesize,
+                      (const uint8_t **)DecodedFrame_->data, DecodedFrame_->linesize,
+                      CodecContext_->pix_fmt, CodecContext_->width, CodecContext_->height);
+    } else
+    {
+        sws_scale(ConvertFormatCtx_,
+                  DecodedFrame_->data, DecodedFrame_->linesize, 0, CodecContext_->height,
+                  ConvertedFrame_->data, ConvertedFrame_->linesize);
+    }
 
     //printf("%d %d\n", DecodedFrame_->linesize, ConvertedFrame_->linesize);
     //fflush(stdout);
@@ -37,6 +37,15 @@ AVPixelFormat flitr::PixelFormatFLITrToFFmpeg(flitr::ImageFormat::PixelFormat in
       case ImageFormat::FLITR_PIX_FMT_BGRA:
           return AV_PIX_FMT_BGRA;
           break;
+      case ImageFormat::FLITR_PIX_FMT_YUV420P:
+        return AV_PIX_FMT_YUV420P;
+        break;
+      case ImageFormat::FLITR_PIX_FMT_NV12:
+        return AV_PIX_FMT_NV12;
+        break;
+      case ImageFormat::FLITR_PIX_FMT_YUYV:
+        return AV_PIX_FMT_YUYV422;
+        break;
       default:
         // \todo maybe return error for unhandled FLITr pix format!
         return AV_PIX_FMT_NONE;
@@ -55,6 +64,15 @@ flitr::ImageFormat::PixelFormat flitr::PixelFormatFFmpegToFLITr(AVPixelFormat in
       case AV_PIX_FMT_GRAY16LE:
         return ImageFormat::FLITR_PIX_FMT_Y_16;
         break;
+      case AV_PIX_FMT_YUV420P:
+        return ImageFormat::FLITR_PIX_FMT_YUV420P;
+        break;
+      case AV_PIX_FMT_NV12:
+        return ImageFormat::FLITR_PIX_FMT_NV12;
+        break;
+      case AV_PIX_FMT_YUYV422:
+        return ImageFormat::FLITR_PIX_FMT_YUYV;
+        break;
       default:
         return ImageFormat::FLITR_PIX_FMT_UNDF;
     }
@@ -86,3 +104,12 @@ AVFrame* flitr::allocFFmpegFrame(AVPixelFormat pix_fmt, int width, int height)
 
     return picture;
 }
+
+void flitr::fillFFmpegFrame(AVFrame *frame, uint8_t *data, const ImageFormat& format)
+{
+    const uint32_t numPlanes = format.getNumPlanes();
+    for (uint32_t p=0; p<numPlanes; p++) {
+        frame->data[p] = data + format.getPlaneOffset(p);
+        frame->linesize[p] = format.getPlaneBytesPerLine(p);
+    }
+}
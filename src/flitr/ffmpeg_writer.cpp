@@ -33,6 +33,7 @@ using std::shared_ptr;
 FFmpegWriter::FFmpegWriter() NOEXCEPT :
 AVCodec_(0),
 AVCodecContext_(0),
+PassThrough_(false),
 WrittenFrameCount_(0)
 {
     av_register_all();
@@ -365,6 +366,11 @@ bool FFmpegWriter::openFile(std::string filename, const ImageFormat& image_forma
     }
     
     
+    //Frames the codec takes as they are do not need to be converted.
+    PassThrough_ = (SaveFrameFormat_==InputFrameFormat_) &&
+        (SaveFrameWidth_==ImageFormat_.getWidth()) &&
+        (SaveFrameHeight_==ImageFormat_.getHeight());
+    
     InputFrame_ = allocFFmpegFrame(InputFrameFormat_, ImageFormat_.getWidth(), ImageFormat_.getHeight());
     SaveFrame_ = allocFFmpegFrame(SaveFrameFormat_, SaveFrameWidth_, SaveFrameHeight_);
     
@@ -444,27 +450,32 @@ bool FFmpegWriter::openFile(std::string filename, const ImageFormat& image_forma
         pkt.size = 0;
         
         // fill the incoming picture
-        avpicture_fill((AVPicture *)InputFrame_, in_buf, InputFrameFormat_, ImageFormat_.getWidth(), ImageFormat_.getHeight());
+        fillFFmpegFrame(InputFrame_, in_buf, ImageFormat_);
+        
+        AVFrame * const encodeFrame = PassThrough_ ? InputFrame_ : SaveFrame_;
         
+        if (!PassThrough_)
+        {
 #if defined FLITR_USE_SWSCALE
-        /*
-         if ((InputFrameFormat_!=AV_PIX_FMT_GRAY8)&&(InputFrameFormat_!=AV_PIX_FMT_GRAY16LE))
-         {//Sometime the image has to be flipped.
-         InputFrame_->data[0] += InputFrame_->linesize[0] * (AVCodecContext_->height-1);
-         InputFrame_->linesize[0]*=-1;
-         }
-         */
-        //int *test = InputFrame_->linesize;
-        //printf("%d %d %d %d\n", test[0], test[1], test[2], test[3]);
-        //fflush(stdout);
-        sws_scale(ConvertToSaveCtx_,
-                  InputFrame_->data, InputFrame_->linesize, 0, ImageFormat_.getHeight(),
-                  SaveFrame_->data, SaveFrame_->linesize);
+            /*
+             if ((InputFrameFormat_!=AV_PIX_FMT_GRAY8)&&(InputFrameFormat_!=AV_PIX_FMT_GRAY16LE))
+             {//Sometime the image has to be flipped.
+             InputFrame_->data[0] += InputFrame_->linesize[0] * (AVCodecContext_->height-1);
+             InputFrame_->linesize[0]*=-1;
+             }
+             */
+            //int *test = InputFrame_->linesize;
+            //printf("%d %d %d %d\n", test[0], test[1], test[2], test[3]);
+            //fflush(stdout);
+            sws_scale(ConvertToSaveCtx_,
+                      InputFrame_->data, InputFrame_->linesize, 0, ImageFormat_.getHeight(),
+                      SaveFrame_->data, SaveFrame_->linesize);
 #else
-        img_convert((AVPicture *)SaveFrame_, AVCodecContext_->pix_fmt,
-                    (AVPicture *)InputFrame_, InputFrameFormat_,
-                    AVCodecContext_->width, AVCodecContext_->height);
+            img_convert((AVPicture *)SaveFrame_, AVCodecContext_->pix_fmt,
+                        (AVPicture *)InputFrame_, InputFrameFormat_,
+                        AVCodecContext_->width, AVCodecContext_->height);
 #endif
+        }
         
         InputFrame_->pts=WrittenFrameCount_;
         SaveFrame_->pts=WrittenFrameCount_;
@@ -478,7 +489,7 @@ bool FFmpegWriter::openFile(std::string filename, const ImageFormat& image_forma
             
             pkt.flags        |= AV_PKT_FLAG_KEY;
             pkt.stream_index  = VideoStream_->index;
-            pkt.data          = SaveFrame_->data[0];
+            pkt.data          = encodeFrame->data[0];
             pkt.size          = sizeof(AVPicture);
             
             int write_ret = av_interleaved_write_frame(FormatContext_, &pkt);
@@ -495,9 +506,9 @@ bool FFmpegWriter::openFile(std::string filename, const ImageFormat& image_forma
             
 #if LIBAVFORMAT_VERSION_INT > ((53<<16) + (35<<8) + 0)
             int got_output;
-            int encode_ret = avcodec_encode_video2(AVCodecContext_, &pkt, SaveFrame_, &got_output);
+            int encode_ret = avcodec_encode_video2(AVCodecContext_, &pkt, encodeFrame, &got_output);
 #else
-            int encode_ret = avcodec_encode_video(AVCodecContext_, VideoEncodeBuffer_, VideoEncodeBufferSize_, SaveFrame_);
+            int encode_ret = avcodec_encode_video(AVCodecContext_, VideoEncodeBuffer_, VideoEncodeBufferSize_, encodeFrame);
 #endif
             
             if (encode_ret<0)
@@ -0,0 +1,201 @@
+/* Framework for Live Image Transformation (FLITr)
+ * Copyright (c) 2010 CSIR
+ *
+ * This file is part of FLITr.
+ *
+ * FLITr is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * FLITr is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with FLITr. If not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+
+#include <flitr/gaussian_pyramid.h>
+#include <flitr/parallel_rows.h>
+
+#include <cstring>
+
+using namespace flitr;
+
+namespace {
+
+    // dst[x]=weight*src[x] for the first tap, dst[x]+=weight*src[x] for the others.
+    inline void weightRow(float * __restrict dst, float const * __restrict src, size_t n,
+                          float weight, bool first)
+    {
+        if (first)
+        {
+            for (size_t x = 0; x < n; ++x) dst[x] = weight * src[x];
+        } else
+        {
+            for (size_t x = 0; x < n; ++x) dst[x] += weight * src[x];
+        }
+    }
+
+    // The same for every second value of src.
+    inline void weightRowStride2(float * __restrict dst, float const * __restrict src, size_t n,
+                                 float weight, bool first)
+    {
+        if (first)
+        {
+            for (size_t x = 0; x < n; ++x) dst[x] = weight * src[x << 1];
+        } else
+        {
+            for (size_t x = 0; x < n; ++x) dst[x] += weight * src[x << 1];
+        }
+    }
+
+    void scharrRow(float const * __restrict above, float const * __restrict row, float const * __restrict below,
+                   float * __restrict dx, float * __restrict dy, size_t width)
+    {
+        for (size_t x = 1; x + 1 < width; ++x)
+        {
+            dx[x] = (above[x + 1] - above[x - 1]) * (3.0f/32.0f) + (row[x + 1] - row[x - 1]) * (10.0f/32.0f) +
+                    (below[x + 1] - below[x - 1]) * (3.0f/32.0f);
+            dy[x] = (below[x - 1] - above[x - 1]) * (3.0f/32.0f) + (below[x] - above[x]) * (10.0f/32.0f) +
+                    (below[x + 1] - above[x + 1]) * (3.0f/32.0f);
+        }
+        dx[0] = dy[0] = 0.0f;
+        dx[width - 1] = dy[width - 1] = 0.0f;
+    }
+}
+
+GaussianPyramid::GaussianPyramid(size_t width, size_t height, size_t num_levels, bool gradients,
+                                 const std::vector<float>& kernel) :
+    Width_(width),
+    Height_(height),
+    Kernel_(kernel.empty() ? binomialKernel() : kernel)
+{
+    const size_t maxLevels = getMaxLevels(width, height);
+    const size_t numLevels = ((num_levels == 0) || (num_levels > maxLevels)) ? maxLevels : num_levels;
+
+    for (size_t levelNum = 0; levelNum < numLevels; ++levelNum)
+    {
+        const size_t levelSize = getLevelWidth(levelNum) * getLevelHeight(levelNum);
+        Levels_.push_back(std::vector<float>(levelSize, 0.0f));
+        if (gradients)
+        {
+            Dx_.push_back(std::vector<float>(levelSize, 0.0f));
+            Dy_.push_back(std::vector<float>(levelSize, 0.0f));
+        }
+    }
+}
+
+std::vector<float> GaussianPyramid::binomialKernel()
+{
+    static const float taps[12] = { 1.0f, 11.0f, 55.0f, 165.0f, 330.0f, 462.0f,
+                                    462.0f, 330.0f, 165.0f, 55.0f, 11.0f, 1.0f };
+    std::vector<float> kernel(taps, taps + 12);
+    for (size_t i = 0; i < kernel.size(); ++i)
+    {
+        kernel[i] *= (1.0f/2048.0f);
+    }
+    return kernel;
+}
+
+size_t GaussianPyramid::getMaxLevels(size_t width, size_t height)
+{
+    size_t numLevels = 1;
+    while (((width >> numLevels) >= 2) && ((height >> numLevels) >= 2))
+    {
+        ++numLevels;
+    }
+    return numLevels;
+}
+
+void GaussianPyramid::downsample(float const * in, size_t in_width, size_t in_height, float * out,
+                                 float const * kernel, size_t kernel_width, uint32_t max_bands)
+{
+    const size_t outWidth = in_width >> 1;
+    const size_t outHeight = in_height >> 1;
+    const size_t halfKernelWidth = kernel_width >> 1;
+    if ((outWidth == 0) || (outHeight == 0) || (halfKernelWidth == 0))
+    {
+        return;
+    }
+
+    // The taps of output pixel x start at input pixel 2x + 1 - halfKernelWidth.
+    const ptrdiff_t firstTap = ptrdiff_t(1) - ptrdiff_t(halfKernelWidth);
+    const ptrdiff_t lastRow = ptrdiff_t(in_height) - 1;
+
+    ParallelRowsPool::instance().run(outHeight, FLITR_PARALLEL_ROWS_GRAIN, 0, [&](const RowBand& band)
+    {
+        // Vertically filtered input row, with the edge pixels repeated for the taps past the edges.
+        std::vector<float> padded(in_width + 2 * halfKernelWidth - 1);
+        float * const row = &padded[halfKernelWidth - 1];
+
+        for (size_t y = band.Begin; y < band.End; ++y)
+        {
+            for (size_t j = 0; j < 2 * halfKernelWidth; ++j)
+            {
+                ptrdiff_t inY = ptrdiff_t(y << 1) + firstTap + ptrdiff_t(j);
+                inY = (inY < 0) ? 0 : ((inY > lastRow) ? lastRow : inY);
+                weightRow(row, in + size_t(inY) * in_width, in_width, kernel[j], j == 0);
+            }
+            for (size_t i = 0; i + 1 < halfKernelWidth; ++i)
+            {
+                padded[i] = row[0];
+            }
+            for (size_t i = 0; i < halfKernelWidth; ++i)
+            {
+                row[in_width + i] = row[in_width - 1];
+            }
+
+            float * const outRow = out + y * outWidth;
+            for (size_t j = 0; j < 2 * halfKernelWidth; ++j)
+            {
+                weightRowStride2(outRow, &padded[j], outWidth, kernel[j], j == 0);
+            }
+        }
+    }, max_bands);
+}
+
+void GaussianPyramid::gradients(float const * in, size_t width, size_t height,
+                                float * dx, float * dy, uint32_t max_bands)
+{
+    if ((width < 3) || (height < 3))
+    {
+        memset(dx, 0, width * height * sizeof(float));
+        memset(dy, 0, width * height * sizeof(float));
+        return;
+    }
+
+    ParallelRowsPool::instance().run(height, FLITR_PARALLEL_ROWS_GRAIN, 0, [&](const RowBand& band)
+    {
+        for (size_t y = band.Begin; y < band.End; ++y)
+        {
+            const size_t lineOffset = y * width;
+            if ((y == 0) || (y + 1 == height))
+            {
+                memset(dx + lineOffset, 0, width * sizeof(float));
+                memset(dy + lineOffset, 0, width * sizeof(float));
+                continue;
+            }
+            scharrRow(in + (lineOffset - width), in + lineOffset, in + (lineOffset + width),
+                      dx + lineOffset, dy + lineOffset, width);
+        }
+    }, max_bands);
+}
+
+void GaussianPyramid::update(uint32_t max_bands)
+{
+    for (size_t levelNum = 1; levelNum < Levels_.size(); ++levelNum)
+    {
+        downsample(getLevel(levelNum - 1), getLevelWidth(levelNum - 1), getLevelHeight(levelNum - 1),
+                   getLevel(levelNum), &Kernel_[0], Kernel_.size(), max_bands);
+    }
+
+    for (size_t levelNum = 0; levelNum < Dx_.size(); ++levelNum)
+    {
+        gradients(getLevel(levelNum), getLevelWidth(levelNum), getLevelHeight(levelNum),
+                  &Dx_[levelNum][0], &Dy_[levelNum][0], max_bands);
+    }
+}
@@ -19,6 +19,8 @@
  */
 
 #include <flitr/graph_manager.h>
+#include <flitr/image_processor.h>
+#include <flitr/image_processor_executor.h>
 
 #include <algorithm>
 
@@ -100,6 +102,7 @@ public:
     ConsumersMap consumers;
 
     CategoryCreatorsMap creators;
+    std::shared_ptr<flitr::ImageProcessorExecutor> executor;
     GraphManagerPrivate() {}
 };
 //--------------------------------------------------
@@ -406,6 +409,20 @@ bool GraphManager::createGraph(const std::string &graphName)
         if((upstreamProducer != nullptr)
                 && (upstreamProducer != producer)) {
             logMessage(flitr::LOG_DEBUG) << "Created an Image Processor: " << consumerName << std::endl;
+            std::shared_ptr<flitr::ImageProcessor> processor = std::dynamic_pointer_cast<flitr::ImageProcessor>(consumer);
+            if((d->executor != nullptr)
+                    && (processor != nullptr)
+                    && (processor->isAttachedToExecutor() == false)) {
+                /* Move the processor from its own trigger thread to the shared executor. */
+                const bool threadStarted = processor->isTriggerThreadStarted();
+                processor->stopTriggerThread();
+                if(processor->attachToExecutor(d->executor) == false) {
+                    logMessage(flitr::LOG_CRITICAL) << "Could not attach the processor to the executor: " << consumerName << std::endl;
+                    if(threadStarted == true) {
+                        processor->startTriggerThread();
+                    }
+                }
+            }
             /* The last consumer created is also a producer. Thus it has to be added to the
              * list of producers. */
             createdGraph.producers.push_back(upstreamProducer);
@@ -460,6 +477,18 @@ bool GraphManager::destroyGraph(const std::string &graphName)
 }
 //--------------------------------------------------
 
+void GraphManager::setExecutor(const std::shared_ptr<ImageProcessorExecutor>& executor)
+{
+    d->executor = executor;
+}
+//--------------------------------------------------
+
+std::shared_ptr<ImageProcessorExecutor> GraphManager::executor() const
+{
+    return d->executor;
+}
+//--------------------------------------------------
+
 std::string GraphManager::producerName(const std::shared_ptr<ImageProducer>& producer) const
 {
     for(ProducersMap::value_type value: d->producers) {
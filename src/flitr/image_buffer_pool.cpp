@@ -0,0 +1,95 @@
+/* Framework for Live Image Transformation (FLITr) 
+ * Copyright (c) 2010 CSIR
+ * 
+ * This file is part of FLITr.
+ *
+ * FLITr is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ * 
+ * FLITr is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ * 
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with FLITr. If not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+
+#include <flitr/image_buffer_pool.h>
+
+extern "C" {
+#include <libavformat/avformat.h>
+}
+
+#include <cstring>
+
+using namespace flitr;
+
+ImageBufferPool::ImageBufferPool(size_t buffer_size, bool zero_mem) :
+    BufferSize_(buffer_size),
+    ZeroMem_(zero_mem),
+    NumAllocated_(0)
+{
+}
+
+ImageBufferPool::~ImageBufferPool()
+{
+    // Buffers in use hold a reference to the pool, so all are free here.
+    for (size_t i=0; i<FreeBuffers_.size(); i++)
+    {
+        av_free(FreeBuffers_[i]);
+    }
+}
+
+std::shared_ptr<uint8_t> ImageBufferPool::acquire()
+{
+    uint8_t *buffer = 0;
+    {
+        std::lock_guard<std::mutex> scopedLock(PoolMutex_);
+        if (!FreeBuffers_.empty())
+        {
+            buffer = FreeBuffers_.back();
+            FreeBuffers_.pop_back();
+        }
+    }
+
+    if (!buffer)
+    {
+        buffer = (uint8_t*)av_malloc(BufferSize_);
+        if (!buffer)
+        {
+            return std::shared_ptr<uint8_t>();
+        }
+        if (ZeroMem_)
+        {
+            memset(buffer, 0, BufferSize_);
+        }
+
+        std::lock_guard<std::mutex> scopedLock(PoolMutex_);
+        NumAllocated_++;
+    }
+
+    std::shared_ptr<ImageBufferPool> pool = shared_from_this();
+    return std::shared_ptr<uint8_t>(buffer, [pool](uint8_t *b) { pool->release(b); });
+}
+
+void ImageBufferPool::release(uint8_t *buffer)
+{
+    std::lock_guard<std::mutex> scopedLock(PoolMutex_);
+    FreeBuffers_.push_back(buffer);
+}
+
+size_t ImageBufferPool::getNumAllocated()
+{
+    std::lock_guard<std::mutex> scopedLock(PoolMutex_);
+    return NumAllocated_;
+}
+
+size_t ImageBufferPool::getNumFree()
+{
+    std::lock_guard<std::mutex> scopedLock(PoolMutex_);
+    return FreeBuffers_.size();
+}
@@ -23,10 +23,12 @@
 
 using namespace flitr;
 
-ImageConsumer::ImageConsumer(ImageProducer& producer) :
-	ImageProducer_(&producer)
+ImageConsumer::ImageConsumer(ImageProducer& producer, SharedImageBuffer::OverflowPolicy overflow_policy) :
+	ImageProducer_(&producer),
+	ProducerImageBuffer_(0),
+	SharedImageBufferIndex_(-1)
 {
-	ImageProducer_->addConsumer(*this);
+	ImageProducer_->addConsumer(*this, overflow_policy);
 }
 
 ImageConsumer::~ImageConsumer()
@@ -31,7 +31,20 @@ void ImageDiffAndScaleThread::run()
 {
     while (true)
     {
-        if (!IDS_->trigger()) FThread::microSleep(1000);
+        if (!IDS_->trigger())
+        {
+            // Block until there is space downstream and both upstream producers have written.
+            if (IDS_->getNumWriteSlotsAvailable()==0)
+            {
+                IDS_->waitForWriteSlot();
+            } else if (IDS_->ImageConsumerVec_[0]->getNumReadSlotsAvailable()==0)
+            {
+                IDS_->ImageConsumerVec_[0]->waitForReadSlot();
+            } else
+            {
+                IDS_->ImageConsumerVec_[1]->waitForReadSlot();
+            }
+        }
         
         // check for exit
         if (ShouldExit_) {
@@ -23,6 +23,7 @@
 #include <flitr/flitr_thread.h>
 
 #include <flitr/image_multiplexer.h>
+#include <flitr/high_resolution_time.h>
 
 using namespace flitr;
 using std::shared_ptr;
@@ -33,7 +34,28 @@ void ImageMultiplexerThread::run()
     {
         IM_->trigger();
 
-        FThread::microSleep(1000);
+        // The upstream producers are serviced in turn, so block until
+        // there is space downstream and the current one has written.
+        if (IM_->getNumWriteSlotsAvailable()==0)
+        {
+            IM_->waitForWriteSlot();
+        } else if (IM_->TimestampFunction_ && !IM_->ImageConsumerVec_.empty())
+        {
+            // Wait for a source that has no frame waiting, but not longer than a
+            // waiting frame may be held back.
+            size_t c=0;
+            while ((c<IM_->PendingRead_.size()) && !IM_->PendingRead_[c].empty()) c++;
+            if (c<IM_->ImageConsumerVec_.size())
+            {
+                IM_->ImageConsumerVec_[c]->waitForReadSlot(IM_->MaxTimestampWaitUS_);
+            }
+        } else if (!IM_->ImageConsumerVec_.empty())
+        {
+            IM_->ImageConsumerVec_[IM_->ConsumerIndex_]->waitForReadSlot();
+        } else
+        {
+            FThread::microSleep(1000);
+        }
 
         // check for exit
         if (ShouldExit_) {
@@ -52,7 +74,10 @@ ImageMultiplexer::ImageMultiplexer(uint32_t w, uint32_t h, ImageFormat::PixelFor
     ConsumerIndex_(0),
     DownstreamWidth_(w),
     DownstreamHeight_(h),
-    DownstreamPixFmt_(pix_fmt)
+    DownstreamPixFmt_(pix_fmt),
+    ResampleFilter_(ImageResampler::FILTER_NEAREST),
+    MaxResampleBands_(0),
+    MaxTimestampWaitUS_(20000)
 {
     std::stringstream stats_name;
     stats_name << " ImageMultiplexer::process";
@@ -112,106 +137,137 @@ bool ImageMultiplexer::startTriggerThread()
     return false;
 }
 
-bool ImageMultiplexer::trigger()
-{    
-    std::vector<Image**> imvWrite;
-    std::vector<Image**> imvRead;
+const ImageResampler& ImageMultiplexer::getResampler(uint32_t consumer_index, uint32_t img_index)
+{
+    const size_t r=size_t(consumer_index)*ImagesPerSlot_ + img_index;
+    if (Resamplers_.size()<=r)
+    {
+        Resamplers_.resize(ImageConsumerVec_.size()*ImagesPerSlot_);
+    }
 
-    //std::cout << getNumWriteSlotsAvailable() << "@write\n";
-    //std::cout.flush();
+    const ImageFormat upstreamFormat=getUpstreamFormat(consumer_index, img_index);
+    const ImageFormat downstreamFormat=getDownstreamFormat(img_index);
+    if (!Resamplers_[r] || !Resamplers_[r]->matches(upstreamFormat, downstreamFormat, ResampleFilter_))
+    {
+        Resamplers_[r]=std::make_shared<ImageResampler>(upstreamFormat, downstreamFormat, ResampleFilter_);
+    }
 
-    int32_t ThreadPlexerSource=PlexerSource_;
+    return *Resamplers_[r];
+}
 
-    if (getNumWriteSlotsAvailable())
+int32_t ImageMultiplexer::selectOldestSource()
+{
+    const size_t numSources=ImageConsumerVec_.size();
+    if (PendingRead_.size()!=numSources)
     {
-        /*
-        for (size_t i=0; i<ImageConsumerVec_.size(); i++)
-        {
-            std::cout << ImageConsumerVec_[i]->getNumReadSlotsAvailable() << "@" << i << "\n";
-            std::cout.flush();
-        }
+        PendingRead_.resize(numSources);
+        PendingSinceNS_.resize(numSources, 0);
+    }
 
-        std::cout << "Currently" << "@" << ConsumerIndex_ << "\n";
-        std::cout.flush();
-        */
-        if (ImageConsumerVec_[ConsumerIndex_]->getNumReadSlotsAvailable())
-        {
-            ProcessorStats_->tick();
+    const uint64_t nowNS=currentTimeNanoSec();
+    bool allPending=true;
+    int32_t oldest=-1;
+    uint64_t oldestTimestamp=0;
 
-            imvRead=ImageConsumerVec_[ConsumerIndex_]->reserveReadSlot();
-            
+    for (size_t c=0; c<numSources; c++)
+    {
+        if (PendingRead_[c].empty() && ImageConsumerVec_[c]->getNumReadSlotsAvailable())
+        {
+            std::vector<Image**> imvRead=ImageConsumerVec_[c]->reserveReadSlot();
             if (imvRead.size()==ImagesPerSlot_)
             {
+                PendingRead_[c]=imvRead;
+                PendingSinceNS_[c]=nowNS;
+            }
+        }
 
-                if ((ThreadPlexerSource<0)||(ConsumerIndex_==ThreadPlexerSource))
-                {
-                    imvWrite=reserveWriteSlot();
-                    if (imvWrite.size()==ImagesPerSlot_)
-                    {
-                        unsigned int i=0;
-                        for (i=0; i<ImagesPerSlot_; i++)
-                        {
-                            Image const * const imRead = *(imvRead[i]);
-                            Image * const imWrite = *(imvWrite[i]);
-
-                            const ImageFormat imReadFormat=getUpstreamFormat(ConsumerIndex_, i);
-                            //const ImageFormat::PixelFormat pixelReadFormat=imReadFormat.getPixelFormat();
-
-                            const ImageFormat imWriteFormat=getDownstreamFormat(i);
-                            const ImageFormat::PixelFormat pixelWriteFormat=imWriteFormat.getPixelFormat();
-
-                            const uint32_t readWidth=imReadFormat.getWidth();
-                            const uint32_t readHeight=imReadFormat.getHeight();
-                            const uint32_t readBytesPerPixel=imReadFormat.getBytesPerPixel();
-
-                            const uint32_t writeWidth=imWriteFormat.getWidth();
-                            const uint32_t writeHeight=imWriteFormat.getHeight();
-                            const uint32_t writeBytesPerPixel=imWriteFormat.getBytesPerPixel();
-
-                            uint8_t const * const dataRead=imRead->data();
-                            uint8_t * const dataWrite=imWrite->data();
+        if (PendingRead_[c].empty())
+        {
+            allPending=false;
+            continue;
+        }
 
-                            uint32_t writeOffset=0;
-                            const float readXOffset_delta_float=((float)readWidth)/writeWidth;
+        const uint64_t timestamp=TimestampFunction_(**(PendingRead_[c][0]));
+        if ((oldest<0) || (timestamp<oldestTimestamp))
+        {
+            oldest=int32_t(c);
+            oldestTimestamp=timestamp;
+        }
+    }
 
-                            //Do image copy and format conversion here...
+    if ((oldest>=0) &&
+        (allPending || ((nowNS-PendingSinceNS_[oldest])>=uint64_t(MaxTimestampWaitUS_)*1000)))
+    {
+        return oldest;
+    }
 
-                            for (uint32_t y=0; y<writeHeight; y++)
-                            {
-                                const uint32_t readOffset=((uint32_t)((((float)y)/writeHeight) * readHeight)) * readWidth;
+    return -1;
+}
 
-                                float readXOffset_float=0.0;
+bool ImageMultiplexer::trigger()
+{    
+    if ((getNumWriteSlotsAvailable()==0) || ImageConsumerVec_.empty())
+    {
+        return true;
+    }
 
-                                for (uint32_t x=0; x<writeWidth; x++)
-                                {
-                                    imReadFormat.cnvrtPixelFormat(dataRead+((uint32_t)(readOffset+readXOffset_float))*readBytesPerPixel,
-                                                                  dataWrite+writeOffset,
-                                                                  pixelWriteFormat);
+    const int32_t ThreadPlexerSource=PlexerSource_;
 
-                                    writeOffset+=writeBytesPerPixel;
+    uint32_t source=ConsumerIndex_;
+    std::vector<Image**> imvRead;
 
-                                    readXOffset_float+=readXOffset_delta_float;
-                                }
-                            }
+    if (TimestampFunction_)
+    {
+        const int32_t oldest=selectOldestSource();
+        if (oldest<0)
+        {
+            return true;
+        }
 
+        source=uint32_t(oldest);
+        imvRead.swap(PendingRead_[source]);
+    } else
+    {
+        if (ImageConsumerVec_[source]->getNumReadSlotsAvailable()==0)
+        {
+            return true;
+        }
 
-                        }
+        imvRead=ImageConsumerVec_[source]->reserveReadSlot();
+        if (imvRead.size()!=ImagesPerSlot_)
+        {
+            return true;
+        }
+    }
 
-                        releaseWriteSlot();
-                    }
-                }
+    ProcessorStats_->tick();
 
-                ImageConsumerVec_[ConsumerIndex_]->releaseReadSlot();
+    if ((ThreadPlexerSource<0)||(int32_t(source)==ThreadPlexerSource))
+    {
+        std::vector<Image**> imvWrite=reserveWriteSlot();
+        if (imvWrite.size()==ImagesPerSlot_)
+        {
+            for (uint32_t i=0; i<ImagesPerSlot_; i++)
+            {
+                Image const * const imRead = *(imvRead[i]);
+                Image * const imWrite = *(imvWrite[i]);
 
-                ConsumerIndex_=(ConsumerIndex_+1)%ImageConsumerVec_.size();
+                getResampler(source, i).resample(*imRead, *imWrite, MaxResampleBands_);
             }
 
-            ProcessorStats_->tock();
+            releaseWriteSlot();
         }
     }
 
+    ImageConsumerVec_[source]->releaseReadSlot();
+
+    if (!TimestampFunction_)
+    {
+        ConsumerIndex_=(ConsumerIndex_+1)%ImageConsumerVec_.size();
+    }
+
+    ProcessorStats_->tock();
 
     return true;
 }
 
-
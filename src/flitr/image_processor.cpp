@@ -19,6 +19,7 @@
  */
 
 #include <flitr/image_processor.h>
+#include <flitr/image_processor_executor.h>
 #include <sstream>
 
 using namespace flitr;
@@ -33,10 +34,7 @@ void ImageProcessorThread::run()
         if (!IP_->trigger())//The processor work happens in IP_->trigger()!!!
         {
             IP_->triggerMutex_.unlock();
-
-            // wait a while for producers and consumers if trigger() method didn't do anything...
-            FThread::microSleep(500);
-            //Thread::YieldCurrentThread();
+            IP_->waitForTriggerSlots();
         } else
         {
             ++IP_->frameNumber_;
@@ -50,13 +48,38 @@ void ImageProcessorThread::run()
     }
 }
 
+ImageProcessorFrameThread::ImageProcessorFrameThread(ImageProcessor *ip, uint32_t index) :
+    IP_(ip),
+    Stats_(ip->ProcessorStats_->getID() + " worker " + std::to_string(index)),
+    ShouldExit_(false)
+{
+}
+
+void ImageProcessorFrameThread::run()
+{
+    while (!ShouldExit_)
+    {
+        if (!IP_->triggerFrameConcurrent(Stats_))
+        {
+            IP_->waitForTriggerSlots();
+        }
+    }
+}
+
 ImageProcessor::ImageProcessor(ImageProducer& upStreamProducer,
                                uint32_t images_per_slot,
                                uint32_t buffer_size) :
     ImageConsumer(upStreamProducer),
     ImagesPerSlot_(images_per_slot),
     buffer_size_(buffer_size),
+    SharedImageBufferSyncMode_(SharedImageBuffer::SYNC_MUTEX),
+    MaxRowBands_(0),
     Thread_(0),
+    NumFrameWorkers_(1),
+    OldestFrame_(0),
+    NextFrame_(0),
+    ExecutorState_(0),
+    ExecutorDetaching_(false),
     frameNumber_(0)
 {
     std::stringstream stats_name;
@@ -76,7 +99,7 @@ bool ImageProcessor::init()
 {
     // Allocate storage
     SharedImageBuffer_ = shared_ptr<SharedImageBuffer>(
-                new SharedImageBuffer(*this, buffer_size_, ImagesPerSlot_));
+                new SharedImageBuffer(*this, buffer_size_, ImagesPerSlot_, SharedImageBufferSyncMode_));
 
     SharedImageBuffer_->initWithStorage(true);
 
@@ -85,6 +108,11 @@ bool ImageProcessor::init()
 
 bool ImageProcessor::stopTriggerThread()
 {
+    if (Executor_)
+    {
+        return detachFromExecutor();
+    }
+
     if (Thread_)
     {
         Thread_->setExit();
@@ -95,18 +123,166 @@ bool ImageProcessor::stopTriggerThread()
         return true;
     }
 
+    if (!FrameThreads_.empty())
+    {
+        for (size_t i=0; i<FrameThreads_.size(); i++)
+        {
+            FrameThreads_[i]->setExit();
+        }
+        for (size_t i=0; i<FrameThreads_.size(); i++)
+        {
+            FrameThreads_[i]->join();
+            delete FrameThreads_[i];
+        }
+        FrameThreads_.clear();
+        return true;
+    }
+
     return false;
 }
 
 bool ImageProcessor::startTriggerThread(int32_t cpu_affinity)
 {
-    if (Thread_==0)
+    if (!isTriggerThreadStarted() && Executor_==nullptr)
     {//If thread not already started.
-        Thread_ = new ImageProcessorThread(this);
-        Thread_->startThread(cpu_affinity);
+        if (NumFrameWorkers_ > 1)
+        {
+            for (uint32_t i=0; i<NumFrameWorkers_; i++)
+            {
+                FrameThreads_.push_back(new ImageProcessorFrameThread(this, i));
+                FrameThreads_.back()->startThread(cpu_affinity);
+            }
+        } else
+        {
+            Thread_ = new ImageProcessorThread(this);
+            Thread_->startThread(cpu_affinity);
+        }
 
         return true;
     }
     
     return false;
 }
+
+bool ImageProcessor::setNumFrameWorkers(uint32_t num_workers)
+{
+    if ((num_workers==0) || isTriggerThreadStarted() || ((num_workers > 1) && !isStateless()))
+    {
+        return false;
+    }
+
+    NumFrameWorkers_ = num_workers;
+    return true;
+}
+
+bool ImageProcessor::triggerFrame()
+{
+    if ((getNumReadSlotsAvailable())&&(getNumWriteSlotsAvailable()))
+    {//There are images to consume and the downstream producer has space to produce.
+        std::vector<Image**> imvRead=reserveReadSlot();
+        std::vector<Image**> imvWrite=reserveWriteSlot();
+        
+        //Start stats measurement event.
+        ProcessorStats_->tick();
+        
+        processFrame(imvRead, imvWrite);
+        
+        //Stop stats measurement event.
+        ProcessorStats_->tock();
+        
+        releaseWriteSlot();
+        releaseReadSlot();
+        
+        return true;
+    }
+    
+    return false;
+}
+
+bool ImageProcessor::triggerFrameConcurrent(StatsCollector& stats)
+{
+    std::vector<Image**> imvRead;
+    std::vector<Image**> imvWrite;
+    uint64_t frame;
+    {
+        std::lock_guard<std::mutex> frameLock(FrameMutex_);
+        if ((getNumReadSlotsAvailable()==0) || (getNumWriteSlotsAvailable()==0))
+        {
+            return false;
+        }
+        imvRead=reserveReadSlot();
+        imvWrite=reserveWriteSlot();
+        frame=NextFrame_++;
+        FramesDone_.push_back(false);
+    }
+    
+    stats.tick();
+    processFrame(imvRead, imvWrite);
+    stats.tock();
+    
+    {
+        std::lock_guard<std::mutex> frameLock(FrameMutex_);
+        FramesDone_[size_t(frame - OldestFrame_)]=true;
+        
+        // The buffers release the oldest reserved slot first, so only
+        // release once every older frame is done too.
+        while (!FramesDone_.empty() && FramesDone_.front())
+        {
+            releaseWriteSlot();
+            releaseReadSlot();
+            FramesDone_.pop_front();
+            ++OldestFrame_;
+            ++frameNumber_;
+        }
+    }
+    
+    return true;
+}
+
+void ImageProcessor::waitForTriggerSlots()
+{
+    // Block until the upstream producer has written or the
+    // downstream consumers have read, instead of polling. The
+    // timeout bounds how long it takes to notice an exit request.
+    if (getNumReadSlotsAvailable()==0)
+    {
+        waitForReadSlot();
+    } else if (getNumWriteSlotsAvailable()==0)
+    {
+        waitForWriteSlot();
+    } else
+    {
+        // trigger() declined to process the available slots, or
+        // the slots were taken by another frame worker.
+        FThread::microSleep(500);
+    }
+}
+
+bool ImageProcessor::attachToExecutor(std::shared_ptr<ImageProcessorExecutor> executor)
+{
+    if (isTriggerThreadStarted() || Executor_ || executor==nullptr)
+    {
+        return false;
+    }
+
+    Executor_ = executor;
+    if (!Executor_->attach(*this))
+    {
+        Executor_ = nullptr;
+        return false;
+    }
+
+    return true;
+}
+
+bool ImageProcessor::detachFromExecutor()
+{
+    if (Executor_)
+    {
+        Executor_->detach(*this);
+        Executor_ = nullptr;
+        return true;
+    }
+
+    return false;
+}
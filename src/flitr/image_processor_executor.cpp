@@ -0,0 +1,289 @@
+/* Framework for Live Image Transformation (FLITr)
+ * Copyright (c) 2010 CSIR
+ *
+ * This file is part of FLITr.
+ *
+ * FLITr is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * FLITr is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with FLITr. If not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+
+#include <flitr/image_processor_executor.h>
+#include <flitr/image_processor.h>
+
+using namespace flitr;
+
+namespace {
+    // Values of ImageProcessor::ExecutorState_.
+    enum {
+        // Not queued and not running. Only an IDLE processor gets queued.
+        STATE_IDLE = 0,
+        // On one of the worker queues.
+        STATE_QUEUED = 1,
+        // A worker is calling trigger().
+        STATE_RUNNING = 2,
+        // As STATE_RUNNING, and an event arrived during the trigger().
+        STATE_RERUN = 3,
+        // Detached. Never queued again.
+        STATE_DETACHED = 4
+    };
+
+    // Lets schedule() find the queue of the worker it is called from.
+    thread_local ImageProcessorExecutor *CurrentExecutor = 0;
+    thread_local uint32_t CurrentWorker = 0;
+}
+
+void ImageProcessorExecutorThread::run()
+{
+    Executor_->runWorker(Index_);
+}
+
+ImageProcessorExecutor::ImageProcessorExecutor(uint32_t num_threads,
+                                               const std::vector<int32_t>& cpu_affinities) :
+    NextQueue_(0),
+    NumQueued_(0),
+    NumIdle_(0),
+    ShouldExit_(false)
+{
+    if (num_threads==0)
+    {
+        num_threads = std::thread::hardware_concurrency();
+        if (num_threads==0) num_threads = 1;
+    }
+
+    for (uint32_t i=0; i<num_threads; i++)
+    {
+        Queues_.push_back(std::unique_ptr<WorkerQueue>(new WorkerQueue()));
+    }
+
+    for (uint32_t i=0; i<num_threads; i++)
+    {
+        int32_t cpu_affinity = -1;
+        if (!cpu_affinities.empty())
+        {
+            cpu_affinity = cpu_affinities[i % cpu_affinities.size()];
+        }
+
+        Threads_.push_back(std::unique_ptr<ImageProcessorExecutorThread>(new ImageProcessorExecutorThread(this, i)));
+        Threads_.back()->startThread(cpu_affinity);
+    }
+}
+
+ImageProcessorExecutor::~ImageProcessorExecutor()
+{
+    {
+        std::lock_guard<std::mutex> idleLock(IdleMutex_);
+        ShouldExit_ = true;
+    }
+    IdleCondition_.notify_all();
+
+    for (size_t i=0; i<Threads_.size(); i++)
+    {
+        Threads_[i]->join();
+    }
+    Threads_.clear();
+}
+
+bool ImageProcessorExecutor::attach(ImageProcessor& processor)
+{
+    SharedImageBuffer *upstream = processor.getProducerImageBuffer();
+    SharedImageBuffer *downstream = processor.SharedImageBuffer_.get();
+    if (upstream==0 || downstream==0)
+    {
+        return false;
+    }
+
+    processor.ExecutorState_ = STATE_IDLE;
+    processor.ExecutorDetaching_ = false;
+
+    ImageProcessor *ip = &processor;
+    upstream->addSlotListener(SharedImageBuffer::SLOT_READABLE, ip, [this, ip]() { schedule(*ip); });
+    downstream->addSlotListener(SharedImageBuffer::SLOT_WRITABLE, ip, [this, ip]() { schedule(*ip); });
+
+    // Catch up on slots written before the listeners were added.
+    schedule(processor);
+    return true;
+}
+
+void ImageProcessorExecutor::detach(ImageProcessor& processor)
+{
+    SharedImageBuffer *upstream = processor.getProducerImageBuffer();
+    if (upstream) upstream->removeSlotListeners(&processor);
+    if (processor.SharedImageBuffer_) processor.SharedImageBuffer_->removeSlotListeners(&processor);
+    processor.ExecutorDetaching_ = true;
+
+    // Wait for a worker to hand the processor back. A queued or
+    // running processor is not triggered again once it sees this.
+    uint32_t expected = STATE_IDLE;
+    while (!processor.ExecutorState_.compare_exchange_strong(expected, STATE_DETACHED))
+    {
+        if (expected==STATE_DETACHED)
+        {
+            return;
+        }
+        expected = STATE_IDLE;
+        FThread::microSleep(100);
+    }
+}
+
+void ImageProcessorExecutor::schedule(ImageProcessor& processor)
+{
+    uint32_t state = processor.ExecutorState_.load();
+    while (true)
+    {
+        if (state==STATE_IDLE)
+        {
+            if (processor.ExecutorState_.compare_exchange_weak(state, STATE_QUEUED))
+            {
+                const uint32_t index = (CurrentExecutor==this) ?
+                    CurrentWorker : (NextQueue_.fetch_add(1) % uint32_t(Queues_.size()));
+                push(&processor, index);
+                return;
+            }
+        } else if (state==STATE_RUNNING)
+        {
+            if (processor.ExecutorState_.compare_exchange_weak(state, STATE_RERUN))
+            {
+                return;
+            }
+        } else
+        {
+            // Already queued, already flagged for a rerun or detached.
+            return;
+        }
+    }
+}
+
+void ImageProcessorExecutor::push(ImageProcessor* processor, uint32_t index, bool requeue)
+{
+    // Count first so that a worker that takes the processor never
+    // sees the count drop below zero.
+    NumQueued_.fetch_add(1);
+    {
+        std::lock_guard<std::mutex> queueLock(Queues_[index]->Mutex);
+        if (requeue)
+        {// The owning worker pops from the back, so the front is taken last.
+            Queues_[index]->Processors.push_front(processor);
+        } else
+        {
+            Queues_[index]->Processors.push_back(processor);
+        }
+    }
+
+    // Pairs with the fence in runWorker(): either the idle worker sees
+    // the queued processor or we see the idle worker.
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if (NumIdle_.load(std::memory_order_relaxed) != 0)
+    {
+        {
+            std::lock_guard<std::mutex> idleLock(IdleMutex_);
+        }
+        IdleCondition_.notify_one();
+    }
+}
+
+ImageProcessor* ImageProcessorExecutor::takeProcessor(uint32_t index)
+{
+    const uint32_t numQueues = uint32_t(Queues_.size());
+
+    for (uint32_t i=0; i<numQueues; i++)
+    {
+        WorkerQueue& queue = *Queues_[(index + i) % numQueues];
+        std::lock_guard<std::mutex> queueLock(queue.Mutex);
+        if (!queue.Processors.empty())
+        {
+            ImageProcessor *processor = 0;
+            if (i==0)
+            {// Our own queue: newest first.
+                processor = queue.Processors.back();
+                queue.Processors.pop_back();
+            } else
+            {// Stealing: oldest first.
+                processor = queue.Processors.front();
+                queue.Processors.pop_front();
+            }
+            NumQueued_.fetch_sub(1);
+            return processor;
+        }
+    }
+
+    return 0;
+}
+
+void ImageProcessorExecutor::runProcessor(ImageProcessor* processor, uint32_t index)
+{
+    // Only the worker that dequeued the processor gets here, so the
+    // state can be set without a compare-exchange.
+    processor->ExecutorState_ = STATE_RUNNING;
+
+    while (true)
+    {
+        if (processor->ExecutorDetaching_)
+        {
+            processor->ExecutorState_ = STATE_IDLE;
+            return;
+        }
+
+        bool triggered = false;
+        {
+            std::lock_guard<std::mutex> triggerLock(processor->triggerMutex_);
+            if (processor->trigger())//The processor work happens in trigger()!!!
+            {
+                ++processor->frameNumber_;
+                triggered = true;
+            }
+        }
+
+        if (triggered)
+        {
+            // There may be more to do. Queue it again behind the other
+            // processors of this worker rather than loop so that they get a turn.
+            processor->ExecutorState_ = STATE_QUEUED;
+            push(processor, index, true);
+            return;
+        }
+
+        uint32_t expected = STATE_RUNNING;
+        if (processor->ExecutorState_.compare_exchange_strong(expected, STATE_IDLE))
+        {
+            return;
+        }
+
+        // An event arrived while trigger() was running.
+        processor->ExecutorState_ = STATE_RUNNING;
+    }
+}
+
+void ImageProcessorExecutor::runWorker(uint32_t index)
+{
+    CurrentExecutor = this;
+    CurrentWorker = index;
+
+    while (!ShouldExit_)
+    {
+        ImageProcessor *processor = takeProcessor(index);
+        if (processor)
+        {
+            runProcessor(processor, index);
+            continue;
+        }
+
+        std::unique_lock<std::mutex> idleLock(IdleMutex_);
+        NumIdle_.fetch_add(1, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        IdleCondition_.wait(idleLock, [this]() { return (NumQueued_.load() != 0) || ShouldExit_; });
+        NumIdle_.fetch_sub(1, std::memory_order_relaxed);
+    }
+
+    CurrentExecutor = 0;
+}
@@ -24,7 +24,20 @@
 #include <cstring>
 
 #include <flitr/image_processor_utils.h>
+#include <flitr/gaussian_pyramid.h>
+#include <flitr/parallel_rows.h>
+#include <flitr/cpu_features.h>
+#include <flitr/pixel_format_converter.h>
 #include <sstream>
+#include <algorithm>
+#include <limits>
+
+#if defined(FLITR_X86_SIMD)
+#include <immintrin.h>
+#endif
+#if defined(FLITR_NEON_SIMD)
+#include <arm_neon.h>
+#endif
 
 using namespace flitr;
 using std::shared_ptr;
@@ -45,8 +58,10 @@ void BoxFilter::setKernelWidth(const int kernelWidth)
 
 bool BoxFilter::filter(float * const dataWriteDS, float const * const dataReadUS,
                        const size_t width, const size_t height,
-                       float * const dataScratch)
+                       float * const dataScratch,
+                       const size_t lineStride)
 {
+    const size_t stride=(lineStride!=0) ? lineStride : width;
     const size_t widthMinusKernel=width-kernelWidth_;
     const size_t heightMinusKernel=height-kernelWidth_;
     const float recipKernelWidth=1.0f/kernelWidth_;
@@ -56,7 +71,7 @@ bool BoxFilter::filter(float * const dataWriteDS, float const * const dataReadUS
     for (size_t y=0; y<height; ++y)
     {
         const size_t lineOffsetFS=y * width + halfKernelWidth;
-        const size_t lineOffsetUS=y * width;
+        const size_t lineOffsetUS=y * stride;
         
         for (size_t x=0; x<widthMinusKernel; ++x)
         {
@@ -73,7 +88,7 @@ bool BoxFilter::filter(float * const dataWriteDS, float const * const dataReadUS
     
     for (size_t y=0; y<heightMinusKernel; ++y)
     {
-        const size_t lineOffsetDS=(y + halfKernelWidth) * width;
+        const size_t lineOffsetDS=(y + halfKernelWidth) * stride;
         const size_t lineOffsetFS=y * width;
         
         for (size_t x=halfKernelWidth; x<widthMinusHalfKernel; ++x)
@@ -96,8 +111,10 @@ bool BoxFilter::filter(float * const dataWriteDS, float const * const dataReadUS
 
 bool BoxFilter::filterRGB(float * const dataWriteDS, float const * const dataReadUS,
                        const size_t width, const size_t height,
-                       float * const dataScratch)
+                       float * const dataScratch,
+                       const size_t lineStride)
 {
+    const size_t stride=(lineStride!=0) ? lineStride : width*3;
     const size_t widthMinusKernel=width-kernelWidth_;
     const size_t heightMinusKernel=height-kernelWidth_;
     const float recipKernelWidth=1.0f/kernelWidth_;
@@ -107,7 +124,7 @@ bool BoxFilter::filterRGB(float * const dataWriteDS, float const * const dataRea
     for (size_t y=0; y<height; ++y)
     {
         const size_t lineOffsetFS=y * width + halfKernelWidth;
-        const size_t lineOffsetUS=y * width;
+        const size_t lineOffsetUS=y * stride;
         
         for (size_t x=0; x<widthMinusKernel; ++x)
         {
@@ -117,9 +134,9 @@ bool BoxFilter::filterRGB(float * const dataWriteDS, float const * const dataRea
             
             for (size_t j=0; j<kernelWidth_; ++j)
             {
-                xFiltValueR += dataReadUS[((lineOffsetUS + x) + j)*3 + 0];
-                xFiltValueG += dataReadUS[((lineOffsetUS + x) + j)*3 + 1];
-                xFiltValueB += dataReadUS[((lineOffsetUS + x) + j)*3 + 2];
+                xFiltValueR += dataReadUS[lineOffsetUS + (x + j)*3 + 0];
+                xFiltValueG += dataReadUS[lineOffsetUS + (x + j)*3 + 1];
+                xFiltValueB += dataReadUS[lineOffsetUS + (x + j)*3 + 2];
             }
             
             dataScratch[(lineOffsetFS + x)*3 + 0]=xFiltValueR*recipKernelWidth;
@@ -130,7 +147,7 @@ bool BoxFilter::filterRGB(float * const dataWriteDS, float const * const dataRea
     
     for (size_t y=0; y<heightMinusKernel; ++y)
     {
-        const size_t lineOffsetDS=(y + halfKernelWidth) * width;
+        const size_t lineOffsetDS=(y + halfKernelWidth) * stride;
         const size_t lineOffsetFS=y * width;
         
         for (size_t x=halfKernelWidth; x<widthMinusHalfKernel; ++x)
@@ -146,9 +163,9 @@ bool BoxFilter::filterRGB(float * const dataWriteDS, float const * const dataRea
                 filtValueB += dataScratch[((lineOffsetFS + x) + j*width)*3 + 2];
             }
             
-            dataWriteDS[(lineOffsetDS + x)*3 + 0]=filtValueR*recipKernelWidth;
-            dataWriteDS[(lineOffsetDS + x)*3 + 1]=filtValueG*recipKernelWidth;
-            dataWriteDS[(lineOffsetDS + x)*3 + 2]=filtValueB*recipKernelWidth;
+            dataWriteDS[lineOffsetDS + x*3 + 0]=filtValueR*recipKernelWidth;
+            dataWriteDS[lineOffsetDS + x*3 + 1]=filtValueG*recipKernelWidth;
+            dataWriteDS[lineOffsetDS + x*3 + 2]=filtValueB*recipKernelWidth;
         }
     }
     
@@ -157,8 +174,10 @@ bool BoxFilter::filterRGB(float * const dataWriteDS, float const * const dataRea
 
 bool BoxFilter::filter(uint8_t * const dataWriteDS, uint8_t const * const dataReadUS,
                        const size_t width, const size_t height,
-                       uint8_t * const dataScratch)
+                       uint8_t * const dataScratch,
+                       const size_t lineStride)
 {
+    const size_t stride=(lineStride!=0) ? lineStride : width;
     const size_t widthMinusKernel=width-kernelWidth_;
     const size_t heightMinusKernel=height-kernelWidth_;
     const size_t halfKernelWidth=(kernelWidth_>>1);
@@ -167,7 +186,7 @@ bool BoxFilter::filter(uint8_t * const dataWriteDS, uint8_t const * const dataRe
     for (size_t y=0; y<height; ++y)
     {
         const size_t lineOffsetFS=y * width + halfKernelWidth;
-        const size_t lineOffsetUS=y * width;
+        const size_t lineOffsetUS=y * stride;
         
         for (size_t x=0; x<widthMinusKernel; ++x)
         {
@@ -185,7 +204,7 @@ bool BoxFilter::filter(uint8_t * const dataWriteDS, uint8_t const * const dataRe
     
     for (size_t y=0; y<heightMinusKernel; ++y)
     {
-        const size_t lineOffsetDS=(y + halfKernelWidth) * width;
+        const size_t lineOffsetDS=(y + halfKernelWidth) * stride;
         const size_t lineOffsetFS=y * width;
         
         for (size_t x=halfKernelWidth; x<widthMinusHalfKernel; ++x)
@@ -209,8 +228,10 @@ bool BoxFilter::filter(uint8_t * const dataWriteDS, uint8_t const * const dataRe
 
 bool BoxFilter::filterRGB(uint8_t * const dataWriteDS, uint8_t const * const dataReadUS,
                           const size_t width, const size_t height,
-                          uint8_t * const dataScratch)
+                          uint8_t * const dataScratch,
+                          const size_t lineStride)
 {
+    const size_t stride=(lineStride!=0) ? lineStride : width*3;
     const size_t widthMinusKernel=width-kernelWidth_;
     const size_t heightMinusKernel=height-kernelWidth_;
     const size_t halfKernelWidth=(kernelWidth_>>1);
@@ -219,7 +240,7 @@ bool BoxFilter::filterRGB(uint8_t * const dataWriteDS, uint8_t const * const dat
     for (size_t y=0; y<height; ++y)
     {
         const size_t lineOffsetFS=y * width + halfKernelWidth;
-        const size_t lineOffsetUS=y * width;
+        const size_t lineOffsetUS=y * stride;
         
         for (size_t x=0; x<widthMinusKernel; ++x)
         {
@@ -230,9 +251,9 @@ bool BoxFilter::filterRGB(uint8_t * const dataWriteDS, uint8_t const * const dat
             
             for (size_t j=0; j<kernelWidth_; ++j)
             {
-                xFiltValueR += dataReadUS[((lineOffsetUS + x) + j)*3 + 0];
-                xFiltValueG += dataReadUS[((lineOffsetUS + x) + j)*3 + 1];
-                xFiltValueB += dataReadUS[((lineOffsetUS + x) + j)*3 + 2];
+                xFiltValueR += dataReadUS[lineOffsetUS + (x + j)*3 + 0];
+                xFiltValueG += dataReadUS[lineOffsetUS + (x + j)*3 + 1];
+                xFiltValueB += dataReadUS[lineOffsetUS + (x + j)*3 + 2];
             }
             
             dataScratch[(lineOffsetFS + x)*3 + 0]=xFiltValueR/kernelWidth_;
@@ -243,7 +264,7 @@ bool BoxFilter::filterRGB(uint8_t * const dataWriteDS, uint8_t const * const dat
     
     for (size_t y=0; y<heightMinusKernel; ++y)
     {
-        const size_t lineOffsetDS=(y + halfKernelWidth) * width;
+        const size_t lineOffsetDS=(y + halfKernelWidth) * stride;
         const size_t lineOffsetFS=y * width;
         
         for (size_t x=halfKernelWidth; x<widthMinusHalfKernel; ++x)
@@ -260,12 +281,246 @@ bool BoxFilter::filterRGB(uint8_t * const dataWriteDS, uint8_t const * const dat
                 filtValueB += dataScratch[((lineOffsetFS + x) + j*width)*3 + 2];
             }
             
-            dataWriteDS[(lineOffsetDS + x)*3 + 0]=filtValueR/kernelWidth_;
-            dataWriteDS[(lineOffsetDS + x)*3 + 1]=filtValueG/kernelWidth_;
-            dataWriteDS[(lineOffsetDS + x)*3 + 2]=filtValueB/kernelWidth_;
+            dataWriteDS[lineOffsetDS + x*3 + 0]=filtValueR/kernelWidth_;
+            dataWriteDS[lineOffsetDS + x*3 + 1]=filtValueG/kernelWidth_;
+            dataWriteDS[lineOffsetDS + x*3 + 2]=filtValueB/kernelWidth_;
+        }
+    }
+    
+    return true;
+}
+
+//=========================================//
+
+
+
+//=========== IntegralImage ==========//
+
+namespace {
+
+    /*! Integral image of rows [begin, end) as if row begin were the first row of the image.
+     *  computeIntegralImage() adds the rows above afterwards.*/
+    template<typename In, typename Sum>
+    void integralBandScalar(Sum * const integral, In const * const data, const size_t width, const size_t channels,
+                            const size_t stride, const size_t begin, const size_t end)
+    {
+        const size_t numValues=width*channels;
+        
+        for (size_t y=begin; y<end; ++y)
+        {
+            In const * const lineRead=data + y*stride;
+            Sum * const lineWrite=integral + y*numValues;
+            
+            for (size_t c=0; c<channels; ++c)
+            {
+                Sum lineSum=0;
+                for (size_t x=c; x<numValues; x+=channels)
+                {
+                    lineSum+=Sum(lineRead[x]);
+                    lineWrite[x]=lineSum;
+                }
+            }
+            
+            if (y>begin)
+            {
+                Sum const * const lineAbove=lineWrite - numValues;
+                for (size_t x=0; x<numValues; ++x)
+                {
+                    lineWrite[x]+=lineAbove[x];
+                }
+            }
+        }
+    }
+    
+#if defined(FLITR_X86_SIMD)
+    /*! SSE2 version for single channel 8 bit data. Four sums at a time are scanned with two shifted adds,
+     *  and the row above is added in the same pass.*/
+    FLITR_TARGET("sse2") void integralBandY8SSE2(uint32_t * const integral, uint8_t const * const data, const size_t width,
+                                                 const size_t stride, const size_t begin, const size_t end)
+    {
+        const __m128i zero=_mm_setzero_si128();
+        
+        for (size_t y=begin; y<end; ++y)
+        {
+            uint8_t const * const lineRead=data + y*stride;
+            uint32_t * const lineWrite=integral + y*width;
+            uint32_t const * const lineAbove=(y>begin) ? lineWrite - width : nullptr;
+            
+            __m128i carry=zero;
+            size_t x=0;
+            for (; x+16<=width; x+=16)
+            {
+                const __m128i bytes=_mm_loadu_si128((__m128i const *)(lineRead + x));
+                const __m128i lo=_mm_unpacklo_epi8(bytes, zero);
+                const __m128i hi=_mm_unpackhi_epi8(bytes, zero);
+                __m128i v[4]={_mm_unpacklo_epi16(lo, zero), _mm_unpackhi_epi16(lo, zero),
+                              _mm_unpacklo_epi16(hi, zero), _mm_unpackhi_epi16(hi, zero)};
+                
+                for (int i=0; i<4; ++i)
+                {
+                    v[i]=_mm_add_epi32(v[i], _mm_slli_si128(v[i], 4));
+                    v[i]=_mm_add_epi32(v[i], _mm_slli_si128(v[i], 8));
+                    v[i]=_mm_add_epi32(v[i], carry);
+                    carry=_mm_shuffle_epi32(v[i], 0xFF);
+                    
+                    __m128i out=v[i];
+                    if (lineAbove!=nullptr)
+                    {
+                        out=_mm_add_epi32(out, _mm_loadu_si128((__m128i const *)(lineAbove + x + i*4)));
+                    }
+                    _mm_storeu_si128((__m128i *)(lineWrite + x + i*4), out);
+                }
+            }
+            
+            uint32_t lineSum=uint32_t(_mm_cvtsi128_si32(carry));
+            for (; x<width; ++x)
+            {
+                lineSum+=lineRead[x];
+                lineWrite[x]=lineSum + ((lineAbove!=nullptr) ? lineAbove[x] : 0);
+            }
+        }
+    }
+#endif
+    
+    template<typename In, typename Sum>
+    void integralBand(Sum * const integral, In const * const data, const size_t width, const size_t channels,
+                      const size_t stride, const size_t begin, const size_t end)
+    {
+        integralBandScalar(integral, data, width, channels, stride, begin, end);
+    }
+    
+    template<>
+    void integralBand<uint8_t, uint32_t>(uint32_t * const integral, uint8_t const * const data, const size_t width, const size_t channels,
+                                         const size_t stride, const size_t begin, const size_t end)
+    {
+#if defined(FLITR_X86_SIMD)
+        if ((channels==1) && isSimdLevelEnabled(FLITR_SIMD_SSE2))
+        {
+            integralBandY8SSE2(integral, data, width, stride, begin, end);
+            return;
+        }
+#endif
+        integralBandScalar(integral, data, width, channels, stride, begin, end);
+    }
+    
+    /*! Packed integral image of an image with the given number of interleaved channels.
+     *
+     *  A parallel two pass prefix sum: every band of rows first sums its own rows. The last rows of
+     *  the bands are then chained from the top, and each band adds the total of the rows above it.*/
+    template<typename In, typename Sum>
+    void computeIntegralImage(Sum * const integral, In const * const data, const size_t width, const size_t height,
+                              const size_t channels, const size_t stride, const uint32_t maxBands)
+    {
+        const size_t numValues=width*channels;
+        
+        std::vector<uint8_t> isBandStart(height, 0);
+        ParallelRowsPool::instance().run(height, FLITR_PARALLEL_ROWS_GRAIN, 0, [&](const RowBand& band)
+        {
+            isBandStart[band.Begin]=1;
+            integralBand(integral, data, width, channels, stride, band.Begin, band.End);
+        }, maxBands);
+        
+        //=== Totals of the rows above every band but the first, and the band of every row.
+        std::vector<Sum> bandOffsets;
+        std::vector<uint32_t> bandOfRow(height);
+        uint32_t bandNum=0;
+        for (size_t y=0; y<height; ++y)
+        {
+            if (isBandStart[y] && (y>0))
+            {
+                ++bandNum;
+                bandOffsets.resize(bandNum*numValues);
+                Sum * const offset=&bandOffsets[(bandNum-1)*numValues];
+                Sum const * const lineAbove=integral + (y-1)*numValues;
+                for (size_t x=0; x<numValues; ++x)
+                {
+                    offset[x]=lineAbove[x] + ((bandNum>1) ? offset[x - numValues] : Sum(0));
+                }
+            }
+            bandOfRow[y]=bandNum;
+        }
+        
+        if (bandNum==0)
+        {
+            return;
         }
+        
+        ParallelRowsPool::instance().run(height, FLITR_PARALLEL_ROWS_GRAIN, 0, [&](const RowBand& band)
+        {
+            for (size_t y=band.Begin; y<band.End; ++y)
+            {
+                if (bandOfRow[y]==0) continue;
+                
+                Sum * const lineWrite=integral + y*numValues;
+                Sum const * const offset=&bandOffsets[(bandOfRow[y]-1)*numValues];
+                for (size_t x=0; x<numValues; ++x)
+                {
+                    lineWrite[x]+=offset[x];
+                }
+            }
+        }, maxBands);
     }
     
+    inline float boxSumToFloat(const double sum) { return float(sum); }
+    inline float boxSumToFloat(const uint32_t sum) { return float(int32_t(sum)); }//Signed conversion is much faster, and sums of 8 bit boxes fit.
+    
+    inline void storeBoxMean(float& out, const float mean) { out=mean; }
+    inline void storeBoxMean(uint8_t& out, const float mean) { out=uint8_t(mean + 0.5f); }
+    
+    /*! Box filter from an integral image. Writes the same pixels as the original BoxFilterII loops:
+     *  the box of the kernelWidth rows and columns after (y, x) goes to (y + kernelWidth/2 + 1, x + kernelWidth/2 + 1).*/
+    template<typename Sum, typename Out>
+    void boxFilterFromIntegral(Out * const dataWriteDS, Sum const * const integral, const size_t width, const size_t height,
+                               const size_t channels, const size_t kernelWidth, const uint32_t maxBands)
+    {
+        if ((width<=kernelWidth) || (height<=kernelWidth))
+        {
+            return;
+        }
+        
+        const size_t numValues=width*channels;
+        const size_t halfKernelWidth=(kernelWidth>>1);
+        const size_t kernelValues=kernelWidth*channels;
+        const size_t widthMinusKernelValues=(width - kernelWidth)*channels;
+        const float recipKernelWidthSq=1.0f / (kernelWidth*kernelWidth);
+        
+        ParallelRowsPool::instance().run(height - kernelWidth, FLITR_PARALLEL_ROWS_GRAIN, 0, [&](const RowBand& band)
+        {
+            for (size_t y=band.Begin; y<band.End; ++y)
+            {
+                Sum const * const top=integral + y*numValues;
+                Sum const * const bottom=integral + (y + kernelWidth)*numValues;
+                Out * const lineWrite=dataWriteDS + (y + halfKernelWidth + 1)*numValues + (halfKernelWidth + 1)*channels;
+                
+                for (size_t i=0; i<widthMinusKernelValues; ++i)
+                {
+                    // In unsigned arithmetic the wrapped sums cancel exactly.
+                    const Sum boxSum=Sum(Sum(bottom[i + kernelValues] - bottom[i]) - Sum(top[i + kernelValues] - top[i]));
+                    storeBoxMean(lineWrite[i], boxSumToFloat(boxSum) * recipKernelWidthSq);
+                }
+            }
+        }, maxBands);
+    }
+}
+
+bool IntegralImage::process(uint32_t * const dataWriteDS, uint8_t const * const dataReadUS,
+                            const size_t width, const size_t height, const size_t lineStride)
+{
+    computeIntegralImage(dataWriteDS, dataReadUS, width, height, 1, (lineStride!=0) ? lineStride : width, maxRowBands_);
+    return true;
+}
+
+bool IntegralImage::processRGB(uint32_t * const dataWriteDS, uint8_t const * const dataReadUS,
+                               const size_t width, const size_t height, const size_t lineStride)
+{
+    computeIntegralImage(dataWriteDS, dataReadUS, width, height, 3, (lineStride!=0) ? lineStride : width*3, maxRowBands_);
+    return true;
+}
+
+bool IntegralImage::process(uint64_t * const dataWriteDS, uint16_t const * const dataReadUS,
+                            const size_t width, const size_t height, const size_t lineStride)
+{
+    computeIntegralImage(dataWriteDS, dataReadUS, width, height, 1, (lineStride!=0) ? lineStride : width, maxRowBands_);
     return true;
 }
 
@@ -276,7 +531,8 @@ bool BoxFilter::filterRGB(uint8_t * const dataWriteDS, uint8_t const * const dat
 //=========== BoxFilterII ==========//
 
 BoxFilterII::BoxFilterII(const size_t kernelWidth) :
-kernelWidth_(kernelWidth|1)//Make sure the kernel width is odd.
+kernelWidth_(kernelWidth|1),//Make sure the kernel width is odd.
+maxRowBands_(0)
 {}
 
 BoxFilterII::~BoxFilterII() {}
@@ -293,34 +549,10 @@ bool BoxFilterII::filter(float * const dataWriteDS, float const * const dataRead
 {
     if (recalcIntegralImage)
     {
-        integralImage_.process(IIDoubleScratch, dataReadUS, width, height);
+        computeIntegralImage(IIDoubleScratch, dataReadUS, width, height, 1, width, maxRowBands_);
     }
     
-    const size_t kernelWidth=kernelWidth_;
-    const size_t halfKernelWidth=(kernelWidth_>>1);
-    const size_t widthMinusKernel=width - kernelWidth_;
-    const size_t heightMinusKernel=height - kernelWidth_;
-    const float recipKernelWidthSq=1.0f / (kernelWidth_*kernelWidth_);
-    const size_t widthTimesKernelWidth = width*kernelWidth_;
-    
-    for (size_t y=0; y<heightMinusKernel; ++y)
-    {
-        size_t lineOffset=(y+halfKernelWidth+1) * width + (halfKernelWidth+1);
-        size_t lineOffsetII=(y+kernelWidth) * width + kernelWidth;
-        
-        for (size_t x=0; x<widthMinusKernel; ++x)
-        {
-            const float c=IIDoubleScratch[lineOffsetII]
-            - IIDoubleScratch[lineOffsetII - kernelWidth]
-            - IIDoubleScratch[lineOffsetII - widthTimesKernelWidth]
-            + IIDoubleScratch[lineOffsetII - kernelWidth - widthTimesKernelWidth];
-            
-            dataWriteDS[lineOffset]=c * recipKernelWidthSq;
-            
-            ++lineOffset;
-            ++lineOffsetII;
-        }
-    }
+    boxFilterFromIntegral(dataWriteDS, IIDoubleScratch, width, height, 1, kernelWidth_, maxRowBands_);
     
     return true;
 }
@@ -332,44 +564,10 @@ bool BoxFilterII::filterRGB(float * const dataWriteDS, float const * const dataR
 {
     if (recalcIntegralImage)
     {
-        integralImage_.processRGB(IIDoubleScratch, dataReadUS, width, height);
+        computeIntegralImage(IIDoubleScratch, dataReadUS, width, height, 3, width*3, maxRowBands_);
     }
     
-    const size_t kernelWidth=kernelWidth_;
-    const size_t halfKernelWidth=(kernelWidth_>>1);
-    const size_t widthMinusKernel=width - kernelWidth_;
-    const size_t heightMinusKernel=height - kernelWidth_;
-    const float recipKernelWidthSq=1.0f / (kernelWidth_*kernelWidth_);
-    const size_t widthTimesKernelWidth = width*kernelWidth_;
-    
-    for (size_t y=0; y<heightMinusKernel; ++y)
-    {
-        size_t lineOffset=(y+halfKernelWidth+1) * width + (halfKernelWidth+1);
-        size_t lineOffsetII=(y+kernelWidth) * width + kernelWidth_;
-        
-        for (size_t x=0; x<widthMinusKernel; ++x)
-        {
-            const float R=IIDoubleScratch[lineOffsetII*3 + 0]
-            - IIDoubleScratch[(lineOffsetII - kernelWidth)*3 + 0]
-            - IIDoubleScratch[(lineOffsetII - widthTimesKernelWidth)*3 + 0]
-            + IIDoubleScratch[(lineOffsetII - kernelWidth - widthTimesKernelWidth)*3 + 0];
-            const float G=IIDoubleScratch[lineOffsetII*3 + 1]
-            - IIDoubleScratch[(lineOffsetII - kernelWidth)*3 + 1]
-            - IIDoubleScratch[(lineOffsetII - widthTimesKernelWidth)*3 + 1]
-            + IIDoubleScratch[(lineOffsetII - kernelWidth - widthTimesKernelWidth)*3 + 1];
-            const float B=IIDoubleScratch[lineOffsetII*3 + 2]
-            - IIDoubleScratch[(lineOffsetII - kernelWidth)*3 + 2]
-            - IIDoubleScratch[(lineOffsetII - widthTimesKernelWidth)*3 + 2]
-            + IIDoubleScratch[(lineOffsetII - kernelWidth - widthTimesKernelWidth)*3 + 2];
-            
-            dataWriteDS[lineOffset*3 + 0]=R * recipKernelWidthSq;
-            dataWriteDS[lineOffset*3 + 1]=G * recipKernelWidthSq;
-            dataWriteDS[lineOffset*3 + 2]=B * recipKernelWidthSq;
-            
-            ++lineOffset;
-            ++lineOffsetII;
-        }
-    }
+    boxFilterFromIntegral(dataWriteDS, IIDoubleScratch, width, height, 3, kernelWidth_, maxRowBands_);
     
     return true;
 }
@@ -381,34 +579,10 @@ bool BoxFilterII::filter(uint8_t * const dataWriteDS, uint8_t const * const data
 {
     if (recalcIntegralImage)
     {
-        integralImage_.process(IIDoubleScratch, dataReadUS, width, height);
+        computeIntegralImage(IIDoubleScratch, dataReadUS, width, height, 1, width, maxRowBands_);
     }
     
-    const size_t kernelWidth=kernelWidth_;
-    const size_t halfKernelWidth=(kernelWidth_>>1);
-    const size_t widthMinusKernel=width - kernelWidth_;
-    const size_t heightMinusKernel=height - kernelWidth_;
-    const float recipKernelWidthSq=1.0f / (kernelWidth_*kernelWidth_);
-    const size_t widthTimesKernelWidth = width*kernelWidth_;
-    
-    for (size_t y=0; y<heightMinusKernel; ++y)
-    {
-        size_t lineOffset=(y+halfKernelWidth+1) * width + (halfKernelWidth+1);
-        size_t lineOffsetII=(y+kernelWidth) * width + kernelWidth;
-        
-        for (size_t x=0; x<widthMinusKernel; ++x)
-        {
-            const float c=IIDoubleScratch[lineOffsetII]
-            - IIDoubleScratch[lineOffsetII - kernelWidth]
-            - IIDoubleScratch[lineOffsetII - widthTimesKernelWidth]
-            + IIDoubleScratch[lineOffsetII - kernelWidth - widthTimesKernelWidth];
-            
-            dataWriteDS[lineOffset]=uint8_t(c * recipKernelWidthSq + 0.5f);
-            
-            ++lineOffset;
-            ++lineOffsetII;
-        }
-    }
+    boxFilterFromIntegral(dataWriteDS, IIDoubleScratch, width, height, 1, kernelWidth_, maxRowBands_);
     
     return true;
 }
@@ -420,45 +594,41 @@ bool BoxFilterII::filterRGB(uint8_t * const dataWriteDS, uint8_t const * const d
 {
     if (recalcIntegralImage)
     {
-        integralImage_.processRGB(IIDoubleScratch, dataReadUS, width, height);
+        computeIntegralImage(IIDoubleScratch, dataReadUS, width, height, 3, width*3, maxRowBands_);
     }
     
-    const size_t kernelWidth=kernelWidth_;
-    const size_t halfKernelWidth=(kernelWidth_>>1);
-    const size_t widthMinusKernel=width - kernelWidth_;
-    const size_t heightMinusKernel=height - kernelWidth_;
-    const float recipKernelWidthSq=1.0f / (kernelWidth_*kernelWidth_);
-    const size_t widthTimesKernelWidth = width*kernelWidth_;
+    boxFilterFromIntegral(dataWriteDS, IIDoubleScratch, width, height, 3, kernelWidth_, maxRowBands_);
     
-    for (size_t y=0; y<heightMinusKernel; ++y)
+    return true;
+}
+
+bool BoxFilterII::filter(uint8_t * const dataWriteDS, uint8_t const * const dataReadUS,
+                         const size_t width, const size_t height,
+                         uint32_t * const IIScratch,
+                         const bool recalcIntegralImage)
+{
+    if (recalcIntegralImage)
     {
-        size_t lineOffset=(y+halfKernelWidth+1) * width + (halfKernelWidth+1);
-        size_t lineOffsetII=(y+kernelWidth) * width + kernelWidth;
-        
-        for (size_t x=0; x<widthMinusKernel; ++x)
-        {
-            const float R=IIDoubleScratch[lineOffsetII*3 + 0]
-            - IIDoubleScratch[(lineOffsetII - kernelWidth)*3 + 0]
-            - IIDoubleScratch[(lineOffsetII - widthTimesKernelWidth)*3 + 0]
-            + IIDoubleScratch[(lineOffsetII - kernelWidth - widthTimesKernelWidth)*3 + 0];
-            const float G=IIDoubleScratch[lineOffsetII*3 + 1]
-            - IIDoubleScratch[(lineOffsetII - kernelWidth)*3 + 1]
-            - IIDoubleScratch[(lineOffsetII - widthTimesKernelWidth)*3 + 1]
-            + IIDoubleScratch[(lineOffsetII - kernelWidth - widthTimesKernelWidth)*3 + 1];
-            const float B=IIDoubleScratch[lineOffsetII*3 + 2]
-            - IIDoubleScratch[(lineOffsetII - kernelWidth)*3 + 2]
-            - IIDoubleScratch[(lineOffsetII - widthTimesKernelWidth)*3 + 2]
-            + IIDoubleScratch[(lineOffsetII - kernelWidth - widthTimesKernelWidth)*3 + 2];
-            
-            dataWriteDS[lineOffset*3 + 0]=uint8_t(R * recipKernelWidthSq + 0.5f);
-            dataWriteDS[lineOffset*3 + 1]=uint8_t(G * recipKernelWidthSq + 0.5f);
-            dataWriteDS[lineOffset*3 + 2]=uint8_t(B * recipKernelWidthSq + 0.5f);
-            
-            ++lineOffset;
-            ++lineOffsetII;
-        }
+        integralImage_.process(IIScratch, dataReadUS, width, height);
+    }
+    
+    boxFilterFromIntegral(dataWriteDS, IIScratch, width, height, 1, kernelWidth_, maxRowBands_);
+    
+    return true;
+}
+
+bool BoxFilterII::filterRGB(uint8_t * const dataWriteDS, uint8_t const * const dataReadUS,
+                            const size_t width, const size_t height,
+                            uint32_t * const IIScratch,
+                            const bool recalcIntegralImage)
+{
+    if (recalcIntegralImage)
+    {
+        integralImage_.processRGB(IIScratch, dataReadUS, width, height);
     }
     
+    boxFilterFromIntegral(dataWriteDS, IIScratch, width, height, 3, kernelWidth_, maxRowBands_);
+    
     return true;
 }
 
@@ -778,333 +948,365 @@ bool BoxFilterRS::filterRGB(uint8_t * const dataWriteDS, uint8_t const * const d
 
 
 
-//=========== GaussianFilter ==========//
-
-GaussianFilter::GaussianFilter(const float filterRadius,
-                               const size_t kernelWidth) :
-kernel1D_(nullptr),
-filterRadius_(filterRadius),
-kernelWidth_(kernelWidth|1)//Make sure the kernel width is odd.
-{
-    updateKernel1D();
-}
+//=========== Separable convolution kernels ==========//
 
-GaussianFilter::~GaussianFilter()
-{
-    delete [] kernel1D_;
-}
+namespace {
 
-void GaussianFilter::updateKernel1D()
-{
-    if (kernel1D_!=nullptr) delete [] kernel1D_;
-    
-    kernel1D_=new float[kernelWidth_];
-    
-    const float kernelCentre=kernelWidth_ * 0.5f;
-    const float sigma=filterRadius_ * 0.5f;
-    
-    const float twoSigmaSquared=2.0f * (sigma*sigma);
-    const float stdNorm=1.0f / (sqrt(2.0f*float(M_PI))*sigma);
-    
-    float kernelSum=0.0f;
-    
-    for (size_t i=0; i<kernelWidth_; ++i)
-    {
-        const float r=(i + 0.5f) - kernelCentre;
-        const float g=stdNorm * exp(-(r*r)/twoSigmaSquared);
-        kernel1D_[i]=g;
-        kernelSum+=g;
-    }
-    
-    const float recipKernelSum=1.0f / kernelSum;
-    
-    //=== Ensure that the kernel is normalised within the specified kernel width!
-    for (size_t i=0; i<kernelWidth_; ++i)
-    {
-        kernel1D_[i] *= recipKernelSum;
-    }
-}
+    /*! Fixed point precision of the 8 bit Gaussian. The weights sum to 1<<14 and the
+     * horizontal pass keeps 8 fractional bits, so no product overflows 32 bits.*/
+    const int GaussWeightBits=14;
+    const int GaussMidBits=8;
 
-void GaussianFilter::setFilterRadius(const float filterRadius)
-{
-    filterRadius_=filterRadius;
-    updateKernel1D();
-}
+    /*! Bytes of horizontally filtered rows a band keeps per column strip. The vertical
+     * pass re-reads every row kernelWidth times, so they should stay in the L1/L2 caches.*/
+    const size_t GaussStripBytes=48*1024;
 
-float GaussianFilter::getFilterRadius() const
-{
-    return filterRadius_;
-}
+    /* The row kernels set out[i] to the sum over j of rows[j][i] * kernel[j], for i in [begin, n).
+     * The 8 bit horizontal pass keeps GaussMidBits fractional bits, which the vertical pass rounds off.*/
+    typedef void (*ConvolveF32Function)(float const * const * rows, size_t kernelWidth, float const * kernel, float * out, size_t begin, size_t n);
+    typedef void (*ConvolveU8Function)(uint8_t const * const * rows, size_t kernelWidth, uint16_t const * kernel, uint16_t * out, size_t begin, size_t n);
+    typedef void (*ConvolveU16Function)(uint16_t const * const * rows, size_t kernelWidth, uint16_t const * kernel, uint8_t * out, size_t begin, size_t n);
 
-void GaussianFilter::setKernelWidth(const int kernelWidth)
-{
-    kernelWidth_=kernelWidth|1;
-    updateKernel1D();
-}
+    void convolveF32Scalar(float const * const * rows, size_t kernelWidth, float const * kernel, float * out, size_t begin, size_t n)
+    {
+        // Row by row, so that the compiler may vectorise the loops. The sums are added in the same order as the SIMD kernels.
+        for (size_t i=begin; i<n; ++i)
+        {
+            out[i]=rows[0][i] * kernel[0];
+        }
+        for (size_t j=1; j<kernelWidth; ++j)
+        {
+            float const * const row=rows[j];
+            const float k=kernel[j];
+            for (size_t i=begin; i<n; ++i)
+            {
+                out[i] += row[i] * k;
+            }
+        }
+    }
 
-bool GaussianFilter::filter(float * const dataWriteDS, float const * const dataReadUS,
-                            const size_t width, const size_t height,
-                            float * const dataScratch)
-{
-    const size_t kernelWidth=kernelWidth_;
-    const size_t widthMinusKernel=width-kernelWidth_;
-    const size_t heightMinusKernel=height-kernelWidth_;
-    
-    const size_t halfKernelWidth=(kernelWidth_>>1);
-    const size_t widthMinusHalfKernel=width-halfKernelWidth;
-    
-    for (size_t y=0; y<height; ++y)
+    void convolveU8Scalar(uint8_t const * const * rows, size_t kernelWidth, uint16_t const * kernel, uint16_t * out, size_t begin, size_t n)
     {
-        const size_t lineOffsetFS=y * width + halfKernelWidth;
-        const size_t lineOffsetUS=y * width;
-        
-        for (size_t x=0; x<widthMinusKernel; ++x)
+        for (size_t i=begin; i<n; ++i)
         {
-            float xFiltValue=0.0f;
-            
+            uint32_t sum=0;
             for (size_t j=0; j<kernelWidth; ++j)
             {
-                xFiltValue += dataReadUS[(lineOffsetUS + x) + j] * kernel1D_[j];
+                sum += uint32_t(rows[j][i]) * kernel[j];
             }
-            
-            dataScratch[lineOffsetFS + x]=xFiltValue;
+            out[i]=uint16_t((sum + (1u << (GaussWeightBits-GaussMidBits-1))) >> (GaussWeightBits-GaussMidBits));
         }
     }
-    
-    for (size_t y=0; y<heightMinusKernel; ++y)
+
+    void convolveU16Scalar(uint16_t const * const * rows, size_t kernelWidth, uint16_t const * kernel, uint8_t * out, size_t begin, size_t n)
     {
-        const size_t lineOffsetDS=(y + halfKernelWidth) * width;
-        const size_t lineOffsetFS=y * width;
-        
-        for (size_t x=halfKernelWidth; x<widthMinusHalfKernel; ++x)
+        for (size_t i=begin; i<n; ++i)
         {
-            float filtValue=0.0f;
-            
+            uint32_t sum=0;
             for (size_t j=0; j<kernelWidth; ++j)
             {
-                filtValue += dataScratch[(lineOffsetFS + x) + j*width] * kernel1D_[j];
-                //Performance note: The XCode profiler shows that the above multiply by width has little performance overhead compared to the loop in x above.
-                //                  Is the code memory bandwidth limited?
+                sum += uint32_t(rows[j][i]) * kernel[j];
             }
-            
-            dataWriteDS[lineOffsetDS + x]=filtValue;
+            out[i]=uint8_t((sum + (1u << (GaussWeightBits+GaussMidBits-1))) >> (GaussWeightBits+GaussMidBits));
         }
     }
-    
-    return true;
-}
 
-bool GaussianFilter::filterRGB(float * const dataWriteDS, float const * const dataReadUS,
-                               const size_t width, const size_t height,
-                               float * const dataScratch)
-{
-    const size_t kernelWidth=kernelWidth_;
-    const size_t widthMinusKernel=width-kernelWidth_;
-    const size_t heightMinusKernel=height-kernelWidth_;
-    
-    const size_t halfKernelWidth=(kernelWidth_>>1);
-    const size_t widthMinusHalfKernel=width-halfKernelWidth;
-    
-    for (size_t y=0; y<height; ++y)
+#if defined(FLITR_X86_SIMD)
+    FLITR_TARGET("sse2") void convolveF32SSE2(float const * const * rows, size_t kernelWidth, float const * kernel, float * out, size_t begin, size_t n)
     {
-        const size_t lineOffsetFS=y * width + halfKernelWidth;
-        const size_t lineOffsetUS=y * width;
-        
-        for (size_t x=0; x<widthMinusKernel; ++x)
+        size_t i=begin;
+        for (; i+4<=n; i+=4)
         {
-            float xFiltValueR=0.0f;
-            float xFiltValueG=0.0f;
-            float xFiltValueB=0.0f;
-            
+            __m128 sum=_mm_setzero_ps();
             for (size_t j=0; j<kernelWidth; ++j)
             {
-                const size_t xOffset=((lineOffsetUS + x) + j)*3;
-                
-                xFiltValueR += dataReadUS[xOffset + 0] * kernel1D_[j];
-                xFiltValueG += dataReadUS[xOffset + 1] * kernel1D_[j];
-                xFiltValueB += dataReadUS[xOffset + 2] * kernel1D_[j];
+                sum=_mm_add_ps(sum, _mm_mul_ps(_mm_loadu_ps(rows[j]+i), _mm_set1_ps(kernel[j])));
             }
-            
-            const size_t xOffset=(lineOffsetFS + x)*3;
-            
-            dataScratch[xOffset + 0]=xFiltValueR;
-            dataScratch[xOffset + 1]=xFiltValueG;
-            dataScratch[xOffset + 2]=xFiltValueB;
+            _mm_storeu_ps(out+i, sum);
         }
+        convolveF32Scalar(rows, kernelWidth, kernel, out, i, n);
     }
-    
-    for (size_t y=0; y<heightMinusKernel; ++y)
+
+    FLITR_TARGET("avx2") void convolveF32AVX2(float const * const * rows, size_t kernelWidth, float const * kernel, float * out, size_t begin, size_t n)
     {
-        const size_t lineOffsetDS=(y + halfKernelWidth) * width;
-        const size_t lineOffsetFS=y * width;
-        
-        for (size_t x=halfKernelWidth; x<widthMinusHalfKernel; ++x)
+        size_t i=begin;
+        for (; i+16<=n; i+=16)
+        {// Two independent sums hide the latency of the adds.
+            __m256 sum0=_mm256_setzero_ps();
+            __m256 sum1=_mm256_setzero_ps();
+            for (size_t j=0; j<kernelWidth; ++j)
+            {
+                const __m256 k=_mm256_set1_ps(kernel[j]);
+                sum0=_mm256_add_ps(sum0, _mm256_mul_ps(_mm256_loadu_ps(rows[j]+i), k));
+                sum1=_mm256_add_ps(sum1, _mm256_mul_ps(_mm256_loadu_ps(rows[j]+i+8), k));
+            }
+            _mm256_storeu_ps(out+i, sum0);
+            _mm256_storeu_ps(out+i+8, sum1);
+        }
+        convolveF32SSE2(rows, kernelWidth, kernel, out, i, n);
+    }
+
+    FLITR_TARGET("avx512f") void convolveF32AVX512(float const * const * rows, size_t kernelWidth, float const * kernel, float * out, size_t begin, size_t n)
+    {
+        size_t i=begin;
+        for (; i+32<=n; i+=32)
         {
-            float filtValueR=0.0f;
-            float filtValueG=0.0f;
-            float filtValueB=0.0f;
-            
+            __m512 sum0=_mm512_setzero_ps();
+            __m512 sum1=_mm512_setzero_ps();
             for (size_t j=0; j<kernelWidth; ++j)
             {
-                const size_t xOffset=((lineOffsetFS + x) + j*width)*3;
-                
-                filtValueR += dataScratch[xOffset + 0] * kernel1D_[j];
-                filtValueG += dataScratch[xOffset + 1] * kernel1D_[j];
-                filtValueB += dataScratch[xOffset + 2] * kernel1D_[j];
+                const __m512 k=_mm512_set1_ps(kernel[j]);
+                sum0=_mm512_add_ps(sum0, _mm512_mul_ps(_mm512_loadu_ps(rows[j]+i), k));
+                sum1=_mm512_add_ps(sum1, _mm512_mul_ps(_mm512_loadu_ps(rows[j]+i+16), k));
             }
-            
-            const size_t xOffset=(lineOffsetDS + x)*3;
-            
-            dataWriteDS[xOffset + 0]=filtValueR;
-            dataWriteDS[xOffset + 1]=filtValueG;
-            dataWriteDS[xOffset + 2]=filtValueB;
+            _mm512_storeu_ps(out+i, sum0);
+            _mm512_storeu_ps(out+i+16, sum1);
         }
+        convolveF32AVX2(rows, kernelWidth, kernel, out, i, n);
     }
-    
-    return true;
-}
 
-bool GaussianFilter::filter(uint8_t * const dataWriteDS, uint8_t const * const dataReadUS,
-                            const size_t width, const size_t height,
-                            uint8_t * const dataScratch)
-{
-    const size_t kernelWidth=kernelWidth_;
-    const size_t widthMinusKernel=width - kernelWidth_;
-    const size_t heightMinusKernel=height - kernelWidth_;
-    
-    const size_t halfKernelWidth=(kernelWidth_>>1);
-    const size_t widthMinusHalfKernel=width-halfKernelWidth;
-    
-    for (size_t y=0; y<height; ++y)
+    // 32 bit products of unsigned 16 bit values and weights, added to sum0 (lanes 0-3) and sum1 (lanes 4-7).
+    FLITR_TARGET("sse2") inline void madd16SSE2(const __m128i a, const __m128i k, __m128i& sum0, __m128i& sum1)
     {
-        const size_t lineOffsetFS=y * width + halfKernelWidth;
-        const size_t lineOffsetUS=y * width;
-        
-        for (size_t x=0; x<widthMinusKernel; ++x)
+        const __m128i lo=_mm_mullo_epi16(a, k);
+        const __m128i hi=_mm_mulhi_epu16(a, k);
+        sum0=_mm_add_epi32(sum0, _mm_unpacklo_epi16(lo, hi));
+        sum1=_mm_add_epi32(sum1, _mm_unpackhi_epi16(lo, hi));
+    }
+
+    FLITR_TARGET("sse2") void convolveU8SSE2(uint8_t const * const * rows, size_t kernelWidth, uint16_t const * kernel, uint16_t * out, size_t begin, size_t n)
+    {
+        const __m128i zero=_mm_setzero_si128();
+        const __m128i round=_mm_set1_epi32(1 << (GaussWeightBits-GaussMidBits-1));
+        const __m128i bias32=_mm_set1_epi32(32768);
+        const __m128i bias16=_mm_set1_epi16(short(0x8000));
+        size_t i=begin;
+        for (; i+8<=n; i+=8)
         {
-            float xFiltValue=0.0f;
-            
+            __m128i sum0=round;
+            __m128i sum1=round;
             for (size_t j=0; j<kernelWidth; ++j)
             {
-                xFiltValue += dataReadUS[(lineOffsetUS + x) + j] * kernel1D_[j];
+                const __m128i a=_mm_unpacklo_epi8(_mm_loadl_epi64((__m128i const *)(rows[j]+i)), zero);
+                madd16SSE2(a, _mm_set1_epi16(short(kernel[j])), sum0, sum1);
             }
-            
-            dataScratch[lineOffsetFS + x]=uint8_t(xFiltValue+0.5f);
+            sum0=_mm_sub_epi32(_mm_srli_epi32(sum0, GaussWeightBits-GaussMidBits), bias32);
+            sum1=_mm_sub_epi32(_mm_srli_epi32(sum1, GaussWeightBits-GaussMidBits), bias32);
+            // SSE2 has no unsigned 32 to 16 bit pack, so pack around zero and move back.
+            _mm_storeu_si128((__m128i *)(out+i), _mm_xor_si128(_mm_packs_epi32(sum0, sum1), bias16));
         }
+        convolveU8Scalar(rows, kernelWidth, kernel, out, i, n);
     }
-    
-    for (size_t y=0; y<heightMinusKernel; ++y)
+
+    FLITR_TARGET("sse2") void convolveU16SSE2(uint16_t const * const * rows, size_t kernelWidth, uint16_t const * kernel, uint8_t * out, size_t begin, size_t n)
     {
-        const size_t lineOffsetDS=(y + halfKernelWidth) * width;
-        const size_t lineOffsetFS=y * width;
-        
-        for (size_t x=halfKernelWidth; x<widthMinusHalfKernel; ++x)
+        const __m128i round=_mm_set1_epi32(1 << (GaussWeightBits+GaussMidBits-1));
+        size_t i=begin;
+        for (; i+8<=n; i+=8)
         {
-            float filtValue=0.0f;
-            
+            __m128i sum0=round;
+            __m128i sum1=round;
             for (size_t j=0; j<kernelWidth; ++j)
             {
-                filtValue += dataScratch[(lineOffsetFS + x) + j*width] * kernel1D_[j];
-                //Performance note: The XCode profiler shows that the above multiply by width has little performance overhead compared to the loop in x above.
-                //                  Is the code memory bandwidth limited?
+                madd16SSE2(_mm_loadu_si128((__m128i const *)(rows[j]+i)), _mm_set1_epi16(short(kernel[j])), sum0, sum1);
             }
-            
-            dataWriteDS[lineOffsetDS + x]=uint8_t(filtValue+0.5f);
+            sum0=_mm_srli_epi32(sum0, GaussWeightBits+GaussMidBits);
+            sum1=_mm_srli_epi32(sum1, GaussWeightBits+GaussMidBits);
+            const __m128i s=_mm_packs_epi32(sum0, sum1);
+            _mm_storel_epi64((__m128i *)(out+i), _mm_packus_epi16(s, s));
         }
+        convolveU16Scalar(rows, kernelWidth, kernel, out, i, n);
     }
-    
-    return true;
-}
 
-bool GaussianFilter::filterRGB(uint8_t * const dataWriteDS, uint8_t const * const dataReadUS,
-                               const size_t width, const size_t height,
-                               uint8_t * const dataScratch)
-{
-    const size_t kernelWidth=kernelWidth_;
-    const size_t widthMinusKernel=width - kernelWidth_;
-    const size_t heightMinusKernel=height - kernelWidth_;
-    
-    const size_t halfKernelWidth=(kernelWidth_>>1);
-    const size_t widthMinusHalfKernel=width-halfKernelWidth;
-    
-    for (size_t y=0; y<height; ++y)
+    FLITR_TARGET("avx2") inline void madd16AVX2(const __m256i a, const __m256i k, __m256i& sum0, __m256i& sum1)
     {
-        const size_t lineOffsetFS=y * width + halfKernelWidth;
-        const size_t lineOffsetUS=y * width;
-        
-        for (size_t x=0; x<widthMinusKernel; ++x)
+        const __m256i lo=_mm256_mullo_epi16(a, k);
+        const __m256i hi=_mm256_mulhi_epu16(a, k);
+        sum0=_mm256_add_epi32(sum0, _mm256_unpacklo_epi16(lo, hi));
+        sum1=_mm256_add_epi32(sum1, _mm256_unpackhi_epi16(lo, hi));
+    }
+
+    // The unpacks and packs below work within 128 bit lanes, so the order of the values is kept.
+    FLITR_TARGET("avx2") void convolveU8AVX2(uint8_t const * const * rows, size_t kernelWidth, uint16_t const * kernel, uint16_t * out, size_t begin, size_t n)
+    {
+        const __m256i round=_mm256_set1_epi32(1 << (GaussWeightBits-GaussMidBits-1));
+        size_t i=begin;
+        for (; i+16<=n; i+=16)
         {
-            float xFiltValueR=0.0f;
-            float xFiltValueG=0.0f;
-            float xFiltValueB=0.0f;
-            
+            __m256i sum0=round;
+            __m256i sum1=round;
             for (size_t j=0; j<kernelWidth; ++j)
             {
-                const size_t xOffset=((lineOffsetUS + x) + j)*3;
-                
-                xFiltValueR += float(dataReadUS[xOffset + 0]) * kernel1D_[j];
-                xFiltValueG += float(dataReadUS[xOffset + 1]) * kernel1D_[j];
-                xFiltValueB += float(dataReadUS[xOffset + 2]) * kernel1D_[j];
+                const __m256i a=_mm256_cvtepu8_epi16(_mm_loadu_si128((__m128i const *)(rows[j]+i)));
+                madd16AVX2(a, _mm256_set1_epi16(short(kernel[j])), sum0, sum1);
             }
-            
-            const size_t xOffset=(lineOffsetFS + x)*3;
-            
-            dataScratch[xOffset + 0]=uint8_t(xFiltValueR+0.5f);
-            dataScratch[xOffset + 1]=uint8_t(xFiltValueG+0.5f);
-            dataScratch[xOffset + 2]=uint8_t(xFiltValueB+0.5f);
+            sum0=_mm256_srli_epi32(sum0, GaussWeightBits-GaussMidBits);
+            sum1=_mm256_srli_epi32(sum1, GaussWeightBits-GaussMidBits);
+            _mm256_storeu_si256((__m256i *)(out+i), _mm256_packus_epi32(sum0, sum1));
         }
+        convolveU8SSE2(rows, kernelWidth, kernel, out, i, n);
     }
-    
-    for (size_t y=0; y<heightMinusKernel; ++y)
+
+    FLITR_TARGET("avx2") void convolveU16AVX2(uint16_t const * const * rows, size_t kernelWidth, uint16_t const * kernel, uint8_t * out, size_t begin, size_t n)
     {
-        const size_t lineOffsetDS=(y + halfKernelWidth) * width;
-        const size_t lineOffsetFS=y * width;
-        
-        for (size_t x=halfKernelWidth; x<widthMinusHalfKernel; ++x)
+        const __m256i round=_mm256_set1_epi32(1 << (GaussWeightBits+GaussMidBits-1));
+        size_t i=begin;
+        for (; i+16<=n; i+=16)
         {
-            float filtValueR=0.0f;
-            float filtValueG=0.0f;
-            float filtValueB=0.0f;
-            
+            __m256i sum0=round;
+            __m256i sum1=round;
             for (size_t j=0; j<kernelWidth; ++j)
             {
-                const size_t xOffset=((lineOffsetFS + x) + j*width)*3;
-                
-                filtValueR += float(dataScratch[xOffset + 0]) * kernel1D_[j];
-                filtValueG += float(dataScratch[xOffset + 1]) * kernel1D_[j];
-                filtValueB += float(dataScratch[xOffset + 2]) * kernel1D_[j];
+                madd16AVX2(_mm256_loadu_si256((__m256i const *)(rows[j]+i)), _mm256_set1_epi16(short(kernel[j])), sum0, sum1);
             }
-            
-            const size_t xOffset=(lineOffsetDS + x)*3;
-            
-            dataWriteDS[xOffset + 0]=uint8_t(filtValueR+0.5f);
-            dataWriteDS[xOffset + 1]=uint8_t(filtValueG+0.5f);
-            dataWriteDS[xOffset + 2]=uint8_t(filtValueB+0.5f);
+            sum0=_mm256_srli_epi32(sum0, GaussWeightBits+GaussMidBits);
+            sum1=_mm256_srli_epi32(sum1, GaussWeightBits+GaussMidBits);
+            const __m256i s=_mm256_packs_epi32(sum0, sum1);
+            const __m256i b=_mm256_permute4x64_epi64(_mm256_packus_epi16(s, s), 0x08);
+            _mm_storeu_si128((__m128i *)(out+i), _mm256_castsi256_si128(b));
         }
+        convolveU16SSE2(rows, kernelWidth, kernel, out, i, n);
+    }
+#endif
+
+#if defined(FLITR_NEON_SIMD)
+    void convolveF32NEON(float const * const * rows, size_t kernelWidth, float const * kernel, float * out, size_t begin, size_t n)
+    {
+        size_t i=begin;
+        for (; i+4<=n; i+=4)
+        {
+            float32x4_t sum=vdupq_n_f32(0.0f);
+            for (size_t j=0; j<kernelWidth; ++j)
+            {
+                sum=vaddq_f32(sum, vmulq_f32(vld1q_f32(rows[j]+i), vdupq_n_f32(kernel[j])));
+            }
+            vst1q_f32(out+i, sum);
+        }
+        convolveF32Scalar(rows, kernelWidth, kernel, out, i, n);
+    }
+#endif
+
+    ConvolveF32Function chooseConvolveF32()
+    {
+#if defined(FLITR_X86_SIMD)
+        if (isSimdLevelEnabled(FLITR_SIMD_AVX512)) return &convolveF32AVX512;
+        if (isSimdLevelEnabled(FLITR_SIMD_AVX2)) return &convolveF32AVX2;
+        if (isSimdLevelEnabled(FLITR_SIMD_SSE2)) return &convolveF32SSE2;
+#endif
+#if defined(FLITR_NEON_SIMD)
+        if (isSimdLevelEnabled(FLITR_SIMD_NEON)) return &convolveF32NEON;
+#endif
+        return &convolveF32Scalar;
+    }
+
+    void chooseConvolveU8(ConvolveU8Function& horizontal, ConvolveU16Function& vertical)
+    {
+        horizontal=&convolveU8Scalar;
+        vertical=&convolveU16Scalar;
+#if defined(FLITR_X86_SIMD)
+        if (isSimdLevelEnabled(FLITR_SIMD_AVX2))
+        {
+            horizontal=&convolveU8AVX2;
+            vertical=&convolveU16AVX2;
+        } else if (isSimdLevelEnabled(FLITR_SIMD_SSE2))
+        {
+            horizontal=&convolveU8SSE2;
+            vertical=&convolveU16SSE2;
+        }
+#endif
+    }
+
+    /*! Separable convolution of the interior of an image, i.e. the pixels at least
+     * kernelWidth/2 from the edges. The rest of dst is not written.
+     *
+     * Bands of rows run in parallel. Each band walks down column strips, filtering every
+     * input row horizontally once into a ring of kernelWidth rows, from which the output
+     * rows are filtered vertically while the ring is still in cache. src and dst may be
+     * the same image.*/
+    template<typename In, typename Mid, typename Out, typename Weight>
+    void separableConvolve(Out * const dst, In const * const src,
+                           const size_t width, const size_t height, const size_t channels, const size_t stride,
+                           const size_t kernelWidth, Weight const * const kernel,
+                           void (*horizontal)(In const * const *, size_t, Weight const *, Mid *, size_t, size_t),
+                           void (*vertical)(Mid const * const *, size_t, Weight const *, Out *, size_t, size_t),
+                           const uint32_t maxBands)
+    {
+        const size_t halfKernelWidth=kernelWidth>>1;
+        if ((width<kernelWidth) || (height<kernelWidth))
+        {
+            return;
+        }
+
+        // Rows are read above and below the rows a band writes, so filtering in place needs a copy.
+        std::vector<In> srcCopy;
+        In const * source=src;
+        if ((void const *)src==(void const *)dst)
+        {
+            srcCopy.assign(src, src + stride*(height-1) + width*channels);
+            source=&srcCopy[0];
+        }
+
+        const size_t stripPixels=std::max<size_t>(16, GaussStripBytes / (kernelWidth*sizeof(Mid)*channels));
+        const size_t stripValues=stripPixels*channels;
+
+        ParallelRowsPool::instance().run(height - 2*halfKernelWidth, FLITR_PARALLEL_ROWS_GRAIN, 0, [&](const RowBand& band)
+        {
+            std::vector<Mid> ring(kernelWidth*stripValues);
+            std::vector<In const *> taps(kernelWidth);
+            std::vector<Mid const *> rows(kernelWidth);
+
+            // Output rows [yBegin, yEnd) need input rows [yBegin-half, yEnd+half).
+            const size_t yBegin=band.Begin + halfKernelWidth;
+            const size_t yEnd=band.End + halfKernelWidth;
+
+            for (size_t x0=halfKernelWidth; x0<width-halfKernelWidth; x0+=stripPixels)
+            {
+                const size_t x1=std::min(x0 + stripPixels, width-halfKernelWidth);
+                const size_t n=(x1-x0)*channels;
+
+                for (size_t r=yBegin-halfKernelWidth; r<yEnd+halfKernelWidth; ++r)
+                {
+                    In const * const line=source + r*stride + (x0-halfKernelWidth)*channels;
+                    for (size_t j=0; j<kernelWidth; ++j)
+                    {
+                        taps[j]=line + j*channels;
+                    }
+                    horizontal(&taps[0], kernelWidth, kernel, &ring[(r%kernelWidth)*stripValues], 0, n);
+
+                    if (r >= yBegin+halfKernelWidth)
+                    {// The ring holds all the rows of output row y.
+                        const size_t y=r-halfKernelWidth;
+                        for (size_t j=0; j<kernelWidth; ++j)
+                        {
+                            rows[j]=&ring[((y-halfKernelWidth+j)%kernelWidth)*stripValues];
+                        }
+                        vertical(&rows[0], kernelWidth, kernel, dst + y*stride + x0*channels, 0, n);
+                    }
+                }
+            }
+        }, maxBands);
     }
-    
-    return true;
 }
-//=========================================//
 
 
+//=========== GaussianFilter ==========//
 
-//=========== GaussianDownsample ==========//
-GaussianDownsample::GaussianDownsample(const float filterRadius,
-                                       const size_t kernelWidth) :
+GaussianFilter::GaussianFilter(const float filterRadius,
+                               const size_t kernelWidth) :
 kernel1D_(nullptr),
 filterRadius_(filterRadius),
-kernelWidth_((kernelWidth>>1)<<1)//Make sure the kernel width is even.
+kernelWidth_(kernelWidth|1),//Make sure the kernel width is odd.
+maxRowBands_(0)
 {
     updateKernel1D();
 }
 
-GaussianDownsample::~GaussianDownsample()
+GaussianFilter::~GaussianFilter()
 {
     delete [] kernel1D_;
 }
 
-void GaussianDownsample::updateKernel1D()
+void GaussianFilter::updateKernel1D()
 {
     if (kernel1D_!=nullptr) delete [] kernel1D_;
     
@@ -1113,83 +1315,111 @@ void GaussianDownsample::updateKernel1D()
     const float kernelCentre=kernelWidth_ * 0.5f;
     const float sigma=filterRadius_ * 0.5f;
     
+    const float twoSigmaSquared=2.0f * (sigma*sigma);
+    const float stdNorm=1.0f / (sqrt(2.0f*float(M_PI))*sigma);
+    
     float kernelSum=0.0f;
     
     for (size_t i=0; i<kernelWidth_; ++i)
     {
-        const float r=((i + 0.5f) - kernelCentre);
-        kernel1D_[i]=(1.0f/(sqrt(2.0f*float(M_PI))*sigma)) * exp(-(r*r)/(2.0f*sigma*sigma));
-        kernelSum+=kernel1D_[i];
+        const float r=(i + 0.5f) - kernelCentre;
+        const float g=stdNorm * exp(-(r*r)/twoSigmaSquared);
+        kernel1D_[i]=g;
+        kernelSum+=g;
     }
     
-    //=== Ensure that the kernel is normalised!
+    const float recipKernelSum=1.0f / kernelSum;
+    
+    //=== Ensure that the kernel is normalised within the specified kernel width!
     for (size_t i=0; i<kernelWidth_; ++i)
     {
-        kernel1D_[i]/=kernelSum;
+        kernel1D_[i] *= recipKernelSum;
+    }
+    
+    //=== Fixed point copy for the 8 bit filters. The rounding error goes to the centre tap so that the weights still sum to one.
+    kernel1DFixed_.resize(kernelWidth_);
+    int fixedSum=0;
+    for (size_t i=0; i<kernelWidth_; ++i)
+    {
+        kernel1DFixed_[i]=uint16_t(lrintf(kernel1D_[i] * (1 << GaussWeightBits)));
+        fixedSum+=kernel1DFixed_[i];
     }
+    kernel1DFixed_[kernelWidth_>>1]=uint16_t(kernel1DFixed_[kernelWidth_>>1] + ((1 << GaussWeightBits) - fixedSum));
 }
 
-void GaussianDownsample::setFilterRadius(const float filterRadius)
+void GaussianFilter::setFilterRadius(const float filterRadius)
 {
     filterRadius_=filterRadius;
     updateKernel1D();
 }
 
-void GaussianDownsample::setKernelWidth(const int kernelWidth)
+float GaussianFilter::getFilterRadius() const
 {
-    kernelWidth_=(kernelWidth>>1)<<1;
+    return filterRadius_;
+}
+
+void GaussianFilter::setKernelWidth(const int kernelWidth)
+{
+    kernelWidth_=kernelWidth|1;
     updateKernel1D();
 }
 
-bool GaussianDownsample::downsample(float * const dataWriteUS, float const * const dataReadUS,
-                                    const size_t widthUS, const size_t heightUS,
-                                    float * const dataScratch)
+bool GaussianFilter::filter(float * const dataWriteDS, float const * const dataReadUS,
+                            const size_t width, const size_t height,
+                            float * const /*dataScratch*/,
+                            const size_t lineStride)
 {
-    const size_t widthDS=widthUS>>1;
-    //const size_t heightDS=widthUS>>1;
+    const size_t stride=(lineStride!=0) ? lineStride : width;
     
-    const size_t widthUSMinusKernel=widthUS - kernelWidth_;
-    const size_t heightUSMinusKernel=heightUS - kernelWidth_;
+    const ConvolveF32Function convolve=chooseConvolveF32();
+    separableConvolve<float, float, float, float>(dataWriteDS, dataReadUS, width, height, 1, stride,
+                                                  kernelWidth_, kernel1D_, convolve, convolve, maxRowBands_);
     
-    const size_t halfKernelWidth=(kernelWidth_>>1);//kernelWidth_ is even!
+    return true;
+}
+
+bool GaussianFilter::filterRGB(float * const dataWriteDS, float const * const dataReadUS,
+                               const size_t width, const size_t height,
+                               float * const /*dataScratch*/,
+                               const size_t lineStride)
+{
+    const size_t stride=(lineStride!=0) ? lineStride : width*3;
     
-    for (size_t y=0; y<heightUS; ++y)
-    {
-        const size_t lineOffsetFS=y * widthDS + (halfKernelWidth>>1);
-        const size_t lineOffsetUS=y * widthUS;
-        
-        for (size_t xUS=0; xUS<widthUSMinusKernel; xUS+=2)
-        {
-            float xFiltValue=0.0f;
-            
-            for (size_t j=0; j<kernelWidth_; ++j)
-            {
-                xFiltValue+=dataReadUS[(lineOffsetUS + xUS) + j] * kernel1D_[j];
-            }
-            
-            dataScratch[lineOffsetFS + (xUS>>1)]=xFiltValue;
-        }
-    }
+    const ConvolveF32Function convolve=chooseConvolveF32();
+    separableConvolve<float, float, float, float>(dataWriteDS, dataReadUS, width, height, 3, stride,
+                                                  kernelWidth_, kernel1D_, convolve, convolve, maxRowBands_);
     
-    for (size_t y=0; y<heightUSMinusKernel; y+=2)
-    {
-        const size_t lineOffsetDS=((y>>1) + (halfKernelWidth>>1)) * widthDS;
-        const size_t lineOffsetFS=y * widthDS;
-        
-        for (size_t xFS=0; xFS<widthDS; ++xFS)
-        {
-            float filtValue=0.0f;
-            
-            for (size_t j=0; j<kernelWidth_; ++j)
-            {
-                filtValue+=dataScratch[(lineOffsetFS + xFS) + j*widthDS] * kernel1D_[j];
-                //Performance note: The XCode profiler shows that the above multiply by width has little performance overhead compared to the loop in x above.
-                //                  Is the code memory bandwidth limited?
-            }
-            
-            dataWriteUS[lineOffsetDS + xFS]=filtValue;
-        }
-    }
+    return true;
+}
+
+bool GaussianFilter::filter(uint8_t * const dataWriteDS, uint8_t const * const dataReadUS,
+                            const size_t width, const size_t height,
+                            uint8_t * const /*dataScratch*/,
+                            const size_t lineStride)
+{
+    const size_t stride=(lineStride!=0) ? lineStride : width;
+    
+    ConvolveU8Function horizontal;
+    ConvolveU16Function vertical;
+    chooseConvolveU8(horizontal, vertical);
+    separableConvolve<uint8_t, uint16_t, uint8_t, uint16_t>(dataWriteDS, dataReadUS, width, height, 1, stride,
+                                                            kernelWidth_, &kernel1DFixed_[0], horizontal, vertical, maxRowBands_);
+    
+    return true;
+}
+
+bool GaussianFilter::filterRGB(uint8_t * const dataWriteDS, uint8_t const * const dataReadUS,
+                               const size_t width, const size_t height,
+                               uint8_t * const /*dataScratch*/,
+                               const size_t lineStride)
+{
+    const size_t stride=(lineStride!=0) ? lineStride : width*3;
+    
+    ConvolveU8Function horizontal;
+    ConvolveU16Function vertical;
+    chooseConvolveU8(horizontal, vertical);
+    separableConvolve<uint8_t, uint16_t, uint8_t, uint16_t>(dataWriteDS, dataReadUS, width, height, 3, stride,
+                                                            kernelWidth_, &kernel1DFixed_[0], horizontal, vertical, maxRowBands_);
     
     return true;
 }
@@ -1197,3 +1427,1005 @@ bool GaussianDownsample::downsample(float * const dataWriteUS, float const * con
 
 
 
+//=========== RecursiveGaussianFilter ==========//
+
+RecursiveGaussianFilter::RecursiveGaussianFilter(const float filterRadius) :
+filterRadius_(filterRadius),
+B_(1.0f),
+b1_(0.0f),
+b2_(0.0f),
+b3_(0.0f),
+maxRowBands_(0)
+{
+    updateCoefficients();
+}
+
+void RecursiveGaussianFilter::setFilterRadius(const float filterRadius)
+{
+    filterRadius_=filterRadius;
+    updateCoefficients();
+}
+
+void RecursiveGaussianFilter::updateCoefficients()
+{
+    //=== Young, I.T. and van Vliet, L.J., "Recursive implementation of the Gaussian filter", Signal Processing 44, 1995.
+    const double sigma=std::max(double(filterRadius_) * 0.5, 0.5);
+    
+    const double q=(sigma>=2.5) ? (0.98711*sigma - 0.96330) : (3.97156 - 4.14554*sqrt(1.0 - 0.26891*sigma));
+    const double q2=q*q;
+    const double q3=q2*q;
+    
+    const double b0=1.57825 + 2.44413*q + 1.4281*q2 + 0.422205*q3;
+    const double b1=2.44413*q + 2.85619*q2 + 1.26661*q3;
+    const double b2=-(1.4281*q2 + 1.26661*q3);
+    const double b3=0.422205*q3;
+    
+    b1_=float(b1/b0);
+    b2_=float(b2/b0);
+    b3_=float(b3/b0);
+    B_=float(1.0 - (b1 + b2 + b3)/b0);
+}
+
+void RecursiveGaussianFilter::filterInPlace(float * const data, const size_t width, const size_t height,
+                                            const size_t channels, const size_t stride) const
+{
+    const float B=B_;
+    const float b1=b1_;
+    const float b2=b2_;
+    const float b3=b3_;
+    
+    if ((width==0) || (height==0))
+    {
+        return;
+    }
+    
+    //=== Rows. The recursion runs along each row, so rows are independent.
+    ParallelRowsPool::instance().run(height, FLITR_PARALLEL_ROWS_GRAIN, 0, [&](const RowBand& band)
+    {
+        for (size_t y=band.Begin; y<band.End; ++y)
+        {
+            float * const line=data + y*stride;
+            
+            for (size_t c=0; c<channels; ++c)
+            {
+                float * const p=line + c;
+                
+                // The DC gain is one, so an edge value extended forever is the steady state.
+                float w1=p[0], w2=p[0], w3=p[0];
+                for (size_t x=0; x<width*channels; x+=channels)
+                {
+                    const float w=B*p[x] + (b1*w1 + b2*w2 + b3*w3);
+                    p[x]=w;
+                    w3=w2; w2=w1; w1=w;
+                }
+                
+                const size_t last=(width-1)*channels;
+                w1=p[last]; w2=p[last]; w3=p[last];
+                for (size_t x=last+channels; x>0; )
+                {
+                    x-=channels;
+                    const float w=B*p[x] + (b1*w1 + b2*w2 + b3*w3);
+                    p[x]=w;
+                    w3=w2; w2=w1; w1=w;
+                }
+            }
+        }
+    }, maxRowBands_);
+    
+    //=== Columns. Whole rows are updated at a time, in bands of columns, so the inner loops vectorise.
+    ParallelRowsPool::instance().run(width, FLITR_PARALLEL_ROWS_GRAIN, 0, [&](const RowBand& band)
+    {
+        const size_t begin=band.Begin*channels;
+        const size_t end=band.End*channels;
+        
+        for (size_t y=0; y<height; ++y)
+        {
+            float * const out=data + y*stride;
+            float const * const w1=data + ((y>=1) ? y-1 : 0)*stride;
+            float const * const w2=data + ((y>=2) ? y-2 : 0)*stride;
+            float const * const w3=data + ((y>=3) ? y-3 : 0)*stride;
+            
+            for (size_t i=begin; i<end; ++i)
+            {
+                out[i]=B*out[i] + (b1*w1[i] + b2*w2[i] + b3*w3[i]);
+            }
+        }
+        
+        for (size_t y=height; y-- > 0; )
+        {
+            float * const out=data + y*stride;
+            float const * const w1=data + std::min(y+1, height-1)*stride;
+            float const * const w2=data + std::min(y+2, height-1)*stride;
+            float const * const w3=data + std::min(y+3, height-1)*stride;
+            
+            for (size_t i=begin; i<end; ++i)
+            {
+                out[i]=B*out[i] + (b1*w1[i] + b2*w2[i] + b3*w3[i]);
+            }
+        }
+    }, maxRowBands_);
+}
+
+bool RecursiveGaussianFilter::filter(float * const dataWriteDS, float const * const dataReadUS,
+                                     const size_t width, const size_t height,
+                                     const size_t lineStride)
+{
+    const size_t stride=(lineStride!=0) ? lineStride : width;
+    
+    if (dataWriteDS!=dataReadUS)
+    {
+        for (size_t y=0; y<height; ++y)
+        {
+            memcpy(dataWriteDS + y*stride, dataReadUS + y*stride, width*sizeof(float));
+        }
+    }
+    filterInPlace(dataWriteDS, width, height, 1, stride);
+    
+    return true;
+}
+
+bool RecursiveGaussianFilter::filterRGB(float * const dataWriteDS, float const * const dataReadUS,
+                                        const size_t width, const size_t height,
+                                        const size_t lineStride)
+{
+    const size_t stride=(lineStride!=0) ? lineStride : width*3;
+    
+    if (dataWriteDS!=dataReadUS)
+    {
+        for (size_t y=0; y<height; ++y)
+        {
+            memcpy(dataWriteDS + y*stride, dataReadUS + y*stride, width*3*sizeof(float));
+        }
+    }
+    filterInPlace(dataWriteDS, width, height, 3, stride);
+    
+    return true;
+}
+
+bool RecursiveGaussianFilter::filter(uint8_t * const dataWriteDS, uint8_t const * const dataReadUS,
+                                     const size_t width, const size_t height,
+                                     const size_t lineStride)
+{
+    const size_t stride=(lineStride!=0) ? lineStride : width;
+    
+    floatScratch_.resize(width*height);
+    PixelFormatConverter toFloat(ImageFormat::FLITR_PIX_FMT_Y_8, ImageFormat::FLITR_PIX_FMT_Y_F32);
+    PixelFormatConverter toY8(ImageFormat::FLITR_PIX_FMT_Y_F32, ImageFormat::FLITR_PIX_FMT_Y_8);
+    
+    for (size_t y=0; y<height; ++y)
+    {
+        toFloat.convertRow(dataReadUS + y*stride, (uint8_t *)&floatScratch_[y*width], width);
+    }
+    filterInPlace(&floatScratch_[0], width, height, 1, width);
+    for (size_t y=0; y<height; ++y)
+    {
+        toY8.convertRow((uint8_t const *)&floatScratch_[y*width], dataWriteDS + y*stride, width);
+    }
+    
+    return true;
+}
+
+bool RecursiveGaussianFilter::filterRGB(uint8_t * const dataWriteDS, uint8_t const * const dataReadUS,
+                                        const size_t width, const size_t height,
+                                        const size_t lineStride)
+{
+    const size_t stride=(lineStride!=0) ? lineStride : width*3;
+    
+    floatScratch_.resize(width*height*3);
+    PixelFormatConverter toFloat(ImageFormat::FLITR_PIX_FMT_RGB_8, ImageFormat::FLITR_PIX_FMT_RGB_F32);
+    PixelFormatConverter toRGB8(ImageFormat::FLITR_PIX_FMT_RGB_F32, ImageFormat::FLITR_PIX_FMT_RGB_8);
+    
+    for (size_t y=0; y<height; ++y)
+    {
+        toFloat.convertRow(dataReadUS + y*stride, (uint8_t *)&floatScratch_[y*width*3], width);
+    }
+    filterInPlace(&floatScratch_[0], width, height, 3, width*3);
+    for (size_t y=0; y<height; ++y)
+    {
+        toRGB8.convertRow((uint8_t const *)&floatScratch_[y*width*3], dataWriteDS + y*stride, width);
+    }
+    
+    return true;
+}
+//=========================================//
+
+
+
+//=========== GaussianDownsample ==========//
+GaussianDownsample::GaussianDownsample(const float filterRadius,
+                                       const size_t kernelWidth) :
+kernel1D_(nullptr),
+filterRadius_(filterRadius),
+kernelWidth_((kernelWidth>>1)<<1)//Make sure the kernel width is even.
+{
+    updateKernel1D();
+}
+
+GaussianDownsample::~GaussianDownsample()
+{
+    delete [] kernel1D_;
+}
+
+void GaussianDownsample::updateKernel1D()
+{
+    if (kernel1D_!=nullptr) delete [] kernel1D_;
+    
+    kernel1D_=new float[kernelWidth_];
+    
+    const float kernelCentre=kernelWidth_ * 0.5f;
+    const float sigma=filterRadius_ * 0.5f;
+    
+    float kernelSum=0.0f;
+    
+    for (size_t i=0; i<kernelWidth_; ++i)
+    {
+        const float r=((i + 0.5f) - kernelCentre);
+        kernel1D_[i]=(1.0f/(sqrt(2.0f*float(M_PI))*sigma)) * exp(-(r*r)/(2.0f*sigma*sigma));
+        kernelSum+=kernel1D_[i];
+    }
+    
+    //=== Ensure that the kernel is normalised!
+    for (size_t i=0; i<kernelWidth_; ++i)
+    {
+        kernel1D_[i]/=kernelSum;
+    }
+}
+
+void GaussianDownsample::setFilterRadius(const float filterRadius)
+{
+    filterRadius_=filterRadius;
+    updateKernel1D();
+}
+
+void GaussianDownsample::setKernelWidth(const int kernelWidth)
+{
+    kernelWidth_=(kernelWidth>>1)<<1;
+    updateKernel1D();
+}
+
+bool GaussianDownsample::downsample(float * const dataWriteUS, float const * const dataReadUS,
+                                    const size_t widthUS, const size_t heightUS,
+                                    float * const dataScratch)
+{
+    GaussianPyramid::downsample(dataReadUS, widthUS, heightUS, dataWriteUS, kernel1D_, kernelWidth_);
+    
+    return true;
+}
+//=========================================//
+
+
+
+
+
+
+//=========== MorphologicalFilter ==========//
+
+namespace {
+
+    template<typename T>
+    struct MinOf
+    {
+        static T identity() { return std::numeric_limits<T>::max(); }
+        static T apply(const T a, const T b) { return (b<a) ? b : a; }
+    };
+
+    template<typename T>
+    struct MaxOf
+    {
+        static T identity() { return std::numeric_limits<T>::lowest(); }
+        static T apply(const T a, const T b) { return (a<b) ? b : a; }
+    };
+
+    // out[i]=Op(a[i], b[i]). A plain loop so that the compiler vectorises it. out may be a.
+    template<typename T, typename Op>
+    inline void combineRows(T * const out, T const * const a, T const * const b, const size_t n)
+    {
+        for (size_t i=0; i<n; ++i)
+        {
+            out[i]=Op::apply(a[i], b[i]);
+        }
+    }
+
+    // Rows filtered together by vanHerkRows().
+    const size_t VanHerkRowGroup=16;
+
+    /*! Minimum or maximum over windows of kernelWidth pixels along up to VanHerkRowGroup rows
+     * of interleaved channels, with the van Herk/Gil-Werman algorithm. Pixels outside the rows
+     * are ignored.
+     *
+     * The rows are padded with the identity by half a window on each side and cut into blocks
+     * of kernelWidth pixels. forward runs from the start of each block and backward runs to
+     * its end. A window starting at padded pixel x covers the end of one block and the start
+     * of the next, so its value is Op(backward[x], forward[x+kernelWidth-1]).
+     *
+     * The scans are serial along a row, so the rows are interleaved and each step combines a
+     * value of every row, which the compiler vectorises. forward and backward hold
+     * (width+2*kernelWidth)*channels*VanHerkRowGroup values.*/
+    template<typename T, typename Op>
+    void vanHerkRows(T * const out, T const * const in, const size_t numRows, const size_t width, const size_t channels,
+                     const size_t kernelWidth, T * const forward, T * const backward)
+    {
+        const size_t G=VanHerkRowGroup;
+        const size_t half=kernelWidth>>1;
+        const size_t rowValues=width*channels;
+        const size_t blockValues=kernelWidth*channels;
+        const size_t numValues=((width + 2*half + kernelWidth-1)/kernelWidth)*blockValues;
+
+        // backward starts as the padded rows and is scanned in place.
+        T * const padded=backward;
+        std::fill(padded, padded + half*channels*G, Op::identity());
+        std::fill(padded + (half*channels + rowValues)*G, padded + numValues*G, Op::identity());
+        for (size_t r=0; r<G; ++r)
+        {
+            T * const column=padded + half*channels*G + r;
+            if (r<numRows)
+            {
+                T const * const row=in + r*rowValues;
+                for (size_t i=0; i<rowValues; ++i) column[i*G]=row[i];
+            } else
+            {
+                for (size_t i=0; i<rowValues; ++i) column[i*G]=Op::identity();
+            }
+        }
+
+        const size_t step=channels*G;
+        for (size_t b=0; b<numValues*G; b+=blockValues*G)
+        {
+            const size_t end=b + blockValues*G;
+
+            std::copy(padded + b, padded + b + step, forward + b);
+            for (size_t i=b+step; i<end; i+=G)
+            {
+                combineRows<T, Op>(forward + i, forward + i - step, padded + i, G);
+            }
+
+            for (size_t i=end-step; i>b; )
+            {
+                i-=G;
+                combineRows<T, Op>(backward + i, backward + i + step, backward + i, G);
+            }
+        }
+
+        combineRows<T, Op>(backward, backward, forward + (kernelWidth-1)*channels*G, rowValues*G);
+        for (size_t r=0; r<numRows; ++r)
+        {
+            T * const row=out + r*rowValues;
+            for (size_t i=0; i<rowValues; ++i) row[i]=backward[i*G + r];
+        }
+    }
+
+    /*! Minimum or maximum over a kernelWidth x kernelWidth square, with windows clipped to
+     * the image. dst may be src.
+     *
+     * Each pass costs about three comparisons per value, whatever the size of the square.
+     * The rows are first filtered into scratch. The columns are then filtered with the same
+     * blocks, but whole strips of rows are combined at a time so that the work is vectorised
+     * across each row. Both passes run in bands on ParallelRowsPool::instance().*/
+    template<typename T, typename Op>
+    void vanHerkMinMax(T * const dst, T const * const src, const size_t kernelWidth,
+                       const size_t width, const size_t height, const size_t channels,
+                       T * const scratch, const uint32_t maxBands)
+    {
+        if ((width==0) || (height==0))
+        {
+            return;
+        }
+
+        const size_t rowValues=width*channels;
+
+        ParallelRowsPool::instance().run(height, FLITR_PARALLEL_ROWS_GRAIN, 0, [&](const RowBand& band)
+        {
+            const size_t paddedValues=(width + 2*kernelWidth)*channels*VanHerkRowGroup;
+            std::vector<T> forward(paddedValues), backward(paddedValues);
+
+            for (size_t y=band.Begin; y<band.End; y+=VanHerkRowGroup)
+            {
+                vanHerkRows<T, Op>(scratch + y*rowValues, src + y*rowValues, std::min(VanHerkRowGroup, band.End-y),
+                                   width, channels, kernelWidth, &forward[0], &backward[0]);
+            }
+        }, maxBands);
+
+        // Output row y is the window of padded rows [y, y+kernelWidth), i.e. image rows [y-half, y+half].
+        const size_t half=kernelWidth>>1;
+        const size_t stripValues=std::max<size_t>(64, GaussStripBytes / (kernelWidth*sizeof(T)));
+
+        ParallelRowsPool::instance().run(height, FLITR_PARALLEL_ROWS_GRAIN, half, [&](const RowBand& band)
+        {
+            std::vector<T> backward(kernelWidth*stripValues);
+            std::vector<T> forward(stripValues);
+            const std::vector<T> identity(stripValues, Op::identity());
+
+            for (size_t x0=0; x0<rowValues; x0+=stripValues)
+            {
+                const size_t n=std::min(stripValues, rowValues-x0);
+
+                auto paddedRow=[&](const size_t e) -> T const *
+                {
+                    return ((e<half) || (e-half>=height)) ? &identity[0] : scratch + (e-half)*rowValues + x0;
+                };
+
+                for (size_t b=(band.Begin/kernelWidth)*kernelWidth; b<band.End; b+=kernelWidth)
+                {
+                    T * const back=&backward[0];
+                    std::copy(paddedRow(b+kernelWidth-1), paddedRow(b+kernelWidth-1) + n, back + (kernelWidth-1)*stripValues);
+                    for (size_t t=kernelWidth-1; t-- > 0; )
+                    {
+                        combineRows<T, Op>(back + t*stripValues, back + (t+1)*stripValues, paddedRow(b+t), n);
+                    }
+
+                    // Row b is the whole block. Row b+t also needs padded rows [b+kernelWidth, b+kernelWidth+t).
+                    if (b>=band.Begin)
+                    {
+                        std::copy(back, back + n, dst + b*rowValues + x0);
+                    }
+                    const size_t tEnd=std::min(kernelWidth, band.End-b);
+                    for (size_t t=1; t<tEnd; ++t)
+                    {
+                        T const * const row=paddedRow(b+kernelWidth+t-1);
+                        if (t==1)
+                        {
+                            std::copy(row, row + n, forward.begin());
+                        } else
+                        {
+                            combineRows<T, Op>(&forward[0], &forward[0], row, n);
+                        }
+
+                        if (b+t>=band.Begin)
+                        {
+                            combineRows<T, Op>(dst + (b+t)*rowValues + x0, back + t*stripValues, &forward[0], n);
+                        }
+                    }
+                }
+            }
+        }, maxBands);
+    }
+}
+
+bool MorphologicalFilter::vanHerkFilter(uint8_t * const dataWriteDS, uint8_t const * const dataReadUS,
+                                        const size_t structElemWidth, const size_t width, const size_t height,
+                                        const size_t channels, const bool dilate, uint8_t * const dataScratch) const
+{
+    if (dilate) vanHerkMinMax<uint8_t, MaxOf<uint8_t> >(dataWriteDS, dataReadUS, structElemWidth, width, height, channels, dataScratch, maxRowBands_);
+    else vanHerkMinMax<uint8_t, MinOf<uint8_t> >(dataWriteDS, dataReadUS, structElemWidth, width, height, channels, dataScratch, maxRowBands_);
+    return true;
+}
+
+bool MorphologicalFilter::vanHerkFilter(uint16_t * const dataWriteDS, uint16_t const * const dataReadUS,
+                                        const size_t structElemWidth, const size_t width, const size_t height,
+                                        const size_t channels, const bool dilate, uint16_t * const dataScratch) const
+{
+    if (dilate) vanHerkMinMax<uint16_t, MaxOf<uint16_t> >(dataWriteDS, dataReadUS, structElemWidth, width, height, channels, dataScratch, maxRowBands_);
+    else vanHerkMinMax<uint16_t, MinOf<uint16_t> >(dataWriteDS, dataReadUS, structElemWidth, width, height, channels, dataScratch, maxRowBands_);
+    return true;
+}
+
+bool MorphologicalFilter::vanHerkFilter(float * const dataWriteDS, float const * const dataReadUS,
+                                        const size_t structElemWidth, const size_t width, const size_t height,
+                                        const size_t channels, const bool dilate, float * const dataScratch) const
+{
+    if (dilate) vanHerkMinMax<float, MaxOf<float> >(dataWriteDS, dataReadUS, structElemWidth, width, height, channels, dataScratch, maxRowBands_);
+    else vanHerkMinMax<float, MinOf<float> >(dataWriteDS, dataReadUS, structElemWidth, width, height, channels, dataScratch, maxRowBands_);
+    return true;
+}
+//=========================================//
+
+
+//=========== MedianFilter ==========//
+
+namespace {
+
+    // Comparators that leave the median of 9 values at index 4 and of 25 values at index 12
+    // (Devillard's opt_med9 and opt_med25). The first value of a pair gets the minimum.
+    const uint8_t Median9Network[][2]={
+        {1,2},{4,5},{7,8},{0,1},{3,4},{6,7},{1,2},{4,5},{7,8},{0,3},{5,8},{4,7},{3,6},{1,4},{2,5},{4,7},{4,2},{6,4},{4,2}};
+    const uint8_t Median25Network[][2]={
+        {0,1},{3,4},{2,4},{2,3},{6,7},{5,7},{5,6},{9,10},{8,10},{8,9},{12,13},{11,13},{11,12},{15,16},{14,16},
+        {14,15},{18,19},{17,19},{17,18},{21,22},{20,22},{20,21},{23,24},{2,5},{3,6},{0,6},{0,3},{4,7},{1,7},
+        {1,4},{11,14},{8,14},{8,11},{12,15},{9,15},{9,12},{13,16},{10,16},{10,13},{20,23},{17,23},{17,20},
+        {21,24},{18,24},{18,21},{19,22},{8,17},{9,18},{0,18},{0,9},{10,19},{1,19},{1,10},{11,20},{2,20},
+        {2,11},{12,21},{3,21},{3,12},{13,22},{4,22},{4,13},{14,23},{5,23},{5,14},{15,24},{6,24},{6,15},
+        {7,16},{7,19},{13,21},{15,23},{7,13},{7,15},{1,9},{3,11},{5,17},{11,17},{9,17},{4,10},{6,12},
+        {7,14},{4,6},{4,7},{12,14},{10,14},{6,7},{10,12},{6,10},{6,17},{12,17},{7,17},{7,10},{12,18},
+        {7,12},{10,18},{12,20},{10,20},{10,12}};
+
+    const size_t MedianStripPixels=256;
+
+    inline size_t clampIndex(const ptrdiff_t i, const size_t size)
+    {
+        return (i<0) ? 0 : ((size_t(i)>=size) ? size-1 : size_t(i));
+    }
+
+    /*! Median filter of radius 1 or 2 with a sorting network. The window values of a strip of
+     * pixels are gathered into one array per window position, so that every comparator is a
+     * minimum and maximum of two arrays, which the compiler vectorises.*/
+    template<typename T>
+    void medianNetwork(T * const dst, T const * const src, const size_t width, const size_t height,
+                       const size_t stride, const size_t radius, const RowBand& band)
+    {
+        const size_t kernelWidth=2*radius+1;
+        const size_t paddedWidth=width + 2*radius;
+        uint8_t const (* const network)[2]=(radius==1) ? Median9Network : Median25Network;
+        const size_t networkSize=(radius==1) ? sizeof(Median9Network)/2 : sizeof(Median25Network)/2;
+
+        // The rows of the window, with the edge pixels repeated radius times on each side.
+        std::vector<T> padded(kernelWidth*paddedWidth);
+        std::vector<T> values(kernelWidth*kernelWidth*MedianStripPixels);
+
+        for (size_t y=band.Begin; y<band.End; ++y)
+        {
+            for (size_t j=0; j<kernelWidth; ++j)
+            {
+                T const * const line=src + clampIndex(ptrdiff_t(y+j) - ptrdiff_t(radius), height)*stride;
+                T * const row=&padded[j*paddedWidth];
+                std::fill(row, row + radius, line[0]);
+                std::copy(line, line + width, row + radius);
+                std::fill(row + radius + width, row + paddedWidth, line[width-1]);
+            }
+
+            for (size_t x0=0; x0<width; x0+=MedianStripPixels)
+            {
+                const size_t n=std::min(MedianStripPixels, width-x0);
+
+                for (size_t j=0; j<kernelWidth; ++j)
+                {
+                    for (size_t i=0; i<kernelWidth; ++i)
+                    {
+                        T const * const p=&padded[j*paddedWidth + x0 + i];
+                        std::copy(p, p + n, &values[(j*kernelWidth + i)*MedianStripPixels]);
+                    }
+                }
+
+                for (size_t k=0; k<networkSize; ++k)
+                {
+                    T * const a=&values[network[k][0]*MedianStripPixels];
+                    T * const b=&values[network[k][1]*MedianStripPixels];
+                    for (size_t m=0; m<n; ++m)
+                    {
+                        const T lo=std::min(a[m], b[m]);
+                        const T hi=std::max(a[m], b[m]);
+                        a[m]=lo;
+                        b[m]=hi;
+                    }
+                }
+
+                T const * const median=&values[((kernelWidth*kernelWidth)>>1)*MedianStripPixels];
+                std::copy(median, median + n, dst + y*stride + x0);
+            }
+        }
+    }
+
+    /*! 256 fine bins of 8 bit values followed by 16 coarse bins of value>>4. The counts are
+     * cumulative within each group of 16 bins, i.e. a bin counts the values up to its own, so
+     * that a bin is found by comparing all 16 bins with the rank at once.
+     *
+     * The operations on a group of 16 bins are written with intrinsics, because the compiler
+     * unrolls such short loops completely instead of vectorising them.*/
+    const size_t MedianBinsU8=256+16;
+
+    struct MedianBinsScalar
+    {
+        // Add count to the bins of value, i.e. to every bin from its own on in both groups.
+        static void add(uint16_t * const hist, const uint8_t value, const uint16_t count)
+        {
+            uint16_t * const fine=hist + (value & 0xf0);
+            uint16_t * const coarse=hist + 256;
+            for (size_t i=(value & 15); i<16; ++i) fine[i]+=count;
+            for (size_t i=(value >> 4); i<16; ++i) coarse[i]+=count;
+        }
+
+        // bins+=add-remove
+        static void slide(uint16_t * const bins, uint16_t const * const add, uint16_t const * const remove)
+        {
+            for (size_t i=0; i<16; ++i) bins[i]=uint16_t(bins[i] + add[i] - remove[i]);
+        }
+
+        static void accumulate(uint16_t * const bins, uint16_t const * const add)
+        {
+            for (size_t i=0; i<16; ++i) bins[i]=uint16_t(bins[i] + add[i]);
+        }
+
+        // The number of bins that are at most rank, which is the bin holding the value of that rank.
+        static size_t find(uint16_t const * const bins, const uint16_t rank)
+        {
+            size_t bin=0;
+            for (size_t i=0; i<16; ++i) bin+=(bins[i]<=rank);
+            return bin;
+        }
+    };
+
+#if defined(FLITR_X86_SIMD)
+    struct MedianBinsSSE2
+    {
+        FLITR_TARGET("sse2") static void add(uint16_t * const hist, const uint8_t value, const uint16_t count)
+        {
+            const __m128i lo=_mm_setr_epi16(0, 1, 2, 3, 4, 5, 6, 7);
+            const __m128i hi=_mm_setr_epi16(8, 9, 10, 11, 12, 13, 14, 15);
+            const __m128i c=_mm_set1_epi16(short(count));
+            __m128i * const fine=(__m128i *)(hist + (value & 0xf0));
+            __m128i * const coarse=(__m128i *)(hist + 256);
+            const __m128i fineBin=_mm_set1_epi16(short((value & 15) - 1));
+            const __m128i coarseBin=_mm_set1_epi16(short((value >> 4) - 1));
+            _mm_storeu_si128(fine, _mm_add_epi16(_mm_loadu_si128(fine), _mm_and_si128(_mm_cmpgt_epi16(lo, fineBin), c)));
+            _mm_storeu_si128(fine+1, _mm_add_epi16(_mm_loadu_si128(fine+1), _mm_and_si128(_mm_cmpgt_epi16(hi, fineBin), c)));
+            _mm_storeu_si128(coarse, _mm_add_epi16(_mm_loadu_si128(coarse), _mm_and_si128(_mm_cmpgt_epi16(lo, coarseBin), c)));
+            _mm_storeu_si128(coarse+1, _mm_add_epi16(_mm_loadu_si128(coarse+1), _mm_and_si128(_mm_cmpgt_epi16(hi, coarseBin), c)));
+        }
+
+        FLITR_TARGET("sse2") static void slide(uint16_t * const bins, uint16_t const * const add, uint16_t const * const remove)
+        {
+            __m128i * const b=(__m128i *)bins;
+            __m128i const * const a=(__m128i const *)add;
+            __m128i const * const r=(__m128i const *)remove;
+            _mm_storeu_si128(b, _mm_sub_epi16(_mm_add_epi16(_mm_loadu_si128(b), _mm_loadu_si128(a)), _mm_loadu_si128(r)));
+            _mm_storeu_si128(b+1, _mm_sub_epi16(_mm_add_epi16(_mm_loadu_si128(b+1), _mm_loadu_si128(a+1)), _mm_loadu_si128(r+1)));
+        }
+
+        FLITR_TARGET("sse2") static void accumulate(uint16_t * const bins, uint16_t const * const add)
+        {
+            __m128i * const b=(__m128i *)bins;
+            __m128i const * const a=(__m128i const *)add;
+            _mm_storeu_si128(b, _mm_add_epi16(_mm_loadu_si128(b), _mm_loadu_si128(a)));
+            _mm_storeu_si128(b+1, _mm_add_epi16(_mm_loadu_si128(b+1), _mm_loadu_si128(a+1)));
+        }
+
+        // Counts reach 65025, so bins<=rank is tested unsigned as bins-rank saturating to zero.
+        FLITR_TARGET("sse2") static size_t find(uint16_t const * const bins, const uint16_t rank)
+        {
+            const __m128i r=_mm_set1_epi16(short(rank));
+            const __m128i zero=_mm_setzero_si128();
+            const __m128i lo=_mm_cmpeq_epi16(_mm_subs_epu16(_mm_loadu_si128((__m128i const *)bins), r), zero);
+            const __m128i hi=_mm_cmpeq_epi16(_mm_subs_epu16(_mm_loadu_si128((__m128i const *)(bins+8)), r), zero);
+            // 0xff per bin at most rank, summed.
+            const __m128i sums=_mm_sad_epu8(_mm_packs_epi16(lo, hi), zero);
+            return size_t(_mm_cvtsi128_si32(sums) + _mm_cvtsi128_si32(_mm_srli_si128(sums, 8))) / 255;
+        }
+    };
+#endif
+
+#if defined(FLITR_NEON_SIMD)
+    struct MedianBinsNEON
+    {
+        static void add(uint16_t * const hist, const uint8_t value, const uint16_t count)
+        {
+            static const uint16_t index[16]={0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15};
+            const uint16x8_t lo=vld1q_u16(index);
+            const uint16x8_t hi=vld1q_u16(index+8);
+            const uint16x8_t c=vdupq_n_u16(count);
+            uint16_t * const fine=hist + (value & 0xf0);
+            uint16_t * const coarse=hist + 256;
+            const uint16x8_t fineBin=vdupq_n_u16(value & 15);
+            const uint16x8_t coarseBin=vdupq_n_u16(value >> 4);
+            vst1q_u16(fine, vaddq_u16(vld1q_u16(fine), vandq_u16(vcgeq_u16(lo, fineBin), c)));
+            vst1q_u16(fine+8, vaddq_u16(vld1q_u16(fine+8), vandq_u16(vcgeq_u16(hi, fineBin), c)));
+            vst1q_u16(coarse, vaddq_u16(vld1q_u16(coarse), vandq_u16(vcgeq_u16(lo, coarseBin), c)));
+            vst1q_u16(coarse+8, vaddq_u16(vld1q_u16(coarse+8), vandq_u16(vcgeq_u16(hi, coarseBin), c)));
+        }
+
+        static void slide(uint16_t * const bins, uint16_t const * const add, uint16_t const * const remove)
+        {
+            vst1q_u16(bins, vsubq_u16(vaddq_u16(vld1q_u16(bins), vld1q_u16(add)), vld1q_u16(remove)));
+            vst1q_u16(bins+8, vsubq_u16(vaddq_u16(vld1q_u16(bins+8), vld1q_u16(add+8)), vld1q_u16(remove+8)));
+        }
+
+        static void accumulate(uint16_t * const bins, uint16_t const * const add)
+        {
+            vst1q_u16(bins, vaddq_u16(vld1q_u16(bins), vld1q_u16(add)));
+            vst1q_u16(bins+8, vaddq_u16(vld1q_u16(bins+8), vld1q_u16(add+8)));
+        }
+
+        static size_t find(uint16_t const * const bins, const uint16_t rank)
+        {
+            const uint16x8_t r=vdupq_n_u16(rank);
+            // 1 per bin at most rank, summed.
+            const uint16x8_t ones=vaddq_u16(vshrq_n_u16(vcleq_u16(vld1q_u16(bins), r), 15),
+                                            vshrq_n_u16(vcleq_u16(vld1q_u16(bins+8), r), 15));
+            const uint64x2_t sums=vpaddlq_u32(vpaddlq_u16(ones));
+            return size_t(vgetq_lane_u64(sums, 0) + vgetq_lane_u64(sums, 1));
+        }
+    };
+#endif
+
+    /*! Median filter of 8 bit images in O(1) per pixel (Perreault and Hebert, "Median filtering
+     * in constant time", 2007).
+     *
+     * Every column has a histogram of its 2*radius+1 pixels around the current row, which is
+     * moved down a row by removing one pixel and adding another. The window histogram is the
+     * sum of 2*radius+1 column histograms, and is moved right by adding the column histogram
+     * entering the window and removing the one leaving it. Only the coarse bins are moved at
+     * every pixel. The 16 fine bins under the coarse bin of the median are brought up to date
+     * when they are needed, which is mostly at the previous pixel. The band works in strips of
+     * columns so that the column histograms stay in cache.*/
+    template<typename Bins>
+    void medianHistogramY8(uint8_t * const dst, uint8_t const * const src, const size_t width, const size_t height,
+                           const size_t stride, const size_t radius, const RowBand& band)
+    {
+        const ptrdiff_t r=ptrdiff_t(radius);
+        const ptrdiff_t kernelWidth=2*r+1;
+        const uint16_t rank=uint16_t((kernelWidth*kernelWidth)>>1);
+        const size_t stripPixels=std::max<size_t>(64, 4*size_t(kernelWidth));
+
+        std::vector<uint16_t> columns((stripPixels + 2*radius)*MedianBinsU8);
+        std::vector<uint16_t *> columnAt(stripPixels + 2*radius + 1);
+        uint16_t fine[256];
+        uint16_t coarse[16];
+        // The pixel at which each group of 16 fine bins was last brought up to date.
+        ptrdiff_t updated[16];
+
+        for (size_t x0=0; x0<width; x0+=stripPixels)
+        {
+            const size_t x1=std::min(x0 + stripPixels, width);
+
+            // The histograms of columns [c0, c1), which are those of the strip's windows clipped to the image.
+            const size_t c0=clampIndex(ptrdiff_t(x0) - r, width);
+            const size_t c1=std::min(x1 + radius, width);
+            // The histogram of every column that the strip's windows move over, edges replicated.
+            const ptrdiff_t firstColumn=ptrdiff_t(x0) - r - 1;
+            for (size_t i=0; i<columnAt.size(); ++i)
+            {
+                columnAt[i]=&columns[(clampIndex(firstColumn + ptrdiff_t(i), width) - c0)*MedianBinsU8];
+            }
+            auto column=[&](const ptrdiff_t x) -> uint16_t *
+            {
+                return columnAt[size_t(x - firstColumn)];
+            };
+
+            std::fill(columns.begin(), columns.begin() + (c1-c0)*MedianBinsU8, uint16_t(0));
+            for (ptrdiff_t dy=-r; dy<=r; ++dy)
+            {
+                uint8_t const * const line=src + clampIndex(ptrdiff_t(band.Begin) + dy, height)*stride;
+                for (size_t c=c0; c<c1; ++c)
+                {
+                    Bins::add(column(c), line[c], 1);
+                }
+            }
+
+            for (size_t y=band.Begin; y<band.End; ++y)
+            {
+                const size_t leaving=clampIndex(ptrdiff_t(y) - r - 1, height);
+                const size_t entering=clampIndex(ptrdiff_t(y) + r, height);
+                if ((y>band.Begin) && (leaving!=entering))
+                {
+                    uint8_t const * const lineLeaving=src + leaving*stride;
+                    uint8_t const * const lineEntering=src + entering*stride;
+                    for (size_t c=c0; c<c1; ++c)
+                    {
+                        uint16_t * const h=column(c);
+                        Bins::add(h, lineLeaving[c], uint16_t(-1));
+                        Bins::add(h, lineEntering[c], 1);
+                    }
+                }
+
+                std::fill(coarse, coarse + 16, uint16_t(0));
+                for (ptrdiff_t dx=-r; dx<=r; ++dx)
+                {
+                    Bins::accumulate(coarse, column(ptrdiff_t(x0) + dx) + 256);
+                }
+                std::fill(updated, updated + 16, ptrdiff_t(x0) - kernelWidth);
+
+                uint8_t * const lineWrite=dst + y*stride;
+                for (ptrdiff_t x=ptrdiff_t(x0); x<ptrdiff_t(x1); ++x)
+                {
+                    if (x>ptrdiff_t(x0))
+                    {
+                        Bins::slide(coarse, column(x + r) + 256, column(x - r - 1) + 256);
+                    }
+
+                    const size_t b=Bins::find(coarse, rank);
+                    const uint16_t rankInBin=uint16_t(rank - ((b>0) ? coarse[b-1] : 0));
+                    uint16_t * const bins=fine + b*16;
+
+                    if (x - updated[b] >= kernelWidth)
+                    {
+                        std::fill(bins, bins + 16, uint16_t(0));
+                        for (ptrdiff_t dx=-r; dx<=r; ++dx)
+                        {
+                            Bins::accumulate(bins, column(x + dx) + b*16);
+                        }
+                    } else
+                    {
+                        for (ptrdiff_t u=updated[b]+1; u<=x; ++u)
+                        {
+                            Bins::slide(bins, column(u + r) + b*16, column(u - r - 1) + b*16);
+                        }
+                    }
+                    updated[b]=x;
+
+                    lineWrite[x]=uint8_t(b*16 + Bins::find(bins, rankInBin));
+                }
+            }
+        }
+    }
+
+    /*! Histogram of 16 bit values at four resolutions (value>>12, value>>8, value>>4 and value),
+     * so that the median is found by scanning at most 16 bins of each.*/
+    class Histogram16
+    {
+    public:
+        Histogram16() : Bins_(16 + 256 + 4096 + 65536, 0) {}
+
+        void add(const uint16_t value, const uint16_t count)
+        {
+            Bins_[value>>12]+=count;
+            Bins_[16 + (value>>8)]+=count;
+            Bins_[272 + (value>>4)]+=count;
+            Bins_[4368 + value]+=count;
+        }
+
+        uint16_t median(size_t rank) const
+        {
+            static const size_t levelOffsets[4]={0, 16, 272, 4368};
+            size_t index=0;
+            for (size_t level=0; level<4; ++level)
+            {
+                uint16_t const * const bins=&Bins_[levelOffsets[level] + index*16];
+                size_t i=0;
+                while (bins[i]<=rank)
+                {
+                    rank-=bins[i];
+                    ++i;
+                }
+                index=index*16 + i;
+            }
+            return uint16_t(index);
+        }
+
+    private:
+        std::vector<uint16_t> Bins_;
+    };
+
+    /*! Median filter of 16 bit images. Column histograms would need 65536 bins each, so the
+     * window histogram is updated pixel by pixel (Huang): it snakes along the band, moving right
+     * along one row and left along the next, so each step adds and removes 2*radius+1 pixels.*/
+    void medianHistogramY16(uint16_t * const dst, uint16_t const * const src, const size_t width, const size_t height,
+                           const size_t stride, const size_t radius, const RowBand& band)
+    {
+        const ptrdiff_t r=ptrdiff_t(radius);
+        const size_t kernelWidth=2*radius+1;
+        const size_t rank=(kernelWidth*kernelWidth)>>1;
+
+        Histogram16 hist;
+        auto addColumn=[&](const ptrdiff_t x, const ptrdiff_t y, const uint16_t count)
+        {
+            uint16_t const * const p=src + clampIndex(x, width);
+            for (ptrdiff_t dy=-r; dy<=r; ++dy)
+            {
+                hist.add(p[clampIndex(y + dy, height)*stride], count);
+            }
+        };
+        auto addRow=[&](const ptrdiff_t y, const ptrdiff_t x, const uint16_t count)
+        {
+            uint16_t const * const line=src + clampIndex(y, height)*stride;
+            for (ptrdiff_t dx=-r; dx<=r; ++dx)
+            {
+                hist.add(line[clampIndex(x + dx, width)], count);
+            }
+        };
+
+        ptrdiff_t x=0;
+        for (ptrdiff_t dx=-r; dx<=r; ++dx)
+        {
+            addColumn(dx, ptrdiff_t(band.Begin), 1);
+        }
+
+        bool right=true;
+        for (size_t y=band.Begin; y<band.End; ++y)
+        {
+            const ptrdiff_t row=ptrdiff_t(y);
+            if (y>band.Begin)
+            {
+                addRow(row - r - 1, x, uint16_t(-1));
+                addRow(row + r, x, 1);
+            }
+
+            uint16_t * const lineWrite=dst + y*stride;
+            lineWrite[x]=hist.median(rank);
+            for (size_t i=1; i<width; ++i)
+            {
+                if (right)
+                {
+                    addColumn(x - r, row, uint16_t(-1));
+                    ++x;
+                    addColumn(x + r, row, 1);
+                } else
+                {
+                    addColumn(x + r, row, uint16_t(-1));
+                    --x;
+                    addColumn(x - r, row, 1);
+                }
+                lineWrite[x]=hist.median(rank);
+            }
+            right=!right;
+        }
+    }
+
+    void medianHistogram(uint8_t * const dst, uint8_t const * const src, const size_t width, const size_t height,
+                         const size_t stride, const size_t radius, const RowBand& band)
+    {
+#if defined(FLITR_X86_SIMD)
+        if (isSimdLevelEnabled(FLITR_SIMD_SSE2))
+        {
+            medianHistogramY8<MedianBinsSSE2>(dst, src, width, height, stride, radius, band);
+            return;
+        }
+#elif defined(FLITR_NEON_SIMD)
+        if (isSimdLevelEnabled(FLITR_SIMD_NEON))
+        {
+            medianHistogramY8<MedianBinsNEON>(dst, src, width, height, stride, radius, band);
+            return;
+        }
+#endif
+        medianHistogramY8<MedianBinsScalar>(dst, src, width, height, stride, radius, band);
+    }
+
+    void medianHistogram(uint16_t * const dst, uint16_t const * const src, const size_t width, const size_t height,
+                         const size_t stride, const size_t radius, const RowBand& band)
+    {
+        medianHistogramY16(dst, src, width, height, stride, radius, band);
+    }
+
+    template<typename T>
+    void medianFilter(T * const dst, T const * const src, const size_t width, const size_t height,
+                      const size_t stride, const size_t radius, const uint32_t maxBands)
+    {
+        if ((width==0) || (height==0))
+        {
+            return;
+        }
+
+        // Bands read rows above and below the rows they write, so filtering in place needs a copy.
+        std::vector<T> srcCopy;
+        T const * source=src;
+        if ((radius>0) && (src==dst))
+        {
+            srcCopy.assign(src, src + stride*(height-1) + width);
+            source=&srcCopy[0];
+        }
+
+        ParallelRowsPool::instance().run(height, FLITR_PARALLEL_ROWS_GRAIN, radius, [&](const RowBand& band)
+        {
+            if (radius==0)
+            {
+                for (size_t y=band.Begin; (y<band.End) && (src!=dst); ++y)
+                {
+                    std::copy(src + y*stride, src + y*stride + width, dst + y*stride);
+                }
+            } else if (radius<=2)
+            {
+                medianNetwork(dst, source, width, height, stride, radius, band);
+            } else
+            {
+                medianHistogram(dst, source, width, height, stride, radius, band);
+            }
+        }, maxBands);
+    }
+}
+
+const size_t MedianFilter::MaxRadius;
+
+MedianFilter::MedianFilter(const size_t radius) :
+radius_(std::min(radius, MaxRadius)),
+maxRowBands_(0)
+{
+}
+
+void MedianFilter::setRadius(const size_t radius)
+{
+    radius_=std::min(radius, MaxRadius);
+}
+
+bool MedianFilter::filter(uint8_t * const dataWriteDS, uint8_t const * const dataReadUS,
+                          const size_t width, const size_t height,
+                          const size_t lineStride)
+{
+    medianFilter(dataWriteDS, dataReadUS, width, height, (lineStride!=0) ? lineStride : width, radius_, maxRowBands_);
+    return true;
+}
+
+bool MedianFilter::filter(uint16_t * const dataWriteDS, uint16_t const * const dataReadUS,
+                          const size_t width, const size_t height,
+                          const size_t lineStride)
+{
+    medianFilter(dataWriteDS, dataReadUS, width, height, (lineStride!=0) ? lineStride : width, radius_, maxRowBands_);
+    return true;
+}
+//=========================================//
@@ -0,0 +1,317 @@
+/* Framework for Live Image Transformation (FLITr)
+ * Copyright (c) 2010 CSIR
+ *
+ * This file is part of FLITr.
+ *
+ * FLITr is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * FLITr is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with FLITr. If not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+
+#include <flitr/image_resampler.h>
+#include <flitr/parallel_rows.h>
+
+#include <algorithm>
+#include <cmath>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+using namespace flitr;
+
+namespace {
+
+    // out = a + (b - a) * w
+    void blendRows(float const * a, float const * b, const float w, float * out, const size_t n)
+    {
+        size_t i = 0;
+#if defined(__SSE2__)
+        const __m128 vw = _mm_set1_ps(w);
+        for (; i + 4 <= n; i += 4)
+        {
+            const __m128 va = _mm_loadu_ps(a + i);
+            _mm_storeu_ps(out + i, _mm_add_ps(va, _mm_mul_ps(_mm_sub_ps(_mm_loadu_ps(b + i), va), vw)));
+        }
+#endif
+        for (; i < n; ++i)
+        {
+            out[i] = a[i] + (b[i] - a[i]) * w;
+        }
+    }
+
+    // acc += r
+    void addRows(float * acc, float const * r, const size_t n)
+    {
+        size_t i = 0;
+#if defined(__SSE2__)
+        for (; i + 4 <= n; i += 4)
+        {
+            _mm_storeu_ps(acc + i, _mm_add_ps(_mm_loadu_ps(acc + i), _mm_loadu_ps(r + i)));
+        }
+#endif
+        for (; i < n; ++i)
+        {
+            acc[i] += r[i];
+        }
+    }
+
+    // out = f * scale, rounded for integer channels.
+    template<typename T>
+    void storeRow(float const * f, const float scale, T * out, const size_t n)
+    {
+        for (size_t i = 0; i < n; ++i)
+        {
+            out[i] = T(f[i] * scale + 0.5f);
+        }
+    }
+
+    template<>
+    void storeRow<float>(float const * f, const float scale, float * out, const size_t n)
+    {
+        for (size_t i = 0; i < n; ++i)
+        {
+            out[i] = f[i] * scale;
+        }
+    }
+
+#if defined(__SSE2__)
+    template<>
+    void storeRow<uint8_t>(float const * f, const float scale, uint8_t * out, const size_t n)
+    {
+        const __m128 vs = _mm_set1_ps(scale);
+        const __m128 half = _mm_set1_ps(0.5f);
+        size_t i = 0;
+        for (; i + 16 <= n; i += 16)
+        {
+            const __m128i a = _mm_cvttps_epi32(_mm_add_ps(_mm_mul_ps(_mm_loadu_ps(f + i + 0), vs), half));
+            const __m128i b = _mm_cvttps_epi32(_mm_add_ps(_mm_mul_ps(_mm_loadu_ps(f + i + 4), vs), half));
+            const __m128i c = _mm_cvttps_epi32(_mm_add_ps(_mm_mul_ps(_mm_loadu_ps(f + i + 8), vs), half));
+            const __m128i d = _mm_cvttps_epi32(_mm_add_ps(_mm_mul_ps(_mm_loadu_ps(f + i + 12), vs), half));
+            _mm_storeu_si128((__m128i *)(out + i), _mm_packus_epi16(_mm_packs_epi32(a, b), _mm_packs_epi32(c, d)));
+        }
+        for (; i < n; ++i)
+        {
+            out[i] = uint8_t(f[i] * scale + 0.5f);
+        }
+    }
+#endif
+}
+
+ImageResampler::ImageResampler(const ImageFormat& in_format, const ImageFormat& out_format, Filter filter) :
+    InFormat_(in_format),
+    OutFormat_(out_format),
+    Filter_(filter),
+    Converter_(in_format.getPixelFormat(), out_format.getPixelFormat()),
+    Channels_(0),
+    BytesPerChannel_(0)
+{
+    switch (in_format.getPixelFormat())
+    {
+        case ImageFormat::FLITR_PIX_FMT_Y_8: Channels_ = 1; BytesPerChannel_ = 1; break;
+        case ImageFormat::FLITR_PIX_FMT_RGB_8:
+        case ImageFormat::FLITR_PIX_FMT_BGR: Channels_ = 3; BytesPerChannel_ = 1; break;
+        case ImageFormat::FLITR_PIX_FMT_BGRA:
+        case ImageFormat::FLITR_PIX_FMT_RGBA: Channels_ = 4; BytesPerChannel_ = 1; break;
+        case ImageFormat::FLITR_PIX_FMT_Y_16: Channels_ = 1; BytesPerChannel_ = 2; break;
+        case ImageFormat::FLITR_PIX_FMT_Y_F32: Channels_ = 1; BytesPerChannel_ = 4; break;
+        case ImageFormat::FLITR_PIX_FMT_RGB_F32: Channels_ = 3; BytesPerChannel_ = 4; break;
+        default: break;
+    }
+
+    if ((in_format.getWidth() > 0) && (in_format.getHeight() > 0))
+    {
+        buildAxis(Columns_, in_format.getWidth(), out_format.getWidth(), filter);
+        buildAxis(Rows_, in_format.getHeight(), out_format.getHeight(), filter);
+    }
+}
+
+bool ImageResampler::matches(const ImageFormat& in_format, const ImageFormat& out_format, Filter filter) const
+{
+    return (filter == Filter_) &&
+           (in_format.getPixelFormat() == InFormat_.getPixelFormat()) &&
+           (in_format.getWidth() == InFormat_.getWidth()) && (in_format.getHeight() == InFormat_.getHeight()) &&
+           (out_format.getPixelFormat() == OutFormat_.getPixelFormat()) &&
+           (out_format.getWidth() == OutFormat_.getWidth()) && (out_format.getHeight() == OutFormat_.getHeight());
+}
+
+void ImageResampler::buildAxis(Axis& axis, uint32_t in_size, uint32_t out_size, Filter filter)
+{
+    axis.Begin.resize(out_size);
+    axis.End.resize(out_size);
+    axis.Weight.resize(out_size);
+
+    const double ratio = double(in_size) / out_size;
+
+    for (uint32_t i = 0; i < out_size; ++i)
+    {
+        uint32_t begin = uint32_t((uint64_t(i) * in_size) / out_size);
+        uint32_t end = begin + 1;
+        float weight = 1.0f;
+
+        if (filter == FILTER_BILINEAR)
+        {// Pixel centres are at +0.5.
+            const double s = std::max((i + 0.5) * ratio - 0.5, 0.0);
+            begin = std::min(uint32_t(s), in_size - 1);
+            end = std::min(begin + 1, in_size - 1);
+            weight = (end > begin) ? float(s - begin) : 0.0f;
+        } else if (filter == FILTER_AREA)
+        {
+            end = std::max(uint32_t((uint64_t(i + 1) * in_size) / out_size), begin + 1);
+            weight = 1.0f / (end - begin);
+        }
+
+        axis.Begin[i] = begin;
+        axis.End[i] = end;
+        axis.Weight[i] = weight;
+    }
+}
+
+template<typename T>
+void ImageResampler::horizontalPass(T const * in, float * out) const
+{
+    const size_t width = Columns_.Begin.size();
+    const size_t channels = Channels_;
+
+    if (Filter_ == FILTER_BILINEAR)
+    {
+        for (size_t x = 0; x < width; ++x)
+        {
+            T const * const a = in + Columns_.Begin[x] * channels;
+            T const * const b = in + Columns_.End[x] * channels;
+            const float w = Columns_.Weight[x];
+            for (size_t c = 0; c < channels; ++c)
+            {
+                out[x * channels + c] = a[c] + (float(b[c]) - float(a[c])) * w;
+            }
+        }
+    } else
+    {
+        for (size_t x = 0; x < width; ++x)
+        {
+            const size_t end = Columns_.End[x] * channels;
+            for (size_t c = 0; c < channels; ++c)
+            {
+                float sum = 0.0f;
+                for (size_t i = Columns_.Begin[x] * channels + c; i < end; i += channels)
+                {
+                    sum += in[i];
+                }
+                out[x * channels + c] = sum * Columns_.Weight[x];
+            }
+        }
+    }
+}
+
+template<typename T>
+void ImageResampler::resampleRows(const Image& in, Image& out, size_t begin, size_t end) const
+{
+    const size_t width = Columns_.Begin.size();
+    const size_t channels = Channels_;
+    const size_t numValues = width * channels;
+    const bool sameWidth = (InFormat_.getWidth() == OutFormat_.getWidth());
+
+    std::vector<T> row(numValues);
+
+    if (Filter_ == FILTER_NEAREST)
+    {
+        for (size_t y = begin; y < end; ++y)
+        {
+            T const * const lineRead = (T const *)in.line(Rows_.Begin[y]);
+            if (sameWidth)
+            {
+                Converter_.convertRow((uint8_t const *)lineRead, out.line(uint32_t(y)), width);
+                continue;
+            }
+
+            for (size_t x = 0; x < width; ++x)
+            {
+                T const * const p = lineRead + Columns_.Begin[x] * channels;
+                for (size_t c = 0; c < channels; ++c)
+                {
+                    row[x * channels + c] = p[c];
+                }
+            }
+            Converter_.convertRow((uint8_t const *)&row[0], out.line(uint32_t(y)), width);
+        }
+        return;
+    }
+
+    // Horizontally filtered input rows. Consecutive output rows mostly share input rows,
+    // so remember which rows the buffers hold.
+    std::vector<float> h0(numValues), h1(numValues), acc(numValues);
+    uint32_t h0Row = UINT32_MAX;
+    uint32_t h1Row = UINT32_MAX;
+
+    for (size_t y = begin; y < end; ++y)
+    {
+        const uint32_t top = Rows_.Begin[y];
+        const uint32_t bottom = Rows_.End[y];
+
+        if (Filter_ == FILTER_BILINEAR)
+        {
+            if (h0Row != top)
+            {
+                if (h1Row == top)
+                {
+                    h0.swap(h1);
+                    std::swap(h0Row, h1Row);
+                } else
+                {
+                    horizontalPass((T const *)in.line(top), &h0[0]);
+                    h0Row = top;
+                }
+            }
+            if (h1Row != bottom)
+            {
+                horizontalPass((T const *)in.line(bottom), &h1[0]);
+                h1Row = bottom;
+            }
+
+            blendRows(&h0[0], &h1[0], Rows_.Weight[y], &acc[0], numValues);
+            storeRow(&acc[0], 1.0f, &row[0], numValues);
+        } else
+        {
+            horizontalPass((T const *)in.line(top), &acc[0]);
+            for (uint32_t r = top + 1; r < bottom; ++r)
+            {
+                horizontalPass((T const *)in.line(r), &h0[0]);
+                addRows(&acc[0], &h0[0], numValues);
+            }
+            h0Row = UINT32_MAX;
+
+            storeRow(&acc[0], Rows_.Weight[y], &row[0], numValues);
+        }
+
+        Converter_.convertRow((uint8_t const *)&row[0], out.line(uint32_t(y)), width);
+    }
+}
+
+void ImageResampler::resample(const Image& in, Image& out, uint32_t max_bands) const
+{
+    if (!isSupported() || (Channels_ == 0) || Rows_.Begin.empty() || Columns_.Begin.empty())
+    {
+        return;
+    }
+
+    ParallelRowsPool::instance().run(Rows_.Begin.size(), FLITR_PARALLEL_ROWS_GRAIN, 0, [&](const RowBand& band)
+    {
+        switch (BytesPerChannel_)
+        {
+            case 1: resampleRows<uint8_t>(in, out, band.Begin, band.End); break;
+            case 2: resampleRows<uint16_t>(in, out, band.Begin, band.End); break;
+            case 4: resampleRows<float>(in, out, band.Begin, band.End); break;
+            default: break;
+        }
+    }, max_bands);
+}
@@ -0,0 +1,306 @@
+/* Framework for Live Image Transformation (FLITr)
+ * Copyright (c) 2010 CSIR
+ *
+ * This file is part of FLITr.
+ *
+ * FLITr is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * FLITr is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with FLITr. If not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+
+#include <flitr/lookup_table.h>
+#include <flitr/cpu_features.h>
+#include <flitr/parallel_rows.h>
+#include <flitr/point_op_chain.h>
+
+#include <cstring>
+
+#if defined(FLITR_X86_SIMD)
+#include <immintrin.h>
+#endif
+#if defined(FLITR_NEON_SIMD)
+#include <arm_neon.h>
+#endif
+
+using namespace flitr;
+
+namespace {
+
+    // Four independent lookups per iteration, from one load of the values.
+    void lookUp8Scalar(uint8_t const * in, uint8_t * out, size_t n, uint8_t const * table)
+    {
+        size_t i = 0;
+        for (; i + 4 <= n; i += 4)
+        {
+            uint32_t v;
+            memcpy(&v, in + i, sizeof(v));
+            const uint32_t r = uint32_t(table[v & 255]) | (uint32_t(table[(v >> 8) & 255]) << 8) |
+                               (uint32_t(table[(v >> 16) & 255]) << 16) | (uint32_t(table[v >> 24]) << 24);
+            memcpy(out + i, &r, sizeof(r));
+        }
+        for (; i < n; ++i)
+        {
+            out[i] = table[in[i]];
+        }
+    }
+
+    void lookUp16Scalar(uint16_t const * in, uint16_t * out, size_t n, uint16_t const * table)
+    {
+        for (size_t i = 0; i < n; ++i)
+        {
+            out[i] = table[in[i]];
+        }
+    }
+
+#if defined(FLITR_X86_SIMD)
+    // Each permute looks up 64 values in two 64 entry quarters of the table, and the top
+    // bit of the value picks the half.
+    FLITR_TARGET("avx512f,avx512bw,avx512vbmi")
+    void lookUp8AVX512Vbmi(uint8_t const * in, uint8_t * out, size_t n, uint8_t const * table)
+    {
+        const __m512i t0 = _mm512_loadu_si512(table);
+        const __m512i t1 = _mm512_loadu_si512(table + 64);
+        const __m512i t2 = _mm512_loadu_si512(table + 128);
+        const __m512i t3 = _mm512_loadu_si512(table + 192);
+        size_t i = 0;
+        for (; i + 64 <= n; i += 64)
+        {
+            const __m512i v = _mm512_loadu_si512(in + i);
+            const __m512i low = _mm512_permutex2var_epi8(t0, v, t1);
+            const __m512i high = _mm512_permutex2var_epi8(t2, v, t3);
+            _mm512_storeu_si512(out + i, _mm512_mask_blend_epi8(_mm512_movepi8_mask(v), low, high));
+        }
+        if (i < n)
+        {
+            const __mmask64 tail = _cvtu64_mask64(~0ULL >> (64 - (n - i)));
+            const __m512i v = _mm512_maskz_loadu_epi8(tail, in + i);
+            const __m512i low = _mm512_permutex2var_epi8(t0, v, t1);
+            const __m512i high = _mm512_permutex2var_epi8(t2, v, t3);
+            _mm512_mask_storeu_epi8(out + i, tail, _mm512_mask_blend_epi8(_mm512_movepi8_mask(v), low, high));
+        }
+    }
+
+    // Gathers read 32 bits at each 16 bit entry, which is why the table has an extra entry.
+    FLITR_TARGET("avx2")
+    void lookUp16AVX2(uint16_t const * in, uint16_t * out, size_t n, uint16_t const * table)
+    {
+        const __m256i low16 = _mm256_set1_epi32(0xffff);
+        size_t i = 0;
+        for (; i + 16 <= n; i += 16)
+        {
+            const __m256i a = _mm256_cvtepu16_epi32(_mm_loadu_si128((__m128i const *)(in + i)));
+            const __m256i b = _mm256_cvtepu16_epi32(_mm_loadu_si128((__m128i const *)(in + i + 8)));
+            const __m256i ta = _mm256_and_si256(_mm256_i32gather_epi32((int const *)table, a, 2), low16);
+            const __m256i tb = _mm256_and_si256(_mm256_i32gather_epi32((int const *)table, b, 2), low16);
+            _mm256_storeu_si256((__m256i *)(out + i), _mm256_permute4x64_epi64(_mm256_packus_epi32(ta, tb), 0xD8));
+        }
+        for (; i < n; ++i)
+        {
+            out[i] = table[in[i]];
+        }
+    }
+#endif
+
+#if defined(FLITR_NEON_SIMD) && defined(__aarch64__)
+    // Each lookup covers a 64 entry quarter of the table. Values outside the quarter are
+    // out of range after the subtraction, so the extending lookups keep what is there.
+    void lookUp8NEON(uint8_t const * in, uint8_t * out, size_t n, uint8_t const * table)
+    {
+        const uint8x16x4_t t0 = vld1q_u8_x4(table);
+        const uint8x16x4_t t1 = vld1q_u8_x4(table + 64);
+        const uint8x16x4_t t2 = vld1q_u8_x4(table + 128);
+        const uint8x16x4_t t3 = vld1q_u8_x4(table + 192);
+        const uint8x16_t quarter = vdupq_n_u8(64);
+        size_t i = 0;
+        for (; i + 16 <= n; i += 16)
+        {
+            uint8x16_t v = vld1q_u8(in + i);
+            uint8x16_t r = vqtbl4q_u8(t0, v);
+            v = vsubq_u8(v, quarter);
+            r = vqtbx4q_u8(r, t1, v);
+            v = vsubq_u8(v, quarter);
+            r = vqtbx4q_u8(r, t2, v);
+            v = vsubq_u8(v, quarter);
+            r = vqtbx4q_u8(r, t3, v);
+            vst1q_u8(out + i, r);
+        }
+        lookUp8Scalar(in + i, out + i, n - i, table);
+    }
+#endif
+
+    size_t valuesPerPixel(ImageFormat::PixelFormat pix_fmt)
+    {
+        switch (pix_fmt)
+        {
+            case ImageFormat::FLITR_PIX_FMT_Y_8: return 1;
+            case ImageFormat::FLITR_PIX_FMT_RGB_8:
+            case ImageFormat::FLITR_PIX_FMT_BGR: return 3;
+            case ImageFormat::FLITR_PIX_FMT_Y_16: return 1;
+            default: return 0;
+        }
+    }
+}
+
+LookupTable::LookupTable(ImageFormat::PixelFormat pix_fmt) :
+    Format_(pix_fmt),
+    ValuesPerPixel_(valuesPerPixel(pix_fmt)),
+    Row8_(0),
+    Row16_(0),
+    KernelName_("")
+{
+    if (ValuesPerPixel_ == 0)
+    {
+        return;
+    }
+
+    if (pix_fmt == ImageFormat::FLITR_PIX_FMT_Y_16)
+    {
+        Row16_ = &lookUp16Scalar;
+        KernelName_ = "scalar";
+#if defined(FLITR_X86_SIMD)
+        if (isSimdLevelEnabled(FLITR_SIMD_AVX2))
+        {
+            Row16_ = &lookUp16AVX2;
+            KernelName_ = getSimdLevelName(FLITR_SIMD_AVX2);
+        }
+#endif
+        Table16_.resize(65536 + 1);
+        for (size_t i = 0; i < 65536; ++i)
+        {
+            Table16_[i] = uint16_t(i);
+        }
+        return;
+    }
+
+    Row8_ = &lookUp8Scalar;
+    KernelName_ = "scalar";
+#if defined(FLITR_X86_SIMD)
+    if (isAvx512VbmiEnabled())
+    {
+        Row8_ = &lookUp8AVX512Vbmi;
+        KernelName_ = "avx512vbmi";
+    }
+#elif defined(FLITR_NEON_SIMD) && defined(__aarch64__)
+    if (isSimdLevelEnabled(FLITR_SIMD_NEON))
+    {
+        Row8_ = &lookUp8NEON;
+        KernelName_ = getSimdLevelName(FLITR_SIMD_NEON);
+    }
+#endif
+    Table8_.resize(256);
+    for (size_t i = 0; i < 256; ++i)
+    {
+        Table8_[i] = uint8_t(i);
+    }
+}
+
+bool LookupTable::setTable(const std::vector<uint8_t>& table)
+{
+    if ((Row8_ == 0) || (table.size() != 256))
+    {
+        return false;
+    }
+    Table8_ = table;
+    return true;
+}
+
+bool LookupTable::setTable(const std::vector<uint16_t>& table)
+{
+    if ((Row16_ == 0) || (table.size() != 65536))
+    {
+        return false;
+    }
+    std::copy(table.begin(), table.end(), Table16_.begin());
+    Table16_[65536] = 0;
+    return true;
+}
+
+bool LookupTable::setTable(const PointOpChain& chain)
+{
+    if (!isSupported() || !chain.isSupported() ||
+        (chain.getInputFormat() != Format_) || (chain.getOutputFormat() != Format_))
+    {
+        return false;
+    }
+
+    // Every value as a row of grey pixels, so that the chain's conversions and rounding apply.
+    const size_t numEntries = getNumEntries();
+    if (Row16_ != 0)
+    {
+        std::vector<uint16_t> values(numEntries);
+        for (size_t i = 0; i < numEntries; ++i)
+        {
+            values[i] = uint16_t(i);
+        }
+        chain.applyRow((uint8_t const *)&values[0], (uint8_t *)&Table16_[0], numEntries);
+        return true;
+    }
+
+    std::vector<uint8_t> values(numEntries * ValuesPerPixel_);
+    std::vector<uint8_t> mapped(values.size());
+    for (size_t i = 0; i < values.size(); ++i)
+    {
+        values[i] = uint8_t(i / ValuesPerPixel_);
+    }
+    chain.applyRow(&values[0], &mapped[0], numEntries);
+    for (size_t i = 0; i < numEntries; ++i)
+    {
+        Table8_[i] = mapped[i * ValuesPerPixel_];
+    }
+    return true;
+}
+
+void LookupTable::applyRow(uint8_t const * in, uint8_t * out, size_t width) const
+{
+    if (Row8_ != 0)
+    {
+        Row8_(in, out, width * ValuesPerPixel_, &Table8_[0]);
+    } else if (Row16_ != 0)
+    {
+        Row16_((uint16_t const *)in, (uint16_t *)out, width, &Table16_[0]);
+    }
+}
+
+void LookupTable::apply(uint8_t const * in, size_t in_bytes_per_line,
+                        uint8_t * out, size_t out_bytes_per_line,
+                        size_t width, size_t height, uint32_t max_bands) const
+{
+    if (!isSupported())
+    {
+        return;
+    }
+
+    ParallelRowsPool::instance().run(height, FLITR_PARALLEL_ROWS_GRAIN, 0, [&](const RowBand& band)
+    {
+        for (size_t y = band.Begin; y < band.End; ++y)
+        {
+            applyRow(in + y * in_bytes_per_line, out + y * out_bytes_per_line, width);
+        }
+    }, max_bands);
+}
+
+bool LookupTable::apply(const Image& in, Image& out, uint32_t max_bands) const
+{
+    const ImageFormat& inFormat = *in.format();
+    const ImageFormat& outFormat = *out.format();
+    if (!isSupported() ||
+        (inFormat.getPixelFormat() != Format_) || (outFormat.getPixelFormat() != Format_) ||
+        (inFormat.getWidth() != outFormat.getWidth()) || (inFormat.getHeight() != outFormat.getHeight()))
+    {
+        return false;
+    }
+
+    apply(in.data(), inFormat.getBytesPerLine(), out.data(), outFormat.getBytesPerLine(),
+          inFormat.getWidth(), inFormat.getHeight(), max_bands);
+    return true;
+}
@@ -70,7 +70,7 @@ bool FIPAdaptiveThreshold::init()
     //Note: SharedImageBuffer of downstream producer is initialised with storage in ImageProcessor::init.
     
     size_t maxScratchDataSize=0;
-    size_t maxScratchDataValues=0;
+    size_t maxIntegralImageSize=0;
     
     for (uint32_t i=0; i<ImagesPerSlot_; i++)
     {
@@ -83,16 +83,17 @@ bool FIPAdaptiveThreshold::init()
         const size_t componentsPerPixel=imFormat.getComponentsPerPixel();
         
         const size_t scratchDataSize = width * height * bytesPerPixel;
-        const size_t scratchDataValues = width * height * componentsPerPixel;
+        const size_t integralImageSize = width * height * componentsPerPixel *
+            ((imFormat.getPixelFormat()==ImageFormat::FLITR_PIX_FMT_Y_8) ? sizeof(uint32_t) : sizeof(double));
         
         if (scratchDataSize>maxScratchDataSize)
         {
             maxScratchDataSize=scratchDataSize;
         }
         
-        if (scratchDataValues>maxScratchDataValues)
+        if (integralImageSize>maxIntegralImageSize)
         {
-            maxScratchDataValues=scratchDataValues;
+            maxIntegralImageSize=integralImageSize;
         }
     }
     
@@ -102,8 +103,8 @@ bool FIPAdaptiveThreshold::init()
     memset(_noiseFilteredInputData, 0, maxScratchDataSize);
     memset(_scratchData, 0, maxScratchDataSize);
     
-    _integralImageScratchData=new double[maxScratchDataValues];
-    memset(_integralImageScratchData, 0, maxScratchDataValues*sizeof(double));
+    _integralImageScratchData=new uint8_t[maxIntegralImageSize];
+    memset(_integralImageScratchData, 0, maxIntegralImageSize);
     
     return rValue;
 }
@@ -125,11 +126,8 @@ bool FIPAdaptiveThreshold::trigger()
             const ImageFormat imFormat=getDownstreamFormat(imgNum);//down stream and up stream formats are the same.
             
             if (!_enabled)
-            {
-                uint8_t const * const dataReadUS=(uint8_t const * const)imReadUS->data();
-                uint8_t * const dataWriteDS=(uint8_t * const)imWriteDS->data();
-                const size_t bytesPerImage=imFormat.getBytesPerImage();
-                memcpy(dataWriteDS, dataReadUS, bytesPerImage);
+            {//Pass not enabled! Pass the upstream data on without copying.
+                imWriteDS->shareDataFrom(*imReadUS);
             } else
             {
                 const size_t width=imFormat.getWidth();
@@ -143,14 +141,14 @@ bool FIPAdaptiveThreshold::trigger()
                     
                     //Small kernel noise filter.
                     _noiseFilter.filter((float *)_noiseFilteredInputData, dataReadUS, width, height,
-                                        _integralImageScratchData, true);
+                                        (double *)_integralImageScratchData, true);
                     
                     for (short i=1; i<_numIntegralImageLevels; ++i)
                     {
                         memcpy(_scratchData, _noiseFilteredInputData, width*height*sizeof(uint8_t));
                         
                         _noiseFilter.filter((float *)_noiseFilteredInputData, (float *)_scratchData, width, height,
-                                            _integralImageScratchData, true);
+                                            (double *)_integralImageScratchData, true);
                     }
                     
                     
@@ -162,14 +160,14 @@ bool FIPAdaptiveThreshold::trigger()
                     
                     //Large kernel adaptive reference.
                     _boxFilter.filter(dataWriteDS, dataReadUS, width, height,
-                                      _integralImageScratchData, true);
+                                      (double *)_integralImageScratchData, true);
                     
                     for (short i=1; i<_numIntegralImageLevels; ++i)
                     {
                         memcpy(_scratchData, dataWriteDS, width*height*sizeof(float));
                         
                         _boxFilter.filter(dataWriteDS, (float *)_scratchData, width, height,
-                                          _integralImageScratchData, true);
+                                          (double *)_integralImageScratchData, true);
                     }
                     
                     
@@ -197,14 +195,14 @@ bool FIPAdaptiveThreshold::trigger()
                         
                         //Small kernel noise filter.
                         _noiseFilter.filter((uint8_t *)_noiseFilteredInputData, dataReadUS, width, height,
-                                            _integralImageScratchData, true);
+                                            (uint32_t *)_integralImageScratchData, true);
                         
                         for (short i=1; i<_numIntegralImageLevels; ++i)
                         {
                             memcpy(_scratchData, _noiseFilteredInputData, width*height*sizeof(uint8_t));
                             
                             _noiseFilter.filter((uint8_t *)_noiseFilteredInputData, (uint8_t *)_scratchData, width, height,
-                                                _integralImageScratchData, true);
+                                                (uint32_t *)_integralImageScratchData, true);
                         }
                         
                         
@@ -216,14 +214,14 @@ bool FIPAdaptiveThreshold::trigger()
                         
                         //Large kernel adaptive reference.
                         _boxFilter.filter(dataWriteDS, dataReadUS, width, height,
-                                          _integralImageScratchData, true);
+                                          (uint32_t *)_integralImageScratchData, true);
                         
                         for (short i=1; i<_numIntegralImageLevels; ++i)
                         {
                             memcpy(_scratchData, dataWriteDS, width*height*sizeof(uint8_t));
                             
                             _boxFilter.filter(dataWriteDS, (uint8_t *)_scratchData, width, height,
-                                              _integralImageScratchData, true);
+                                              (uint32_t *)_integralImageScratchData, true);
                         }
                         
                         
@@ -19,19 +19,101 @@
  */
 
 #include <flitr/modules/flitr_image_processors/average_image/fip_average_image.h>
+#include <flitr/log_message.h>
 
 using namespace flitr;
 using std::shared_ptr;
 
+namespace {
+
+    //Bytes per component of the formats that are averaged, or zero.
+    size_t bytesPerComponent(const ImageFormat::PixelFormat pixFormat)
+    {
+        switch (pixFormat)
+        {
+            case ImageFormat::FLITR_PIX_FMT_Y_8:
+            case ImageFormat::FLITR_PIX_FMT_RGB_8:
+            case ImageFormat::FLITR_PIX_FMT_BGR:
+            case ImageFormat::FLITR_PIX_FMT_BGRA:
+            case ImageFormat::FLITR_PIX_FMT_RGBA:
+                return 1;
+            case ImageFormat::FLITR_PIX_FMT_Y_16:
+                return 2;
+            case ImageFormat::FLITR_PIX_FMT_Y_F32:
+            case ImageFormat::FLITR_PIX_FMT_RGB_F32:
+                return 4;
+            default:
+                return 0;
+        }
+    }
+
+    //Bytes per component of the sum. 8 bit windows of up to 256 frames fit in 16 bits.
+    size_t bytesPerSumComponent(const size_t componentBytes, const uint8_t base2WindowLength)
+    {
+        return ((componentBytes==1) && (base2WindowLength<=8)) ? 2 : 4;
+    }
+
+    //sum+=in-oldest, oldest=in, out=sum*recipWindowLength
+    void averageRow(float * __restrict out, float * __restrict sum, float * __restrict oldest,
+                    float const * __restrict in, const size_t n, const float recipWindowLength)
+    {
+        for (size_t x=0; x<n; ++x)
+        {
+            const float s=(sum[x] + in[x]) - oldest[x];
+            sum[x]=s;
+            oldest[x]=in[x];
+            out[x]=s * recipWindowLength;
+        }
+    }
+
+    //oldest=in, sum=the sum of every slot of the history, out=sum*recipWindowLength
+    void recomputeRow(float * __restrict out, float * __restrict sum, float * __restrict oldest,
+                      float const * __restrict in, float const * __restrict history, const size_t historyPlaneSize,
+                      const size_t windowLength, const size_t n, const float recipWindowLength)
+    {
+        memcpy(oldest, in, n*sizeof(float));
+        memcpy(sum, history, n*sizeof(float));
+        for (size_t slot=1; slot<windowLength; ++slot)
+        {
+            float const * __restrict const historyRow=history + slot*historyPlaneSize;
+            for (size_t x=0; x<n; ++x)
+            {
+                sum[x]+=historyRow[x];
+            }
+        }
+        for (size_t x=0; x<n; ++x)
+        {
+            out[x]=sum[x] * recipWindowLength;
+        }
+    }
+
+    //sum+=in-oldest, oldest=in, out=sum/2^shift rounded to nearest. Unsigned wrap around keeps the sum exact.
+    template<typename P, typename S>
+    void averageRow(P * __restrict out, S * __restrict sum, P * __restrict oldest,
+                    P const * __restrict in, const size_t n, const uint8_t shift)
+    {
+        const S half=S((S(1)<<shift)>>1);
+        for (size_t x=0; x<n; ++x)
+        {
+            const S s=S(S(sum[x] + in[x]) - oldest[x]);
+            sum[x]=s;
+            oldest[x]=in[x];
+            out[x]=P((s + half)>>shift);
+        }
+    }
+}
+
 FIPAverageImage::FIPAverageImage(ImageProducer& upStreamProducer, uint32_t images_per_slot,
                                  uint8_t base2WindowLength,
                                  uint32_t buffer_size) :
 ImageProcessor(upStreamProducer, images_per_slot, buffer_size),
 base2WindowLength_(base2WindowLength),
-windowLength_((uint32_t)(powf(2.0f, base2WindowLength_)+0.5f)),
+windowLength_(size_t(1)<<base2WindowLength_),
 recipWindowLength_(1.0f/((float)windowLength_)),
 Title_(std::string("Average Image")),
-oldestHistorySlot_(0)
+recomputeInterval_(windowLength_*16),
+oldestHistorySlot_(0),
+triggerCount_(0)
 {
     ProcessorStats_->setID("ImageProcessor::FIPAverageImage");
     //Setup image format being produced to downstream.
@@ -54,22 +136,36 @@ FIPAverageImage::~FIPAverageImage()
     stopTriggerThread();
     // Thread should be done, cleaning up can start. This might still be a problem
     // if the application calls trigger() and not the triggerThread.
-    for (uint32_t i=0; i<ImagesPerSlot_; ++i)
+    for (size_t i=0; i<sumImageVec_.size(); ++i)
     {
         delete [] sumImageVec_[i];
-        
-        for (size_t historyIndex=0; historyIndex<windowLength_; ++historyIndex)
-        {
-            delete [] historyImageVecVec_[i][historyIndex];
-        }
-        historyImageVecVec_[i].clear();
+        delete [] historyImageVec_[i];
     }
     
     sumImageVec_.clear();
+    historyImageVec_.clear();
 }
 
 bool FIPAverageImage::init()
 {
+    for (uint32_t i=0; i<ImagesPerSlot_; ++i)
+    {
+        const ImageFormat::PixelFormat pixFormat=getUpstreamFormat(i).getPixelFormat();
+        const size_t componentBytes=bytesPerComponent(pixFormat);
+        
+        if (componentBytes==0)
+        {
+            logMessage(LOG_CRITICAL) << "FIPAverageImage: The pixel format of image " << i << " is not supported.\n";
+            return false;
+        }
+        
+        if (((componentBytes==1) && (base2WindowLength_>24)) || ((componentBytes==2) && (base2WindowLength_>16)))
+        {
+            logMessage(LOG_CRITICAL) << "FIPAverageImage: The window of " << windowLength_ << " frames is too long for the 32 bit sum of image " << i << ".\n";
+            return false;
+        }
+    }
+    
     bool rValue=ImageProcessor::init();
     //Note: SharedImageBuffer of downstream producer is initialised with storage in ImageProcessor::init.
     
@@ -81,21 +177,89 @@ bool FIPAverageImage::init()
         const size_t height=imFormat.getHeight();
         
         const size_t componentsPerPixel=imFormat.getComponentsPerPixel();
+        const size_t componentBytes=bytesPerComponent(imFormat.getPixelFormat());
+        const size_t sumBytes=(componentBytes==4) ? 4 : bytesPerSumComponent(componentBytes, base2WindowLength_);
         
-        sumImageVec_.push_back(new float[width*height*componentsPerPixel]);
-        memset(sumImageVec_[i], 0, width*height*componentsPerPixel*sizeof(float));
+        const size_t planeSize=width*height*componentsPerPixel;
         
-        historyImageVecVec_.push_back(std::vector<float *>());
-        for (size_t historyIndex=0; historyIndex<windowLength_; ++historyIndex)
-        {
-            historyImageVecVec_[i].push_back(new float[width*height*componentsPerPixel]);
-            memset(historyImageVecVec_[i][historyIndex], 0, width*height*componentsPerPixel*sizeof(float));
-        }
+        sumImageVec_.push_back(new uint8_t[planeSize*sumBytes]);
+        memset(sumImageVec_[i], 0, planeSize*sumBytes);
+        
+        historyImageVec_.push_back(new uint8_t[planeSize*componentBytes*windowLength_]);
+        memset(historyImageVec_[i], 0, planeSize*componentBytes*windowLength_);
     }
     
     return rValue;
 }
 
+void FIPAverageImage::updateAverageF32(size_t imgNum, Image const * const imRead, Image * const imWrite)
+{
+    const ImageFormat imFormat=getUpstreamFormat(imgNum);//Downstream format is same as upstream format.
+    
+    const size_t height=imFormat.getHeight();
+    const size_t rowLength=imFormat.getWidth()*imFormat.getComponentsPerPixel();
+    const size_t planeSize=rowLength*height;
+    const size_t bytesPerLineRead=imFormat.getBytesPerLine();
+    const size_t bytesPerLineWrite=getDownstreamFormat(imgNum).getBytesPerLine();
+    
+    uint8_t const * const dataRead=imRead->data();
+    uint8_t * const dataWrite=imWrite->data();
+    float * const sumImage=(float *)sumImageVec_[imgNum];
+    float * const historyImage=(float *)historyImageVec_[imgNum];
+    float * const oldestHistoryImage=historyImage + oldestHistorySlot_*planeSize;
+    
+    const size_t recomputeInterval=recomputeInterval_;
+    const size_t recomputePhase=(recomputeInterval!=0) ? (triggerCount_ % recomputeInterval) : 0;
+    
+    parallelRows(height, FLITR_PARALLEL_ROWS_GRAIN, [&](const RowBand& band)
+    {
+        for (size_t y=band.Begin; y<band.End; ++y)
+        {
+            const size_t offset=y*rowLength;
+            float const * const lineRead=(float const *)(dataRead + y*bytesPerLineRead);
+            float * const lineWrite=(float *)(dataWrite + y*bytesPerLineWrite);
+            
+            if ((recomputeInterval!=0) && ((y % recomputeInterval)==recomputePhase))
+            {
+                recomputeRow(lineWrite, sumImage + offset, oldestHistoryImage + offset, lineRead,
+                             historyImage + offset, planeSize, windowLength_, rowLength, recipWindowLength_);
+            } else
+            {
+                averageRow(lineWrite, sumImage + offset, oldestHistoryImage + offset, lineRead,
+                           rowLength, recipWindowLength_);
+            }
+        }
+    });
+}
+
+template<typename P, typename S>
+void FIPAverageImage::updateAverage(size_t imgNum, Image const * const imRead, Image * const imWrite)
+{
+    const ImageFormat imFormat=getUpstreamFormat(imgNum);//Downstream format is same as upstream format.
+    
+    const size_t height=imFormat.getHeight();
+    const size_t rowLength=imFormat.getWidth()*imFormat.getComponentsPerPixel();
+    const size_t planeSize=rowLength*height;
+    const size_t bytesPerLineRead=imFormat.getBytesPerLine();
+    const size_t bytesPerLineWrite=getDownstreamFormat(imgNum).getBytesPerLine();
+    
+    uint8_t const * const dataRead=imRead->data();
+    uint8_t * const dataWrite=imWrite->data();
+    S * const sumImage=(S *)sumImageVec_[imgNum];
+    P * const oldestHistoryImage=((P *)historyImageVec_[imgNum]) + oldestHistorySlot_*planeSize;
+    
+    parallelRows(height, FLITR_PARALLEL_ROWS_GRAIN, [&](const RowBand& band)
+    {
+        for (size_t y=band.Begin; y<band.End; ++y)
+        {
+            const size_t offset=y*rowLength;
+            
+            averageRow((P *)(dataWrite + y*bytesPerLineWrite), sumImage + offset, oldestHistoryImage + offset,
+                       (P const *)(dataRead + y*bytesPerLineRead), rowLength, base2WindowLength_);
+        }
+    });
+}
+
 bool FIPAverageImage::trigger()
 {
     if ((getNumReadSlotsAvailable())&&(getNumWriteSlotsAvailable()))
@@ -119,68 +283,28 @@ bool FIPAverageImage::trigger()
                 imWrite->setMetadata(PassMetadataFunction_(imRead->metadata()));
             }
             
-            const ImageFormat imFormat=getUpstreamFormat(imgNum);//Downstream format is same as upstream format.
-            
-            const size_t width=imFormat.getWidth();
-            const size_t height=imFormat.getHeight();
-            
             //Update this slot's average image here...
-            if (imFormat.getPixelFormat()==ImageFormat::FLITR_PIX_FMT_Y_F32)
+            const size_t componentBytes=bytesPerComponent(getUpstreamFormat(imgNum).getPixelFormat());
+            
+            if (componentBytes==4)
             {
-                float const * const dataRead = (float const * const)imRead->data();
-                float * const dataWrite = (float * const)imWrite->data();
-                float * const sumImage = sumImageVec_[imgNum];
-                float * const oldestHistoryImage = historyImageVecVec_[imgNum][oldestHistorySlot_];
-                
-                for (size_t y=0; y<height; ++y)
-                {
-                    const size_t lineOffset=y * width;
-                    
-                    for (size_t x=0; x<width; ++x)
-                    {
-                        sumImage[lineOffset + x]+=dataRead[lineOffset + x];
-                        sumImage[lineOffset + x]-=oldestHistoryImage[lineOffset + x];
-                        oldestHistoryImage[lineOffset + x]=dataRead[lineOffset + x];
-                        dataWrite[lineOffset + x]=sumImage[lineOffset + x] * recipWindowLength_;
-                    }
-                }
+                updateAverageF32(imgNum, imRead, imWrite);
             } else
-                if (imFormat.getPixelFormat()==ImageFormat::FLITR_PIX_FMT_RGB_F32)
+                if (componentBytes==2)
                 {
-                    float const * const dataRead = (float const * const)imRead->data();
-                    float * const dataWrite = (float * const)imWrite->data();
-                    float * const sumImage = sumImageVec_[imgNum];
-                    float * const oldestHistoryImage = historyImageVecVec_[imgNum][oldestHistorySlot_];
-                    
-                    for (size_t y=0; y<height; ++y)
+                    updateAverage<uint16_t, uint32_t>(imgNum, imRead, imWrite);
+                } else
+                    if (bytesPerSumComponent(componentBytes, base2WindowLength_)==2)
+                    {
+                        updateAverage<uint8_t, uint16_t>(imgNum, imRead, imWrite);
+                    } else
                     {
-                        size_t offset=y * width*3;
-                        
-                        for (size_t x=0; x<width; ++x)
-                        {
-                            sumImage[offset + 0]+=dataRead[offset + 0];
-                            sumImage[offset + 0]-=oldestHistoryImage[offset + 0];
-                            oldestHistoryImage[offset + 0]=dataRead[offset + 0];
-                            dataWrite[offset + 0]=sumImage[offset + 0] * recipWindowLength_;
-                            
-                            sumImage[offset + 1]+=dataRead[offset + 1];
-                            sumImage[offset + 1]-=oldestHistoryImage[offset + 1];
-                            oldestHistoryImage[offset + 1]=dataRead[offset + 1];
-                            dataWrite[offset + 1]=sumImage[offset + 1] * recipWindowLength_;
-                            
-                            sumImage[offset + 2]+=dataRead[offset + 2];
-                            sumImage[offset + 2]-=oldestHistoryImage[offset + 2];
-                            oldestHistoryImage[offset + 2]=dataRead[offset + 2];
-                            dataWrite[offset + 2]=sumImage[offset + 2] * recipWindowLength_;
-                            
-                            offset+=3;
-                        }
+                        updateAverage<uint8_t, uint32_t>(imgNum, imRead, imWrite);
                     }
-                }
-
         }
         
         oldestHistorySlot_=(oldestHistorySlot_+1) % windowLength_;
+        ++triggerCount_;
         
         //Stop stats measurement event.
         ProcessorStats_->tock();
@@ -193,4 +317,3 @@ bool FIPAverageImage::trigger()
     
     return false;
 }
-
@@ -19,27 +19,104 @@
  */
 
 #include <flitr/modules/flitr_image_processors/beat_image/fip_beat_image.h>
+#include <flitr/log_message.h>
+
+#include <cmath>
 
 using namespace flitr;
 using std::shared_ptr;
 
+namespace {
+
+    //change = in - history, history = in
+    void updateHistoryRow(float * __restrict change, float * __restrict history, float const * __restrict in,
+                          const size_t n)
+    {
+        for (size_t x=0; x<n; ++x)
+        {
+            change[x]=in[x]-history[x];
+            history[x]=in[x];
+        }
+    }
+
+    //Add the change times the twiddle factor to the bin and output its power.
+    void slideRow(float * __restrict out, float * __restrict binReal, float * __restrict binImag,
+                  float const * __restrict change, const size_t n,
+                  const float twiddleCos, const float twiddleSin)
+    {
+        for (size_t x=0; x<n; ++x)
+        {
+            const float vx=binReal[x] + change[x]*twiddleCos;
+            const float vi=binImag[x] - change[x]*twiddleSin;
+            binReal[x]=vx;
+            binImag[x]=vi;
+            out[x]=(vx*vx+vi*vi)*2.625f+0.5f;
+        }
+    }
+
+    //Recompute the bin from every slot of the history and output its power.
+    void resyncRow(float * __restrict out, float * __restrict binReal, float * __restrict binImag,
+                   float const * __restrict history, const size_t historyPlaneSize,
+                   float const * __restrict twiddleCos, float const * __restrict twiddleSin,
+                   const size_t windowLength, const size_t n)
+    {
+        for (size_t x=0; x<n; ++x)
+        {
+            binReal[x]=0.0f;
+            binImag[x]=0.0f;
+        }
+        for (size_t slot=0; slot<windowLength; ++slot)
+        {
+            float const * __restrict const historyRow=history + slot*historyPlaneSize;
+            const float c=twiddleCos[slot];
+            const float s=twiddleSin[slot];
+            for (size_t x=0; x<n; ++x)
+            {
+                binReal[x]+=historyRow[x]*c;
+                binImag[x]-=historyRow[x]*s;
+            }
+        }
+        for (size_t x=0; x<n; ++x)
+        {
+            out[x]=(binReal[x]*binReal[x]+binImag[x]*binImag[x])*2.625f+0.5f;
+        }
+    }
+}
+
+FIPBeatImage::FIPBeatImage(ImageProducer& upStreamProducer, uint32_t images_per_slot,
+                           uint8_t base2WindowLength,
+                           uint32_t buffer_size) :
+FIPBeatImage(upStreamProducer, images_per_slot, base2WindowLength, std::vector<size_t>(1, 2), buffer_size)
+{
+}
+
 FIPBeatImage::FIPBeatImage(ImageProducer& upStreamProducer, uint32_t images_per_slot,
                            uint8_t base2WindowLength,
+                           const std::vector<size_t>& beatBins,
                            uint32_t buffer_size) :
-ImageProcessor(upStreamProducer, images_per_slot, buffer_size),
+ImageProcessor(upStreamProducer, images_per_slot*uint32_t(beatBins.size()), buffer_size),
 base2WindowLength_(base2WindowLength),
-windowLength_((uint32_t)(powf(2.0f, base2WindowLength_)+0.5f)),
+windowLength_(size_t(1)<<base2WindowLength_),
+beatBins_(beatBins),
+numSources_(images_per_slot),
 oldestHistorySlot_(0)
 {
+    ProcessorStats_->setID("ImageProcessor::FIPBeatImage");
+    
     //Setup image format being produced to downstream.
     for (uint32_t i=0; i<images_per_slot; i++) {
-        ImageFormat_.push_back(upStreamProducer.getFormat(i));//Output format is same as input format.
+        for (size_t binIndex=0; binIndex<beatBins_.size(); ++binIndex)
+        {
+            ImageFormat_.push_back(upStreamProducer.getFormat(i));//Output format is same as input format.
+        }
     }
 }
 
 FIPBeatImage::~FIPBeatImage()
 {
-    for (uint32_t i=0; i<ImagesPerSlot_; ++i)
+    stopTriggerThread();
+    
+    for (size_t i=0; i<historyImageVec_.size(); ++i)
     {
         delete [] historyImageVec_[i];
         delete [] beatImageVec_[i];
@@ -48,23 +125,59 @@ FIPBeatImage::~FIPBeatImage()
 
 bool FIPBeatImage::init()
 {
+    if (beatBins_.empty())
+    {
+        logMessage(LOG_CRITICAL) << "FIPBeatImage: No beat bins were given.\n";
+        return false;
+    }
+    
+    for (size_t binIndex=0; binIndex<beatBins_.size(); ++binIndex)
+    {
+        if (beatBins_[binIndex]>=windowLength_)
+        {
+            logMessage(LOG_CRITICAL) << "FIPBeatImage: Beat bin " << beatBins_[binIndex] << " is not less than the window length " << windowLength_ << ".\n";
+            return false;
+        }
+    }
+    
+    for (uint32_t i=0; i<numSources_; ++i)
+    {
+        const ImageFormat::PixelFormat pixFormat=getUpstreamFormat(i).getPixelFormat();
+        if ((pixFormat!=ImageFormat::FLITR_PIX_FMT_Y_F32) && (pixFormat!=ImageFormat::FLITR_PIX_FMT_RGB_F32))
+        {
+            logMessage(LOG_CRITICAL) << "FIPBeatImage: Image " << i << " is not Y_F32 or RGB_F32.\n";
+            return false;
+        }
+    }
+    
     bool rValue=ImageProcessor::init();
     //Note: SharedImageBuffer of downstream producer is initialised with storage in ImageProcessor::init.
     
-    for (uint32_t i=0; i<ImagesPerSlot_; ++i)
+    for (uint32_t i=0; i<numSources_; ++i)
     {
-        const ImageFormat imFormat=getUpstreamFormat(i);//Downstream format is same as upstream format.
-        
-        const size_t width=imFormat.getWidth();
-        const size_t height=imFormat.getHeight();
+        const ImageFormat imFormat=getUpstreamFormat(i);
         
-        const size_t componentsPerPixel=imFormat.getComponentsPerPixel();
+        const size_t planeSize=imFormat.getWidth()*imFormat.getHeight()*imFormat.getComponentsPerPixel();
         
-        historyImageVec_.push_back(new float[width*height*componentsPerPixel * windowLength_]);
-        memset(historyImageVec_[i], 0, width*height*componentsPerPixel * windowLength_ * sizeof(float));
+        historyImageVec_.push_back(new float[planeSize * windowLength_]);
+        memset(historyImageVec_[i], 0, planeSize * windowLength_ * sizeof(float));
         
-        beatImageVec_.push_back(new float[width*height*componentsPerPixel * windowLength_*2]);
-        memset(beatImageVec_[i], 0, width*height*componentsPerPixel * windowLength_*2 * sizeof(float));
+        beatImageVec_.push_back(new float[planeSize * beatBins_.size()*2]);
+        memset(beatImageVec_[i], 0, planeSize * beatBins_.size()*2 * sizeof(float));
+    }
+    
+    twiddleCos_.resize(beatBins_.size()*windowLength_);
+    twiddleSin_.resize(beatBins_.size()*windowLength_);
+    
+    for (size_t binIndex=0; binIndex<beatBins_.size(); ++binIndex)
+    {
+        for (size_t slot=0; slot<windowLength_; ++slot)
+        {
+            //Reduce bin*slot first so that the angle stays exact.
+            const double theta=6.28318530717959*double((beatBins_[binIndex]*slot) % windowLength_)/windowLength_;
+            twiddleCos_[binIndex*windowLength_ + slot]=float(cos(theta));
+            twiddleSin_[binIndex*windowLength_ + slot]=float(sin(theta));
+        }
     }
     
     return rValue;
@@ -82,71 +195,72 @@ bool FIPBeatImage::trigger()
         //Start stats measurement event.
         ProcessorStats_->tick();
         
-        for (size_t imgNum=0; imgNum<ImagesPerSlot_; ++imgNum)
+        const size_t numBins=beatBins_.size();
+        
+        for (size_t imgNum=0; imgNum<numSources_; ++imgNum)
         {
             Image const * const imRead = *(imvRead[imgNum]);
-            Image * const imWrite = *(imvWrite[imgNum]);
             
-            const ImageFormat imFormat=getUpstreamFormat(imgNum);//Downstream format is same as upstream format.
+            // Pass the metadata from the read image to the write images.
+            // By Default the base implementation will copy the pointer if no custom
+            // pass function was set.
+            if(PassMetadataFunction_ != nullptr)
+            {
+                const std::shared_ptr<ImageMetadata> metadata=PassMetadataFunction_(imRead->metadata());
+                for (size_t binIndex=0; binIndex<numBins; ++binIndex)
+                {
+                    (*(imvWrite[getBeatImageIndex(imgNum, binIndex)]))->setMetadata(metadata);
+                }
+            }
+            
+            const ImageFormat imFormat=getUpstreamFormat(imgNum);
             
-            const size_t width=imFormat.getWidth();
             const size_t height=imFormat.getHeight();
-            const size_t windowLength_Minus1=windowLength_-1;
+            const size_t rowLength=imFormat.getWidth()*imFormat.getComponentsPerPixel();
+            const size_t planeSize=rowLength*height;
+            const size_t bytesPerLineRead=imFormat.getBytesPerLine();
+            const size_t bytesPerLineWrite=getDownstreamFormat(getBeatImageIndex(imgNum, 0)).getBytesPerLine();
+            const size_t newestSlot=oldestHistorySlot_;
             
+            uint8_t const * const dataRead=imRead->data();
+            float * const historyImage=historyImageVec_[imgNum];
+            float * const beatImage=beatImageVec_[imgNum];
             
-            if (imFormat.getPixelFormat()==ImageFormat::FLITR_PIX_FMT_Y_F32)
+            parallelRows(height, FLITR_PARALLEL_ROWS_GRAIN, [&](const RowBand& band)
             {
-                float const * const dataRead = (float const * const)imRead->data();
-                float * const dataWrite = (float * const)imWrite->data();
-                
-                float * const historyImage = historyImageVec_[imgNum];
-                float * const beatImage = beatImageVec_[imgNum];
+                std::vector<float> change(rowLength);
                 
-                for (size_t y=0; y<height; ++y)
+                for (size_t y=band.Begin; y<band.End; ++y)
                 {
-                    const size_t imgOffset=y * width;
-                    size_t histOffset=y * width * windowLength_;
-                    size_t beatOffset=y * width * (windowLength_<<1);
+                    const size_t rowOffset=y*rowLength;
+                    
+                    //Replace the oldest frame in the history ring buffer by the new one.
+                    updateHistoryRow(&change[0], historyImage + newestSlot*planeSize + rowOffset,
+                                     (float const *)(dataRead + y*bytesPerLineRead), rowLength);
+                    
+                    //Every frame recomputes a different row in windowLength_ from the history.
+                    const bool resync=((y % windowLength_)==newestSlot);
                     
-                    for (size_t x=0; x<width; ++x)
+                    for (size_t binIndex=0; binIndex<numBins; ++binIndex)
                     {
-                        //Update history ring buffer.
-                        historyImage[histOffset + oldestHistorySlot_]=dataRead[imgOffset + x];
+                        float * const binReal=beatImage + (binIndex*2)*planeSize + rowOffset;
+                        float * const binImag=beatImage + (binIndex*2+1)*planeSize + rowOffset;
+                        float * const dataWrite=(float *)((*(imvWrite[getBeatImageIndex(imgNum, binIndex)]))->data() + y*bytesPerLineWrite);
                         
-                        
-                        //Setup beat input...
-                        //* Unring the history ring buffer.
-                        //* beatImage will then be modified in place.
-                        for (size_t n=0; n<windowLength_; ++n)
+                        if (resync)
+                        {
+                            resyncRow(dataWrite, binReal, binImag, historyImage + rowOffset, planeSize,
+                                      &twiddleCos_[binIndex*windowLength_], &twiddleSin_[binIndex*windowLength_],
+                                      windowLength_, rowLength);
+                        } else
                         {
-                            beatImage[beatOffset + (n << 1)]     = historyImage[histOffset + ((n+oldestHistorySlot_) & windowLength_Minus1)];
-                            beatImage[beatOffset + (n << 1) + 1] = 0.0f;
+                            slideRow(dataWrite, binReal, binImag, &change[0], rowLength,
+                                     twiddleCos_[binIndex*windowLength_ + newestSlot],
+                                     twiddleSin_[binIndex*windowLength_ + newestSlot]);
                         }
-                        
-                        
-                        //Calculculate the beat...
-                        four1(beatImage+beatOffset-1, windowLength_, +1);
-                        
-                        
-                        //Update the output image.
-                        const size_t beatNum=4;//0,2,4,...
-                        const float vx=beatImage[beatOffset+beatNum];
-                        const float vi=beatImage[beatOffset+beatNum+1];
-                        
-                        dataWrite[imgOffset + x]=(vx*vx+vi*vi)*2.625f+0.5f;
-                        
-                        histOffset+=windowLength_;
-                        beatOffset+=windowLength_<<1;
                     }
                 }
-            } else
-                if (imFormat.getPixelFormat()==ImageFormat::FLITR_PIX_FMT_RGB_F32)
-                {
-                    //float const * const dataRead = (float const * const)imRead->data();
-                    //float * const dataWrite = (float * const)imWrite->data();
-                    
-                }
-            
+            });
         }
         
         oldestHistorySlot_=(oldestHistorySlot_+1) % windowLength_;
@@ -162,4 +276,3 @@ bool FIPBeatImage::trigger()
     
     return false;
 }
-
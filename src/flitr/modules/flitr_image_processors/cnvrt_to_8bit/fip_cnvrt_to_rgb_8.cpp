@@ -19,6 +19,7 @@
  */
 
 #include <flitr/modules/flitr_image_processors/cnvrt_to_8bit/fip_cnvrt_to_rgb_8.h>
+#include <flitr/log_message.h>
 
 
 using namespace flitr;
@@ -49,6 +50,17 @@ FIPConvertToRGB8::~FIPConvertToRGB8()
 
 bool FIPConvertToRGB8::init()
 {
+    Converters_.clear();
+    for (uint32_t i=0; i<ImagesPerSlot_; i++)
+    {
+        Converters_.push_back(PixelFormatConverter(getUpstreamFormat(i).getPixelFormat(), ImageFormat::FLITR_PIX_FMT_RGB_8, scaleFactor_));
+        if (!Converters_.back().isSupported())
+        {
+            logMessage(LOG_CRITICAL) << "FIPConvertToRGB8: Pixel format of image " << i << " is not supported.\n";
+            return false;
+        }
+    }
+    
     bool rValue=ImageProcessor::init();
     //Note: SharedImageBuffer of downstream producer is initialised with storage in ImageProcessor::init.
     
@@ -70,101 +82,7 @@ bool FIPConvertToRGB8::trigger()
             Image const * const imRead = *(imvRead[imgNum]);
             Image * const imWrite = *(imvWrite[imgNum]);
             
-            uint8_t * const dataWrite=imWrite->data();
-            
-            const ImageFormat imFormatUS=getUpstreamFormat(imgNum);
-            
-            const size_t width=imFormatUS.getWidth();
-            const size_t height=imFormatUS.getHeight();
-            
-            if (imFormatUS.getPixelFormat()==ImageFormat::FLITR_PIX_FMT_RGB_F32)
-            {
-                float const * const dataRead=(float *)imRead->data();
-                
-                for (size_t y=0; y<height; ++y)
-                {
-                    size_t offset=(y * width) * 3;
-                    
-                    for (size_t x=0; x<width; ++x)
-                    {
-                        const float R=dataRead[offset + 0]*(256.0f*scaleFactor_);
-                        const float G=dataRead[offset + 1]*(256.0f*scaleFactor_);
-                        const float B=dataRead[offset + 2]*(256.0f*scaleFactor_);
-                        
-                        dataWrite[offset + 0]=(R>=255.0f)?((uint8_t)255):((R<=0.0f)?((uint8_t)0):(R+0.5f));
-                        dataWrite[offset + 1]=(G>=255.0f)?((uint8_t)255):((G<=0.0f)?((uint8_t)0):(G+0.5f));
-                        dataWrite[offset + 2]=(B>=255.0f)?((uint8_t)255):((B<=0.0f)?((uint8_t)0):(B+0.5f));
-                        
-                        offset+=3;
-                    }
-                }
-            } else
-            if (imFormatUS.getPixelFormat()==ImageFormat::FLITR_PIX_FMT_Y_F32)
-            {
-                float const * const dataRead=(float *)imRead->data();
-                
-                for (size_t y=0; y<height; ++y)
-                {
-                    const size_t readOffset=(y * width);
-                    size_t writeOffset=readOffset * 3;
-                    
-                    for (size_t x=0; x<width; ++x)
-                    {
-                        const float I=dataRead[readOffset+x]*(256.0f*scaleFactor_);
-                        const float clampedI=(I>=255.0f)?((uint8_t)255):((I<=0.0f)?((uint8_t)0):(I+0.5f));
-                        
-                        dataWrite[writeOffset + 0]=clampedI;
-                        dataWrite[writeOffset + 1]=clampedI;
-                        dataWrite[writeOffset + 2]=clampedI;
-                        
-                        writeOffset+=3;
-                    }
-                }
-            } else
-            if (imFormatUS.getPixelFormat()==ImageFormat::FLITR_PIX_FMT_Y_8)
-            {
-                uint8_t const * const dataRead=imRead->data();
-                
-                for (size_t y=0; y<height; ++y)
-                {
-                    const size_t readOffset=(y * width);
-                    size_t writeOffset=readOffset * 3;
-                    
-                    for (size_t x=0; x<width; ++x)
-                    {
-                        const float I=dataRead[readOffset+x];
-                        const float clampedI=(I>=255)?((uint8_t)255):((I<=0)?((uint8_t)0):(I+1));
-                        
-                        dataWrite[writeOffset + 0]=clampedI;
-                        dataWrite[writeOffset + 1]=clampedI;
-                        dataWrite[writeOffset + 2]=clampedI;
-                        
-                        writeOffset+=3;
-                    }
-                }
-			} else
-            if (imFormatUS.getPixelFormat()==ImageFormat::FLITR_PIX_FMT_Y_16)
-            {
-                uint16_t const * const dataRead=(uint16_t *)imRead->data();
-                
-                for (size_t y=0; y<height; ++y)
-                {
-                    const size_t readOffset=(y * width);
-                    size_t writeOffset=readOffset * 3;
-                    
-                    for (size_t x=0; x<width; ++x)
-                    {
-                        const float I=dataRead[readOffset+x];
-                        const float clampedI=(I>=255)?((uint8_t)255):((I<=0)?((uint8_t)0):(I+1));
-                        
-                        dataWrite[writeOffset + 0]=clampedI;
-                        dataWrite[writeOffset + 1]=clampedI;
-                        dataWrite[writeOffset + 2]=clampedI;
-                        
-                        writeOffset+=3;
-                    }
-                }
-			}
+            Converters_[imgNum].convert(*imRead, *imWrite);
         }
         
         //Stop stats measurement event.
@@ -19,6 +19,7 @@
  */
 
 #include <flitr/modules/flitr_image_processors/cnvrt_to_8bit/fip_cnvrt_to_y_8.h>
+#include <flitr/log_message.h>
 
 
 using namespace flitr;
@@ -39,6 +40,11 @@ Title_("Convert To Y8")
         ImageFormat downStreamFormat(upStreamProducer.getFormat().getWidth(), upStreamProducer.getFormat().getHeight(),
                                      ImageFormat::FLITR_PIX_FMT_Y_8);
         
+        if (upStreamProducer.getFormat(i).isPlanar())
+        {//Keep the rows of the Y plane as they are, so that it can be shared.
+            downStreamFormat=upStreamProducer.getFormat(i).getLumaFormat();
+        }
+        
         ImageFormat_.push_back(downStreamFormat);
     }
     
@@ -50,6 +56,19 @@ FIPConvertToY8::~FIPConvertToY8()
 
 bool FIPConvertToY8::init()
 {
+    Converters_.clear();
+    for (uint32_t i=0; i<ImagesPerSlot_; i++)
+    {
+        const ImageFormat imFormatUS=getUpstreamFormat(i);
+        Converters_.push_back(PixelFormatConverter(imFormatUS.getPixelFormat(), ImageFormat::FLITR_PIX_FMT_Y_8, scaleFactor_));
+        if (!imFormatUS.isPlanar() && (imFormatUS.getPixelFormat()!=ImageFormat::FLITR_PIX_FMT_YUYV) &&
+            !Converters_.back().isSupported())
+        {//The Y plane of the YUV formats is taken without a converter.
+            logMessage(LOG_CRITICAL) << "FIPConvertToY8: Pixel format of image " << i << " is not supported.\n";
+            return false;
+        }
+    }
+    
     bool rValue=ImageProcessor::init();
     //Note: SharedImageBuffer of downstream producer is initialised with storage in ImageProcessor::init.
     
@@ -58,60 +77,54 @@ bool FIPConvertToY8::init()
 
 bool FIPConvertToY8::trigger()
 {
-    if ((getNumReadSlotsAvailable())&&(getNumWriteSlotsAvailable()))
-    {//There are images to consume and the downstream producer has space to produce.
-        std::vector<Image**> imvRead=reserveReadSlot();
-        std::vector<Image**> imvWrite=reserveWriteSlot();
+    return triggerFrame();
+}
+
+void FIPConvertToY8::processFrame(const std::vector<Image**>& imvRead, const std::vector<Image**>& imvWrite)
+{
+    for (size_t imgNum=0; imgNum<ImagesPerSlot_; ++imgNum)
+    {
+        Image const * const imRead = *(imvRead[imgNum]);
+        Image * const imWrite = *(imvWrite[imgNum]);
+
+        // Pass the metadata from the read image to the write image.
+        // By Default the base implementation will copy the pointer if no custom
+        // pass function was set.
+        if(PassMetadataFunction_ != nullptr)
+        {
+            imWrite->setMetadata(PassMetadataFunction_(imRead->metadata()));
+        }
         
-        //Start stats measurement event.
-        ProcessorStats_->tick();
+        const ImageFormat imFormatUS=getUpstreamFormat(imgNum);
         
-        for (size_t imgNum=0; imgNum<ImagesPerSlot_; ++imgNum)
-        {
-            Image const * const imRead = *(imvRead[imgNum]);
-            Image * const imWrite = *(imvWrite[imgNum]);
-
-            // Pass the metadata from the read image to the write image.
-            // By Default the base implementation will copy the pointer if no custom
-            // pass function was set.
-            if(PassMetadataFunction_ != nullptr)
+        const size_t width=imFormatUS.getWidth();
+        const size_t height=imFormatUS.getHeight();
+        
+        if (imFormatUS.isPlanar())
+        {//The Y plane comes first, so the downstream image refers to it without copying.
+            if (!imWrite->shareDataFrom(*imRead))
             {
-                imWrite->setMetadata(PassMetadataFunction_(imRead->metadata()));
+                for (size_t y=0; y<height; ++y)
+                {
+                    memcpy(imWrite->line(uint32_t(y)), imRead->line(uint32_t(y)), width);
+                }
             }
-            
-            uint8_t * const dataWrite=imWrite->data();
-            
-            const ImageFormat imFormatUS=getUpstreamFormat(imgNum);
-            
-            const size_t width=imFormatUS.getWidth();
-            const size_t height=imFormatUS.getHeight();
-            
-            if (imFormatUS.getPixelFormat()==ImageFormat::FLITR_PIX_FMT_Y_F32)
+        } else if (imFormatUS.getPixelFormat()==ImageFormat::FLITR_PIX_FMT_YUYV)
+        {
+            for (size_t y=0; y<height; ++y)
             {
-                float const * const dataRead=(float *)imRead->data();
+                uint8_t const * const lineRead=imRead->line(uint32_t(y));
+                uint8_t * const lineWrite=imWrite->line(uint32_t(y));
                 
-                for (size_t y=0; y<height; ++y)
+                for (size_t x=0; x<width; ++x)
                 {
-                    const size_t lineOffset=y * width;
-                    
-                    for (size_t x=0; x<width; ++x)
-                    {
-                        const float writeValue=dataRead[lineOffset + x]*(256.0f*scaleFactor_);
-                        dataWrite[lineOffset + x]=(writeValue>=255.0f)?((uint8_t)255):((writeValue<=0.0f)?((uint8_t)0):(writeValue+0.5f));
-                    }
+                    lineWrite[x]=lineRead[x*2];
                 }
             }
+        } else
+        {
+            Converters_[imgNum].convert(*imRead, *imWrite);
         }
-        
-        //Stop stats measurement event.
-        ProcessorStats_->tock();
-        
-        releaseWriteSlot();
-        releaseReadSlot();
-        
-        return true;
     }
-    
-    return false;
 }
 
@@ -19,6 +19,7 @@
  */
 
 #include <flitr/modules/flitr_image_processors/cnvrt_to_float/fip_cnvrt_to_rgb_f32.h>
+#include <flitr/log_message.h>
 
 using namespace flitr;
 using std::shared_ptr;
@@ -46,6 +47,17 @@ FIPConvertToRGBF32::~FIPConvertToRGBF32()
 
 bool FIPConvertToRGBF32::init()
 {
+    Converters_.clear();
+    for (uint32_t i=0; i<ImagesPerSlot_; i++)
+    {
+        Converters_.push_back(PixelFormatConverter(getUpstreamFormat(i).getPixelFormat(), ImageFormat::FLITR_PIX_FMT_RGB_F32));
+        if (!Converters_.back().isSupported())
+        {
+            logMessage(LOG_CRITICAL) << "FIPConvertToRGBF32: Pixel format of image " << i << " is not supported.\n";
+            return false;
+        }
+    }
+    
     bool rValue=ImageProcessor::init();
     //Note: SharedImageBuffer of downstream producer is initialised with storage in ImageProcessor::init.
     
@@ -67,64 +79,7 @@ bool FIPConvertToRGBF32::trigger()
             Image const * const imRead = *(imvRead[imgNum]);
             Image * const imWrite = *(imvWrite[imgNum]);
             
-            uint8_t const * const dataRead=imRead->data();
-            
-            float * const dataWrite=(float *)imWrite->data();
-            
-            const ImageFormat imFormatUS=getUpstreamFormat(imgNum);
-            
-            const size_t width=imFormatUS.getWidth();
-            const size_t height=imFormatUS.getHeight();
-
-            if (imFormatUS.getPixelFormat()==flitr::ImageFormat::FLITR_PIX_FMT_Y_8)
-            {
-                for (size_t y=0; y<height; ++y)
-                {
-                    const size_t lineOffset=y * width;
-                    size_t writeOffset=lineOffset*3;
-
-                    for (size_t x=0; x<width; ++x)
-                    {
-                        const float fc=((float)dataRead[lineOffset + x]) * 0.00390625f; // /256.0
-                        dataWrite[writeOffset + 0]=fc;
-                        dataWrite[writeOffset + 1]=fc;
-                        dataWrite[writeOffset + 2]=fc;
-                        writeOffset+=3;
-                    }
-                }
-            } else
-                if (imFormatUS.getPixelFormat()==flitr::ImageFormat::FLITR_PIX_FMT_RGB_8)
-                {
-                    for (size_t y=0; y<height; ++y)
-                    {
-                        size_t offset=(y * width) * 3;
-
-                        for (size_t x=0; x<width; ++x)
-                        {
-                            dataWrite[offset + 0]=((float)dataRead[offset+0]) * 0.00390625f; // /256.0
-                            dataWrite[offset + 1]=((float)dataRead[offset+1]) * 0.00390625f; // /256.0
-                            dataWrite[offset + 2]=((float)dataRead[offset+2]) * 0.00390625f; // /256.0
-                            offset+=3;
-                        }
-                    }
-            } else
-                if (imFormatUS.getPixelFormat()==flitr::ImageFormat::FLITR_PIX_FMT_BGRA)
-                {
-                    for (size_t y=0; y<height; ++y)
-                    {
-                        size_t offset=(y * width) * 4;
-                        size_t offset_rgb = (y * width) * 3;
-
-                        for (size_t x=0; x<width; ++x)
-                        {
-                            dataWrite[offset_rgb + 2]=((float)dataRead[offset+0]) * 0.00390625f; // /256.0
-                            dataWrite[offset_rgb + 1]=((float)dataRead[offset+1]) * 0.00390625f; // /256.0
-                            dataWrite[offset_rgb + 0]=((float)dataRead[offset+2]) * 0.00390625f; // /256.0
-                            offset+=4;
-                            offset_rgb+=3;
-                        }
-                    }
-                }
+            Converters_[imgNum].convert(*imRead, *imWrite);
         }
         
         //Stop stats measurement event.
@@ -19,6 +19,7 @@
  */
 
 #include <flitr/modules/flitr_image_processors/cnvrt_to_float/fip_cnvrt_to_y_f32.h>
+#include <flitr/log_message.h>
 
 using namespace flitr;
 using std::shared_ptr;
@@ -45,6 +46,17 @@ FIPConvertToYF32::~FIPConvertToYF32()
 
 bool FIPConvertToYF32::init()
 {
+    Converters_.clear();
+    for (uint32_t i=0; i<ImagesPerSlot_; i++)
+    {
+        Converters_.push_back(PixelFormatConverter(getUpstreamFormat(i).getPixelFormat(), ImageFormat::FLITR_PIX_FMT_Y_F32));
+        if (!Converters_.back().isSupported())
+        {
+            logMessage(LOG_CRITICAL) << "FIPConvertToYF32: Pixel format of image " << i << " is not supported.\n";
+            return false;
+        }
+    }
+    
     bool rValue=ImageProcessor::init();
     //Note: SharedImageBuffer of downstream producer is initialised with storage in ImageProcessor::init.
     
@@ -74,58 +86,7 @@ bool FIPConvertToYF32::trigger()
                 imWrite->setMetadata(PassMetadataFunction_(imRead->metadata()));
             }
             
-            float * const dataWrite=(float *)imWrite->data();
-            
-            const ImageFormat imFormatUS=getUpstreamFormat(imgNum);
-            
-            const size_t width=imFormatUS.getWidth();
-            const size_t height=imFormatUS.getHeight();
-
-            if (imFormatUS.getPixelFormat()==flitr::ImageFormat::FLITR_PIX_FMT_Y_8)
-            {
-				uint8_t const * const dataRead=imRead->data();
-                for (size_t y=0; y<height; ++y)
-                {
-                    const size_t lineOffset=y * width;
-
-                    for (size_t x=0; x<width; ++x)
-                    {
-                        dataWrite[lineOffset + x]=((float)dataRead[lineOffset + x]) * 0.00390625f; // /256.0
-                    }
-                }
-            } else
-                if (imFormatUS.getPixelFormat()==flitr::ImageFormat::FLITR_PIX_FMT_RGB_8)
-                {
-					uint8_t const * const dataRead=imRead->data();
-                    for (size_t y=0; y<height; ++y)
-                    {
-                        const size_t lineOffset=y * width;
-                        size_t readOffset=lineOffset*3;
-
-                        for (size_t x=0; x<width; ++x)
-                        {
-                            float dw=((float)dataRead[readOffset]) * (0.00390625f*0.33333333333f); // /(256.0*3.0)
-                            dw+=((float)dataRead[readOffset+1]) * (0.00390625f*0.33333333333f); // /(256.0*3.0)
-                            dw+=((float)dataRead[readOffset+2]) * (0.00390625f*0.33333333333f); // /(256.0*3.0)
-                            
-                            dataWrite[lineOffset + x]=dw;
-                            readOffset+=3;
-                        }
-                    }
-                } else
-		            if (imFormatUS.getPixelFormat()==flitr::ImageFormat::FLITR_PIX_FMT_Y_16)
-		            {
-						uint16_t const * const dataRead=(uint16_t *)imRead->data();
-		                for (size_t y=0; y<height; ++y)
-						{
-						    const size_t lineOffset=y * width;
-
-						    for (size_t x=0; x<width; ++x)
-						    {
-						        dataWrite[lineOffset + x]=((float)dataRead[lineOffset + x]) * 0.000015259f; // /655636.0
-						    }
-						}
-		            }
+            Converters_[imgNum].convert(*imRead, *imWrite);
         }
         
         //Stop stats measurement event.
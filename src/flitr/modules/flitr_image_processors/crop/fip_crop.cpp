@@ -46,6 +46,8 @@ height_(height)
     {
         ImageFormat dsFormat=upStreamProducer.getFormat(i);
         
+        //Keep the upstream line size, so that trigger() can refer to the cropped upstream rows instead of copying them.
+        dsFormat.setBytesPerLine(dsFormat.getBytesPerLine());
         dsFormat.setWidth(width_);
         dsFormat.setHeight(height_);
         
@@ -89,25 +91,34 @@ bool FIPCrop::trigger()
                 imWrite->setMetadata(PassMetadataFunction_(imRead->metadata()));
             }
             
-            uint8_t const * const dataRead=(uint8_t const * const)imRead->data();
-            uint8_t * const dataWrite=(uint8_t * const )imWrite->data();
-            
             //US and DS pixel formats are the same, but the image sizes are not.
             const ImageFormat imFormatUS=getUpstreamFormat(imgNum);
             const ImageFormat imFormatDS=getDownstreamFormat(imgNum);
             
             const size_t bytesPerPixel=imFormatDS.getBytesPerPixel();
             
-            const size_t widthUS=imFormatUS.getWidth();
+            const size_t bytesPerLineUS=imFormatUS.getBytesPerLine();
+            const size_t bytesPerLineDS=imFormatDS.getBytesPerLine();
             
             const size_t widthDS=imFormatDS.getWidth();
             const size_t heightDS=imFormatDS.getHeight();
             
+            const size_t cropOffsetUS=startY_ * bytesPerLineUS + startX_ * bytesPerPixel;
+            
+            if ((bytesPerLineDS==bytesPerLineUS) &&
+                imWrite->shareDataFrom(*imRead, cropOffsetUS))
+            {//The rows are equally far apart, so the downstream image refers to the upstream rows without copying.
+                continue;
+            }
+            
+            uint8_t const * const dataRead=(uint8_t const * const)imRead->data();
+            uint8_t * const dataWrite=(uint8_t * const )imWrite->data();
+            
             //Works for all pixel formats!
             for (size_t yDS=0; yDS<heightDS; ++yDS)
             {
-                const size_t lineOffsetUS=((yDS+startY_) * widthUS + startX_) * bytesPerPixel;
-                const size_t lineOffsetDS=(yDS * widthDS) * bytesPerPixel;
+                const size_t lineOffsetUS=cropOffsetUS + yDS * bytesPerLineUS;
+                const size_t lineOffsetDS=yDS * bytesPerLineDS;
                 
                 memcpy(dataWrite+lineOffsetDS, dataRead+lineOffsetUS, widthDS * bytesPerPixel);
             }
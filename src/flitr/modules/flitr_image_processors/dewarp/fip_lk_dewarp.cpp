@@ -19,6 +19,7 @@
  */
 
 #include <flitr/modules/flitr_image_processors/dewarp/fip_lk_dewarp.h>
+#include <flitr/log_message.h>
 
 #include <iostream>
 #include <fstream>
@@ -40,8 +41,9 @@ _title(std::string("LK Dewarp")),
 avrgImageLongevity_(avrgImageLongevity),
 recipGradientThreshold_(1.0f / 0.00025f),
 numLevels_(5),//Num levels searched for scint motion.
+upstreamPyramid_(nullptr),
+pyramid_(nullptr),
 gaussianFilter_(0.5f, 3),
-gaussianDownsample_(0.5f, 2),
 gaussianReguFilter_(2.5f, 11),
 scratchData_(0),
 inputImgDataR_(0),
@@ -60,6 +62,32 @@ finalImgDataB_(0)
     }
 }
 
+FIPLKDewarp::FIPLKDewarp(FIPGaussianPyramid& upStreamPyramid,
+                         const float avrgImageLongevity,
+                         uint32_t buffer_size) :
+ImageProcessor(upStreamPyramid, 1, buffer_size),
+_enabled(true),
+_title(std::string("LK Dewarp")),
+avrgImageLongevity_(avrgImageLongevity),
+recipGradientThreshold_(1.0f / 0.00025f),
+numLevels_(5),//Num levels searched for scint motion.
+upstreamPyramid_(&upStreamPyramid),
+pyramid_(nullptr),
+gaussianFilter_(0.5f, 3),
+gaussianReguFilter_(2.5f, 11),
+scratchData_(0),
+inputImgDataR_(0),
+inputImgDataG_(0),
+inputImgDataB_(0),
+finalImgDataR_(0),
+finalImgDataG_(0),
+finalImgDataB_(0)
+{
+    ProcessorStats_->setID("ImageProcessor::FIPLKDewarp");
+    //Setup image format being produced to downstream.
+    ImageFormat_.push_back(upStreamPyramid.getDownstreamFormat(upStreamPyramid.getSourceIndex(0)));
+}
+
 FIPLKDewarp::~FIPLKDewarp()
 {
     // First stop the trigger thread. The stopTriggerThread() function will
@@ -83,28 +111,19 @@ FIPLKDewarp::~FIPLKDewarp()
     delete [] inputImgDataG_;
     delete [] inputImgDataB_;
     
-    for (size_t levelNum=0; levelNum<numLevels_; ++levelNum)
+    delete pyramid_;
+    
+    for (size_t levelNum=0; levelNum<refImgVec_.size(); ++levelNum)
     {
-        delete [] imgVec_.back();
-        imgVec_.pop_back();
-        
-        delete [] refImgVec_.back();
-        refImgVec_.pop_back();
-        
-        delete [] dxVec_.back();
-        dxVec_.pop_back();
-        
-        delete [] dyVec_.back();
-        dyVec_.pop_back();
-        
-        delete [] dSqRecipVec_.back();
-        dSqRecipVec_.pop_back();
-        
-        delete [] hxVec_.back();
-        hxVec_.pop_back();
-        
-        delete [] hyVec_.back();
-        hyVec_.pop_back();
+        delete [] refImgVec_[levelNum];
+        delete [] dSqRecipVec_[levelNum];
+    }
+    
+    //hxVec_ and hyVec_ have an extra zero level.
+    for (size_t levelNum=0; levelNum<hxVec_.size(); ++levelNum)
+    {
+        delete [] hxVec_[levelNum];
+        delete [] hyVec_[levelNum];
     }
     
     //delete [] avrgHxData_;
@@ -113,6 +132,13 @@ FIPLKDewarp::~FIPLKDewarp()
 
 bool FIPLKDewarp::init()
 {
+    if ((upstreamPyramid_!=nullptr) &&
+        ((!upstreamPyramid_->hasGradients()) || (upstreamPyramid_->getNumLevels()<numLevels_)))
+    {
+        logMessage(LOG_CRITICAL) << "FIPLKDewarp: The upstream pyramid must have gradients and at least " << numLevels_ << " levels.\n";
+        return false;
+    }
+    
     bool rValue=ImageProcessor::init();
     //Note: SharedImageBuffer of downstream producer is initialised with storage in ImageProcessor::init.
     
@@ -124,12 +150,19 @@ bool FIPLKDewarp::init()
         const ptrdiff_t height=imFormat.getHeight();
         
         //=== Image will be cropped so that at least all levels of the pyramid is divisible by 2 ===
-        const ptrdiff_t croppedWidth=(width>>(numLevels_-1))<<(numLevels_-1);
-        const ptrdiff_t croppedHeight=(height>>(numLevels_-1))<<(numLevels_-1);
-        //const ptrdiff_t croppedWidth=1 << ((int)log2f(width));
-        //const ptrdiff_t croppedHeight=1 << ((int)log2f(height));
+        //The upstream pyramid's crop is a multiple of a larger power of 2.
+        const ImageFormat levelFormat=(upstreamPyramid_!=nullptr) ? getUpstreamFormat(upstreamPyramid_->getLevelIndex(imgNum, 0)) :
+            ImageFormat((width>>(numLevels_-1))<<(numLevels_-1), (height>>(numLevels_-1))<<(numLevels_-1), ImageFormat::FLITR_PIX_FMT_Y_F32);
+        const ptrdiff_t croppedWidth=levelFormat.getWidth();
+        const ptrdiff_t croppedHeight=levelFormat.getHeight();
         //=== ===
         
+        if (upstreamPyramid_==nullptr)
+        {
+            //Each level is the 2x2 average of the one above, i.e. GaussianDownsample(0.5f, 2).
+            pyramid_=new GaussianPyramid(croppedWidth, croppedHeight, numLevels_, true, std::vector<float>(2, 0.5f));
+        }
+        
         scratchData_=new float[width*height];
         memset(scratchData_, 0, (width*height)*sizeof(float));
         
@@ -149,18 +182,9 @@ bool FIPLKDewarp::init()
         
         for (size_t levelNum=0; levelNum<numLevels_; ++levelNum)
         {
-            imgVec_.push_back(new float[(croppedWidth>>levelNum) * (croppedHeight>>levelNum)]);
-            memset(imgVec_.back(), 0, (croppedWidth>>levelNum) * (croppedHeight>>levelNum) * sizeof(float));
-            
             refImgVec_.push_back(new float[(croppedWidth>>levelNum) * (croppedHeight>>levelNum)]);
             memset(refImgVec_.back(), 0, (croppedWidth>>levelNum) * (croppedHeight>>levelNum) * sizeof(float));
             
-            dxVec_.push_back(new float[(croppedWidth>>levelNum) * (croppedHeight>>levelNum)]);
-            memset(dxVec_.back(), 0, (croppedWidth>>levelNum) * (croppedHeight>>levelNum) * sizeof(float));
-            
-            dyVec_.push_back(new float[(croppedWidth>>levelNum) * (croppedHeight>>levelNum)]);
-            memset(dyVec_.back(), 0, (croppedWidth>>levelNum) * (croppedHeight>>levelNum) * sizeof(float));
-            
             dSqRecipVec_.push_back(new float[(croppedWidth>>levelNum) * (croppedHeight>>levelNum)]);
             memset(dSqRecipVec_.back(), 0, (croppedWidth>>levelNum) * (croppedHeight>>levelNum) * sizeof(float));
             
@@ -214,21 +238,18 @@ bool FIPLKDewarp::trigger()
             const ImageFormat imFormat=getUpstreamFormat(imgNum);
             
             if (!_enabled)
-            {//Pass not enabled! Just copy the data from input to output.
-                uint8_t const * const dataReadUS=(uint8_t const * const)imRead->data();
-                uint8_t * const dataWriteDS=(uint8_t * const)imWrite->data();
-                const size_t bytesPerImage=imFormat.getBytesPerImage();
-                memcpy(dataWriteDS, dataReadUS, bytesPerImage);
+            {//Pass not enabled! Pass the upstream data on without copying.
+                imWrite->shareDataFrom(*imRead);
             } else
             {//Pass enabled...
                 const ptrdiff_t uncroppedWidth=imFormat.getWidth();
                 const ptrdiff_t uncroppedHeight=imFormat.getHeight();
                 
-                //=== Image will be cropped so that at least all levels of the pyramid is divisible by 2 ===
-                const ptrdiff_t croppedWidth=(uncroppedWidth>>(numLevels_-1))<<(numLevels_-1);
-                const ptrdiff_t croppedHeight=(uncroppedHeight>>(numLevels_-1))<<(numLevels_-1);
-                //const ptrdiff_t croppedWidth=1 << ((int)log2f(uncroppedWidth));
-                //const ptrdiff_t croppedHeight=1 << ((int)log2f(uncroppedHeight));
+                //=== Image is cropped so that at least all levels of the pyramid is divisible by 2 ===
+                const ImageFormat levelFormat=(upstreamPyramid_!=nullptr) ? getUpstreamFormat(upstreamPyramid_->getLevelIndex(imgNum, 0)) :
+                    ImageFormat(pyramid_->getLevelWidth(0), pyramid_->getLevelHeight(0), ImageFormat::FLITR_PIX_FMT_Y_F32);
+                const ptrdiff_t croppedWidth=levelFormat.getWidth();
+                const ptrdiff_t croppedHeight=levelFormat.getHeight();
                 //=== ===
                 
                 const ptrdiff_t startCroppedX=(uncroppedWidth - croppedWidth)>>1;
@@ -241,31 +262,8 @@ bool FIPLKDewarp::trigger()
                     float const * const dataRead=(float const * const)imRead->data();
                     float * const dataWrite=(float * const)imWrite->data();
                     
-                    //****************
-                    //Prime the reference image during the first couple of frames.
-                    const float avrgImageLongevityConst = (frameNumber_ < 3) ? 0.0f : avrgImageLongevity_;
-                    //****************
-                    
                     {//=== ===
                         
-                        {//=== Update ref/avrg img before new data arrives. ===//
-                            float * const imgData=imgVec_[0];
-                            float * const refImgData=refImgVec_[0];
-                            
-                            for (ptrdiff_t y=0; y<croppedHeight; ++y)
-                            {
-                                const ptrdiff_t lineOffset=y*croppedWidth;
-                                
-                                for (ptrdiff_t x=0; x<croppedWidth; ++x)
-                                {
-                                    const ptrdiff_t offset=lineOffset + x;
-                                    
-                                    refImgData[offset]*=avrgImageLongevityConst;
-                                    refImgData[offset]+=imgData[offset] * (1.0f - avrgImageLongevityConst);
-                                }
-                            }
-                        }
-                        
                         //=== Crop input data ===//
                         if (imFormat.getPixelFormat()==flitr::ImageFormat::FLITR_PIX_FMT_Y_F32)
                         {
@@ -295,102 +293,48 @@ bool FIPLKDewarp::trigger()
                                 }
                             }
                         
+                    }//=== ===
+                    
+                    std::vector<float const *> imgVec(numLevels_);
+                    std::vector<float const *> dxVec(numLevels_);
+                    std::vector<float const *> dyVec(numLevels_);
+                    
+                    if (upstreamPyramid_!=nullptr)
+                    {//=== Use the scale space pyramid of the upstream producer ===
+                        for (size_t levelNum=0; levelNum<numLevels_; ++levelNum)
+                        {
+                            imgVec[levelNum]=(float const *)(*(imvRead[upstreamPyramid_->getLevelIndex(imgNum, levelNum)]))->data();
+                            dxVec[levelNum]=(float const *)(*(imvRead[upstreamPyramid_->getLevelIndex(imgNum, levelNum, FIPGaussianPyramid::Plane::DX)]))->data();
+                            dyVec[levelNum]=(float const *)(*(imvRead[upstreamPyramid_->getLevelIndex(imgNum, levelNum, FIPGaussianPyramid::Plane::DY)]))->data();
+                        }
+                    } else
+                    {//=== Calculate scale space pyramid ===
                         //=== Do Gaussian filter of initial input and store in first level of pyramid - Green channel is used for optical flow! ===//
-                        gaussianFilter_.filter(imgVec_[0], inputImgDataG_, croppedWidth, croppedHeight, scratchData_);
+                        gaussianFilter_.filter(pyramid_->getLevel(0), inputImgDataG_, croppedWidth, croppedHeight, scratchData_);
                         
+                        pyramid_->update(MaxRowBands_);
+                        
+                        for (size_t levelNum=0; levelNum<numLevels_; ++levelNum)
+                        {
+                            imgVec[levelNum]=pyramid_->getLevel(levelNum);
+                            dxVec[levelNum]=pyramid_->getDx(levelNum);
+                            dyVec[levelNum]=pyramid_->getDy(levelNum);
+                        }
                     }//=== ===
                     
-                    {//=== Calculate scale space pyramid. ===
-                        for (size_t levelNum=0; levelNum<numLevels_; ++levelNum)
+                    for (size_t levelNum=0; levelNum<numLevels_; ++levelNum)
+                    {//=== Reciprocal of the squared gradient magnitude ===
+                        float const * const dxData=dxVec[levelNum];
+                        float const * const dyData=dyVec[levelNum];
+                        float * const dSqRecipData=dSqRecipVec_[levelNum];
+                        
+                        const size_t levelSize=(croppedWidth>>levelNum) * (croppedHeight>>levelNum);
+                        
+                        for (size_t offset=0; offset<levelSize; ++offset)
                         {
-                            float * const imgData=imgVec_[levelNum];
-                            //float * const refImgData=refImgVec_[levelNum];
-                            
-                            const ptrdiff_t levelHeight=croppedHeight >> levelNum;
-                            const ptrdiff_t levelWidth=croppedWidth >> levelNum;
-                            const ptrdiff_t levelWidthMinus1 = levelWidth - ((ptrdiff_t)1);
-                            
-                            //=== Calculate the scale space images ===
-                            if (levelNum>0)//First level (incoming data) is not a downsampled image.
-                            {
-                                {//Update ref/avrg img before new data arrives.
-                                    float * const refImgData=refImgVec_[levelNum];
-                                    
-                                    for (ptrdiff_t y=0; y<levelHeight; ++y)
-                                    {
-                                        const ptrdiff_t lineOffset=y*levelWidth;
-                                        
-                                        for (ptrdiff_t x=0; x<levelWidth; ++x)
-                                        {
-                                            const ptrdiff_t offset=lineOffset + x;
-                                            
-                                            refImgData[offset]*=avrgImageLongevityConst;
-                                            refImgData[offset]+=imgData[offset] * (1.0f - avrgImageLongevityConst);
-                                        }
-                                    }
-                                }
-                                
-                                {//Downsample higher resolution level.
-                                    const ptrdiff_t heightUS=croppedHeight >> (levelNum-1);
-                                    const ptrdiff_t widthUS=croppedWidth >> (levelNum-1);
-                                    
-                                    gaussianDownsample_.downsample(imgData, imgVec_[levelNum-1],
-                                                                   widthUS, heightUS,
-                                                                   scratchData_);
-                                }//=== ===
-                                
-                            }//=== ===
-                            
-                            
-                            {//=== Calculate scale space gradient images ===
-                                float * const dxData=dxVec_[levelNum];
-                                float * const dyData=dyVec_[levelNum];
-                                float * const dSqRecipData=dSqRecipVec_[levelNum];
-                                
-                                for (ptrdiff_t y=1; y<(levelHeight - ((ptrdiff_t)1)); ++y)
-                                {
-                                    const ptrdiff_t lineOffset=y*levelWidth;
-                                    
-                                    for (ptrdiff_t x=((ptrdiff_t)1); x<levelWidthMinus1; ++x)
-                                    {
-                                        const ptrdiff_t offset=lineOffset + x;
-                                        
-                                        //#define DESCINT_SCATTER
-                                        
-#ifdef DESCINT_SCATTER
-                                        DESCINT_SCATTER CODE NOT REALLY USED
-                                        
-                                        const float v1=refImgData[offset-levelWidth-1];
-                                        const float v2=refImgData[offset-levelWidth];
-                                        const float v3=refImgData[offset-levelWidth+1];
-                                        const float v4=refImgData[offset-1];
-                                        //const float v5=refImgData[offset];
-                                        const float v6=refImgData[offset+1];
-                                        const float v7=refImgData[offset+levelWidth-1];
-                                        const float v8=refImgData[offset+levelWidth];
-                                        const float v9=refImgData[offset+levelWidth+1];
-#else//DESCINT_GATHER
-                                        const float v1=imgData[offset-levelWidth-1];
-                                        const float v2=imgData[offset-levelWidth];
-                                        const float v3=imgData[offset-levelWidth+1];
-                                        const float v4=imgData[offset-1];
-                                        //const float v5=imgData[offset];
-                                        const float v6=imgData[offset+1];
-                                        const float v7=imgData[offset+levelWidth-1];
-                                        const float v8=imgData[offset+levelWidth];
-                                        const float v9=imgData[offset+levelWidth+1];
-#endif
-                                        
-                                        //Use Scharr operator for image gradient. It has good rotation independence!
-                                        const float dx=(v3-v1)*(3.0f/32.0f) + (v6-v4)*(10.0f/32.0f) + (v9-v7)*(3.0f/32.0f); //32 = (3+10+3)*2
-                                        const float dy=(v7-v1)*(3.0f/32.0f) + (v8-v2)*(10.0f/32.0f) + (v9-v3)*(3.0f/32.0f); //32 = (3+10+3)*2
-                                        
-                                        dxData[offset]=dx;
-                                        dyData[offset]=dy;
-                                        dSqRecipData[offset]=1.0f/(dx*dx+dy*dy);
-                                    }
-                                }
-                            }//=== ===
+                            const float dx=dxData[offset];
+                            const float dy=dyData[offset];
+                            dSqRecipData[offset]=1.0f/(dx*dx+dy*dy);
                         }
                     }//=== ===
                     
@@ -402,11 +346,11 @@ bool FIPLKDewarp::trigger()
                     
                     for (ptrdiff_t levelNum=(numLevels_-1); levelNum>=0; --levelNum)
                     {
-                        float const * const imgData=imgVec_[levelNum];
+                        float const * const imgData=imgVec[levelNum];
                         float const * const refImgData=refImgVec_[levelNum];
                         
-                        float const * const dxData=dxVec_[levelNum];
-                        float const * const dyData=dyVec_[levelNum];
+                        float const * const dxData=dxVec[levelNum];
+                        float const * const dyData=dyVec[levelNum];
                         float const * const dSqRecipData=dSqRecipVec_[levelNum];
                         
                         float * const hxData=hxVec_[levelNum];
@@ -642,10 +586,10 @@ bool FIPLKDewarp::trigger()
                                     //finalImgDataG_[offset]=sqrtf(hxB*hxB+hyB*hyB)*0.1f;
                                     //finalImgDataB_[offset]=sqrtf(hxB*hxB+hyB*hyB)*0.1f;
                                     
-                                    //finalImgDataR_[offset]=imgVec_[levelIndex][offsetB];
+                                    //finalImgDataR_[offset]=imgVec[levelIndex][offsetB];
                                     //finalImgDataR_[offset]=refImgVec_[levelIndex][offsetB];
                                     
-                                    finalImgDataR_[offset]=(imgVec_[levelIndex][offsetB] - refImgVec_[levelIndex][offsetB])*100.0f+0.5f;
+                                    finalImgDataR_[offset]=(imgVec[levelIndex][offsetB] - refImgVec_[levelIndex][offsetB])*100.0f+0.5f;
                                 }
                             }
                         }
@@ -680,6 +624,27 @@ bool FIPLKDewarp::trigger()
                         }
                         //=== ===//
                     }
+                    
+                    {//=== Update ref/avrg img with this frame's levels, for the next frame. ===//
+                        //****************
+                        //Prime the reference image during the first couple of frames.
+                        const float avrgImageLongevityConst = ((frameNumber_+1) < 3) ? 0.0f : avrgImageLongevity_;
+                        //****************
+                        
+                        for (size_t levelNum=0; levelNum<numLevels_; ++levelNum)
+                        {
+                            float const * const imgData=imgVec[levelNum];
+                            float * const refImgData=refImgVec_[levelNum];
+                            
+                            const size_t levelSize=(croppedWidth>>levelNum) * (croppedHeight>>levelNum);
+                            
+                            for (size_t offset=0; offset<levelSize; ++offset)
+                            {
+                                refImgData[offset]*=avrgImageLongevityConst;
+                                refImgData[offset]+=imgData[offset] * (1.0f - avrgImageLongevityConst);
+                            }
+                        }
+                    }//=== ===//
                 }
             }
         }
@@ -87,8 +87,8 @@ bool FIPFlip::trigger()
 
 
             if ((!flipLeftRightVect_[imgNum]) && (!flipTopBottomVect_[imgNum]))
-            {
-                memcpy(dataWrite, dataRead, width*height*bytesPerPixel);
+            {//Nothing to flip, pass the upstream data on without copying.
+                imWrite->shareDataFrom(*imRead);
             } else
                 if ((flipLeftRightVect_[imgNum]) && (!flipTopBottomVect_[imgNum]))
                 {
@@ -110,17 +110,10 @@ bool FIPFlip::trigger()
                     if ((!flipLeftRightVect_[imgNum]) && (flipTopBottomVect_[imgNum]))
                     {
                         //=== Flip top-bottom ===//
+                        const int rowBytes=width*bytesPerPixel;
                         for (int y=0; y<height; ++y)
                         {
-                            int readOffset=(y*width)*bytesPerPixel;
-                            int writeOffset=((height-y-1)*width)*bytesPerPixel;
-
-                            for (int x=0; x<width; ++x)
-                            {
-                                memcpy(dataWrite+writeOffset, dataRead+readOffset, bytesPerPixel);
-                                readOffset+=bytesPerPixel;
-                                writeOffset+=bytesPerPixel;
-                            }
+                            memcpy(dataWrite+(height-y-1)*rowBytes, dataRead+y*rowBytes, rowBytes);
                         }
                         //=======================//
                     } else
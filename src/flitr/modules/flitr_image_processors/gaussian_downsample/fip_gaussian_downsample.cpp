@@ -28,7 +28,6 @@ FIPGaussianDownsample::FIPGaussianDownsample(ImageProducer& upStreamProducer, ui
                                              const size_t kernelWidth,
                                              uint32_t buffer_size) :
 ImageProcessor(upStreamProducer, images_per_slot, buffer_size),
-xFiltData_(nullptr),
 gaussianDownsample_(filterRadius, kernelWidth)
 {
     
@@ -45,7 +44,6 @@ gaussianDownsample_(filterRadius, kernelWidth)
 
 FIPGaussianDownsample::~FIPGaussianDownsample()
 {
-    delete [] xFiltData_;
 }
 
 
@@ -64,28 +62,6 @@ bool FIPGaussianDownsample::init()
     bool rValue=ImageProcessor::init();
     //Note: SharedImageBuffer of downstream producer is initialised with storage in ImageProcessor::init.
     
-    size_t maxXFiltDataSize=0;
-    
-    for (uint32_t i=0; i<ImagesPerSlot_; i++)
-    {
-        const ImageFormat imFormat=getUpstreamFormat(i);
-        
-        const size_t width=imFormat.getWidth();
-        const size_t height=imFormat.getHeight();
-        
-        const size_t componentsPerPixel=imFormat.getComponentsPerPixel();
-        
-        const size_t xFiltDataSize = (width/2+1) * height * componentsPerPixel;
-        
-        if (xFiltDataSize>maxXFiltDataSize)
-        {
-            maxXFiltDataSize=xFiltDataSize;
-        }
-    }
-    
-    //Allocate a buffer big enough for the biggest of the image slots.
-    xFiltData_=new float[maxXFiltDataSize];
-
     return rValue;
 }
 
@@ -117,7 +93,7 @@ bool FIPGaussianDownsample::trigger()
                 float const * const dataReadUS=(float const * const)imReadUS->data();
                 float * const dataWriteDS=(float * const)imWriteDS->data();
 
-                gaussianDownsample_.downsample(dataWriteDS, dataReadUS, widthUS, heightUS, xFiltData_);
+                gaussianDownsample_.downsample(dataWriteDS, dataReadUS, widthUS, heightUS, nullptr);
             }
         }
         
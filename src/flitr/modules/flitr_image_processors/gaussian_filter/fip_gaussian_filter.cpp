@@ -33,6 +33,8 @@ ImageProcessor(upStreamProducer, images_per_slot, buffer_size),
 _approxIterations(approxIterations),
 _scratchData(nullptr),
 _gaussianFilter(filterRadius, kernelWidth),
+_useRecursive(false),
+_recursiveFilter(filterRadius),
 #ifdef APPROX_GAUSS_FILT_USE_INTEGRAL_IMAGES
 _intImageScratchData(nullptr),
 #endif
@@ -73,6 +75,7 @@ FIPGaussianFilter::~FIPGaussianFilter()
 void FIPGaussianFilter::setFilterRadius(const float filterRadius)
 {
     _gaussianFilter.setFilterRadius(filterRadius);
+    _recursiveFilter.setFilterRadius(filterRadius);
 }
 
 void FIPGaussianFilter::setKernelWidth(const int kernelWidth)
@@ -87,7 +90,7 @@ bool FIPGaussianFilter::init()
     //Note: SharedImageBuffer of downstream producer is initialised with storage in ImageProcessor::init.
     
     size_t maxScratchDataSize=0;
-    size_t maxScratchDataValues=0;
+    size_t maxIntImageSize=0;
     
     for (uint32_t i=0; i<ImagesPerSlot_; i++)
     {
@@ -100,16 +103,17 @@ bool FIPGaussianFilter::init()
         const size_t componentsPerPixel=imFormat.getComponentsPerPixel();
         
         const size_t scratchDataSize = width * height * bytesPerPixel;
-        const size_t scratchDataValues = width * height * componentsPerPixel;
+        const bool is8Bit=(imFormat.getPixelFormat()==ImageFormat::FLITR_PIX_FMT_Y_8) || (imFormat.getPixelFormat()==ImageFormat::FLITR_PIX_FMT_RGB_8);
+        const size_t intImageSize = width * height * componentsPerPixel * (is8Bit ? sizeof(uint32_t) : sizeof(double));
         
         if (scratchDataSize>maxScratchDataSize)
         {
             maxScratchDataSize=scratchDataSize;
         }
         
-        if (scratchDataValues>maxScratchDataValues)
+        if (intImageSize>maxIntImageSize)
         {
-            maxScratchDataValues=scratchDataValues;
+            maxIntImageSize=intImageSize;
         }
     }
     
@@ -118,8 +122,8 @@ bool FIPGaussianFilter::init()
     memset(_scratchData, 0, maxScratchDataSize);
     
 #ifdef APPROX_GAUSS_FILT_USE_INTEGRAL_IMAGES
-    _intImageScratchData=new double[maxScratchDataValues];
-    memset(_intImageScratchData, 0, maxScratchDataValues*sizeof(double));
+    _intImageScratchData=new uint8_t[maxIntImageSize];
+    memset(_intImageScratchData, 0, maxIntImageSize);
 #endif
     
     return rValue;
@@ -151,11 +155,8 @@ bool FIPGaussianFilter::trigger()
             const ImageFormat imFormat=getDownstreamFormat(imgNum);//down stream and up stream formats are the same.
             
             if (!_enabled)
-            {
-                uint8_t const * const dataReadUS=(uint8_t const * const)imReadUS->data();
-                uint8_t * const dataWriteDS=(uint8_t * const)imWriteDS->data();
-                const size_t bytesPerImage=imFormat.getBytesPerImage();
-                memcpy(dataWriteDS, dataReadUS, bytesPerImage);
+            {//Pass not enabled! Pass the upstream data on without copying.
+                imWriteDS->shareDataFrom(*imReadUS);
             } else
             {
                 const size_t width=imFormat.getWidth();
@@ -167,13 +168,17 @@ bool FIPGaussianFilter::trigger()
                     float const * const dataReadUS=(float const * const)imReadUS->data();
                     float * const dataWriteDS=(float * const)imWriteDS->data();
                     
+                    if (_useRecursive)
+                    {
+                        _recursiveFilter.filter(dataWriteDS, dataReadUS, width, height);
+                    } else
                     if (_approxIterations==0)
                     {
                         _gaussianFilter.filter(dataWriteDS, dataReadUS, width, height, (float *)_scratchData);
                     } else
                     {
 #ifdef APPROX_GAUSS_FILT_USE_INTEGRAL_IMAGES
-                        _boxFilter.filter(dataWriteDS, dataReadUS, width, height, _intImageScratchData, true);
+                        _boxFilter.filter(dataWriteDS, dataReadUS, width, height, (double *)_intImageScratchData, true);
 #else
                         _boxFilter.filter(dataWriteDS, dataReadUS, width, height, (float *)_scratchData);
 #endif
@@ -183,7 +188,7 @@ bool FIPGaussianFilter::trigger()
                             memcpy(_scratchData, dataWriteDS, width*height*sizeof(float));
                             
 #ifdef APPROX_GAUSS_FILT_USE_INTEGRAL_IMAGES
-                            _boxFilter.filter(dataWriteDS, (float *)_scratchData, width, height, _intImageScratchData, true);
+                            _boxFilter.filter(dataWriteDS, (float *)_scratchData, width, height, (double *)_intImageScratchData, true);
 #else
                             _boxFilter.filter(dataWriteDS, (float *)_scratchData, width, height, (float *)_scratchData);
 #endif
@@ -195,13 +200,17 @@ bool FIPGaussianFilter::trigger()
                         uint8_t const * const dataReadUS=(uint8_t const * const)imReadUS->data();
                         uint8_t * const dataWriteDS=(uint8_t * const)imWriteDS->data();
                         
+                        if (_useRecursive)
+                        {
+                            _recursiveFilter.filter(dataWriteDS, dataReadUS, width, height);
+                        } else
                         if (_approxIterations==0)
                         {
                             _gaussianFilter.filter(dataWriteDS, dataReadUS, width, height, (uint8_t *)_scratchData);
                         } else
                         {
 #ifdef APPROX_GAUSS_FILT_USE_INTEGRAL_IMAGES
-                            _boxFilter.filter(dataWriteDS, dataReadUS, width, height, _intImageScratchData, true);
+                            _boxFilter.filter(dataWriteDS, dataReadUS, width, height, (uint32_t *)_intImageScratchData, true);
 #else
                             _boxFilter.filter(dataWriteDS, dataReadUS, width, height, (uint8_t *)_scratchData);
 #endif
@@ -211,7 +220,7 @@ bool FIPGaussianFilter::trigger()
                                 memcpy(_scratchData, dataWriteDS, width*height*sizeof(uint8_t));
                                 
 #ifdef APPROX_GAUSS_FILT_USE_INTEGRAL_IMAGES
-                                _boxFilter.filter(dataWriteDS, _scratchData, width, height, _intImageScratchData, true);
+                                _boxFilter.filter(dataWriteDS, _scratchData, width, height, (uint32_t *)_intImageScratchData, true);
 #else
                                 _boxFilter.filter(dataWriteDS, (uint8_t *)_scratchData, width, height, (uint8_t *)_scratchData);
 #endif
@@ -223,13 +232,17 @@ bool FIPGaussianFilter::trigger()
                             float const * const dataReadUS=(float const * const)imReadUS->data();
                             float * const dataWriteDS=(float * const)imWriteDS->data();
                             
+                            if (_useRecursive)
+                            {
+                                _recursiveFilter.filterRGB(dataWriteDS, dataReadUS, width, height);
+                            } else
                             if (_approxIterations==0)
                             {
                                 _gaussianFilter.filterRGB(dataWriteDS, dataReadUS, width, height, (float *)_scratchData);
                             } else
                             {
 #ifdef APPROX_GAUSS_FILT_USE_INTEGRAL_IMAGES
-                                _boxFilter.filterRGB(dataWriteDS, dataReadUS, width, height, _intImageScratchData, true);
+                                _boxFilter.filterRGB(dataWriteDS, dataReadUS, width, height, (double *)_intImageScratchData, true);
 #else
                                 _boxFilter.filterRGB(dataWriteDS, dataReadUS, width, height, (float *)_scratchData);
 #endif
@@ -239,7 +252,7 @@ bool FIPGaussianFilter::trigger()
                                     memcpy(_scratchData, dataWriteDS, width*height*sizeof(float)*3);
                                     
 #ifdef APPROX_GAUSS_FILT_USE_INTEGRAL_IMAGES
-                                    _boxFilter.filterRGB(dataWriteDS, (float *)_scratchData, width, height, _intImageScratchData, true);
+                                    _boxFilter.filterRGB(dataWriteDS, (float *)_scratchData, width, height, (double *)_intImageScratchData, true);
 #else
                                     _boxFilter.filterRGB(dataWriteDS, (float *)_scratchData, width, height, (float *)_scratchData);
 #endif
@@ -251,13 +264,17 @@ bool FIPGaussianFilter::trigger()
                                 uint8_t const * const dataReadUS=(uint8_t const * const)imReadUS->data();
                                 uint8_t * const dataWriteDS=(uint8_t * const)imWriteDS->data();
                                 
+                                if (_useRecursive)
+                                {
+                                    _recursiveFilter.filterRGB(dataWriteDS, dataReadUS, width, height);
+                                } else
                                 if (_approxIterations==0)
                                 {
                                     _gaussianFilter.filterRGB(dataWriteDS, dataReadUS, width, height, (uint8_t *)_scratchData);
                                 } else
                                 {
 #ifdef APPROX_GAUSS_FILT_USE_INTEGRAL_IMAGES
-                                    _boxFilter.filterRGB(dataWriteDS, dataReadUS, width, height, _intImageScratchData, true);
+                                    _boxFilter.filterRGB(dataWriteDS, dataReadUS, width, height, (uint32_t *)_intImageScratchData, true);
 #else
                                     _boxFilter.filterRGB(dataWriteDS, dataReadUS, width, height, (uint8_t *)_scratchData);
 #endif
@@ -267,7 +284,7 @@ bool FIPGaussianFilter::trigger()
                                         memcpy(_scratchData, dataWriteDS, width*height*sizeof(uint8_t)*3);
                                         
 #ifdef APPROX_GAUSS_FILT_USE_INTEGRAL_IMAGES
-                                        _boxFilter.filterRGB(dataWriteDS, _scratchData, width, height, _intImageScratchData, true);
+                                        _boxFilter.filterRGB(dataWriteDS, _scratchData, width, height, (uint32_t *)_intImageScratchData, true);
 #else
                                         _boxFilter.filterRGB(dataWriteDS, _scratchData, width, height, (uint8_t *)_scratchData);
 #endif
@@ -0,0 +1,191 @@
+/* Framework for Live Image Transformation (FLITr)
+ * Copyright (c) 2010 CSIR
+ *
+ * This file is part of FLITr.
+ *
+ * FLITr is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * FLITr is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with FLITr. If not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+
+#include <flitr/modules/flitr_image_processors/gaussian_pyramid/fip_gaussian_pyramid.h>
+#include <flitr/log_message.h>
+
+#include <cstring>
+
+using namespace flitr;
+using std::shared_ptr;
+
+namespace {
+
+    //Levels of the smallest upstream image, or numLevels if it fits all of them.
+    size_t pyramidLevels(ImageProducer& upStreamProducer, uint32_t images_per_slot, size_t numLevels)
+    {
+        size_t levels=numLevels;
+        for (uint32_t i=0; i<images_per_slot; ++i)
+        {
+            const ImageFormat imFormat=upStreamProducer.getFormat(i);
+            const size_t maxLevels=GaussianPyramid::getMaxLevels(imFormat.getWidth(), imFormat.getHeight());
+            if ((levels==0) || (levels>maxLevels)) levels=maxLevels;
+        }
+        return levels;
+    }
+}
+
+FIPGaussianPyramid::FIPGaussianPyramid(ImageProducer& upStreamProducer, uint32_t images_per_slot,
+                                       size_t numLevels,
+                                       bool gradients,
+                                       uint32_t buffer_size) :
+ImageProcessor(upStreamProducer,
+               images_per_slot * (1 + pyramidLevels(upStreamProducer, images_per_slot, numLevels) * (gradients ? 3 : 1)),
+               buffer_size),
+NumSources_(images_per_slot),
+NumLevels_(pyramidLevels(upStreamProducer, images_per_slot, numLevels)),
+PlanesPerLevel_(gradients ? 3 : 1),
+ImagesPerSource_(1 + NumLevels_*PlanesPerLevel_),
+Kernel_(GaussianPyramid::binomialKernel())
+{
+    ProcessorStats_->setID("ImageProcessor::FIPGaussianPyramid");
+    //Setup image format being produced to downstream.
+    for (uint32_t i=0; i<images_per_slot; i++) {
+        const ImageFormat upStreamFormat=upStreamProducer.getFormat(i);
+        ImageFormat_.push_back(upStreamFormat);
+
+        //Crop so that every level is half the size of the one above.
+        const size_t croppedWidth=(upStreamFormat.getWidth()>>(NumLevels_-1))<<(NumLevels_-1);
+        const size_t croppedHeight=(upStreamFormat.getHeight()>>(NumLevels_-1))<<(NumLevels_-1);
+
+        for (size_t levelNum=0; levelNum<NumLevels_; ++levelNum)
+        {
+            const ImageFormat levelFormat(croppedWidth>>levelNum, croppedHeight>>levelNum, ImageFormat::FLITR_PIX_FMT_Y_F32);
+            for (size_t plane=0; plane<PlanesPerLevel_; ++plane)
+            {
+                ImageFormat_.push_back(levelFormat);
+            }
+        }
+    }
+}
+
+FIPGaussianPyramid::~FIPGaussianPyramid()
+{
+}
+
+bool FIPGaussianPyramid::init()
+{
+    for (uint32_t i=0; i<NumSources_; ++i)
+    {
+        const ImageFormat::PixelFormat pixFormat=getUpstreamFormat(i).getPixelFormat();
+        if ((pixFormat!=ImageFormat::FLITR_PIX_FMT_Y_F32) && (pixFormat!=ImageFormat::FLITR_PIX_FMT_RGB_F32))
+        {
+            logMessage(LOG_CRITICAL) << "FIPGaussianPyramid: Image " << i << " is not Y_F32 or RGB_F32.\n";
+            return false;
+        }
+    }
+
+    if ((Kernel_.size()<2) || (Kernel_.size()&1))
+    {
+        logMessage(LOG_CRITICAL) << "FIPGaussianPyramid: The kernel must have an even number of taps.\n";
+        return false;
+    }
+
+    bool rValue=ImageProcessor::init();
+    //Note: SharedImageBuffer of downstream producer is initialised with storage in ImageProcessor::init.
+
+    return rValue;
+}
+
+bool FIPGaussianPyramid::trigger()
+{
+    return triggerFrame();
+}
+
+void FIPGaussianPyramid::processFrame(const std::vector<Image**>& imvRead, const std::vector<Image**>& imvWrite)
+{
+    for (size_t imgNum=0; imgNum<NumSources_; ++imgNum)
+    {
+        Image const * const imRead = *(imvRead[imgNum]);
+
+        // Pass the metadata from the read image to the write images.
+        // By Default the base implementation will copy the pointer if no custom
+        // pass function was set.
+        if(PassMetadataFunction_ != nullptr)
+        {
+            const std::shared_ptr<ImageMetadata> metadata=PassMetadataFunction_(imRead->metadata());
+            for (size_t i=0; i<ImagesPerSource_; ++i)
+            {
+                (*(imvWrite[getSourceIndex(imgNum)+i]))->setMetadata(metadata);
+            }
+        }
+
+        (*(imvWrite[getSourceIndex(imgNum)]))->shareDataFrom(*imRead);
+
+        const ImageFormat imFormat=getUpstreamFormat(imgNum);
+        const ImageFormat levelFormat=getDownstreamFormat(getLevelIndex(imgNum, 0));
+        const size_t width=levelFormat.getWidth();
+        const size_t height=levelFormat.getHeight();
+        const size_t startCroppedX=(imFormat.getWidth() - width)>>1;
+        const size_t startCroppedY=(imFormat.getHeight() - height)>>1;
+        const size_t bytesPerLine=imFormat.getBytesPerLine();
+        uint8_t const * const dataRead=imRead->data();
+
+        {//=== Crop copy input data to level 0 ===//
+            float * const levelData=(float *)(*(imvWrite[getLevelIndex(imgNum, 0)]))->data();
+
+            if (imFormat.getPixelFormat()==ImageFormat::FLITR_PIX_FMT_Y_F32)
+            {
+                parallelRows(height, FLITR_PARALLEL_ROWS_GRAIN, [&](const RowBand& band)
+                {
+                    for (size_t y=band.Begin; y<band.End; ++y)
+                    {
+                        float const * const line=(float const *)(dataRead + (y+startCroppedY)*bytesPerLine) + startCroppedX;
+                        memcpy(levelData + y*width, line, width*sizeof(float));
+                    }
+                });
+            } else
+            {//Use the green channel.
+                parallelRows(height, FLITR_PARALLEL_ROWS_GRAIN, [&](const RowBand& band)
+                {
+                    for (size_t y=band.Begin; y<band.End; ++y)
+                    {
+                        float const * const line=(float const *)(dataRead + (y+startCroppedY)*bytesPerLine) + startCroppedX*3;
+                        float * const levelLine=levelData + y*width;
+                        for (size_t x=0; x<width; ++x)
+                        {
+                            levelLine[x]=line[x*3 + 1];
+                        }
+                    }
+                });
+            }
+        }
+
+        for (size_t levelNum=0; levelNum<NumLevels_; ++levelNum)
+        {
+            float * const levelData=(float *)(*(imvWrite[getLevelIndex(imgNum, levelNum)]))->data();
+
+            if (levelNum>0)
+            {
+                float const * const levelDataHR=(float const *)(*(imvWrite[getLevelIndex(imgNum, levelNum-1)]))->data();
+                GaussianPyramid::downsample(levelDataHR, width>>(levelNum-1), height>>(levelNum-1), levelData,
+                                            &Kernel_[0], Kernel_.size(), MaxRowBands_);
+            }
+
+            if (hasGradients())
+            {
+                GaussianPyramid::gradients(levelData, width>>levelNum, height>>levelNum,
+                                           (float *)(*(imvWrite[getLevelIndex(imgNum, levelNum, Plane::DX)]))->data(),
+                                           (float *)(*(imvWrite[getLevelIndex(imgNum, levelNum, Plane::DY)]))->data(),
+                                           MaxRowBands_);
+            }
+        }
+    }
+}
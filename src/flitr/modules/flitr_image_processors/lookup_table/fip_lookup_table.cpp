@@ -0,0 +1,121 @@
+/* Framework for Live Image Transformation (FLITr)
+ * Copyright (c) 2010 CSIR
+ *
+ * This file is part of FLITr.
+ *
+ * FLITr is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * FLITr is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with FLITr. If not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+
+#include <flitr/modules/flitr_image_processors/lookup_table/fip_lookup_table.h>
+#include <flitr/log_message.h>
+
+using namespace flitr;
+using std::shared_ptr;
+
+FIPLookupTable::FIPLookupTable(ImageProducer& upStreamProducer, uint32_t images_per_slot,
+                               uint32_t buffer_size) :
+ImageProcessor(upStreamProducer, images_per_slot, buffer_size)
+{
+    ProcessorStats_->setID("ImageProcessor::FIPLookupTable");
+    //Setup image format being produced to downstream.
+    for (uint32_t i=0; i<images_per_slot; i++) {
+        ImageFormat_.push_back(upStreamProducer.getFormat(i));//Output format is same as input format.
+        Tables_.push_back(shared_ptr<const LookupTable>(new LookupTable(upStreamProducer.getFormat(i).getPixelFormat())));
+    }
+}
+
+FIPLookupTable::~FIPLookupTable()
+{
+}
+
+template<typename F>
+bool FIPLookupTable::updateTables(F set)
+{
+    std::lock_guard<std::mutex> scopedLock(TablesMutex_);
+
+    bool rValue=false;
+    for (size_t i=0; i<Tables_.size(); ++i)
+    {
+        shared_ptr<LookupTable> table(new LookupTable(*Tables_[i]));
+        if (set(*table))
+        {
+            Tables_[i]=table;
+            rValue=true;
+        }
+    }
+    return rValue;
+}
+
+bool FIPLookupTable::setTable(const std::vector<uint8_t>& table)
+{
+    return updateTables([&](LookupTable& lut) { return lut.setTable(table); });
+}
+
+bool FIPLookupTable::setTable(const std::vector<uint16_t>& table)
+{
+    return updateTables([&](LookupTable& lut) { return lut.setTable(table); });
+}
+
+bool FIPLookupTable::setTable(const PointOpChain& chain)
+{
+    return updateTables([&](LookupTable& lut) { return lut.setTable(chain); });
+}
+
+bool FIPLookupTable::init()
+{
+    for (size_t i=0; i<Tables_.size(); ++i)
+    {
+        if (!Tables_[i]->isSupported())
+        {
+            logMessage(LOG_CRITICAL) << "FIPLookupTable: Pixel format of image " << i << " is not supported.\n";
+            return false;
+        }
+    }
+
+    bool rValue=ImageProcessor::init();
+    //Note: SharedImageBuffer of downstream producer is initialised with storage in ImageProcessor::init.
+
+    return rValue;
+}
+
+bool FIPLookupTable::trigger()
+{
+    return triggerFrame();
+}
+
+void FIPLookupTable::processFrame(const std::vector<Image**>& imvRead, const std::vector<Image**>& imvWrite)
+{
+    std::vector< shared_ptr<const LookupTable> > tables;
+    {
+        std::lock_guard<std::mutex> scopedLock(TablesMutex_);
+        tables=Tables_;
+    }
+
+    for (size_t imgNum=0; imgNum<ImagesPerSlot_; ++imgNum)
+    {
+        Image const * const imRead = *(imvRead[imgNum]);
+        Image * const imWrite = *(imvWrite[imgNum]);
+
+        // Pass the metadata from the read image to the write image.
+        // By Default the base implementation will copy the pointer if no custom
+        // pass function was set.
+        if(PassMetadataFunction_ != nullptr)
+        {
+            imWrite->setMetadata(PassMetadataFunction_(imRead->metadata()));
+        }
+
+        tables[imgNum]->apply(*imRead, *imWrite, MaxRowBands_);
+    }
+}
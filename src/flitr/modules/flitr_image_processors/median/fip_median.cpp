@@ -20,7 +20,7 @@
 
 #include <flitr/modules/flitr_image_processors/median/fip_median.h>
 
-#include <iostream>
+#include <cstring>
 
 using namespace flitr;
 using std::shared_ptr;
@@ -29,13 +29,13 @@ FIPMedian::FIPMedian(ImageProducer& upStreamProducer, uint32_t filterSize,
                      uint32_t images_per_slot,
                      uint32_t buffer_size) :
 ImageProcessor(upStreamProducer, images_per_slot, buffer_size),
-filterSize_(filterSize>=1 ? filterSize : 1)
+filterSize_(filterSize>=1 ? filterSize : 1),
+medianFilter_(filterSize_-1)
 {
     //Setup image format being produced to downstream.
     for (uint32_t i=0; i<images_per_slot; i++) {
-        //ImageFormat(uint32_t w=0, uint32_t h=0, PixelFormat pix_fmt=FLITR_PIX_FMT_Y_8, bool flipV = false, bool flipH = false):
-        ImageFormat downStreamFormat(upStreamProducer.getFormat().getWidth(), upStreamProducer.getFormat().getHeight(),
-                                     upStreamProducer.getFormat().getPixelFormat());
+        //Same format and line stride as upstream.
+        ImageFormat downStreamFormat=upStreamProducer.getFormat(i);
         
         ImageFormat_.push_back(downStreamFormat);
     }
@@ -63,122 +63,29 @@ bool FIPMedian::trigger()
         //Start stats measurement event.
         ProcessorStats_->tick();
         
-        for (size_t imgNum=0; imgNum<1; ++imgNum)//For now, only process one image in each slot.
+        for (size_t imgNum=0; imgNum<ImagesPerSlot_; ++imgNum)
         {
             Image const * const imRead = *(imvRead[imgNum]);
             Image * const imWrite = *(imvWrite[imgNum]);
             
-            uint8_t const * const dataRead=imRead->data();
-            uint8_t * const dataWrite=imWrite->data();
-            
             const ImageFormat imFormat=getDownstreamFormat(imgNum);
             
-            const int32_t width=imFormat.getWidth();
-            const int32_t height=imFormat.getHeight();
-            
-            memset(dataWrite, 0, width*height);//Clear the downstream image.
-            
-            const int32_t border=filterSize_-1;
-            const int32_t widthMinusBorder=width - border;
-            const int32_t heightMinusBorder=height - border;
+            const size_t width=imFormat.getWidth();
+            const size_t height=imFormat.getHeight();
+            const size_t bytesPerLine=imFormat.getBytesPerLine();
             
-            for (int32_t y=border; y<heightMinusBorder; ++y)
+            if (imFormat.getPixelFormat()==ImageFormat::FLITR_PIX_FMT_Y_8)
             {
-                const int32_t lineOffset=y * width;
-                
-                for (int32_t x=border; x<widthMinusBorder; ++x)
+                medianFilter_.filter(imWrite->data(), imRead->data(), width, height, bytesPerLine);
+            } else
+                if (imFormat.getPixelFormat()==ImageFormat::FLITR_PIX_FMT_Y_16)
                 {
-                    uint8_t minPixelValue;
-                    uint8_t maxMinValue=0;
-                    
-                    //=== TopLeft ===//
-                    minPixelValue=255;
-                    for (int32_t dy=-border; dy<=0; ++dy)
-                    {
-                        for (int32_t dx=-border; dx<=0; ++dx)
-                        {
-                            const uint8_t value=dataRead[lineOffset + x + dx + dy*width];
-                            
-                            if (value<minPixelValue)
-                            {
-                                minPixelValue=value;
-                            }
-                        }
-                    }
-                    //=== ===//
-                    
-                    if (minPixelValue>maxMinValue)
-                    {
-                        maxMinValue=minPixelValue;
-                    }
-                    
-                    //=== TopRight ===//
-                    minPixelValue=255;
-                    for (int32_t dy=-border; dy<=0; ++dy)
-                    {
-                        for (int32_t dx=0; dx<=border; ++dx)
-                        {
-                            const uint8_t value=dataRead[lineOffset + x + dx + dy*width];
-                            
-                            if (value<minPixelValue)
-                            {
-                                minPixelValue=value;
-                            }
-                        }
-                    }
-                    //=== ===//
-                    
-                    if (minPixelValue>maxMinValue)
-                    {
-                        maxMinValue=minPixelValue;
-                    }
-                    
-                    //=== BottomLeft ===//
-                    minPixelValue=255;
-                    for (int32_t dy=0; dy<=border; ++dy)
-                    {
-                        for (int32_t dx=-border; dx<=0; ++dx)
-                        {
-                            const uint8_t value=dataRead[lineOffset + x + dx + dy*width];
-                            
-                            if (value<minPixelValue)
-                            {
-                                minPixelValue=value;
-                            }
-                        }
-                    }
-                    //=== ===//
-                    
-                    if (minPixelValue>maxMinValue)
-                    {
-                        maxMinValue=minPixelValue;
-                    }
-                    
-                    //=== BottomRight ===//
-                    minPixelValue=255;
-                    for (int32_t dy=0; dy<=border; ++dy)
-                    {
-                        for (int32_t dx=0; dx<=border; ++dx)
-                        {
-                            const uint8_t value=dataRead[lineOffset + x + dx + dy*width];
-                            
-                            if (value<minPixelValue)
-                            {
-                                minPixelValue=value;
-                            }
-                        }
-                    }
-                    //=== ===//
-                    
-                    if (minPixelValue>maxMinValue)
-                    {
-                        maxMinValue=minPixelValue;
-                    }
-
-                    dataWrite[lineOffset + x]=maxMinValue;
+                    medianFilter_.filter((uint16_t *)imWrite->data(), (uint16_t const *)imRead->data(),
+                                         width, height, bytesPerLine/sizeof(uint16_t));
+                } else
+                {
+                    memcpy(imWrite->data(), imRead->data(), imFormat.getBytesPerImage());
                 }
-            }
-            
         }
         
         //Stop stats measurement event.
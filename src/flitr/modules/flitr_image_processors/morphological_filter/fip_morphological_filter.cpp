@@ -47,7 +47,7 @@ FIPMorphologicalFilter::~FIPMorphologicalFilter()
 {
     delete [] passScratchData_[0];
     delete [] passScratchData_[1];
-    delete tmpScratchData_;
+    delete [] tmpScratchData_;
 }
 
 bool FIPMorphologicalFilter::init()
@@ -107,7 +107,7 @@ bool FIPMorphologicalFilter::trigger()
                 float const * const dataReadUS=(float const * const)imReadUS->data();
                 float * const dataWriteDS=(float * const)imWriteDS->data();
                 
-                //doMorphoPasses(dataReadUS, dataWriteDS, width, height);
+                doMorphoPasses(dataReadUS, dataWriteDS, width, height);
             } else
                 if (imFormat.getPixelFormat()==ImageFormat::FLITR_PIX_FMT_Y_8)
                 {
@@ -116,20 +116,27 @@ bool FIPMorphologicalFilter::trigger()
                     
                     doMorphoPasses(dataReadUS, dataWriteDS, width, height);
                 } else
-                    if (imFormat.getPixelFormat()==ImageFormat::FLITR_PIX_FMT_RGB_F32)
+                    if (imFormat.getPixelFormat()==ImageFormat::FLITR_PIX_FMT_Y_16)
                     {
-                        float const * const dataReadUS=(float const * const)imReadUS->data();
-                        float * const dataWriteDS=(float * const)imWriteDS->data();
+                        uint16_t const * const dataReadUS=(uint16_t const * const)imReadUS->data();
+                        uint16_t * const dataWriteDS=(uint16_t * const)imWriteDS->data();
                         
-                        //doMorphoPassesRGB(dataReadUS, dataWriteDS, width, height);
+                        doMorphoPasses(dataReadUS, dataWriteDS, width, height);
                     } else
-                        if (imFormat.getPixelFormat()==ImageFormat::FLITR_PIX_FMT_RGB_8)
+                        if (imFormat.getPixelFormat()==ImageFormat::FLITR_PIX_FMT_RGB_F32)
                         {
-                            uint8_t const * const dataReadUS=(uint8_t const * const)imReadUS->data();
-                            uint8_t * const dataWriteDS=(uint8_t * const)imWriteDS->data();
+                            float const * const dataReadUS=(float const * const)imReadUS->data();
+                            float * const dataWriteDS=(float * const)imWriteDS->data();
                             
                             doMorphoPassesRGB(dataReadUS, dataWriteDS, width, height);
-                        }
+                        } else
+                            if (imFormat.getPixelFormat()==ImageFormat::FLITR_PIX_FMT_RGB_8)
+                            {
+                                uint8_t const * const dataReadUS=(uint8_t const * const)imReadUS->data();
+                                uint8_t * const dataWriteDS=(uint8_t * const)imWriteDS->data();
+                                
+                                doMorphoPassesRGB(dataReadUS, dataWriteDS, width, height);
+                            }
         }
         
         //Stop stats measurement event.
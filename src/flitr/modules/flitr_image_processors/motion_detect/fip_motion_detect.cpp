@@ -20,26 +20,86 @@
 
 #include <flitr/modules/flitr_image_processors/motion_detect/fip_motion_detect.h>
 
+#include <algorithm>
+#include <cstring>
 
 using namespace flitr;
 using std::shared_ptr;
 
+const uint32_t MotionDetectMetadata::MaxStreamedBlobs;
+const uint32_t FIPMotionDetect::CellSize;
+
+namespace {
+
+    //Smallest variance that a pixel is tested against: one grey level squared, with 8 fractional bits.
+    const int32_t minVariance=256;
+
+    //Initial variance chosen quite large to suppress motion during early background learning.
+    const int32_t initialVariance=100*256;
+
+    /*! Test every component against the background, then update the background with it.
+     * moving is set to 1 where the squared difference from the mean is more than thresholdSq
+     * times the variance. The mean and variance move towards the new values by 2^-learningShift,
+     * rounded to nearest.*/
+    void updateBackgroundRow(uint8_t * __restrict moving, uint16_t * __restrict mean, int32_t * __restrict variance,
+                             uint8_t const * __restrict in, const size_t n,
+                             const float thresholdSq, const uint8_t learningShift)
+    {
+        const int32_t half=int32_t(1)<<(learningShift-1);
+        for (size_t x=0; x<n; ++x)
+        {
+            const int32_t m=mean[x];
+            const int32_t v=variance[x];
+            const int32_t d=(int32_t(in[x])<<8) - m;//8.8 fixed point.
+            const int32_t dQ4=d>>4;
+            const int32_t dSq=dQ4*dQ4;//Same fixed point as the variance, and at most 255^2 * 2^8.
+            const int32_t vFloor=(v>minVariance) ? v : minVariance;
+            
+            moving[x]=(float(dSq) > thresholdSq*float(vFloor)) ? 1 : 0;
+            mean[x]=uint16_t(m + ((d+half)>>learningShift));
+            variance[x]=v + ((dSq-v+half)>>learningShift);
+        }
+    }
+
+    //Add the number of moving pixels in every CellSize wide span of the row to its cell.
+    void countCellsRow(uint32_t * __restrict cellMovingPixels, uint8_t const * __restrict moving,
+                       const size_t width, const size_t cellSize)
+    {
+        for (size_t cellX=0, startX=0; startX<width; ++cellX, startX+=cellSize)
+        {
+            const size_t endX=(startX+cellSize<width) ? startX+cellSize : width;
+            uint32_t count=0;
+            for (size_t x=startX; x<endX; ++x)
+            {
+                count+=moving[x];
+            }
+            cellMovingPixels[cellX]+=count;
+        }
+    }
+
+    //out = (in>>1)+128 where tint is set, in otherwise.
+    void tintRow(uint8_t * __restrict out, uint8_t const * __restrict in, uint8_t const * __restrict tint, const size_t n)
+    {
+        for (size_t x=0; x<n; ++x)
+        {
+            out[x]=tint[x] ? uint8_t((in[x]>>1)+128) : in[x];
+        }
+    }
+}
+
 FIPMotionDetect::FIPMotionDetect(ImageProducer& upStreamProducer, uint32_t images_per_slot,
                                  const bool showOverlays, const bool produceOnlyMotionImages, const bool forceRGBOutput,
                                  const float motionThreshold, const int detectionThreshold,
                                  uint32_t buffer_size) :
 ImageProcessor(upStreamProducer, images_per_slot, buffer_size),
+_title("Motion Detect"),
 _frameCounter(0),
-_avrgImg(nullptr),
-_varImg(nullptr),
-_detectionImg(nullptr),
-_detectionCountImg(nullptr),
 _showOverlays(showOverlays),
 _produceOnlyMotionImages(produceOnlyMotionImages),
 _forceRGBOutput(forceRGBOutput),
 _motionThreshold(motionThreshold),
 _detectionThreshold(detectionThreshold),
-_title("Motion Detect")
+_learningShift(7)
 {
     //!@todo can we get images_per_slot from upstream producer?
 
@@ -67,19 +127,27 @@ _title("Motion Detect")
 
 FIPMotionDetect::~FIPMotionDetect()
 {
-    if (_avrgImg) delete [] _avrgImg;
-    if (_varImg) delete [] _varImg;
-    if (_detectionImg) delete [] _detectionImg;
-    if (_detectionCountImg) delete [] _detectionCountImg;
+    stopTriggerThread();
 }
 
 bool FIPMotionDetect::init()
 {
+    for (uint32_t i=0; i<ImagesPerSlot_; i++)
+    {
+        const ImageFormat::PixelFormat pixFormat=getUpstreamFormat(i).getPixelFormat();
+        
+        if ((pixFormat!=ImageFormat::FLITR_PIX_FMT_Y_8) && (pixFormat!=ImageFormat::FLITR_PIX_FMT_RGB_8) &&
+            (pixFormat!=ImageFormat::FLITR_PIX_FMT_BGR))
+        {
+            logMessage(LOG_CRITICAL) << "FIPMotionDetect: Image " << i << " is not Y_8, RGB_8 or BGR.\n";
+            return false;
+        }
+    }
+    
     if (!ImageProcessor::init()) return false;
     //Note: SharedImageBuffer of downstream producer is initialised with storage in ImageProcessor::init.
     
-    size_t maxScratchDataSize=0;
-    size_t maxScratchDataValues=0;
+    _imageStates.resize(ImagesPerSlot_);
     
     for (uint32_t i=0; i<ImagesPerSlot_; i++)
     {
@@ -87,38 +155,233 @@ bool FIPMotionDetect::init()
         
         const size_t width=imFormat.getWidth();
         const size_t height=imFormat.getHeight();
+        const size_t componentsPerImage=width * height * imFormat.getComponentsPerPixel();
         
-        const size_t bytesPerPixel=imFormat.getBytesPerPixel();
-        const size_t componentsPerPixel=imFormat.getComponentsPerPixel();
+        ImageState& state=_imageStates[i];
         
-        const size_t scratchDataSize = width * height * bytesPerPixel;
-        const size_t scratchDataValues = width * height * componentsPerPixel;
+        state.Mean.resize(componentsPerImage, 0);
+        state.Variance.resize(componentsPerImage, initialVariance);
         
-        if (scratchDataSize>maxScratchDataSize)
+        state.CellsWide=(width + CellSize - 1) / CellSize;
+        state.CellsHigh=(height + CellSize - 1) / CellSize;
+        state.CellDetectionCount.resize(state.CellsWide * state.CellsHigh, 0);
+        state.CellMovingPixels.resize(state.CellsWide * state.CellsHigh, 0);
+        
+        state.MotionScore=0.0f;
+    }
+    
+    return true;
+}
+
+void FIPMotionDetect::detect(size_t imgNum, Image const * const imReadUS)
+{
+    ImageState& state=_imageStates[imgNum];
+    
+    const ImageFormat imFormat=getUpstreamFormat(imgNum);
+    const size_t width=imFormat.getWidth();
+    const size_t height=imFormat.getHeight();
+    const size_t componentsPerPixel=imFormat.getComponentsPerPixel();
+    const size_t rowLength=width * componentsPerPixel;
+    const size_t bytesPerLine=imFormat.getBytesPerLine();
+    uint8_t const * const dataReadUS=imReadUS->data();
+    
+    const float thresholdSq=_motionThreshold * _motionThreshold;
+    const uint8_t learningShift=_learningShift;
+    const bool firstFrame=(_frameCounter==0);
+    
+    //Bands of whole cell rows, so that every cell is counted by one band.
+    parallelRows(state.CellsHigh, 1, [&](const RowBand& band)
+    {
+        std::vector<uint8_t> moving(rowLength);
+        
+        for (size_t cellY=band.Begin; cellY<band.End; ++cellY)
         {
-            maxScratchDataSize=scratchDataSize;
+            uint32_t * const cellMovingPixels=&state.CellMovingPixels[cellY * state.CellsWide];
+            std::fill(cellMovingPixels, cellMovingPixels + state.CellsWide, 0);
+            
+            const size_t endY=std::min((cellY+1) * CellSize, height);
+            for (size_t y=cellY * CellSize; y<endY; ++y)
+            {
+                uint8_t const * const lineRead=dataReadUS + y * bytesPerLine;
+                uint16_t * const mean=&state.Mean[y * rowLength];
+                int32_t * const variance=&state.Variance[y * rowLength];
+                
+                if (firstFrame)
+                {//Initial pixel averages. The variances start at initialVariance.
+                    for (size_t x=0; x<rowLength; ++x)
+                    {
+                        mean[x]=uint16_t(lineRead[x]<<8);
+                    }
+                }
+                
+                updateBackgroundRow(&moving[0], mean, variance, lineRead, rowLength, thresholdSq, learningShift);
+                
+                //A pixel moves if any of its components moves.
+                if (componentsPerPixel==3)
+                {
+                    for (size_t x=0; x<width; ++x)
+                    {
+                        moving[x]=moving[x*3] | moving[x*3 + 1] | moving[x*3 + 2];
+                    }
+                } else
+                if (componentsPerPixel>1)
+                {
+                    for (size_t x=0; x<width; ++x)
+                    {
+                        uint8_t pixelMoving=moving[x * componentsPerPixel];
+                        for (size_t c=1; c<componentsPerPixel; ++c)
+                        {
+                            pixelMoving|=moving[x * componentsPerPixel + c];
+                        }
+                        moving[x]=pixelMoving;
+                    }
+                }
+                
+                countCellsRow(cellMovingPixels, &moving[0], width, CellSize);
+            }
         }
+    });
+    
+    //Count detections over time.
+    uint64_t numMovingPixels=0;
+    for (size_t i=0; i<state.CellMovingPixels.size(); ++i)
+    {
+        numMovingPixels+=state.CellMovingPixels[i];
+        state.CellDetectionCount[i]=state.CellMovingPixels[i] ? (state.CellDetectionCount[i] + 1) : 0;
+    }
+    state.MotionScore=float(numMovingPixels) / float(width * height);
+    
+    //=== Blobs of 8-connected detected cells ===//
+    state.Blobs.clear();
+    std::vector<uint8_t> visited(state.CellDetectionCount.size(), 0);
+    std::vector<size_t> stack;
+    
+    for (size_t seed=0; seed<state.CellDetectionCount.size(); ++seed)
+    {
+        if (visited[seed] || (state.CellDetectionCount[seed] <= _detectionThreshold)) continue;
         
-        if (scratchDataValues>maxScratchDataValues)
+        size_t minX=state.CellsWide, minY=state.CellsHigh, maxX=0, maxY=0;
+        uint32_t area=0;
+        
+        visited[seed]=1;
+        stack.push_back(seed);
+        while (!stack.empty())
         {
-            maxScratchDataValues=scratchDataValues;
+            const size_t cell=stack.back();
+            stack.pop_back();
+            
+            const size_t cellX=cell % state.CellsWide;
+            const size_t cellY=cell / state.CellsWide;
+            minX=std::min(minX, cellX); maxX=std::max(maxX, cellX);
+            minY=std::min(minY, cellY); maxY=std::max(maxY, cellY);
+            area+=state.CellMovingPixels[cell];
+            
+            for (size_t y=(cellY>0) ? cellY-1 : 0; y<=std::min(cellY+1, state.CellsHigh-1); ++y)
+            {
+                for (size_t x=(cellX>0) ? cellX-1 : 0; x<=std::min(cellX+1, state.CellsWide-1); ++x)
+                {
+                    const size_t neighbour=y * state.CellsWide + x;
+                    if ((!visited[neighbour]) && (state.CellDetectionCount[neighbour] > _detectionThreshold))
+                    {
+                        visited[neighbour]=1;
+                        stack.push_back(neighbour);
+                    }
+                }
+            }
         }
+        
+        MotionBlob blob;
+        blob.Left=uint32_t(minX * CellSize);
+        blob.Top=uint32_t(minY * CellSize);
+        blob.Width=uint32_t(std::min((maxX+1) * CellSize, width)) - blob.Left;
+        blob.Height=uint32_t(std::min((maxY+1) * CellSize, height)) - blob.Top;
+        blob.Area=area;
+        state.Blobs.push_back(blob);
     }
     
-    //Allocate a buffer big enough for any of the image slots.
-    _avrgImg=new float[maxScratchDataValues];
-    memset(_avrgImg, 0, maxScratchDataValues * sizeof(float));
+    std::sort(state.Blobs.begin(), state.Blobs.end(),
+              [](const MotionBlob& a, const MotionBlob& b) { return a.Area > b.Area; });
+}
+
+void FIPMotionDetect::writeImage(size_t imgNum, Image const * const imReadUS, Image * const imWriteDS, const bool frameMotion)
+{
+    const ImageState& state=_imageStates[imgNum];
     
-    _varImg=new float[maxScratchDataValues];
-    memset(_varImg, 0, maxScratchDataValues * sizeof(float));
+    // Publish the motion with the metadata from the read image.
+    // By Default the base implementation will copy the pointer if no custom
+    // pass function was set.
+    shared_ptr<MotionDetectMetadata> metadata(new MotionDetectMetadata());
+    metadata->MotionScore_=state.MotionScore;
+    metadata->Blobs_=state.Blobs;
+    if(PassMetadataFunction_ != nullptr)
+    {
+        metadata->Upstream_=PassMetadataFunction_(imReadUS->metadata());
+    }
+    imWriteDS->setMetadata(metadata);
     
-    _detectionImg=new uint8_t[maxScratchDataValues];
-    memset(_detectionImg, 0, maxScratchDataValues * sizeof(*_detectionImg));
+    const ImageFormat imFormatUS=getUpstreamFormat(imgNum);
+    const ImageFormat imFormatDS=getDownstreamFormat(imgNum);
+    const size_t width=imFormatUS.getWidth();
+    const size_t height=imFormatUS.getHeight();
+    const size_t componentsPerPixel=imFormatUS.getComponentsPerPixel();
+    const size_t bytesPerLineUS=imFormatUS.getBytesPerLine();
+    const size_t bytesPerLineDS=imFormatDS.getBytesPerLine();
+    const bool expandToRGB=(imFormatUS.getPixelFormat()==ImageFormat::FLITR_PIX_FMT_Y_8) &&
+                           (imFormatDS.getPixelFormat()==ImageFormat::FLITR_PIX_FMT_RGB_8);
+    const bool showOverlays=frameMotion && _showOverlays;
+    const int detectionThreshold=_detectionThreshold;
     
-    _detectionCountImg=new int[maxScratchDataValues];
-    memset(_detectionCountImg, 0, maxScratchDataValues * sizeof(int));
+    uint8_t const * const dataReadUS=imReadUS->data();
+    uint8_t * const dataWriteDS=imWriteDS->data();
     
-    return true;
+    parallelRows(height, FLITR_PARALLEL_ROWS_GRAIN, [&](const RowBand& band)
+    {
+        std::vector<uint8_t> tint(showOverlays ? width*componentsPerPixel : 0);
+        std::vector<uint8_t> tintedRow((showOverlays && expandToRGB) ? width : 0);
+        
+        for (size_t y=band.Begin; y<band.End; ++y)
+        {
+            uint8_t const * const lineRead=dataReadUS + y * bytesPerLineUS;
+            uint8_t * const lineWrite=dataWriteDS + y * bytesPerLineDS;
+            
+            if (showOverlays)
+            {//Brighten the detected cells; only the first and last components of colour images, which tints them.
+                int const * const cellDetectionCount=&state.CellDetectionCount[(y / CellSize) * state.CellsWide];
+                for (size_t x=0; x<width; ++x)
+                {
+                    const uint8_t detected=(cellDetectionCount[x / CellSize] > detectionThreshold) ? 1 : 0;
+                    for (size_t c=0; c<componentsPerPixel; ++c)
+                    {
+                        tint[x * componentsPerPixel + c]=((c==0) || (c+1==componentsPerPixel)) ? detected : 0;
+                    }
+                }
+            }
+            
+            if (expandToRGB)
+            {//Upstream is Y8; Downstream is expected to be RGB8
+                uint8_t const * red=lineRead;
+                if (showOverlays)
+                {
+                    tintRow(&tintedRow[0], lineRead, &tint[0], width);
+                    red=&tintedRow[0];
+                }
+                
+                for (size_t x=0; x<width; ++x)
+                {
+                    lineWrite[x*3+0]=red[x];
+                    lineWrite[x*3+1]=lineRead[x];
+                    lineWrite[x*3+2]=red[x];
+                }
+            } else
+            if (showOverlays)
+            {
+                tintRow(lineWrite, lineRead, &tint[0], width * componentsPerPixel);
+            } else
+            {//Don't add motion overlay. Just copy the data from the input.
+                memcpy(lineWrite, lineRead, width * componentsPerPixel);
+            }
+        }
+    });
 }
 
 bool FIPMotionDetect::trigger()
@@ -127,194 +390,37 @@ bool FIPMotionDetect::trigger()
     {
         std::vector<Image**> imvRead=reserveReadSlot();
         
-        //The write slot will be reserved later.
+        //The write slot will be reserved later, if the frame is passed downstream.
         
         //Start stats measurement event.
         ProcessorStats_->tick();
         
+        bool frameMotion=false;
+        
         for (size_t imgNum=0; imgNum<ImagesPerSlot_; ++imgNum)
         {
-            Image const * const imReadUS = *(imvRead[imgNum]);
-            const ImageFormat imFormat=getUpstreamFormat(imgNum);//down stream and up stream image dimensions are the same.
-            const int width=imFormat.getWidth();
-            const int height=imFormat.getHeight();
-            const size_t componentsPerPixel=imFormat.getComponentsPerPixel();
-            const size_t componentsPerImage = width * height * componentsPerPixel;
-            const size_t bytesPerImage=imFormat.getBytesPerImage();
-            
+            detect(imgNum, *(imvRead[imgNum]));
             
-            //Mask that defines the detection bin width and height. Could be made configurable!
-            const uint32_t detectImgMask = 0xFFFFFFF0;
+            if (!_imageStates[imgNum].Blobs.empty())
+            {
+                frameMotion=true;
+            }
+        }
+        
+        if ((!_produceOnlyMotionImages) || frameMotion)
+        {
+            std::vector<Image**> imvWrite=reserveWriteSlot();
             
-            if (imFormat.getPixelFormat()==ImageFormat::FLITR_PIX_FMT_RGB_8)
+            for (size_t imgNum=0; imgNum<ImagesPerSlot_; ++imgNum)
             {
-                logMessage(LOG_CRITICAL) << "Pixel format is not supported yet!" << __FILE__ << " " << __LINE__ << "\n";
-            } else
-                if (imFormat.getPixelFormat()==ImageFormat::FLITR_PIX_FMT_Y_8)
-                {
-                    uint8_t const * const dataReadUS=(uint8_t const * const)imReadUS->data();
-                    //boxFilter_.filter(currentFrame_, scratchData_, width, height, integralImageScratchData_, true);
-                    
-                    
-                    //Update the background variance and average.
-                    if (_frameCounter>0)
-                    {
-                        //The frame avrg&var update filter parameter. Could be made configurable: Smaller values of a could improve sensitivity to slow moving objects.
-                        const float a=1.0/100.0;
-                        
-                        for (size_t i=0; i<componentsPerImage; ++i)
-                        {
-                            _avrgImg[i]=dataReadUS[i]*a + _avrgImg[i]*(1.0f-a);
-                            const float d=(int(dataReadUS[i])-int(_avrgImg[i]));//uint8_t variables are promoted to int.
-                            _varImg[i]=(d*d) * a + _varImg[i]*(1.0f-a);
-                        }
-                    } else
-                    {
-                        //Initial pixel averages and variances.
-                        for (size_t i=0; i<componentsPerImage; ++i)
-                        {
-                            _avrgImg[i]=dataReadUS[i];
-                            _varImg[i]=100.0f;//Initial variance chosen quite large to suppress motion during early background learning.
-                        }
-                    }
-                    
-                    //Zero the detection image.
-                    memset(_detectionImg, 0, componentsPerImage * sizeof(*_detectionImg));
-                    
-                    //Mark cells with detections.
-                    for (int y=0; y<height; ++y)
-                    {
-                        const int lineOffset=y*width;
-                        const int lineOffsetB=(y&detectImgMask)*width;
-                        
-                        for (int x=0; x<width; ++x)
-                        {
-                            const int offset=lineOffset + x;
-                            const int offsetB=lineOffsetB + (x&detectImgMask);
-                            
-                            const float mvMag=fabsf(float(dataReadUS[offset]) - _avrgImg[offset]) / sqrtf(_varImg[offset]);
-                            
-                            if (mvMag > _motionThreshold)
-                            {
-                                _detectionImg[offsetB]=1;
-                            }
-                        }
-                    }
-                    
-                    //Count detections over time.
-                    for (size_t i=0; i<componentsPerImage; ++i)
-                    {
-                        if (_detectionImg[i])
-                        {
-                            _detectionCountImg[i]=_detectionCountImg[i] + 1;
-                        } else
-                        {
-                            _detectionCountImg[i]=0;//_detectionCountImg[i] - 1;
-                            //if (_detectionCountImg[i] < 0) _detectionCountImg[i]=0;
-                        }
-                    }
-                    
-                    //int64_t M=0;
-                    //for (int i=0; i<(width*height); ++i)
-                    //{
-                    //    M+=std::abs(currentFrame_[i] - previousFrame_[i]);
-                    //}
-                    const bool frameMotion = true;//(M / (width*height*0.001f) + 0.5f) > (motionThreshold_);
-                    
-                    
-                    if ((!_produceOnlyMotionImages) || frameMotion)
-                    {
-                        std::vector<Image**> imvWrite=reserveWriteSlot();
-                        
-                        Image * const imWriteDS = *(imvWrite[imgNum]);
-                        uint8_t * const dataWriteDS=(uint8_t * const)imWriteDS->data();
-
-                        // Pass the metadata from the read image to the write image.
-                        // By Default the base implementation will copy the pointer if no custom
-                        // pass function was set.
-                        if(PassMetadataFunction_ != nullptr)
-                        {
-                            imWriteDS->setMetadata(PassMetadataFunction_(imReadUS->metadata()));
-                        }
-                        
-                        if ((frameMotion) && (_showOverlays))
-                        {//Add motion blob overlay.
-                            
-                            if (_forceRGBOutput)
-                            {//Upstream is Y8; Downstream is expected to be RGB8
-                                for (int y=0; y<height; ++y)
-                                {
-                                    const int lineOffsetDS=y * (width*3);
-                                    
-                                    const int lineOffset=y * width;
-                                    const int lineOffsetB=(y&detectImgMask)*width;
-                                    
-                                    for (int x=0; x<width; ++x)
-                                    {
-                                        const int offsetDS=lineOffsetDS + x*3;
-                                        
-                                        const int offset=lineOffset + x;
-                                        const int offsetB=lineOffsetB + (x & detectImgMask);
-                                        
-                                        const uint8_t c=(_detectionCountImg[offsetB] > _detectionThreshold) ? ((dataReadUS[offset]>>1)+128) : dataReadUS[offset];
-                                        
-                                        dataWriteDS[offsetDS+0]=c;
-                                        dataWriteDS[offsetDS+1]=dataReadUS[offset];
-                                        dataWriteDS[offsetDS+2]=c;
-                                    }
-                                }
-                            } else
-                            {//Upstream is Y8; Downstream is expected to be Y8.
-                                for (int y=0; y<height; ++y)
-                                {
-                                    const int lineOffset=y*width;
-                                    const int lineOffsetB=(y&detectImgMask)*width;
-                                    
-                                    for (int x=0; x<width; ++x)
-                                    {
-                                        const int offset=lineOffset + x;
-                                        const int offsetB=lineOffsetB + (x & detectImgMask);
-                                        
-                                        const uint8_t c=(_detectionCountImg[offsetB] > _detectionThreshold) ? ((dataReadUS[offset]>>1)+128) : dataReadUS[offset];
-                                        
-                                        dataWriteDS[offset]=c;
-                                    }
-                                }
-                            }
-                        } else
-                        {//Don't add motion overlay. Just copy the data from the input.
-                            if (_forceRGBOutput)
-                            {//Upstream is Y8; Downstream is expected to be RGB8
-                                for (int y=0; y<height; ++y)
-                                {
-                                    const int lineOffsetUS=y * width;
-                                    const int lineOffsetDS=y * (width*3);
-                                    
-                                    for (int x=0; x<width; ++x)
-                                    {
-                                        const int offsetUS=lineOffsetUS + x;
-                                        const int offsetDS=lineOffsetDS + x*3;
-                                        
-                                        const uint8_t c = dataReadUS[offsetUS];
-                                        
-                                        dataWriteDS[offsetDS+0]=c;
-                                        dataWriteDS[offsetDS+1]=c;
-                                        dataWriteDS[offsetDS+2]=c;
-                                    }
-                                }
-                            } else
-                            {//Upstream is Y8; Downstream is expected to be Y8.
-                                memcpy(dataWriteDS, dataReadUS, bytesPerImage);
-                            }
-                        }
-                        
-                        releaseWriteSlot();
-                    }
-                }
+                writeImage(imgNum, *(imvRead[imgNum]), *(imvWrite[imgNum]), frameMotion);
+            }
             
-            ++_frameCounter;
+            releaseWriteSlot();
         }
         
+        ++_frameCounter;
+        
         //Stop stats measurement event.
         ProcessorStats_->tock();
         
@@ -325,4 +431,3 @@ bool FIPMotionDetect::trigger()
     
     return false;
 }
-
@@ -19,12 +19,105 @@
  */
 
 #include <flitr/modules/flitr_image_processors/msr/fip_msr.h>
+#include <flitr/fast_math.h>
 #include <iostream>
 #include <algorithm>
+#include <cmath>
+#include <mutex>
 
 using namespace flitr;
 using std::shared_ptr;
 
+namespace {
+
+    void log2Array(float * __restrict out, float const * __restrict in, const size_t n)
+    {
+        for (size_t i=0; i<n; ++i)
+        {
+            out[i]=fastLog2(in[i]);
+        }
+    }
+
+    void log2InPlace(float * const values, const size_t n)
+    {
+        for (size_t i=0; i<n; ++i)
+        {
+            values[i]=fastLog2(values[i]);
+        }
+    }
+
+    //out = a + (b-a)*weight
+    void lerpRows(float * __restrict out, float const * __restrict a, float const * __restrict b,
+                  const size_t n, const float weight)
+    {
+        for (size_t i=0; i<n; ++i)
+        {
+            out[i]=a[i] + (b[i]-a[i])*weight;
+        }
+    }
+
+    void upsampleRow(float * __restrict out, float const * __restrict row,
+                     size_t const * __restrict x0, size_t const * __restrict x1, float const * __restrict weight,
+                     const size_t n)
+    {
+        for (size_t x=0; x<n; ++x)
+        {
+            out[x]=row[x0[x]] + (row[x1[x]]-row[x0[x]])*weight[x];
+        }
+    }
+
+    //SSR given the log2 of the input and the surround.
+    void ssrRow(float * __restrict out, float const * __restrict logIn, float const * __restrict surround,
+                const size_t n, const float log2Gain)
+    {
+        for (size_t x=0; x<n; ++x)
+        {
+            out[x]=(logIn[x] - fastLog2(surround[x])) * log2Gain;//log is faster than power/gamma tonemapping.
+        }
+    }
+
+    //SSR given the log2 of the input and the log2 of the surround.
+    void ssrRowFromLog(float * __restrict out, float const * __restrict logIn, float const * __restrict logSurround,
+                       const size_t n, const float log2Gain)
+    {
+        for (size_t x=0; x<n; ++x)
+        {
+            out[x]=(logIn[x] - logSurround[x]) * log2Gain;
+        }
+    }
+
+    /*! Deepest pyramid level, below maxLevels, at which a surround of filterRadius full resolution
+     * pixels can be computed. The downsampling kernel and the bilinear upsampling blur too, so the
+     * radius that is left to filter at the level, returned in levelRadius, has to stay above a few
+     * level pixels for the surround to remain Gaussian. Level 0 returns filterRadius.*/
+    size_t surroundLevel(const float filterRadius, const size_t maxLevels, float& levelRadius)
+    {
+        const float minLevelStdDev=2.0f;
+        const float kernelVariance=11.0f/4.0f;//Variance of GaussianPyramid::binomialKernel() in the pixels it reads.
+        const float upsampleVariance=1.0f/6.0f;//Variance of bilinear interpolation in level pixels.
+
+        const float stdDev=filterRadius*0.5f;
+        size_t level=0;
+        float levelStdDev=stdDev;
+
+        for (size_t levelNum=1; levelNum<maxLevels; ++levelNum)
+        {
+            //Level n has been blurred by kernelVariance*(1 + 4 + ... + 4^(n-1)) full resolution pixels squared.
+            const float scale=float(size_t(1)<<levelNum);
+            const float pyramidVariance=kernelVariance*(scale*scale-1.0f)*(1.0f/3.0f);
+            const float levelVariance=(stdDev*stdDev - pyramidVariance)/(scale*scale) - upsampleVariance;
+
+            if (levelVariance<minLevelStdDev*minLevelStdDev) break;
+
+            level=levelNum;
+            levelStdDev=sqrtf(levelVariance);
+        }
+
+        levelRadius=levelStdDev*2.0f;
+        return level;
+    }
+}
+
 FIPMSR::FIPMSR(ImageProducer& upStreamProducer, uint32_t images_per_slot,
                const FilterType filterType,
                uint32_t buffer_size) :
@@ -32,6 +125,7 @@ ImageProcessor(upStreamProducer, images_per_slot, buffer_size),
 _enabled(true),
 _filterType(filterType),
 _GFXY(1.0, 4),
+_GFIIR(1.0f),
 _GFII(1),
 _GFRS(1),
 _GFScale(20),
@@ -44,7 +138,9 @@ _doubleScratchData1(nullptr),
 _doubleScratchData2(nullptr),
 _histoBins(nullptr),
 _triggerCount(0),
-_Title(std::string("MSR"))
+_Title(std::string("MSR")),
+_logScratchData(nullptr),
+_pyramidKernel(GaussianPyramid::binomialKernel())
 {
     ProcessorStats_->setID("ImageProcessor::FIPMSR");
 
@@ -79,6 +175,7 @@ FIPMSR::~FIPMSR()
     delete [] _doubleScratchData1;
     delete [] _doubleScratchData2;
     delete [] _histoBins;
+    delete [] _logScratchData;
 }
 
 bool FIPMSR::init()
@@ -120,6 +217,25 @@ bool FIPMSR::init()
     
     _histoBins=new size_t[_histoBinArrSize];
     
+    _logScratchData=new float[maxWidth*maxHeight];
+    memset(_logScratchData, 0, maxWidth*maxHeight*sizeof(float));
+    
+    if (_filterType==FilterType::Pyramid)
+    {//Level 0 is the intensity image itself.
+        const size_t numLevels=GaussianPyramid::getMaxLevels(maxWidth, maxHeight);
+        _pyramidLevels.resize(numLevels);
+        
+        for (size_t levelNum=1; levelNum<numLevels; ++levelNum)
+        {
+            _pyramidLevels[levelNum].resize((maxWidth>>levelNum)*(maxHeight>>levelNum), 0.0f);
+        }
+        
+        if (numLevels>1)
+        {
+            _levelScratchData.resize(_pyramidLevels[1].size(), 0.0f);
+        }
+    }
+    
     return rValue;
 }
 
@@ -150,11 +266,8 @@ bool FIPMSR::trigger()
 
             const ImageFormat imFormatUS=getUpstreamFormat(imgNum);
             if (!_enabled)
-            {//Pass not enabled! Just copy the data from input to output.
-                uint8_t const * const dataReadUS=(uint8_t const * const)imRead->data();
-                uint8_t * const dataWriteDS=(uint8_t * const)imWrite->data();
-                const size_t bytesPerImage=imFormatUS.getBytesPerImage();
-                memcpy(dataWriteDS, dataReadUS, bytesPerImage);
+            {//Pass not enabled! Pass the upstream data on without copying.
+                imWrite->shareDataFrom(*imRead);
             } else
             {//Pass enabled...
 
@@ -174,24 +287,31 @@ bool FIPMSR::trigger()
                     F32Image=dataRead;
                 } else
                 {//Convert input image to Y_F32 and store in pre-allocated F32Image.
-                    // #parallel
-                    for (size_t y=0; y<height; ++y)
+                    parallelRows(height, FLITR_PARALLEL_ROWS_GRAIN, [&](const RowBand& band)
                     {
-                        size_t readOffset=y*width*3;
-                        size_t writeOffset=y*width;
-
-                        for (size_t x=0; x<width; ++x)
+                        for (size_t y=band.Begin; y<band.End; ++y)
                         {
-                            _intensityScratchData[writeOffset]=(dataRead[readOffset+0] + dataRead[readOffset+1] + dataRead[readOffset+2])*(1.0f/3.0f);
-                            readOffset+=3;
-                            ++writeOffset;
+                            size_t readOffset=y*width*3;
+                            size_t writeOffset=y*width;
+
+                            for (size_t x=0; x<width; ++x)
+                            {
+                                _intensityScratchData[writeOffset]=(dataRead[readOffset+0] + dataRead[readOffset+1] + dataRead[readOffset+2])*(1.0f/3.0f);
+                                readOffset+=3;
+                                ++writeOffset;
+                            }
                         }
-                    }
+                    });
 
                     F32Image=_intensityScratchData;
                 }
                 //=== ===//
 
+                //=== log2 of the input, once for all scales ===//
+                parallelRows(height, FLITR_PARALLEL_ROWS_GRAIN, [&](const RowBand& band)
+                {
+                    log2Array(_logScratchData + band.Begin*width, F32Image + band.Begin*width, (band.End-band.Begin)*width);
+                });
 
 
                 memset(_MSRScratchData, 0, width*height*sizeof(float));
@@ -202,10 +322,59 @@ bool FIPMSR::trigger()
                 const float chromatGain=2.5f;//Boosts colour.
                 const float blacknessFloor=2.5f/255.0f;//Limits the enhancement of low signal (black) areas.
 
+                //The SSR is (log10(input) - log10(surround)) * gain, computed from log2.
+                const float log2Gain=gain*0.301029996f;
+
+                //The surround filters split rows into no more bands than this processor.
+                _GFXY.setMaxRowBands(MaxRowBands_);
+                _GFIIR.setMaxRowBands(MaxRowBands_);
+                _GFII.setMaxRowBands(MaxRowBands_);
+
+                //=== Pyramid level and filter radius of the surround of every scale ===//
+                std::vector<size_t> scaleLevels(_numScales, 0);
+                std::vector<float> scaleRadii(_numScales, 0.0f);
+                size_t numPyramidLevels=0;
+
                 for (size_t scaleIndex=0; scaleIndex<_numScales; ++scaleIndex)
                 {
                     const size_t kernelWidth=(imFormatUS.getWidth() / (_GFScale*(1 << scaleIndex))) | 1; // | 1 to make sure kernelWidth is odd.
+                    scaleRadii[scaleIndex]=kernelWidth*0.25f * 3.0f;
+
+                    if (_filterType==FilterType::Pyramid)
+                    {
+                        scaleLevels[scaleIndex]=surroundLevel(scaleRadii[scaleIndex], GaussianPyramid::getMaxLevels(width, height),
+                                                              scaleRadii[scaleIndex]);
+                        numPyramidLevels=std::max(numPyramidLevels, scaleLevels[scaleIndex]);
+                    }
+                }
+
+                for (size_t levelNum=1; levelNum<=numPyramidLevels; ++levelNum)
+                {
+                    GaussianPyramid::downsample((levelNum==1) ? F32Image : &_pyramidLevels[levelNum-1][0],
+                                                width>>(levelNum-1), height>>(levelNum-1),
+                                                &_pyramidLevels[levelNum][0],
+                                                &_pyramidKernel[0], _pyramidKernel.size(), MaxRowBands_);
+                }
+                //=== ===//
+
+                for (size_t scaleIndex=0; scaleIndex<_numScales; ++scaleIndex)
+                {
+                    const size_t kernelWidth=(imFormatUS.getWidth() / (_GFScale*(1 << scaleIndex))) | 1; // | 1 to make sure kernelWidth is odd.
+                    const size_t level=scaleLevels[scaleIndex];
+                    const size_t levelWidth=width>>level;
+                    const size_t levelHeight=height>>level;
+
+                    if (level>0)
+                    {//Blur the pyramid level and take its log2 there, at a fraction of the cost of a full resolution surround.
+                        _GFIIR.setFilterRadius(scaleRadii[scaleIndex]);
 
+                        _GFIIR.filter(&_levelScratchData[0], &_pyramidLevels[level][0], levelWidth, levelHeight);
+
+                        parallelRows(levelHeight, FLITR_PARALLEL_ROWS_GRAIN, [&](const RowBand& band)
+                        {
+                            log2InPlace(&_levelScratchData[band.Begin*levelWidth], (band.End-band.Begin)*levelWidth);
+                        });
+                    } else
                     if (_filterType==FilterType::GausXY)
                     {
                         _GFXY.setKernelWidth(kernelWidth * 3.0f);
@@ -250,50 +419,91 @@ bool FIPMSR::trigger()
                                     // #parallel
                                     _GFRS.filter(_GFScratchData, _floatScratchData, width, height, _floatScratchData);
                                 }
-                            }
+                            } else
+                                if ((_filterType==FilterType::GausIIR) || (_filterType==FilterType::Pyramid))
+                                {//Same radius as GausXY, at the same cost for every scale.
+                                    _GFIIR.setFilterRadius(kernelWidth*0.25f * 3.0f);
 
-                    //Calc SSR image...
-                    for (size_t y=0; y<height; ++y)
+                                    _GFIIR.filter(_GFScratchData, F32Image, width, height);
+                                }
+
+                    //Bilinear upsampling from the pyramid level. Full resolution pixel x is at (x+0.5)/2^level-0.5 in the level.
+                    const float levelScale=1.0f/float(size_t(1)<<level);
+                    std::vector<size_t> upsampleX0, upsampleX1;
+                    std::vector<float> upsampleWeightX;
+
+                    if (level>0)
                     {
-                        size_t offset=y*width;
+                        upsampleX0.resize(width);
+                        upsampleX1.resize(width);
+                        upsampleWeightX.resize(width);
 
                         for (size_t x=0; x<width; ++x)
                         {
-                            //const float r=(F32Image[offset] - _GFScratchData[offset]) * gain;
-                            const float r=(log10f(F32Image[offset]) - log10f(_GFScratchData[offset])) * gain;//log is faster than power/gamma tonemapping.
-                            //const float r=log10f(F32Image[offset]/_GFScratchData[offset]) * gain;//log is faster than power/gamma tonemapping.
-
-                            _floatScratchData[offset]=r;
-
-                            ++offset;
+                            const float u=std::min(std::max((x+0.5f)*levelScale-0.5f, 0.0f), float(levelWidth-1));
+                            upsampleX0[x]=size_t(u);
+                            upsampleX1[x]=std::min(upsampleX0[x]+1, levelWidth-1);
+                            upsampleWeightX[x]=u-upsampleX0[x];
                         }
                     }
 
-                    //=== Update MSR with global min/max minus outliers : MUCH faster than local min/max window; Global min/max means filter is not strictly local, but results still very good ===//
-                    float rmin=-1.0f;
-                    float rmax=1.0f;
-
-                    size_t numHistoSamples=0;
+                    //=== Calc SSR image and the histogram of its centre region ===//
                     memset(_histoBins, 0, _histoBinArrSize*sizeof(size_t));
+                    std::mutex histoMutex;
 
-                    for (size_t y=height/4; y<(height*3)/4; ++y)
+                    parallelRows(height, FLITR_PARALLEL_ROWS_GRAIN, [&](const RowBand& band)
                     {
-                        const size_t offset=y*width;
+                        std::vector<size_t> histoBins(_histoBinArrSize, 0);
+                        std::vector<float> levelRow(level>0 ? levelWidth : 0);
+                        std::vector<float> logSurround(level>0 ? width : 0);
 
-                        for (size_t x=width/4; x<(width*3/4); ++x)
+                        for (size_t y=band.Begin; y<band.End; ++y)
                         {
-                            const float r=_floatScratchData[offset+x];
+                            const size_t offset=y*width;
 
-                            const int histoBinNum=int(((r + 1.0f)*0.5f) * (_histoBinArrSize-1) + 0.5f);
+                            if (level>0)
+                            {
+                                const float v=std::min(std::max((y+0.5f)*levelScale-0.5f, 0.0f), float(levelHeight-1));
+                                const size_t y0=size_t(v);
+                                const size_t y1=std::min(y0+1, levelHeight-1);
+
+                                lerpRows(&levelRow[0], &_levelScratchData[y0*levelWidth], &_levelScratchData[y1*levelWidth],
+                                         levelWidth, v-y0);
+                                upsampleRow(&logSurround[0], &levelRow[0], &upsampleX0[0], &upsampleX1[0], &upsampleWeightX[0], width);
+                                ssrRowFromLog(_floatScratchData+offset, _logScratchData+offset, &logSurround[0], width, log2Gain);
+                            } else
+                            {
+                                ssrRow(_floatScratchData+offset, _logScratchData+offset, _GFScratchData+offset, width, log2Gain);
+                            }
 
-                            if ((histoBinNum>=0) && (histoBinNum<_histoBinArrSize))
+                            //=== Update MSR with global min/max minus outliers : MUCH faster than local min/max window; Global min/max means filter is not strictly local, but results still very good ===//
+                            if ((y>=height/4) && (y<(height*3)/4))
                             {
-                                _histoBins[histoBinNum]=_histoBins[histoBinNum]+1;
+                                for (size_t x=width/4; x<(width*3/4); ++x)
+                                {
+                                    const float r=_floatScratchData[offset+x];
+
+                                    const int histoBinNum=int(((r + 1.0f)*0.5f) * (_histoBinArrSize-1) + 0.5f);
+
+                                    if ((histoBinNum>=0) && (histoBinNum<_histoBinArrSize))
+                                    {
+                                        histoBins[histoBinNum]=histoBins[histoBinNum]+1;
+                                    }
+                                }
                             }
+                        }
 
-                            ++numHistoSamples;
+                        std::lock_guard<std::mutex> lock(histoMutex);
+                        for (int binNum=0; binNum<_histoBinArrSize; ++binNum)
+                        {
+                            _histoBins[binNum]+=histoBins[binNum];
                         }
-                    }
+                    });
+
+                    float rmin=-1.0f;
+                    float rmax=1.0f;
+
+                    const size_t numHistoSamples=((height*3)/4 - height/4) * ((width*3)/4 - width/4);
 
                     //Remove outliers.
                     size_t lowerToRemove=numHistoSamples*0.0001f;
@@ -343,16 +553,19 @@ bool FIPMSR::trigger()
                     const float recipRange=1.0f/(rmax - rmin);
 
                     //Update MSR image...
-                    for (size_t y=0; y<height; ++y)
+                    parallelRows(height, FLITR_PARALLEL_ROWS_GRAIN, [&](const RowBand& band)
                     {
-                        const size_t offset=y*width;
-
-                        for (size_t x=0; x<width; ++x)
+                        for (size_t y=band.Begin; y<band.End; ++y)
                         {
-                            const float r=(_floatScratchData[offset+x]-rmin) * (recipRange * recipNumScales);
-                            _MSRScratchData[offset+x]+=r;
+                            const size_t offset=y*width;
+
+                            for (size_t x=0; x<width; ++x)
+                            {
+                                const float r=(_floatScratchData[offset+x]-rmin) * (recipRange * recipNumScales);
+                                _MSRScratchData[offset+x]+=r;
+                            }
                         }
-                    }
+                    });
                     //=====================================================//
                 }
 
@@ -360,39 +573,45 @@ bool FIPMSR::trigger()
 
                 if (imFormatUS.getPixelFormat()==ImageFormat::FLITR_PIX_FMT_RGB_F32)
                 {
-                    for (size_t y=0; y<height; ++y)
+                    parallelRows(height, FLITR_PARALLEL_ROWS_GRAIN, [&](const RowBand& band)
                     {
-                        size_t intensityOffset=y*width;
-                        size_t colourOffset=y*width*3;
-
-                        for (size_t x=0; x<width; ++x)
+                        for (size_t y=band.Begin; y<band.End; ++y)
                         {
-                            const float r=_MSRScratchData[intensityOffset];
-                            const float intInput=F32Image[intensityOffset];
-                            const float recipIntInput=1.0f/(intInput+blacknessFloor);//Bias very dark colours more towards black...
+                            size_t intensityOffset=y*width;
+                            size_t colourOffset=y*width*3;
 
-                            dataWrite[colourOffset+0]=r * (dataRead[colourOffset+0]*recipIntInput) + (chromatGain) * (dataRead[colourOffset+0]-intInput);
-                            dataWrite[colourOffset+1]=r * (dataRead[colourOffset+1]*recipIntInput) + (chromatGain) * (dataRead[colourOffset+1]-intInput);
-                            dataWrite[colourOffset+2]=r * (dataRead[colourOffset+2]*recipIntInput) + (chromatGain) * (dataRead[colourOffset+2]-intInput);
+                            for (size_t x=0; x<width; ++x)
+                            {
+                                const float r=_MSRScratchData[intensityOffset];
+                                const float intInput=F32Image[intensityOffset];
+                                const float recipIntInput=1.0f/(intInput+blacknessFloor);//Bias very dark colours more towards black...
+
+                                dataWrite[colourOffset+0]=r * (dataRead[colourOffset+0]*recipIntInput) + (chromatGain) * (dataRead[colourOffset+0]-intInput);
+                                dataWrite[colourOffset+1]=r * (dataRead[colourOffset+1]*recipIntInput) + (chromatGain) * (dataRead[colourOffset+1]-intInput);
+                                dataWrite[colourOffset+2]=r * (dataRead[colourOffset+2]*recipIntInput) + (chromatGain) * (dataRead[colourOffset+2]-intInput);
 
-                            ++intensityOffset;
-                            colourOffset+=3;
+                                ++intensityOffset;
+                                colourOffset+=3;
+                            }
                         }
-                    }
+                    });
                 } else
                 {
-                    for (size_t y=0; y<height; ++y)
+                    parallelRows(height, FLITR_PARALLEL_ROWS_GRAIN, [&](const RowBand& band)
                     {
-                        const size_t offset=y*width;
-
-                        for (size_t x=0; x<width; ++x)
+                        for (size_t y=band.Begin; y<band.End; ++y)
                         {
-                            const float r=_MSRScratchData[offset+x];
-                            const float intInput=F32Image[offset+x];
+                            const size_t offset=y*width;
 
-                            dataWrite[offset+x]=r * (intInput/(intInput+blacknessFloor));//Bias very dark colours more towards black...
+                            for (size_t x=0; x<width; ++x)
+                            {
+                                const float r=_MSRScratchData[offset+x];
+                                const float intInput=F32Image[offset+x];
+
+                                dataWrite[offset+x]=r * (intInput/(intInput+blacknessFloor));//Bias very dark colours more towards black...
+                            }
                         }
-                    }
+                    });
                 }
             }
         }
@@ -0,0 +1,111 @@
+/* Framework for Live Image Transformation (FLITr)
+ * Copyright (c) 2010 CSIR
+ *
+ * This file is part of FLITr.
+ *
+ * FLITr is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * FLITr is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with FLITr. If not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+
+#include <flitr/modules/flitr_image_processors/point_ops/fip_point_ops.h>
+#include <flitr/log_message.h>
+
+using namespace flitr;
+using std::shared_ptr;
+
+FIPPointOps::FIPPointOps(ImageProducer& upStreamProducer, uint32_t images_per_slot,
+                         ImageFormat::PixelFormat out_pix_fmt,
+                         float scale_factor,
+                         uint32_t buffer_size) :
+ImageProcessor(upStreamProducer, images_per_slot, buffer_size)
+{
+    ProcessorStats_->setID("ImageProcessor::FIPPointOps");
+    //Setup image format being produced to downstream.
+    for (uint32_t i=0; i<images_per_slot; i++) {
+        const ImageFormat upStreamFormat=upStreamProducer.getFormat(i);
+
+        ImageFormat_.push_back(ImageFormat(upStreamFormat.getWidth(), upStreamFormat.getHeight(), out_pix_fmt));
+        Chains_.push_back(PointOpChain(upStreamFormat.getPixelFormat(), out_pix_fmt, scale_factor));
+    }
+}
+
+FIPPointOps::~FIPPointOps()
+{
+}
+
+void FIPPointOps::addGainOffset(float gain, float offset)
+{
+    for (size_t i=0; i<Chains_.size(); ++i) Chains_[i].addGainOffset(gain, offset);
+}
+
+void FIPPointOps::addPower(float power)
+{
+    for (size_t i=0; i<Chains_.size(); ++i) Chains_[i].addPower(power);
+}
+
+void FIPPointOps::addThreshold(float threshold, float below, float above)
+{
+    for (size_t i=0; i<Chains_.size(); ++i) Chains_[i].addThreshold(threshold, below, above);
+}
+
+void FIPPointOps::addLUT(const std::vector<float>& table, float minimum, float maximum)
+{
+    for (size_t i=0; i<Chains_.size(); ++i) Chains_[i].addLUT(table, minimum, maximum);
+}
+
+void FIPPointOps::addClamp(float minimum, float maximum)
+{
+    for (size_t i=0; i<Chains_.size(); ++i) Chains_[i].addClamp(minimum, maximum);
+}
+
+bool FIPPointOps::init()
+{
+    for (size_t i=0; i<Chains_.size(); ++i)
+    {
+        if (!Chains_[i].isSupported())
+        {
+            logMessage(LOG_CRITICAL) << "FIPPointOps: Pixel format of image " << i << " is not supported.\n";
+            return false;
+        }
+    }
+
+    bool rValue=ImageProcessor::init();
+    //Note: SharedImageBuffer of downstream producer is initialised with storage in ImageProcessor::init.
+
+    return rValue;
+}
+
+bool FIPPointOps::trigger()
+{
+    return triggerFrame();
+}
+
+void FIPPointOps::processFrame(const std::vector<Image**>& imvRead, const std::vector<Image**>& imvWrite)
+{
+    for (size_t imgNum=0; imgNum<ImagesPerSlot_; ++imgNum)
+    {
+        Image const * const imRead = *(imvRead[imgNum]);
+        Image * const imWrite = *(imvWrite[imgNum]);
+
+        // Pass the metadata from the read image to the write image.
+        // By Default the base implementation will copy the pointer if no custom
+        // pass function was set.
+        if(PassMetadataFunction_ != nullptr)
+        {
+            imWrite->setMetadata(PassMetadataFunction_(imRead->metadata()));
+        }
+
+        Chains_[imgNum].apply(*imRead, *imWrite, MaxRowBands_);
+    }
+}
@@ -65,103 +65,88 @@ bool FIPRotate::init()
 
 bool FIPRotate::trigger()
 {
-    if ((getNumReadSlotsAvailable())&&(getNumWriteSlotsAvailable()))
-    {//There are images to consume and the downstream producer has space to produce.
-        std::vector<Image**> imvRead=reserveReadSlot();
-        std::vector<Image**> imvWrite=reserveWriteSlot();
+    return triggerFrame();
+}
+
+void FIPRotate::processFrame(const std::vector<Image**>& imvRead, const std::vector<Image**>& imvWrite)
+{
+    for (size_t imgNum=0; imgNum<ImagesPerSlot_; ++imgNum)
+    {
+        Image const * const imRead = *(imvRead[imgNum]);
+        Image * const imWrite = *(imvWrite[imgNum]);
+        
+        uint8_t const * const dataRead=(uint8_t const * const)imRead->data();
+        uint8_t * const dataWrite=(uint8_t * const )imWrite->data();
+        
+        const ImageFormat imFormatUS=getUpstreamFormat(imgNum);
+        const ImageFormat imFormatDS=getDownstreamFormat(imgNum);
         
-        //Start stats measurement event.
-        ProcessorStats_->tick();
+        const size_t widthUS=imFormatUS.getWidth();
+        const size_t heightUS=imFormatUS.getHeight();
+
+        const size_t widthDS=imFormatDS.getWidth();
+        const size_t heightDS=imFormatDS.getHeight();
+
+        const size_t bytesPerPixel=imFormatUS.getBytesPerPixel();
         
-        for (size_t imgNum=0; imgNum<ImagesPerSlot_; ++imgNum)
+        const size_t bytesPerPixelTimesWidthDS=bytesPerPixel * widthDS;
+
+        if (rotate90CountVect_[imgNum] == 0)
         {
-            Image const * const imRead = *(imvRead[imgNum]);
-            Image * const imWrite = *(imvWrite[imgNum]);
-            
-            uint8_t const * const dataRead=(uint8_t const * const)imRead->data();
-            uint8_t * const dataWrite=(uint8_t * const )imWrite->data();
-            
-            const ImageFormat imFormatUS=getUpstreamFormat(imgNum);
-            const ImageFormat imFormatDS=getDownstreamFormat(imgNum);
-            
-            const size_t widthUS=imFormatUS.getWidth();
-            const size_t heightUS=imFormatUS.getHeight();
-
-            const size_t widthDS=imFormatDS.getWidth();
-            const size_t heightDS=imFormatDS.getHeight();
-
-            const size_t bytesPerPixel=imFormatUS.getBytesPerPixel();
-            
-            const size_t bytesPerPixelTimesWidthDS=bytesPerPixel * widthDS;
-
-            if (rotate90CountVect_[imgNum] == 0)
+            memcpy(dataWrite, dataRead, widthUS*heightUS*bytesPerPixel);
+        } else
+            if (rotate90CountVect_[imgNum] == 1)
             {
-                memcpy(dataWrite, dataRead, widthUS*heightUS*bytesPerPixel);
+                //=== Rotate by 90 deg ===//
+                for (int y=0; y<heightUS; ++y)
+                {
+                    int readOffset=(y*widthUS)*bytesPerPixel;
+                    int writeOffset=(widthDS-y-1)*bytesPerPixel;
+
+                    for (int x=0; x<widthUS; ++x)
+                    {
+                        memcpy(dataWrite+writeOffset, dataRead+readOffset, bytesPerPixel);
+                        readOffset+=bytesPerPixel;
+                        writeOffset+=bytesPerPixel*widthDS;
+                    }
+                }
+                //=======================//
             } else
-                if (rotate90CountVect_[imgNum] == 1)
+                if (rotate90CountVect_[imgNum] == 2)
                 {
-                    //=== Rotate by 90 deg ===//
+                    //=== Rotate by 180 deg ===//
                     for (int y=0; y<heightUS; ++y)
                     {
                         int readOffset=(y*widthUS)*bytesPerPixel;
-                        int writeOffset=(widthDS-y-1)*bytesPerPixel;
+                        int writeOffset=((heightDS-y-1)*widthDS + widthDS-1)*bytesPerPixel;
 
                         for (int x=0; x<widthUS; ++x)
                         {
                             memcpy(dataWrite+writeOffset, dataRead+readOffset, bytesPerPixel);
                             readOffset+=bytesPerPixel;
-                            writeOffset+=bytesPerPixel*widthDS;
+                            writeOffset-=bytesPerPixel;
                         }
                     }
                     //=======================//
                 } else
-                    if (rotate90CountVect_[imgNum] == 2)
+                    if (rotate90CountVect_[imgNum] == 3)
                     {
-                        //=== Rotate by 180 deg ===//
+                        //=== Rotate by 270 deg ===//
                         for (int y=0; y<heightUS; ++y)
                         {
                             int readOffset=(y*widthUS)*bytesPerPixel;
-                            int writeOffset=((heightDS-y-1)*widthDS + widthDS-1)*bytesPerPixel;
+                            int writeOffset=((heightDS-1)*widthDS + y)*bytesPerPixel;
 
                             for (int x=0; x<widthUS; ++x)
                             {
                                 memcpy(dataWrite+writeOffset, dataRead+readOffset, bytesPerPixel);
                                 readOffset+=bytesPerPixel;
-                                writeOffset-=bytesPerPixel;
+                                writeOffset-=bytesPerPixelTimesWidthDS;
                             }
                         }
                         //=======================//
-                    } else
-                        if (rotate90CountVect_[imgNum] == 3)
-                        {
-                            //=== Rotate by 270 deg ===//
-                            for (int y=0; y<heightUS; ++y)
-                            {
-                                int readOffset=(y*widthUS)*bytesPerPixel;
-                                int writeOffset=((heightDS-1)*widthDS + y)*bytesPerPixel;
-
-                                for (int x=0; x<widthUS; ++x)
-                                {
-                                    memcpy(dataWrite+writeOffset, dataRead+readOffset, bytesPerPixel);
-                                    readOffset+=bytesPerPixel;
-                                    writeOffset-=bytesPerPixelTimesWidthDS;
-                                }
-                            }
-                            //=======================//
-                        }
-        }
-        
-        
-        //Stop stats measurement event.
-        ProcessorStats_->tock();
-        
-        releaseWriteSlot();
-        releaseReadSlot();
-        
-        return true;
+                    }
     }
-    
-    return false;
 }
 
 
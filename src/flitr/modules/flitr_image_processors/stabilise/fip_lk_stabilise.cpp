@@ -19,6 +19,7 @@
  */
 
 #include <flitr/modules/flitr_image_processors/stabilise/fip_lk_stabilise.h>
+#include <flitr/log_message.h>
 
 #include <iostream>
 #include <fstream>
@@ -37,8 +38,9 @@ FIPLKStabilise::FIPLKStabilise(ImageProducer& upStreamProducer, uint32_t images_
                                uint32_t buffer_size) :
 ImageProcessor(upStreamProducer, images_per_slot, buffer_size),
 Title_(std::string("LK Stabilise")),
+upstreamPyramid_(nullptr),
+pyramid_(nullptr),
 numLevels_(0), //Setup numLevels_ automatically in init().
-scratchData_(0),
 outputMode_(outputMode),
 latestHx_(0.0),
 latestHy_(0.0),
@@ -57,6 +59,28 @@ burnFy_(1.0f)
     }
 }
 
+FIPLKStabilise::FIPLKStabilise(FIPGaussianPyramid& upStreamPyramid,
+                               Mode outputMode,
+                               uint32_t buffer_size) :
+ImageProcessor(upStreamPyramid, 1, buffer_size),
+Title_(std::string("LK Stabilise")),
+upstreamPyramid_(&upStreamPyramid),
+pyramid_(nullptr),
+numLevels_(upStreamPyramid.getNumLevels()),
+outputMode_(outputMode),
+latestHx_(0.0),
+latestHy_(0.0),
+latestHFrameNumber_(0),
+sumHx_(0.0f),
+sumHy_(0.0f),
+burnFx_(1.0f),
+burnFy_(1.0f)
+{
+    ProcessorStats_->setID("ImageProcessor::FIPLKStabilise");
+    //Setup image format being produced to downstream.
+    ImageFormat_.push_back(upStreamPyramid.getDownstreamFormat(upStreamPyramid.getSourceIndex(0)));
+}
+
 FIPLKStabilise::~FIPLKStabilise()
 {
     // First stop the trigger thread. The stopTriggerThread() function will
@@ -70,69 +94,61 @@ FIPLKStabilise::~FIPLKStabilise()
     stopTriggerThread();
     // Thread should be done, cleaning up can start. This might still be a problem
     // if the application calls trigger() and not the triggerThread.
-    delete [] scratchData_;
+    delete pyramid_;
     
-    for (size_t levelNum=0; levelNum<numLevels_; ++levelNum)
+    for (size_t levelNum=0; levelNum<refImgVec_.size(); ++levelNum)
     {
-        delete [] imgVec_.back();
-        imgVec_.pop_back();
-        
-        delete [] refImgVec_.back();
-        refImgVec_.pop_back();
-        
-        delete [] dxVec_.back();
-        dxVec_.pop_back();
-        
-        delete [] dyVec_.back();
-        dyVec_.pop_back();
-        
-        delete [] dSqRecipVec_.back();
-        dSqRecipVec_.pop_back();
+        delete [] refImgVec_[levelNum];
+        delete [] dSqRecipVec_[levelNum];
     }
 }
 
 bool FIPLKStabilise::init()
 {
+    if ((upstreamPyramid_!=nullptr) && (!upstreamPyramid_->hasGradients()))
+    {
+        logMessage(LOG_CRITICAL) << "FIPLKStabilise: The upstream pyramid must have gradients.\n";
+        return false;
+    }
+    
     bool rValue=ImageProcessor::init();
     //Note: SharedImageBuffer of downstream producer is initialised with storage in ImageProcessor::init.
     
-    const size_t imgNum=0;
+    ptrdiff_t croppedWidth=0;
+    ptrdiff_t croppedHeight=0;
+    
+    if (upstreamPyramid_!=nullptr)
+    {
+        const ImageFormat levelFormat=getUpstreamFormat(upstreamPyramid_->getLevelIndex(0, 0));
+        croppedWidth=levelFormat.getWidth();
+        croppedHeight=levelFormat.getHeight();
+    } else
     {
-        const ImageFormat imFormat=getUpstreamFormat(imgNum);
+        const ImageFormat imFormat=getUpstreamFormat(0);
         
         const ptrdiff_t width=imFormat.getWidth();
         const ptrdiff_t height=imFormat.getHeight();
         
         //Setup numLevels_ automatically.
-        numLevels_=(width>=height) ? log2f(width) : log2f(height);
+        numLevels_=GaussianPyramid::getMaxLevels(width, height);
         
         //=== Image will be cropped so that at least all levels of the pyramid is divisible by 2 ===
-        const ptrdiff_t croppedWidth=(width>>(numLevels_-1))<<(numLevels_-1);
-        const ptrdiff_t croppedHeight=(height>>(numLevels_-1))<<(numLevels_-1);
-        //const ptrdiff_t croppedWidth=1 << ((int)log2f(width));
-        //const ptrdiff_t croppedHeight=1 << ((int)log2f(height));
+        croppedWidth=(width>>(numLevels_-1))<<(numLevels_-1);
+        croppedHeight=(height>>(numLevels_-1))<<(numLevels_-1);
         //=== ===
         
-        scratchData_=new float[(width*height)<<1];
-        memset(scratchData_, 0, ((width*height)<<1)*sizeof(float));
+        pyramid_=new GaussianPyramid(croppedWidth, croppedHeight, numLevels_);
+    }
+    
+    for (size_t levelNum=0; levelNum<numLevels_; ++levelNum)
+    {
+        const size_t levelSize=(croppedWidth>>levelNum) * (croppedHeight>>levelNum);
+        
+        refImgVec_.push_back(new float[levelSize]);
+        memset(refImgVec_.back(), 0, levelSize * sizeof(float));
         
-        for (size_t levelNum=0; levelNum<numLevels_; ++levelNum)
-        {
-            imgVec_.push_back(new float[(croppedWidth>>levelNum) * (croppedHeight>>levelNum)]);
-            memset(imgVec_.back(), 0, (croppedWidth>>levelNum) * (croppedHeight>>levelNum) * sizeof(float));
-            
-            refImgVec_.push_back(new float[(croppedWidth>>levelNum) * (croppedHeight>>levelNum)]);
-            memset(refImgVec_.back(), 0, (croppedWidth>>levelNum) * (croppedHeight>>levelNum) * sizeof(float));
-            
-            dxVec_.push_back(new float[(croppedWidth>>levelNum) * (croppedHeight>>levelNum)]);
-            memset(dxVec_.back(), 0, (croppedWidth>>levelNum) * (croppedHeight>>levelNum) * sizeof(float));
-            
-            dyVec_.push_back(new float[(croppedWidth>>levelNum) * (croppedHeight>>levelNum)]);
-            memset(dyVec_.back(), 0, (croppedWidth>>levelNum) * (croppedHeight>>levelNum) * sizeof(float));
-            
-            dSqRecipVec_.push_back(new float[(croppedWidth>>levelNum) * (croppedHeight>>levelNum)]);
-            memset(dSqRecipVec_.back(), 0, (croppedWidth>>levelNum) * (croppedHeight>>levelNum) * sizeof(float));
-        }
+        dSqRecipVec_.push_back(new float[levelSize]);
+        memset(dSqRecipVec_.back(), 0, levelSize * sizeof(float));
     }
     
     return rValue;
@@ -168,11 +184,11 @@ bool FIPLKStabilise::trigger()
             const ptrdiff_t uncroppedHeight=imFormat.getHeight();
             const size_t bytesPerPixel=imFormat.getBytesPerPixel();
             
-            //=== Image will be cropped so that at least all levels of the pyramid is divisible by 2 ===
-            const ptrdiff_t croppedWidth=(uncroppedWidth>>(numLevels_-1))<<(numLevels_-1);
-            const ptrdiff_t croppedHeight=(uncroppedHeight>>(numLevels_-1))<<(numLevels_-1);
-            //const ptrdiff_t croppedWidth=1 << ((int)log2f(uncroppedWidth));
-            //const ptrdiff_t croppedHeight=1 << ((int)log2f(uncroppedHeight));
+            //=== Image is cropped so that at least all levels of the pyramid is divisible by 2 ===
+            const ImageFormat levelFormat=(upstreamPyramid_!=nullptr) ? getUpstreamFormat(upstreamPyramid_->getLevelIndex(imgNum, 0)) :
+                ImageFormat(pyramid_->getLevelWidth(0), pyramid_->getLevelHeight(0), ImageFormat::FLITR_PIX_FMT_Y_F32);
+            const ptrdiff_t croppedWidth=levelFormat.getWidth();
+            const ptrdiff_t croppedHeight=levelFormat.getHeight();
             //=== ===
             
             const ptrdiff_t startCroppedX=(uncroppedWidth - croppedWidth)>>1;
@@ -181,164 +197,72 @@ bool FIPLKStabilise::trigger()
             const ptrdiff_t endCroppedY=startCroppedY + croppedHeight - 1;
             
             
-            {//=== Copy cropped input to level 0 of scale space ===
-                
-                float * const imgData=imgVec_[0];
-                float * const refImgData=refImgVec_[0];
-                
-                {//=== Update ref img before new data arrives. ===//
-                    memcpy(refImgData, imgData, croppedWidth*croppedHeight*sizeof(float));
+            std::vector<float const *> imgVec(numLevels_);
+            std::vector<float const *> dxVec(numLevels_);
+            std::vector<float const *> dyVec(numLevels_);
+            
+            if (upstreamPyramid_!=nullptr)
+            {//=== Use the scale space pyramid of the upstream producer ===
+                for (size_t levelNum=0; levelNum<numLevels_; ++levelNum)
+                {
+                    imgVec[levelNum]=(float const *)(*(imvRead[upstreamPyramid_->getLevelIndex(imgNum, levelNum)]))->data();
+                    dxVec[levelNum]=(float const *)(*(imvRead[upstreamPyramid_->getLevelIndex(imgNum, levelNum, FIPGaussianPyramid::Plane::DX)]))->data();
+                    dyVec[levelNum]=(float const *)(*(imvRead[upstreamPyramid_->getLevelIndex(imgNum, levelNum, FIPGaussianPyramid::Plane::DY)]))->data();
                 }
-                
-                //=== Crop copy input data to level 0 of scale space ===//
-                if (imFormat.getPixelFormat()==flitr::ImageFormat::FLITR_PIX_FMT_Y_F32)
+            } else
+            {//=== Calculate scale space pyramid ===
                 {
-                    for (size_t y=startCroppedY; y<=endCroppedY; ++y)
-                    {
-                        const ptrdiff_t uncroppedLineOffset=y*uncroppedWidth + startCroppedX;
-                        const ptrdiff_t croppedLineOffset=(y-startCroppedY)*croppedWidth;
-                        memcpy(imgData+croppedLineOffset, dataRead+uncroppedLineOffset, croppedWidth*sizeof(float));
-                    }
-                } else
-                    if (imFormat.getPixelFormat()==flitr::ImageFormat::FLITR_PIX_FMT_RGB_F32)
+                    float * const imgData=pyramid_->getLevel(0);
+                    
+                    //=== Crop copy input data to level 0 of scale space ===//
+                    if (imFormat.getPixelFormat()==flitr::ImageFormat::FLITR_PIX_FMT_Y_F32)
                     {
                         for (size_t y=startCroppedY; y<=endCroppedY; ++y)
                         {
-                            const ptrdiff_t uncroppedLineOffset=(y*uncroppedWidth + startCroppedX)*3;
+                            const ptrdiff_t uncroppedLineOffset=y*uncroppedWidth + startCroppedX;
                             const ptrdiff_t croppedLineOffset=(y-startCroppedY)*croppedWidth;
-                            
-                            for (int x=0; x<croppedWidth; ++x)
+                            memcpy(imgData+croppedLineOffset, dataRead+uncroppedLineOffset, croppedWidth*sizeof(float));
+                        }
+                    } else
+                        if (imFormat.getPixelFormat()==flitr::ImageFormat::FLITR_PIX_FMT_RGB_F32)
+                        {
+                            for (size_t y=startCroppedY; y<=endCroppedY; ++y)
                             {
-                                imgData[croppedLineOffset+x]=dataRead[uncroppedLineOffset + x*3 + 1];//Use the green channel to stabilise!
+                                const ptrdiff_t uncroppedLineOffset=(y*uncroppedWidth + startCroppedX)*3;
+                                const ptrdiff_t croppedLineOffset=(y-startCroppedY)*croppedWidth;
+                                
+                                for (int x=0; x<croppedWidth; ++x)
+                                {
+                                    imgData[croppedLineOffset+x]=dataRead[uncroppedLineOffset + x*3 + 1];//Use the green channel to stabilise!
+                                }
                             }
                         }
-                    }
+                }
+                
+                pyramid_->update(MaxRowBands_);
+                
+                for (size_t levelNum=0; levelNum<numLevels_; ++levelNum)
+                {
+                    imgVec[levelNum]=pyramid_->getLevel(levelNum);
+                    dxVec[levelNum]=pyramid_->getDx(levelNum);
+                    dyVec[levelNum]=pyramid_->getDy(levelNum);
+                }
             }//=== ===
             
             
-            {//=== Calculate scale space pyramid. ===
-                for (size_t levelNum=0; levelNum<numLevels_; ++levelNum)
+            for (size_t levelNum=0; levelNum<numLevels_; ++levelNum)
+            {//=== Reciprocal of the squared gradient magnitude ===
+                float const * const dxData=dxVec[levelNum];
+                float const * const dyData=dyVec[levelNum];
+                float * const dSqRecipData=dSqRecipVec_[levelNum];
+                
+                const size_t levelSize=(croppedWidth>>levelNum) * (croppedHeight>>levelNum);
+                
+                for (size_t offset=0; offset<levelSize; ++offset)
                 {
-                    float * const imgData=imgVec_[levelNum];
-                    
-                    const ptrdiff_t levelHeight=croppedHeight >> levelNum;
-                    const ptrdiff_t levelWidth=croppedWidth >> levelNum;
-                    const ptrdiff_t levelWidthMinus1 = levelWidth - ((ptrdiff_t)1);
-                    const ptrdiff_t levelWidthMinus3 = levelWidth - ((ptrdiff_t)3);
-                    
-                    //=== Calculate the scale space images ===
-                    if (levelNum>0)//First level (incoming data) is not a downsampled image.
-                    {
-                        {//Update ref img before new data arrives.
-                            memcpy(refImgVec_[levelNum], imgData, levelWidth*levelHeight*sizeof(float));
-                        }
-                        
-                        float const * const imgDataHR=imgVec_[levelNum-1];
-                        const ptrdiff_t heightHR=croppedHeight >> (levelNum-1);
-                        const ptrdiff_t widthHR=croppedWidth >> (levelNum-1);
-                        
-                        //=== Seperable Gaussian first pass - down filter x ===
-                        for (size_t y=0; y<heightHR; ++y)
-                        {
-                            const ptrdiff_t lineOffsetScratch=y * levelWidth;
-                            const ptrdiff_t lineOffsetHR=y * widthHR;
-                            
-                            for (ptrdiff_t x=3; x<levelWidthMinus3; ++x)
-                            {
-                                const ptrdiff_t xHR=(x<<1);
-                                const ptrdiff_t offsetHR=lineOffsetHR + xHR;
-                                
-                                float filtValue=(imgDataHR[offsetHR] +
-                                                 imgDataHR[offsetHR + 1] ) * (462.0f/2048.0f);//The const expr devisions will be compiled/folded away!
-                                
-                                filtValue+=(imgDataHR[offsetHR - 1] +
-                                            imgDataHR[offsetHR + 2] ) * (330.0f/2048.0f);
-                                
-                                filtValue+=(imgDataHR[offsetHR - 2] +
-                                            imgDataHR[offsetHR + 3] ) * (165.0f/2048.0f);
-                                
-                                filtValue+=(imgDataHR[offsetHR - 3] +
-                                            imgDataHR[offsetHR + 4] ) * (55.0f/2048.0f);
-                                
-                                filtValue+=(imgDataHR[offsetHR - 4] +
-                                            imgDataHR[offsetHR + 5] ) * (11.0f/2048.0f);
-                                
-                                filtValue+=(imgDataHR[offsetHR - 5] +
-                                            imgDataHR[offsetHR + 6] ) * (1.0f/2048.0f);
-                                
-                                scratchData_[lineOffsetScratch + x]=filtValue;
-                            }
-                        }
-                        //=== ===
-                        
-                        //=== Seperable Gaussian second pass - down filter y===
-                        for (ptrdiff_t y=((ptrdiff_t)3); y<(levelHeight-((ptrdiff_t)3)); ++y)
-                        {
-                            const ptrdiff_t lineOffset=y * levelWidth;
-                            const ptrdiff_t lineOffsetScratch=(y<<1) * levelWidth;
-                            
-                            for (ptrdiff_t x=3; x<levelWidthMinus3; ++x)
-                            {
-                                const ptrdiff_t offsetScratch=lineOffsetScratch + x;
-                                
-                                float filtValue=(scratchData_[offsetScratch] +
-                                                 scratchData_[offsetScratch + levelWidth] ) * (462.0f/2048.0f);//The const expr devisions will be compiled/folded away!
-                                
-                                filtValue+=(scratchData_[offsetScratch - levelWidth] +
-                                            scratchData_[offsetScratch + (levelWidth<<1)] ) * (330.0f/2048.0f);
-                                
-                                filtValue+=(scratchData_[offsetScratch - (levelWidth<<1)] +
-                                            scratchData_[offsetScratch + ((levelWidth<<1) + levelWidth)] ) * (165.0f/2048.0f);
-                                
-                                filtValue+=(scratchData_[offsetScratch - ((levelWidth<<1) + levelWidth)] +
-                                            scratchData_[offsetScratch + (levelWidth<<2)] ) * (55.0f/2048.0f);
-                                
-                                filtValue+=(scratchData_[offsetScratch - (levelWidth<<2)] +
-                                            scratchData_[offsetScratch + ((levelWidth<<2) + levelWidth)] ) * (11.0f/2048.0f);
-                                
-                                filtValue+=(scratchData_[offsetScratch - ((levelWidth<<2) + levelWidth)] +
-                                            scratchData_[offsetScratch + ((levelWidth<<2) + (levelWidth<<1))] ) * (1.0f/2048.0f);
-                                
-                                imgData[lineOffset + x]=filtValue;
-                            }
-                        }
-                        //=== ===
-                    }//=== ===
-                    
-                    
-                    {//=== Calculate scale space gradient images ===
-                        float * const dxData=dxVec_[levelNum];
-                        float * const dyData=dyVec_[levelNum];
-                        float * const dSqRecipData=dSqRecipVec_[levelNum];
-                        
-                        for (ptrdiff_t y=1; y<(levelHeight - ((ptrdiff_t)1)); ++y)
-                        {
-                            const ptrdiff_t lineOffset=y*levelWidth;
-                            
-                            for (ptrdiff_t x=((ptrdiff_t)1); x<levelWidthMinus1; ++x)
-                            {
-                                const ptrdiff_t offset=lineOffset + x;
-                                
-                                const float v1=imgData[offset-levelWidth-1];
-                                const float v2=imgData[offset-levelWidth];
-                                const float v3=imgData[offset-levelWidth+1];
-                                const float v4=imgData[offset-1];
-                                //const float v5=imgData[offset];
-                                const float v6=imgData[offset+1];
-                                const float v7=imgData[offset+levelWidth-1];
-                                const float v8=imgData[offset+levelWidth];
-                                const float v9=imgData[offset+levelWidth+1];
-                                
-                                //Use Scharr operator for image gradient.
-                                const float dx=(v3-v1)*(3.0f/32.0f) + (v6-v4)*(10.0f/32.0f) + (v9-v7)*(3.0f/32.0f);
-                                const float dy=(v7-v1)*(3.0f/32.0f) + (v8-v2)*(10.0f/32.0f) + (v9-v3)*(3.0f/32.0f);
-                                
-                                dxData[offset]=dx;
-                                dyData[offset]=dy;
-                                dSqRecipData[offset]=1.0f/(dx*dx+dy*dy+0.000000001f);
-                            }
-                        }
-                    }//=== ===
+                    const float dx=dxData[offset];
+                    const float dy=dyData[offset];
+                    dSqRecipData[offset]=1.0f/(dx*dx+dy*dy+0.000000001f);
                 }
             }//=== ===
             
@@ -356,11 +280,11 @@ bool FIPLKStabilise::trigger()
                 Hx*=2.0f;
                 Hy*=2.0f;
                 
-                float const * const imgData=imgVec_[levelNum];
+                float const * const imgData=imgVec[levelNum];
                 float const * const refImgData=refImgVec_[levelNum];
                 
-                float const * const dxData=dxVec_[levelNum];
-                float const * const dyData=dyVec_[levelNum];
+                float const * const dxData=dxVec[levelNum];
+                float const * const dyData=dyVec[levelNum];
                 float const * const dSqRecipData=dSqRecipVec_[levelNum];
                 
                 const ptrdiff_t levelWidth=(croppedWidth>>levelNum);
@@ -425,6 +349,14 @@ bool FIPLKStabilise::trigger()
             //===========================
             
             
+            {//=== Keep the levels as the reference of the next frame ===
+                for (size_t levelNum=0; levelNum<numLevels_; ++levelNum)
+                {
+                    memcpy(refImgVec_[levelNum], imgVec[levelNum], (croppedWidth>>levelNum) * (croppedHeight>>levelNum) * sizeof(float));
+                }
+            }//=== ===
+            
+            
             Hx*=powf(2.0f, float(levelsToSkip));
             Hy*=powf(2.0f, float(levelsToSkip));
             
@@ -454,7 +386,7 @@ bool FIPLKStabilise::trigger()
             
             if (outputMode_==Mode::CROP_FILTER_SUBPIXELSTAB)
             {
-                float const * const imgDataGF=imgVec_[0];
+                float const * const imgDataGF=imgVec[0];
                 
                 const float hx=-sumHx_;
                 const float hy=-sumHy_;
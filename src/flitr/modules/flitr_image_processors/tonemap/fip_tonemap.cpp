@@ -33,6 +33,27 @@ FIPTonemap::FIPTonemap(ImageProducer& upStreamProducer, uint32_t images_per_slot
     //Setup image format being produced to downstream.
     for (uint32_t i=0; i<images_per_slot; i++) {
         ImageFormat_.push_back(upStreamProducer.getFormat(i));//Output format is same as input format.
+
+        // v^power of the values scaled to [0, 1], as the per pixel code did for RGB_8.
+        LookupTable table(upStreamProducer.getFormat(i).getPixelFormat());
+        if (table.getNumEntries()==256)
+        {
+            std::vector<uint8_t> values(256);
+            for (size_t v=0; v<256; ++v)
+            {
+                values[v]=uint8_t(powf(float(v)*(1.0f/255.0f), power_)*255.0f+0.5f);
+            }
+            table.setTable(values);
+        } else if (table.getNumEntries()==65536)
+        {
+            std::vector<uint16_t> values(65536);
+            for (size_t v=0; v<65536; ++v)
+            {
+                values[v]=uint16_t(powf(float(v)*(1.0f/65535.0f), power_)*65535.0f+0.5f);
+            }
+            table.setTable(values);
+        }
+        tables_.push_back(table);
     }
 
 }
@@ -70,72 +91,40 @@ bool FIPTonemap::init()
 
 bool FIPTonemap::trigger()
 {
-    if ((getNumReadSlotsAvailable())&&(getNumWriteSlotsAvailable()))
-    {//There are images to consume and the downstream producer has space to produce.
-        std::vector<Image**> imvRead=reserveReadSlot();
-        std::vector<Image**> imvWrite=reserveWriteSlot();
-
-        //Start stats measurement event.
-        ProcessorStats_->tick();
-
-        for (size_t imgNum=0; imgNum<ImagesPerSlot_; imgNum++)
-        {
-            const ImageFormat imFormat=getUpstreamFormat(imgNum);//Downstream format is same as upstream format.
+    return triggerFrame();
+}
 
-            const size_t width=imFormat.getWidth();
-            const size_t height=imFormat.getHeight();
-            const size_t bytesPerPixel=imFormat.getBytesPerPixel();
+void FIPTonemap::processFrame(const std::vector<Image**>& imvRead, const std::vector<Image**>& imvWrite)
+{
+    for (size_t imgNum=0; imgNum<ImagesPerSlot_; imgNum++)
+    {
+        const ImageFormat imFormat=getUpstreamFormat(imgNum);//Downstream format is same as upstream format.
 
-            Image const * const imRead = *(imvRead[imgNum]);
-            Image * const imWrite = *(imvWrite[imgNum]);
+        const size_t width=imFormat.getWidth();
+        const size_t height=imFormat.getHeight();
 
-            if (imFormat.getPixelFormat()==flitr::ImageFormat::FLITR_PIX_FMT_Y_F32)
-            {//Image format float32.
-                float const * const dataRead=(float const * const)imRead->data();
-                float * const dataWrite=(float * const )imWrite->data();
+        Image const * const imRead = *(imvRead[imgNum]);
+        Image * const imWrite = *(imvWrite[imgNum]);
 
-                for (size_t y=0; y<height; ++y)
-                {
-                    const size_t lineOffset=y * width;
+        if (imFormat.getPixelFormat()==flitr::ImageFormat::FLITR_PIX_FMT_Y_F32)
+        {//Image format float32.
+            float const * const dataRead=(float const * const)imRead->data();
+            float * const dataWrite=(float * const )imWrite->data();
 
-                    for (size_t x=0; x<width; ++x)
-                    {
-                        dataWrite[lineOffset + x]=powf(dataRead[lineOffset + x], power_);
-                    }
-                }
-            } else
-            if (imFormat.getPixelFormat()==flitr::ImageFormat::FLITR_PIX_FMT_RGB_8)
-            {//Image format rgb8.
-                uint8_t const * const dataRead=(uint8_t const * const)imRead->data();
-                uint8_t * const dataWrite=(uint8_t * const )imWrite->data();
+            for (size_t y=0; y<height; ++y)
+            {
+                const size_t lineOffset=y * width;
 
-                for (size_t y=0; y<height; ++y)
+                for (size_t x=0; x<width; ++x)
                 {
-                    const size_t lineOffset=(y * width)*bytesPerPixel;
-                    size_t pixelOffset=0;
-
-                    for (size_t x=0; x<width; ++x)
-                    {
-                        dataWrite[lineOffset + pixelOffset + 0]=uint8_t(powf(float(dataRead[lineOffset + pixelOffset + 0])*(1.0f/255.0f), power_)*255.0f+0.5f);
-                        dataWrite[lineOffset + pixelOffset + 1]=uint8_t(powf(float(dataRead[lineOffset + pixelOffset + 1])*(1.0f/255.0f), power_)*255.0f+0.5f);
-                        dataWrite[lineOffset + pixelOffset + 2]=uint8_t(powf(float(dataRead[lineOffset + pixelOffset + 2])*(1.0f/255.0f), power_)*255.0f+0.5f);
-                        pixelOffset+=bytesPerPixel;
-                    }
+                    dataWrite[lineOffset + x]=powf(dataRead[lineOffset + x], power_);
                 }
             }
+        } else
+        {//Integer formats.
+            tables_[imgNum].apply(*imRead, *imWrite, MaxRowBands_);
         }
-
-
-        //Stop stats measurement event.
-        ProcessorStats_->tock();
-
-        releaseWriteSlot();
-        releaseReadSlot();
-
-        return true;
     }
-
-    return false;
 }
 
 
@@ -52,38 +52,37 @@ bool FIPTransform2D::init()
 
 bool FIPTransform2D::trigger()
 {
-    if ((getNumReadSlotsAvailable())&&(getNumWriteSlotsAvailable()))
-    {//There are images to consume and the downstream producer has space to produce.
-        std::vector<Image**> imvRead=reserveReadSlot();
-        std::vector<Image**> imvWrite=reserveWriteSlot();
+    return triggerFrame();
+}
+
+void FIPTransform2D::processFrame(const std::vector<Image**>& imvRead, const std::vector<Image**>& imvWrite)
+{
+    for (size_t imgNum=0; imgNum<ImagesPerSlot_; ++imgNum)
+    {
+        Image const * const imRead = *(imvRead[imgNum]);
+        Image * const imWrite = *(imvWrite[imgNum]);
+        
+        uint8_t const * const dataRead=(uint8_t const * const)imRead->data();
+        uint8_t * const dataWrite=(uint8_t * const )imWrite->data();
+        
+        const ImageFormat imFormatUS=getUpstreamFormat(imgNum);
+        const ImageFormat imFormatDS=getDownstreamFormat(imgNum);
+        
+        const int widthUS=imFormatUS.getWidth();
+        //const int heightUS=imFormatUS.getHeight();
+        const int widthDS=imFormatDS.getWidth();
+        const int heightDS=imFormatDS.getHeight();
         
-        //Start stats measurement event.
-        ProcessorStats_->tick();
+        const float halfWidthDS=widthDS * 0.5f;
+        const float halfHeightDS=heightDS * 0.5f;
         
-        for (size_t imgNum=0; imgNum<ImagesPerSlot_; ++imgNum)
+        const M2D transform=transformVect_[imgNum];
+        
+        const int bytesPerPixel=imFormatUS.getBytesPerPixel();
+        
+        parallelRows(heightDS, FLITR_PARALLEL_ROWS_GRAIN, [&](const RowBand& band)
         {
-            Image const * const imRead = *(imvRead[imgNum]);
-            Image * const imWrite = *(imvWrite[imgNum]);
-            
-            uint8_t const * const dataRead=(uint8_t const * const)imRead->data();
-            uint8_t * const dataWrite=(uint8_t * const )imWrite->data();
-            
-            const ImageFormat imFormatUS=getUpstreamFormat(imgNum);
-            const ImageFormat imFormatDS=getDownstreamFormat(imgNum);
-            
-            const int widthUS=imFormatUS.getWidth();
-            //const int heightUS=imFormatUS.getHeight();
-            const int widthDS=imFormatDS.getWidth();
-            const int heightDS=imFormatDS.getHeight();
-            
-            const float halfWidthDS=widthDS * 0.5f;
-            const float halfHeightDS=heightDS * 0.5f;
-            
-            const M2D transform=transformVect_[imgNum];
-            
-            const int bytesPerPixel=imFormatUS.getBytesPerPixel();
-            
-            for (int y=0; y<heightDS; ++y)
+            for (int y=int(band.Begin); y<int(band.End); ++y)
             {
                 int writeOffset=(y*widthDS)*bytesPerPixel;
                 
@@ -101,19 +100,8 @@ bool FIPTransform2D::trigger()
                     writeOffset+=bytesPerPixel;
                 }
             }
-        }
-        
-        
-        //Stop stats measurement event.
-        ProcessorStats_->tock();
-        
-        releaseWriteSlot();
-        releaseReadSlot();
-        
-        return true;
+        });
     }
-    
-    return false;
 }
 
 
@@ -114,6 +114,7 @@ bool TargetInjector::trigger()
                             offset=y*width*3;
                             break;
                         case ImageFormat::FLITR_PIX_FMT_BGRA :
+                        case ImageFormat::FLITR_PIX_FMT_RGBA :
                             offset=y*width*4;
                             break;
                         case ImageFormat::FLITR_PIX_FMT_Y_F32 :
@@ -122,6 +123,12 @@ bool TargetInjector::trigger()
                         case ImageFormat::FLITR_PIX_FMT_RGB_F32 :
                             //Not handled yet.
                             break;
+                        case ImageFormat::FLITR_PIX_FMT_YUV420P :
+                        case ImageFormat::FLITR_PIX_FMT_NV12 :
+                        case ImageFormat::FLITR_PIX_FMT_YUYV :
+                            //The target is drawn into the Y plane, which comes first.
+                            offset=y*imFormat.getBytesPerLine();
+                            break;
                             
                         case ImageFormat::FLITR_PIX_FMT_UNDF:
                             //Should not happen.
@@ -161,6 +168,7 @@ bool TargetInjector::trigger()
                                 dataWrite[offset+2]=(uint8_t)(dataRead[offset+2]*(1.0f-targetSupportDensity)+targetBrightness_*targetSupportDensity+0.5f);
                                 break;
                             case ImageFormat::FLITR_PIX_FMT_BGRA :
+                            case ImageFormat::FLITR_PIX_FMT_RGBA :
                                 dataWrite[offset]=(uint8_t)(dataRead[offset]*(1.0f-targetSupportDensity)+targetBrightness_*targetSupportDensity+0.5f);
                                 dataWrite[offset+1]=(uint8_t)(dataRead[offset+1]*(1.0f-targetSupportDensity)+targetBrightness_*targetSupportDensity+0.5f);
                                 dataWrite[offset+2]=(uint8_t)(dataRead[offset+2]*(1.0f-targetSupportDensity)+targetBrightness_*targetSupportDensity+0.5f);
@@ -171,6 +179,12 @@ bool TargetInjector::trigger()
                             case ImageFormat::FLITR_PIX_FMT_RGB_F32 :
                                 //Not handled yet.
                                 break;
+                            case ImageFormat::FLITR_PIX_FMT_YUV420P :
+                            case ImageFormat::FLITR_PIX_FMT_NV12 :
+                            case ImageFormat::FLITR_PIX_FMT_YUYV :
+                                //Y only. YUYV has U or V in the second byte of each pixel, which is left as is.
+                                dataWrite[offset]=(uint8_t)(dataRead[offset]*(1.0f-targetSupportDensity)+targetBrightness_*targetSupportDensity+0.5f);
+                                break;
                                 
                             case ImageFormat::FLITR_PIX_FMT_UNDF:
                                 //Should not happen.
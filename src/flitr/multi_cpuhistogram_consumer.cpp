@@ -85,8 +85,8 @@ void MultiCPUHistogramConsumerThread::run()
             imageCount++;
         } else
         {
-            // wait a while for producers.
-            FThread::microSleep(1000);
+            // block until the producers have written.
+            Consumer_->waitForReadSlot();
         }
         // check for exit
         if (ShouldExit_) {
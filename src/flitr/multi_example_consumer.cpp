@@ -75,8 +75,8 @@ void MultiExampleConsumerThread::run()
             _consumer->releaseReadSlot();
         } else
         {
-            // wait a while for producers.
-            FThread::microSleep(1000);
+            // block until the producers have written.
+            _consumer->waitForReadSlot();
         }
         // check for exit
         if (_shouldExit) {
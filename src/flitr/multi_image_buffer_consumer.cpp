@@ -66,8 +66,8 @@ void MultiImageBufferConsumerThread::run()
             _consumer->releaseReadSlot();
         } else
         {
-            // wait a while for producers.
-            FThread::microSleep(1000);
+            // block until the producers have written.
+            _consumer->waitForReadSlot();
         }
         // check for exit
         if (_shouldExit) {
@@ -59,8 +59,8 @@ void MultiRawVideoFileConsumerThread::run()
             // indicate we are done with the image/s
             Consumer_->releaseReadSlot();
         } else {
-            // wait a while for producers.
-            FThread::microSleep(1000);
+            // block until the producers have written.
+            Consumer_->waitForReadSlot();
         }
         // check for exit
         if (ShouldExit_) {
@@ -0,0 +1,159 @@
+/* Framework for Live Image Transformation (FLITr)
+ * Copyright (c) 2010 CSIR
+ *
+ * This file is part of FLITr.
+ *
+ * FLITr is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * FLITr is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with FLITr. If not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+
+#include <flitr/parallel_rows.h>
+
+#include <algorithm>
+
+using namespace flitr;
+
+void ParallelRowsThread::run()
+{
+    Pool_->runWorker();
+}
+
+ParallelRowsPool::ParallelRowsPool(uint32_t num_threads, int32_t cpu_affinity) :
+    ShouldExit_(false)
+{
+    for (uint32_t i=0; i<num_threads; i++)
+    {
+        Threads_.push_back(std::unique_ptr<ParallelRowsThread>(new ParallelRowsThread(this)));
+        Threads_.back()->startThread(cpu_affinity);
+    }
+}
+
+ParallelRowsPool::~ParallelRowsPool()
+{
+    {
+        std::lock_guard<std::mutex> jobsLock(JobsMutex_);
+        ShouldExit_ = true;
+    }
+    JobsCondition_.notify_all();
+
+    for (size_t i=0; i<Threads_.size(); i++)
+    {
+        Threads_[i]->join();
+    }
+}
+
+ParallelRowsPool& ParallelRowsPool::instance()
+{
+    static ParallelRowsPool pool(std::max<uint32_t>(std::thread::hardware_concurrency(), 1) - 1);
+    return pool;
+}
+
+void ParallelRowsPool::run(size_t height, size_t grain_size, size_t halo, const RowBandFunction& fn,
+                           uint32_t max_bands)
+{
+    if (height==0)
+    {
+        return;
+    }
+
+    size_t numBands = (max_bands > 0) ? size_t(max_bands) : (getNumThreads() + 1);
+    numBands = std::min(numBands, std::max<size_t>(height / std::max<size_t>(grain_size, 1), 1));
+
+    if (numBands==1)
+    {// Not worth waking anyone.
+        RowBand band;
+        band.Begin = 0;
+        band.End = height;
+        band.HaloBegin = 0;
+        band.HaloEnd = height;
+        fn(band);
+        return;
+    }
+
+    std::shared_ptr<Job> job(new Job());
+    job->Function = &fn;
+    job->Height = height;
+    job->Halo = halo;
+    job->NumBands = uint32_t(numBands);
+    job->NextBand = 0;
+    job->NumDone = 0;
+
+    {
+        std::lock_guard<std::mutex> jobsLock(JobsMutex_);
+        Jobs_.push_back(job);
+    }
+    JobsCondition_.notify_all();
+
+    processBands(*job);
+
+    {
+        std::lock_guard<std::mutex> jobsLock(JobsMutex_);
+        std::deque<std::shared_ptr<Job> >::iterator it = std::find(Jobs_.begin(), Jobs_.end(), job);
+        if (it != Jobs_.end()) Jobs_.erase(it);
+    }
+
+    std::unique_lock<std::mutex> doneLock(job->DoneMutex);
+    job->DoneCondition.wait(doneLock, [&job]() { return job->NumDone.load() == job->NumBands; });
+}
+
+void ParallelRowsPool::processBands(Job& job)
+{
+    while (true)
+    {
+        const uint32_t b = job.NextBand.fetch_add(1);
+        if (b >= job.NumBands)
+        {
+            break;
+        }
+
+        RowBand band;
+        band.Begin = (job.Height * b) / job.NumBands;
+        band.End = (job.Height * (b+1)) / job.NumBands;
+        band.HaloBegin = (band.Begin > job.Halo) ? (band.Begin - job.Halo) : 0;
+        band.HaloEnd = std::min(band.End + job.Halo, job.Height);
+
+        (*job.Function)(band);
+
+        if ((job.NumDone.fetch_add(1) + 1) == job.NumBands)
+        {
+            std::lock_guard<std::mutex> doneLock(job.DoneMutex);
+            job.DoneCondition.notify_all();
+        }
+    }
+}
+
+void ParallelRowsPool::runWorker()
+{
+    while (true)
+    {
+        std::shared_ptr<Job> job;
+        {
+            std::unique_lock<std::mutex> jobsLock(JobsMutex_);
+            JobsCondition_.wait(jobsLock, [this]() { return ShouldExit_ || !Jobs_.empty(); });
+            if (ShouldExit_)
+            {
+                return;
+            }
+
+            job = Jobs_.front();
+            if (job->NextBand.load() >= job->NumBands)
+            {// Every band is claimed. Leave it to the threads processing them.
+                Jobs_.pop_front();
+                continue;
+            }
+        }
+
+        processBands(*job);
+    }
+}
@@ -0,0 +1,603 @@
+/* Framework for Live Image Transformation (FLITr)
+ * Copyright (c) 2010 CSIR
+ *
+ * This file is part of FLITr.
+ *
+ * FLITr is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * FLITr is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with FLITr. If not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+
+#include <flitr/pixel_format_converter.h>
+#include <flitr/cpu_features.h>
+
+#include <cstring>
+
+#if defined(FLITR_X86_SIMD)
+#include <immintrin.h>
+#endif
+#if defined(FLITR_NEON_SIMD)
+#include <arm_neon.h>
+#endif
+
+using namespace flitr;
+
+namespace {
+
+    // Pixel layouts. The kernels are instantiated per pair of layouts so
+    // that the per pixel code has no branches on the format.
+    struct Y8 { enum { Bytes = 1 }; };
+    struct Y16 { enum { Bytes = 2 }; };
+    struct YF32 { enum { Bytes = 4 }; };
+    struct RGBF32 { enum { Bytes = 12 }; };
+
+    // 8 bit colour with the byte offsets of the channels. A is -1 without alpha.
+    template<int R, int G, int B, int A, int N>
+    struct Colour8 { enum { ROff = R, GOff = G, BOff = B, AOff = A, Bytes = N }; };
+
+    typedef Colour8<0, 1, 2, -1, 3> RGB8;
+    typedef Colour8<2, 1, 0, -1, 3> BGR8;
+    typedef Colour8<2, 1, 0, 3, 4> BGRA8;
+    typedef Colour8<0, 1, 2, 3, 4> RGBA8;
+
+    const float Inv256 = 0.00390625f;
+    const float Inv768 = 0.00390625f * 0.333333333333f;
+    const float Inv65536 = 0.0000152587890625f;
+
+    inline uint8_t floatTo8(const float v, const float scale)
+    {
+        const float s = v * (256.0f * scale) + 0.5f;
+        return (s >= 255.0f) ? ((uint8_t)255) : ((s <= 0.0f) ? ((uint8_t)0) : ((uint8_t)s));
+    }
+
+    inline uint16_t floatTo16(const float v, const float scale)
+    {
+        const float s = v * (65536.0f * scale) + 0.5f;
+        return (s >= 65535.0f) ? ((uint16_t)65535) : ((s <= 0.0f) ? ((uint16_t)0) : ((uint16_t)s));
+    }
+
+    template<int R, int G, int B, int A, int N>
+    inline void writeGrey(uint8_t * const o, const uint8_t g, Colour8<R, G, B, A, N>)
+    {
+        o[R] = g; o[G] = g; o[B] = g;
+        if (A >= 0) o[A] = 255;
+    }
+
+    inline void writeGrey(float * const o, const float g)
+    {
+        o[0] = g; o[1] = g; o[2] = g;
+    }
+
+    template<int R, int G, int B, int A, int N>
+    inline uint32_t sum8(uint8_t const * const i, Colour8<R, G, B, A, N>)
+    {
+        return uint32_t(i[R]) + uint32_t(i[G]) + uint32_t(i[B]);
+    }
+
+    //=== One pixel, per pair of layouts ===//
+
+    // From Y_8.
+    inline void cnvrt(Y8, Y8, uint8_t const * i, uint8_t * o, float) { *o = *i; }
+    template<int R, int G, int B, int A, int N>
+    inline void cnvrt(Y8, Colour8<R, G, B, A, N> c, uint8_t const * i, uint8_t * o, float) { writeGrey(o, *i, c); }
+    inline void cnvrt(Y8, Y16, uint8_t const * i, uint8_t * o, float) { *((uint16_t *)o) = uint16_t(*i) << 8; }
+    inline void cnvrt(Y8, YF32, uint8_t const * i, uint8_t * o, float) { *((float *)o) = (*i) * Inv256; }
+    inline void cnvrt(Y8, RGBF32, uint8_t const * i, uint8_t * o, float) { writeGrey((float *)o, (*i) * Inv256); }
+
+    // From 8 bit colour.
+    template<int R, int G, int B, int A, int N>
+    inline void cnvrt(Colour8<R, G, B, A, N> c, Y8, uint8_t const * i, uint8_t * o, float) { *o = uint8_t(sum8(i, c) / 3); }
+    template<int R, int G, int B, int A, int N, int R2, int G2, int B2, int A2, int N2>
+    inline void cnvrt(Colour8<R, G, B, A, N>, Colour8<R2, G2, B2, A2, N2>, uint8_t const * i, uint8_t * o, float)
+    {
+        o[R2] = i[R]; o[G2] = i[G]; o[B2] = i[B];
+        if (A2 >= 0) o[A2] = (A >= 0) ? i[A >= 0 ? A : 0] : 255;
+    }
+    template<int R, int G, int B, int A, int N>
+    inline void cnvrt(Colour8<R, G, B, A, N> c, Y16, uint8_t const * i, uint8_t * o, float) { *((uint16_t *)o) = uint16_t((sum8(i, c) << 8) / 3); }
+    template<int R, int G, int B, int A, int N>
+    inline void cnvrt(Colour8<R, G, B, A, N> c, YF32, uint8_t const * i, uint8_t * o, float) { *((float *)o) = sum8(i, c) * Inv768; }
+    template<int R, int G, int B, int A, int N>
+    inline void cnvrt(Colour8<R, G, B, A, N>, RGBF32, uint8_t const * i, uint8_t * o, float)
+    {
+        float * const f = (float *)o;
+        f[0] = i[R] * Inv256; f[1] = i[G] * Inv256; f[2] = i[B] * Inv256;
+    }
+
+    // From Y_16.
+    inline void cnvrt(Y16, Y8, uint8_t const * i, uint8_t * o, float) { *o = uint8_t(*((uint16_t const *)i) >> 8); }
+    template<int R, int G, int B, int A, int N>
+    inline void cnvrt(Y16, Colour8<R, G, B, A, N> c, uint8_t const * i, uint8_t * o, float) { writeGrey(o, uint8_t(*((uint16_t const *)i) >> 8), c); }
+    inline void cnvrt(Y16, Y16, uint8_t const * i, uint8_t * o, float) { *((uint16_t *)o) = *((uint16_t const *)i); }
+    inline void cnvrt(Y16, YF32, uint8_t const * i, uint8_t * o, float) { *((float *)o) = *((uint16_t const *)i) * Inv65536; }
+    inline void cnvrt(Y16, RGBF32, uint8_t const * i, uint8_t * o, float) { writeGrey((float *)o, *((uint16_t const *)i) * Inv65536); }
+
+    // From Y_F32.
+    inline void cnvrt(YF32, Y8, uint8_t const * i, uint8_t * o, float s) { *o = floatTo8(*((float const *)i), s); }
+    template<int R, int G, int B, int A, int N>
+    inline void cnvrt(YF32, Colour8<R, G, B, A, N> c, uint8_t const * i, uint8_t * o, float s) { writeGrey(o, floatTo8(*((float const *)i), s), c); }
+    inline void cnvrt(YF32, Y16, uint8_t const * i, uint8_t * o, float s) { *((uint16_t *)o) = floatTo16(*((float const *)i), s); }
+    inline void cnvrt(YF32, YF32, uint8_t const * i, uint8_t * o, float) { *((float *)o) = *((float const *)i); }
+    inline void cnvrt(YF32, RGBF32, uint8_t const * i, uint8_t * o, float) { writeGrey((float *)o, *((float const *)i)); }
+
+    // From RGB_F32.
+    inline float meanF(uint8_t const * i)
+    {
+        float const * const f = (float const *)i;
+        return (f[0] + f[1] + f[2]) * 0.333333333333f;
+    }
+    inline void cnvrt(RGBF32, Y8, uint8_t const * i, uint8_t * o, float s) { *o = floatTo8(meanF(i), s); }
+    template<int R, int G, int B, int A, int N>
+    inline void cnvrt(RGBF32, Colour8<R, G, B, A, N>, uint8_t const * i, uint8_t * o, float s)
+    {
+        float const * const f = (float const *)i;
+        o[R] = floatTo8(f[0], s); o[G] = floatTo8(f[1], s); o[B] = floatTo8(f[2], s);
+        if (A >= 0) o[A >= 0 ? A : 0] = 255;
+    }
+    inline void cnvrt(RGBF32, Y16, uint8_t const * i, uint8_t * o, float s) { *((uint16_t *)o) = floatTo16(meanF(i), s); }
+    inline void cnvrt(RGBF32, YF32, uint8_t const * i, uint8_t * o, float) { *((float *)o) = meanF(i); }
+    inline void cnvrt(RGBF32, RGBF32, uint8_t const * i, uint8_t * o, float)
+    {
+        float const * const f = (float const *)i;
+        float * const g = (float *)o;
+        g[0] = f[0]; g[1] = f[1]; g[2] = f[2];
+    }
+
+    //=== Rows ===//
+
+    template<class In, class Out>
+    void rowScalar(uint8_t const * in, uint8_t * out, size_t width, float scale)
+    {
+        for (size_t x = 0; x < width; ++x)
+        {
+            cnvrt(In(), Out(), in + x * In::Bytes, out + x * Out::Bytes, scale);
+        }
+    }
+
+    template<int Bytes>
+    void rowCopy(uint8_t const * in, uint8_t * out, size_t width, float)
+    {
+        memcpy(out, in, width * Bytes);
+    }
+
+#if defined(FLITR_X86_SIMD)
+    FLITR_TARGET("sse2") void rowY8ToYF32SSE2(uint8_t const * in, uint8_t * out, size_t width, float scale)
+    {
+        float * const o = (float *)out;
+        const __m128i zero = _mm_setzero_si128();
+        const __m128 k = _mm_set1_ps(Inv256);
+        size_t x = 0;
+        for (; x + 16 <= width; x += 16)
+        {
+            const __m128i v = _mm_loadu_si128((__m128i const *)(in + x));
+            const __m128i lo = _mm_unpacklo_epi8(v, zero);
+            const __m128i hi = _mm_unpackhi_epi8(v, zero);
+            _mm_storeu_ps(o + x + 0, _mm_mul_ps(_mm_cvtepi32_ps(_mm_unpacklo_epi16(lo, zero)), k));
+            _mm_storeu_ps(o + x + 4, _mm_mul_ps(_mm_cvtepi32_ps(_mm_unpackhi_epi16(lo, zero)), k));
+            _mm_storeu_ps(o + x + 8, _mm_mul_ps(_mm_cvtepi32_ps(_mm_unpacklo_epi16(hi, zero)), k));
+            _mm_storeu_ps(o + x + 12, _mm_mul_ps(_mm_cvtepi32_ps(_mm_unpackhi_epi16(hi, zero)), k));
+        }
+        rowScalar<Y8, YF32>(in + x, out + x * 4, width - x, scale);
+    }
+
+    // Scaled, rounded and clamped to [0, 255]. Truncation then matches floatTo8().
+    FLITR_TARGET("sse2") inline __m128i floatTo32SSE2(float const * f, const __m128 k)
+    {
+        const __m128 s = _mm_add_ps(_mm_mul_ps(_mm_loadu_ps(f), k), _mm_set1_ps(0.5f));
+        return _mm_cvttps_epi32(_mm_min_ps(_mm_max_ps(s, _mm_setzero_ps()), _mm_set1_ps(255.0f)));
+    }
+
+    FLITR_TARGET("sse2") void rowYF32ToY8SSE2(uint8_t const * in, uint8_t * out, size_t width, float scale)
+    {
+        float const * const f = (float const *)in;
+        const __m128 k = _mm_set1_ps(256.0f * scale);
+        size_t x = 0;
+        for (; x + 16 <= width; x += 16)
+        {
+            const __m128i a = _mm_packs_epi32(floatTo32SSE2(f + x + 0, k), floatTo32SSE2(f + x + 4, k));
+            const __m128i b = _mm_packs_epi32(floatTo32SSE2(f + x + 8, k), floatTo32SSE2(f + x + 12, k));
+            _mm_storeu_si128((__m128i *)(out + x), _mm_packus_epi16(a, b));
+        }
+        rowScalar<YF32, Y8>(in + x * 4, out + x, width - x, scale);
+    }
+
+    FLITR_TARGET("sse2") void rowY8ToY16SSE2(uint8_t const * in, uint8_t * out, size_t width, float scale)
+    {
+        const __m128i zero = _mm_setzero_si128();
+        size_t x = 0;
+        for (; x + 16 <= width; x += 16)
+        {
+            const __m128i v = _mm_loadu_si128((__m128i const *)(in + x));
+            _mm_storeu_si128((__m128i *)(out + x * 2), _mm_unpacklo_epi8(zero, v));
+            _mm_storeu_si128((__m128i *)(out + x * 2 + 16), _mm_unpackhi_epi8(zero, v));
+        }
+        rowScalar<Y8, Y16>(in + x, out + x * 2, width - x, scale);
+    }
+
+    FLITR_TARGET("sse2") void rowY16ToY8SSE2(uint8_t const * in, uint8_t * out, size_t width, float scale)
+    {
+        size_t x = 0;
+        for (; x + 16 <= width; x += 16)
+        {
+            const __m128i a = _mm_srli_epi16(_mm_loadu_si128((__m128i const *)(in + x * 2)), 8);
+            const __m128i b = _mm_srli_epi16(_mm_loadu_si128((__m128i const *)(in + x * 2 + 16)), 8);
+            _mm_storeu_si128((__m128i *)(out + x), _mm_packus_epi16(a, b));
+        }
+        rowScalar<Y16, Y8>(in + x * 2, out + x, width - x, scale);
+    }
+
+    // Grey to either 4 byte colour layout. R, G and B are equal, so only alpha has to be placed.
+    template<class Out>
+    FLITR_TARGET("sse2") void rowY8ToColour32SSE2(uint8_t const * in, uint8_t * out, size_t width, float scale)
+    {
+        const __m128i alpha = _mm_set1_epi8((char)0xFF);
+        size_t x = 0;
+        for (; x + 16 <= width; x += 16)
+        {
+            const __m128i v = _mm_loadu_si128((__m128i const *)(in + x));
+            const __m128i vv = _mm_unpacklo_epi8(v, v);
+            const __m128i va = _mm_unpacklo_epi8(v, alpha);
+            const __m128i vv2 = _mm_unpackhi_epi8(v, v);
+            const __m128i va2 = _mm_unpackhi_epi8(v, alpha);
+            _mm_storeu_si128((__m128i *)(out + x * 4 + 0), _mm_unpacklo_epi16(vv, va));
+            _mm_storeu_si128((__m128i *)(out + x * 4 + 16), _mm_unpackhi_epi16(vv, va));
+            _mm_storeu_si128((__m128i *)(out + x * 4 + 32), _mm_unpacklo_epi16(vv2, va2));
+            _mm_storeu_si128((__m128i *)(out + x * 4 + 48), _mm_unpackhi_epi16(vv2, va2));
+        }
+        rowScalar<Y8, Out>(in + x, out + x * 4, width - x, scale);
+    }
+
+    // BGRA <-> RGBA: swap bytes 0 and 2 of every pixel.
+    template<class In, class Out>
+    FLITR_TARGET("sse2") void rowSwapRB32SSE2(uint8_t const * in, uint8_t * out, size_t width, float scale)
+    {
+        const __m128i keep = _mm_set1_epi32(0xFF00FF00);
+        const __m128i low = _mm_set1_epi32(0x000000FF);
+        size_t x = 0;
+        for (; x + 4 <= width; x += 4)
+        {
+            const __m128i v = _mm_loadu_si128((__m128i const *)(in + x * 4));
+            const __m128i r = _mm_or_si128(_mm_and_si128(v, keep),
+                                           _mm_or_si128(_mm_and_si128(_mm_srli_epi32(v, 16), low),
+                                                        _mm_slli_epi32(_mm_and_si128(v, low), 16)));
+            _mm_storeu_si128((__m128i *)(out + x * 4), r);
+        }
+        rowScalar<In, Out>(in + x * 4, out + x * 4, width - x, scale);
+    }
+
+    // Grey to either 3 byte colour layout.
+    template<class Out>
+    FLITR_TARGET("ssse3") void rowY8ToColour24SSSE3(uint8_t const * in, uint8_t * out, size_t width, float scale)
+    {
+        const __m128i m0 = _mm_setr_epi8(0, 0, 0, 1, 1, 1, 2, 2, 2, 3, 3, 3, 4, 4, 4, 5);
+        const __m128i m1 = _mm_setr_epi8(5, 5, 6, 6, 6, 7, 7, 7, 8, 8, 8, 9, 9, 9, 10, 10);
+        const __m128i m2 = _mm_setr_epi8(10, 11, 11, 11, 12, 12, 12, 13, 13, 13, 14, 14, 14, 15, 15, 15);
+        size_t x = 0;
+        for (; x + 16 <= width; x += 16)
+        {
+            const __m128i v = _mm_loadu_si128((__m128i const *)(in + x));
+            _mm_storeu_si128((__m128i *)(out + x * 3 + 0), _mm_shuffle_epi8(v, m0));
+            _mm_storeu_si128((__m128i *)(out + x * 3 + 16), _mm_shuffle_epi8(v, m1));
+            _mm_storeu_si128((__m128i *)(out + x * 3 + 32), _mm_shuffle_epi8(v, m2));
+        }
+        rowScalar<Y8, Out>(in + x, out + x * 3, width - x, scale);
+    }
+
+    // RGB <-> BGR, five pixels per 16 byte load. The 16th byte written is
+    // overwritten by the next step, so a spare pixel must follow.
+    template<class In, class Out>
+    FLITR_TARGET("ssse3") void rowSwapRB24SSSE3(uint8_t const * in, uint8_t * out, size_t width, float scale)
+    {
+        const __m128i m = _mm_setr_epi8(2, 1, 0, 5, 4, 3, 8, 7, 6, 11, 10, 9, 14, 13, 12, 15);
+        size_t x = 0;
+        for (; x + 6 <= width; x += 5)
+        {
+            const __m128i v = _mm_loadu_si128((__m128i const *)(in + x * 3));
+            _mm_storeu_si128((__m128i *)(out + x * 3), _mm_shuffle_epi8(v, m));
+        }
+        rowScalar<In, Out>(in + x * 3, out + x * 3, width - x, scale);
+    }
+
+    FLITR_TARGET("avx2") void rowY8ToYF32AVX2(uint8_t const * in, uint8_t * out, size_t width, float scale)
+    {
+        float * const o = (float *)out;
+        const __m256 k = _mm256_set1_ps(Inv256);
+        size_t x = 0;
+        for (; x + 16 <= width; x += 16)
+        {
+            const __m256i a = _mm256_cvtepu8_epi32(_mm_loadl_epi64((__m128i const *)(in + x)));
+            const __m256i b = _mm256_cvtepu8_epi32(_mm_loadl_epi64((__m128i const *)(in + x + 8)));
+            _mm256_storeu_ps(o + x, _mm256_mul_ps(_mm256_cvtepi32_ps(a), k));
+            _mm256_storeu_ps(o + x + 8, _mm256_mul_ps(_mm256_cvtepi32_ps(b), k));
+        }
+        rowScalar<Y8, YF32>(in + x, out + x * 4, width - x, scale);
+    }
+
+    FLITR_TARGET("avx2") void rowYF32ToY8AVX2(uint8_t const * in, uint8_t * out, size_t width, float scale)
+    {
+        float const * const f = (float const *)in;
+        const __m256 k = _mm256_set1_ps(256.0f * scale);
+        const __m256 half = _mm256_set1_ps(0.5f);
+        const __m256 zero = _mm256_setzero_ps();
+        const __m256 top = _mm256_set1_ps(255.0f);
+        size_t x = 0;
+        for (; x + 16 <= width; x += 16)
+        {
+            const __m256 a = _mm256_min_ps(_mm256_max_ps(_mm256_add_ps(_mm256_mul_ps(_mm256_loadu_ps(f + x), k), half), zero), top);
+            const __m256 b = _mm256_min_ps(_mm256_max_ps(_mm256_add_ps(_mm256_mul_ps(_mm256_loadu_ps(f + x + 8), k), half), zero), top);
+            // packs works per 128 bit lane, so restore the order afterwards.
+            const __m256i p = _mm256_packs_epi32(_mm256_cvttps_epi32(a), _mm256_cvttps_epi32(b));
+            const __m256i q = _mm256_permute4x64_epi64(p, 0xD8);
+            const __m128i r = _mm_packus_epi16(_mm256_castsi256_si128(q), _mm256_extracti128_si256(q, 1));
+            _mm_storeu_si128((__m128i *)(out + x), r);
+        }
+        rowScalar<YF32, Y8>(in + x * 4, out + x, width - x, scale);
+    }
+
+// GCC 12 warns about the undefined upper lanes inside its own AVX-512 conversion intrinsics.
+#if defined(__GNUC__) && !defined(__clang__)
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wmaybe-uninitialized"
+#endif
+    FLITR_TARGET("avx512f,avx512bw") void rowY8ToYF32AVX512(uint8_t const * in, uint8_t * out, size_t width, float scale)
+    {
+        float * const o = (float *)out;
+        const __m512 k = _mm512_set1_ps(Inv256);
+        size_t x = 0;
+        for (; x + 16 <= width; x += 16)
+        {
+            const __m512i v = _mm512_cvtepu8_epi32(_mm_loadu_si128((__m128i const *)(in + x)));
+            _mm512_storeu_ps(o + x, _mm512_mul_ps(_mm512_cvtepi32_ps(v), k));
+        }
+        rowScalar<Y8, YF32>(in + x, out + x * 4, width - x, scale);
+    }
+
+    FLITR_TARGET("avx512f,avx512bw") void rowYF32ToY8AVX512(uint8_t const * in, uint8_t * out, size_t width, float scale)
+    {
+        float const * const f = (float const *)in;
+        const __m512 k = _mm512_set1_ps(256.0f * scale);
+        const __m512 half = _mm512_set1_ps(0.5f);
+        const __m512 zero = _mm512_setzero_ps();
+        const __m512 top = _mm512_set1_ps(255.0f);
+        size_t x = 0;
+        for (; x + 16 <= width; x += 16)
+        {
+            const __m512 a = _mm512_min_ps(_mm512_max_ps(_mm512_add_ps(_mm512_mul_ps(_mm512_loadu_ps(f + x), k), half), zero), top);
+            _mm_storeu_si128((__m128i *)(out + x), _mm512_cvtepi32_epi8(_mm512_cvttps_epi32(a)));
+        }
+        rowScalar<YF32, Y8>(in + x * 4, out + x, width - x, scale);
+    }
+#if defined(__GNUC__) && !defined(__clang__)
+#pragma GCC diagnostic pop
+#endif
+#endif
+
+#if defined(FLITR_NEON_SIMD)
+    void rowY8ToYF32NEON(uint8_t const * in, uint8_t * out, size_t width, float scale)
+    {
+        float * const o = (float *)out;
+        const float32x4_t k = vdupq_n_f32(Inv256);
+        size_t x = 0;
+        for (; x + 16 <= width; x += 16)
+        {
+            const uint8x16_t v = vld1q_u8(in + x);
+            const uint16x8_t lo = vmovl_u8(vget_low_u8(v));
+            const uint16x8_t hi = vmovl_u8(vget_high_u8(v));
+            vst1q_f32(o + x + 0, vmulq_f32(vcvtq_f32_u32(vmovl_u16(vget_low_u16(lo))), k));
+            vst1q_f32(o + x + 4, vmulq_f32(vcvtq_f32_u32(vmovl_u16(vget_high_u16(lo))), k));
+            vst1q_f32(o + x + 8, vmulq_f32(vcvtq_f32_u32(vmovl_u16(vget_low_u16(hi))), k));
+            vst1q_f32(o + x + 12, vmulq_f32(vcvtq_f32_u32(vmovl_u16(vget_high_u16(hi))), k));
+        }
+        rowScalar<Y8, YF32>(in + x, out + x * 4, width - x, scale);
+    }
+
+    // Scaled, rounded and clamped to [0, 255], as floatTo8().
+    inline uint16x4_t floatTo8x4NEON(float const * f, const float32x4_t k)
+    {
+        const float32x4_t s = vaddq_f32(vmulq_f32(vld1q_f32(f), k), vdupq_n_f32(0.5f));
+        return vmovn_u32(vcvtq_u32_f32(vminq_f32(vmaxq_f32(s, vdupq_n_f32(0.0f)), vdupq_n_f32(255.0f))));
+    }
+
+    void rowYF32ToY8NEON(uint8_t const * in, uint8_t * out, size_t width, float scale)
+    {
+        float const * const f = (float const *)in;
+        const float32x4_t k = vdupq_n_f32(256.0f * scale);
+        size_t x = 0;
+        for (; x + 8 <= width; x += 8)
+        {
+            vst1_u8(out + x, vmovn_u16(vcombine_u16(floatTo8x4NEON(f + x, k), floatTo8x4NEON(f + x + 4, k))));
+        }
+        rowScalar<YF32, Y8>(in + x * 4, out + x, width - x, scale);
+    }
+
+    void rowY8ToY16NEON(uint8_t const * in, uint8_t * out, size_t width, float scale)
+    {
+        uint16_t * const o = (uint16_t *)out;
+        size_t x = 0;
+        for (; x + 8 <= width; x += 8)
+        {
+            vst1q_u16(o + x, vshll_n_u8(vld1_u8(in + x), 8));
+        }
+        rowScalar<Y8, Y16>(in + x, out + x * 2, width - x, scale);
+    }
+
+    void rowY16ToY8NEON(uint8_t const * in, uint8_t * out, size_t width, float scale)
+    {
+        uint16_t const * const i = (uint16_t const *)in;
+        size_t x = 0;
+        for (; x + 8 <= width; x += 8)
+        {
+            vst1_u8(out + x, vshrn_n_u16(vld1q_u16(i + x), 8));
+        }
+        rowScalar<Y16, Y8>(in + x * 2, out + x, width - x, scale);
+    }
+#endif
+
+    //=== Choosing the row kernel ===//
+
+    // Vectorised kernels, best first. The first one the CPU supports is used.
+    struct VectorKernel {
+        ImageFormat::PixelFormat In;
+        ImageFormat::PixelFormat Out;
+        SimdLevel Level;
+        PixelFormatConverter::RowFunction Row;
+    };
+
+    typedef ImageFormat F;
+
+    const VectorKernel VectorKernels[] = {
+#if defined(FLITR_X86_SIMD)
+        { F::FLITR_PIX_FMT_Y_8, F::FLITR_PIX_FMT_Y_F32, FLITR_SIMD_AVX512, &rowY8ToYF32AVX512 },
+        { F::FLITR_PIX_FMT_Y_F32, F::FLITR_PIX_FMT_Y_8, FLITR_SIMD_AVX512, &rowYF32ToY8AVX512 },
+        { F::FLITR_PIX_FMT_Y_8, F::FLITR_PIX_FMT_Y_F32, FLITR_SIMD_AVX2, &rowY8ToYF32AVX2 },
+        { F::FLITR_PIX_FMT_Y_F32, F::FLITR_PIX_FMT_Y_8, FLITR_SIMD_AVX2, &rowYF32ToY8AVX2 },
+        { F::FLITR_PIX_FMT_Y_8, F::FLITR_PIX_FMT_RGB_8, FLITR_SIMD_SSSE3, &rowY8ToColour24SSSE3<RGB8> },
+        { F::FLITR_PIX_FMT_Y_8, F::FLITR_PIX_FMT_BGR, FLITR_SIMD_SSSE3, &rowY8ToColour24SSSE3<BGR8> },
+        { F::FLITR_PIX_FMT_RGB_8, F::FLITR_PIX_FMT_BGR, FLITR_SIMD_SSSE3, &rowSwapRB24SSSE3<RGB8, BGR8> },
+        { F::FLITR_PIX_FMT_BGR, F::FLITR_PIX_FMT_RGB_8, FLITR_SIMD_SSSE3, &rowSwapRB24SSSE3<BGR8, RGB8> },
+        { F::FLITR_PIX_FMT_Y_8, F::FLITR_PIX_FMT_Y_F32, FLITR_SIMD_SSE2, &rowY8ToYF32SSE2 },
+        { F::FLITR_PIX_FMT_Y_F32, F::FLITR_PIX_FMT_Y_8, FLITR_SIMD_SSE2, &rowYF32ToY8SSE2 },
+        { F::FLITR_PIX_FMT_Y_8, F::FLITR_PIX_FMT_Y_16, FLITR_SIMD_SSE2, &rowY8ToY16SSE2 },
+        { F::FLITR_PIX_FMT_Y_16, F::FLITR_PIX_FMT_Y_8, FLITR_SIMD_SSE2, &rowY16ToY8SSE2 },
+        { F::FLITR_PIX_FMT_Y_8, F::FLITR_PIX_FMT_BGRA, FLITR_SIMD_SSE2, &rowY8ToColour32SSE2<BGRA8> },
+        { F::FLITR_PIX_FMT_Y_8, F::FLITR_PIX_FMT_RGBA, FLITR_SIMD_SSE2, &rowY8ToColour32SSE2<RGBA8> },
+        { F::FLITR_PIX_FMT_BGRA, F::FLITR_PIX_FMT_RGBA, FLITR_SIMD_SSE2, &rowSwapRB32SSE2<BGRA8, RGBA8> },
+        { F::FLITR_PIX_FMT_RGBA, F::FLITR_PIX_FMT_BGRA, FLITR_SIMD_SSE2, &rowSwapRB32SSE2<RGBA8, BGRA8> },
+#endif
+#if defined(FLITR_NEON_SIMD)
+        { F::FLITR_PIX_FMT_Y_8, F::FLITR_PIX_FMT_Y_F32, FLITR_SIMD_NEON, &rowY8ToYF32NEON },
+        { F::FLITR_PIX_FMT_Y_F32, F::FLITR_PIX_FMT_Y_8, FLITR_SIMD_NEON, &rowYF32ToY8NEON },
+        { F::FLITR_PIX_FMT_Y_8, F::FLITR_PIX_FMT_Y_16, FLITR_SIMD_NEON, &rowY8ToY16NEON },
+        { F::FLITR_PIX_FMT_Y_16, F::FLITR_PIX_FMT_Y_8, FLITR_SIMD_NEON, &rowY16ToY8NEON },
+#endif
+        { F::FLITR_PIX_FMT_UNDF, F::FLITR_PIX_FMT_UNDF, FLITR_SIMD_SCALAR, 0 }
+    };
+
+    struct Kernel {
+        PixelFormatConverter::RowFunction Row;
+        const char* Name;
+    };
+
+    Kernel scalar(PixelFormatConverter::RowFunction row)
+    {
+        Kernel k = { row, "scalar" };
+        return k;
+    }
+
+    template<class In>
+    Kernel chooseScalar(const ImageFormat::PixelFormat out_fmt)
+    {
+        switch (out_fmt)
+        {
+            case ImageFormat::FLITR_PIX_FMT_Y_8: return scalar(&rowScalar<In, Y8>);
+            case ImageFormat::FLITR_PIX_FMT_RGB_8: return scalar(&rowScalar<In, RGB8>);
+            case ImageFormat::FLITR_PIX_FMT_BGR: return scalar(&rowScalar<In, BGR8>);
+            case ImageFormat::FLITR_PIX_FMT_BGRA: return scalar(&rowScalar<In, BGRA8>);
+            case ImageFormat::FLITR_PIX_FMT_RGBA: return scalar(&rowScalar<In, RGBA8>);
+            case ImageFormat::FLITR_PIX_FMT_Y_16: return scalar(&rowScalar<In, Y16>);
+            case ImageFormat::FLITR_PIX_FMT_Y_F32: return scalar(&rowScalar<In, YF32>);
+            case ImageFormat::FLITR_PIX_FMT_RGB_F32: return scalar(&rowScalar<In, RGBF32>);
+            default: return scalar(0);
+        }
+    }
+
+    Kernel chooseScalar(const ImageFormat::PixelFormat in_fmt, const ImageFormat::PixelFormat out_fmt)
+    {
+        switch (in_fmt)
+        {
+            case ImageFormat::FLITR_PIX_FMT_Y_8: return chooseScalar<Y8>(out_fmt);
+            case ImageFormat::FLITR_PIX_FMT_RGB_8: return chooseScalar<RGB8>(out_fmt);
+            case ImageFormat::FLITR_PIX_FMT_BGR: return chooseScalar<BGR8>(out_fmt);
+            case ImageFormat::FLITR_PIX_FMT_BGRA: return chooseScalar<BGRA8>(out_fmt);
+            case ImageFormat::FLITR_PIX_FMT_RGBA: return chooseScalar<RGBA8>(out_fmt);
+            case ImageFormat::FLITR_PIX_FMT_Y_16: return chooseScalar<Y16>(out_fmt);
+            case ImageFormat::FLITR_PIX_FMT_Y_F32: return chooseScalar<YF32>(out_fmt);
+            case ImageFormat::FLITR_PIX_FMT_RGB_F32: return chooseScalar<RGBF32>(out_fmt);
+            default: return scalar(0);
+        }
+    }
+
+    Kernel chooseKernel(const ImageFormat::PixelFormat in_fmt, const ImageFormat::PixelFormat out_fmt)
+    {
+        Kernel k = chooseScalar(in_fmt, out_fmt);
+        if (k.Row == 0)
+        {
+            return k;
+        }
+
+        if (in_fmt == out_fmt)
+        {
+            switch (ImageFormat(0, 0, in_fmt).getBytesPerPixel())
+            {
+                case 1: k.Row = &rowCopy<1>; break;
+                case 2: k.Row = &rowCopy<2>; break;
+                case 3: k.Row = &rowCopy<3>; break;
+                case 4: k.Row = &rowCopy<4>; break;
+                case 12: k.Row = &rowCopy<12>; break;
+                default: break;
+            }
+            k.Name = "copy";
+            return k;
+        }
+
+        for (size_t i = 0; i < sizeof(VectorKernels) / sizeof(VectorKernels[0]); ++i)
+        {
+            const VectorKernel& v = VectorKernels[i];
+            if ((v.Row != 0) && (v.In == in_fmt) && (v.Out == out_fmt) && isSimdLevelEnabled(v.Level))
+            {
+                k.Row = v.Row;
+                k.Name = getSimdLevelName(v.Level);
+                return k;
+            }
+        }
+
+        return k;
+    }
+}
+
+PixelFormatConverter::PixelFormatConverter(ImageFormat::PixelFormat in_fmt, ImageFormat::PixelFormat out_fmt,
+                                           float scale_factor) :
+    InFormat_(in_fmt),
+    OutFormat_(out_fmt),
+    Scale_(scale_factor)
+{
+    const Kernel k = chooseKernel(in_fmt, out_fmt);
+    Row_ = k.Row;
+    KernelName_ = (k.Row != 0) ? k.Name : "";
+}
+
+void PixelFormatConverter::convert(uint8_t const * in, size_t in_bytes_per_line,
+                                   uint8_t * out, size_t out_bytes_per_line,
+                                   size_t width, size_t height) const
+{
+    for (size_t y = 0; y < height; ++y)
+    {
+        Row_(in + y * in_bytes_per_line, out + y * out_bytes_per_line, width, Scale_);
+    }
+}
+
+bool PixelFormatConverter::convert(const Image& in, Image& out) const
+{
+    const ImageFormat& inFormat = *in.format();
+    const ImageFormat& outFormat = *out.format();
+    if (!isSupported() ||
+        (inFormat.getPixelFormat() != InFormat_) || (outFormat.getPixelFormat() != OutFormat_) ||
+        (inFormat.getWidth() != outFormat.getWidth()) || (inFormat.getHeight() != outFormat.getHeight()))
+    {
+        return false;
+    }
+
+    convert(in.data(), inFormat.getBytesPerLine(), out.data(), outFormat.getBytesPerLine(),
+            inFormat.getWidth(), inFormat.getHeight());
+    return true;
+}
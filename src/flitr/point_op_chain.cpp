@@ -0,0 +1,233 @@
+/* Framework for Live Image Transformation (FLITr)
+ * Copyright (c) 2010 CSIR
+ *
+ * This file is part of FLITr.
+ *
+ * FLITr is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * FLITr is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with FLITr. If not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+
+#include <flitr/point_op_chain.h>
+#include <flitr/fast_math.h>
+#include <flitr/parallel_rows.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+using namespace flitr;
+
+namespace {
+
+    bool isColour(ImageFormat::PixelFormat fmt)
+    {
+        return ImageFormat(0, 0, fmt).getComponentsPerPixel() >= 3;
+    }
+
+    /*! x^power for x>0, as exp2(power*log2(x)) with polynomials instead of calls into libm,
+     * so that loops of it vectorise. The relative error is below 1e-5 while power*log2(x)
+     * stays within [-126, 127].*/
+    inline float powPositive(const float x, const float power)
+    {
+        const float y = std::min(std::max(power * fastLog2(x), -126.0f), 127.0f);
+
+        // 2^y = 2^n * e^(f*ln(2)) with f in [-0.5, 0.5]. y + 127.5 is positive, so the
+        // conversion to int rounds it down, which rounds y to the nearest n. A real conversion
+        // is needed: -ffast-math folds the float rounding trick of adding and subtracting
+        // 1.5*2^23 back to y.
+        const int32_t n = int32_t(y + 127.5f) - 127;
+        const float g = (y - float(n)) * 0.693147181f;
+        const float expG = 1.0f + g * (1.0f + g * (1.0f / 2.0f + g * (1.0f / 6.0f + g * (1.0f / 24.0f + g * (1.0f / 120.0f + g * (1.0f / 720.0f))))));
+        return floatFromBits(bitsFromFloat(expG) + int32_t(uint32_t(n) << 23));
+    }
+
+    /*! values = table at (values - minimum)*scale, interpolated linearly and limited to
+     * [0, last]. The table has an entry past last. __restrict tells the compiler that the
+     * gathers from the table do not depend on the stores to values, which it cannot check.*/
+    void lookUp(float * __restrict values, float const * __restrict table, const size_t n,
+                const float minimum, const float scale, const float last)
+    {
+        for (size_t i = 0; i < n; ++i)
+        {
+            // p is not negative, so the conversion to int rounds it down. k is last at most,
+            // and table[last + 1] exists.
+            const float unclamped = (values[i] - minimum) * scale;
+            const float p = (unclamped > 0.0f) ? ((unclamped < last) ? unclamped : last) : 0.0f;
+            const int32_t k = int32_t(p);
+            values[i] = table[k] + (table[k + 1] - table[k]) * (p - float(k));
+        }
+    }
+
+    // The float format that the operations work on.
+    ImageFormat::PixelFormat floatFormat(ImageFormat::PixelFormat in_fmt, ImageFormat::PixelFormat out_fmt)
+    {
+        return (isColour(in_fmt) && isColour(out_fmt)) ? ImageFormat::FLITR_PIX_FMT_RGB_F32 : ImageFormat::FLITR_PIX_FMT_Y_F32;
+    }
+}
+
+const size_t PointOpChain::TilePixels;
+
+PointOpChain::PointOpChain(ImageFormat::PixelFormat in_fmt, ImageFormat::PixelFormat out_fmt, float scale_factor) :
+    ToFloat_(in_fmt, floatFormat(in_fmt, out_fmt)),
+    FromFloat_(floatFormat(in_fmt, out_fmt), out_fmt, scale_factor),
+    Channels_((floatFormat(in_fmt, out_fmt) == ImageFormat::FLITR_PIX_FMT_RGB_F32) ? 3 : 1),
+    InBytesPerPixel_(ImageFormat(0, 0, in_fmt).getBytesPerPixel()),
+    OutBytesPerPixel_(ImageFormat(0, 0, out_fmt).getBytesPerPixel())
+{
+}
+
+void PointOpChain::addGainOffset(float gain, float offset)
+{
+    PointOp op;
+    op.Type = OP_GAIN_OFFSET;
+    op.A = gain;
+    op.B = offset;
+    op.C = 0.0f;
+    Ops_.push_back(op);
+}
+
+void PointOpChain::addPower(float power)
+{
+    PointOp op;
+    op.Type = OP_POWER;
+    op.A = power;
+    op.B = 0.0f;
+    op.C = 0.0f;
+    Ops_.push_back(op);
+}
+
+void PointOpChain::addThreshold(float threshold, float below, float above)
+{
+    PointOp op;
+    op.Type = OP_THRESHOLD;
+    op.A = threshold;
+    op.B = below;
+    op.C = above;
+    Ops_.push_back(op);
+}
+
+void PointOpChain::addLUT(const std::vector<float>& table, float minimum, float maximum)
+{
+    if (table.empty())
+    {
+        return;
+    }
+
+    // A = minimum, B = entries per unit and C = the last index. The last entry is repeated
+    // so that interpolating at the last index reads inside the table.
+    PointOp op;
+    op.Type = OP_LUT;
+    op.A = minimum;
+    op.B = (maximum > minimum) ? float(table.size() - 1) / (maximum - minimum) : 0.0f;
+    op.C = float(table.size() - 1);
+    op.Table = table;
+    op.Table.push_back(table.back());
+    Ops_.push_back(op);
+}
+
+void PointOpChain::addClamp(float minimum, float maximum)
+{
+    PointOp op;
+    op.Type = OP_CLAMP;
+    op.A = minimum;
+    op.B = maximum;
+    op.C = 0.0f;
+    Ops_.push_back(op);
+}
+
+void PointOpChain::applyOps(float * values, size_t n) const
+{
+    // One simple loop per operation, which the compiler vectorises.
+    for (size_t o = 0; o < Ops_.size(); ++o)
+    {
+        const PointOp& op = Ops_[o];
+        const float a = op.A;
+        const float b = op.B;
+        const float c = op.C;
+
+        switch (op.Type)
+        {
+            case OP_GAIN_OFFSET:
+                for (size_t i = 0; i < n; ++i)
+                {
+                    values[i] = values[i] * a + b;
+                }
+                break;
+            case OP_POWER:
+                for (size_t i = 0; i < n; ++i)
+                {
+                    const float v = powPositive(values[i], a);
+                    values[i] = (values[i] > 0.0f) ? v : 0.0f;
+                }
+                break;
+            case OP_THRESHOLD:
+                for (size_t i = 0; i < n; ++i)
+                {
+                    values[i] = (values[i] >= a) ? c : b;
+                }
+                break;
+            case OP_LUT:
+                lookUp(values, &op.Table[0], n, a, b, c);
+                break;
+            case OP_CLAMP:
+                for (size_t i = 0; i < n; ++i)
+                {
+                    values[i] = std::min(std::max(values[i], a), b);
+                }
+                break;
+        }
+    }
+}
+
+void PointOpChain::applyRow(uint8_t const * in, uint8_t * out, size_t width) const
+{
+    float tile[TilePixels * 3];
+
+    for (size_t x = 0; x < width; x += TilePixels)
+    {
+        const size_t n = std::min(TilePixels, width - x);
+        ToFloat_.convertRow(in + x * InBytesPerPixel_, (uint8_t *)tile, n);
+        applyOps(tile, n * Channels_);
+        FromFloat_.convertRow((uint8_t const *)tile, out + x * OutBytesPerPixel_, n);
+    }
+}
+
+void PointOpChain::apply(uint8_t const * in, size_t in_bytes_per_line,
+                         uint8_t * out, size_t out_bytes_per_line,
+                         size_t width, size_t height, uint32_t max_bands) const
+{
+    ParallelRowsPool::instance().run(height, FLITR_PARALLEL_ROWS_GRAIN, 0, [&](const RowBand& band)
+    {
+        for (size_t y = band.Begin; y < band.End; ++y)
+        {
+            applyRow(in + y * in_bytes_per_line, out + y * out_bytes_per_line, width);
+        }
+    }, max_bands);
+}
+
+bool PointOpChain::apply(const Image& in, Image& out, uint32_t max_bands) const
+{
+    const ImageFormat& inFormat = *in.format();
+    const ImageFormat& outFormat = *out.format();
+    if (!isSupported() ||
+        (inFormat.getPixelFormat() != getInputFormat()) || (outFormat.getPixelFormat() != getOutputFormat()) ||
+        (inFormat.getWidth() != outFormat.getWidth()) || (inFormat.getHeight() != outFormat.getHeight()))
+    {
+        return false;
+    }
+
+    apply(in.data(), inFormat.getBytesPerLine(), out.data(), outFormat.getBytesPerLine(),
+          inFormat.getWidth(), inFormat.getHeight(), max_bands);
+    return true;
+}
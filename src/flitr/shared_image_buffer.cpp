@@ -23,18 +23,60 @@
 #include <flitr/image_producer.h>
 
 #include <algorithm>
+#include <chrono>
+#include <memory>
+#include <new>
 
 using namespace flitr;
 
-SharedImageBuffer::SharedImageBuffer(ImageProducer& my_producer, uint32_t num_slots, uint32_t images_per_slot) :
+SharedImageBuffer::SharedImageBuffer(ImageProducer& my_producer, uint32_t num_slots, uint32_t images_per_slot,
+                                     SyncMode sync_mode) :
 	ImageProducer_(&my_producer),
 	NumSlots_(num_slots+1),
 	ImagesPerSlot_(images_per_slot),
 	WriteTail_(0),
 	WriteHead_(0),
 	NumWriteReserved_(0),
-	HasStorage_(false)
+	HasStorage_(false),
+	SyncMode_(sync_mode),
+	SeqWriteHead_(0),
+	SeqWriteTail_(0),
+	SeqNumWriteReserved_(0),
+	CachedMinReadTail_(0),
+	SeqPoppedTail_(0),
+	NumConsumerIndices_(0),
+	Cursors_(0),
+	CursorStorage_(0),
+	NumReadWaiters_(0),
+	NumWriteWaiters_(0),
+	NumSlotListeners_(0)
 {
+    static_assert(sizeof(ConsumerCursor) == FLITR_CACHE_LINE_SIZE,
+                  "A consumer cursor must fill exactly one cache line.");
+
+    if (SyncMode_==SYNC_LOCK_FREE_SPMC)
+    {
+        // Over-allocate by one cache line and align the cursor array
+        // by hand. The C++11 operator new[] does not honour alignas.
+        size_t space = (FLITR_SHARED_BUFFER_MAX_LOCK_FREE_CONSUMERS + 1) * sizeof(ConsumerCursor);
+        CursorStorage_ = new uint8_t[space];
+        void *aligned = CursorStorage_;
+        std::align(FLITR_CACHE_LINE_SIZE,
+                    FLITR_SHARED_BUFFER_MAX_LOCK_FREE_CONSUMERS * sizeof(ConsumerCursor),
+                    aligned, space);
+
+        Cursors_ = static_cast<ConsumerCursor*>(aligned);
+        for (uint32_t i=0; i<FLITR_SHARED_BUFFER_MAX_LOCK_FREE_CONSUMERS; i++)
+        {
+            ConsumerCursor *c = new (&Cursors_[i]) ConsumerCursor;
+            c->ReadHead.store(0, std::memory_order_relaxed);
+            c->ReadTail.store(0, std::memory_order_relaxed);
+            c->NumDropped.store(0, std::memory_order_relaxed);
+            c->NumReadReserved.store(0, std::memory_order_relaxed);
+            c->Policy.store(OVERFLOW_LOSSLESS, std::memory_order_relaxed);
+            c->Active.store(false, std::memory_order_relaxed);
+        }
+    }
 }
 
 SharedImageBuffer::~SharedImageBuffer()
@@ -49,12 +91,26 @@ SharedImageBuffer::~SharedImageBuffer()
 			}
 		}
 	}
+
+    // The cursors are trivially destructible.
+    delete [] CursorStorage_;
 }
 
 bool SharedImageBuffer::initWithStorage(const bool zero_mem)
 {
     // assert producer has all formats
 
+    // One pool per image in the slot, as the formats may differ.
+    // Buffers are padded to a whole vector, so that kernels may load
+    // full vectors up to the end of the last row.
+    std::vector< std::shared_ptr<ImageBufferPool> > pools;
+    for (uint32_t j=0; j<ImagesPerSlot_; j++)
+    {
+        const size_t bytes = ImageProducer_->getFormat(j).getBytesPerImage();
+        const size_t padded = ((bytes + FLITR_DEFAULT_ROW_ALIGNMENT - 1) / FLITR_DEFAULT_ROW_ALIGNMENT) * FLITR_DEFAULT_ROW_ALIGNMENT;
+        pools.push_back(std::shared_ptr<ImageBufferPool>(new ImageBufferPool(padded, zero_mem)));
+    }
+
 	// create images
 	Buffer_.clear();
 	Buffer_.resize(NumSlots_);
@@ -63,7 +119,7 @@ bool SharedImageBuffer::initWithStorage(const bool zero_mem)
 		Buffer_[i].reserve(ImagesPerSlot_);
 		for (uint32_t j=0; j<ImagesPerSlot_; j++)
         {
-			Buffer_[i].push_back(new Image(ImageProducer_->getFormat(j), zero_mem));
+			Buffer_[i].push_back(new Image(ImageProducer_->getFormat(j), pools[j]));
 		}
 	}
 	HasStorage_=true;
@@ -102,6 +158,9 @@ uint32_t SharedImageBuffer::getFill() const
             max_fill = fill;
         }
     }
+    // Consumers that allow dropping are kept below full by
+    // dropOverrunSlots(), unless they are busy with their oldest slot.
+
     // also check writer
     uint32_t fill = (WriteHead_ + NumSlots_ - WriteTail_) % NumSlots_;
     if (fill > max_fill)
@@ -134,20 +193,287 @@ bool SharedImageBuffer::tailPopped(const ImageConsumer& consumer)
     return true;
 }
 
+uint32_t SharedImageBuffer::getMaxReadGap() const
+{
+    // caller should lock
+    typedef std::map< const ImageConsumer*, uint32_t >::const_iterator map_it;
+    uint32_t max_gap = 0;
+    for (map_it i = ReadTails_.begin(); i != ReadTails_.end(); ++i)
+    {
+        uint32_t gap = (WriteTail_ + NumSlots_ - i->second) % NumSlots_;
+        if (gap > max_gap)
+        {
+            max_gap = gap;
+        }
+    }
+    return max_gap;
+}
+
+uint32_t SharedImageBuffer::dropOverrunSlots()
+{
+    // caller should lock
+    const uint32_t gap_before = getMaxReadGap();
+
+    typedef std::map< const ImageConsumer*, uint32_t >::iterator map_it;
+    for (map_it i = ReadTails_.begin(); i != ReadTails_.end(); ++i)
+    {
+        const ImageConsumer* c = i->first;
+        if (OverflowPolicies_[c] == OVERFLOW_LOSSLESS)
+        {
+            continue;
+        }
+
+        uint32_t& read_tail = i->second;
+        uint32_t& read_head = ReadHeads_[c];
+        // Leave space for the next write. A consumer busy with its
+        // oldest slots (head != tail) keeps holding the producer back.
+        while ((read_head == read_tail) && (read_tail != WriteTail_) &&
+               (((WriteHead_ + NumSlots_ - read_tail) % NumSlots_) >= (NumSlots_ - 1)))
+        {
+            read_tail = (read_tail + 1) % NumSlots_;
+            read_head = read_tail;
+            NumDropped_[c]++;
+        }
+    }
+
+    return gap_before - getMaxReadGap();
+}
+
 uint32_t SharedImageBuffer::numAvailable(const ImageConsumer& consumer)
 {
+    if (SyncMode_==SYNC_LOCK_FREE_SPMC)
+    {
+        const ConsumerCursor& c = cursor(consumer);
+        return (uint32_t)(SeqWriteTail_.load(std::memory_order_acquire) -
+                          c.ReadHead.load(std::memory_order_relaxed));
+    }
+
 	// caller should lock
 	uint32_t read_head = ReadHeads_[&consumer];
 	return (WriteTail_ + NumSlots_ - read_head) % NumSlots_;
 }
 
-bool SharedImageBuffer::addConsumer(ImageConsumer& consumer)
+SharedImageBuffer::ConsumerCursor& SharedImageBuffer::cursor(const ImageConsumer& consumer) const
+{
+    return Cursors_[consumer.SharedImageBufferIndex_];
+}
+
+uint64_t SharedImageBuffer::scanMinReadTail() const
+{
+    // Without consumers the writer's own tail limits the fill.
+    uint64_t min_tail = SeqWriteTail_.load(std::memory_order_acquire);
+
+    const uint32_t num_indices = NumConsumerIndices_.load(std::memory_order_acquire);
+    for (uint32_t i=0; i<num_indices; i++)
+    {
+        const ConsumerCursor& c = Cursors_[i];
+        if (c.Active.load(std::memory_order_acquire))
+        {
+            const uint64_t read_tail = c.ReadTail.load(std::memory_order_acquire);
+            if (read_tail < min_tail)
+            {
+                min_tail = read_tail;
+            }
+        }
+    }
+    return min_tail;
+}
+
+void SharedImageBuffer::reportPoppedSlots()
+{
+    // Every slot that all consumers are now done with is reported
+    // exactly once. Threads racing to report the same slot settle it
+    // with the compare-exchange.
+    const uint64_t min_tail = scanMinReadTail();
+    uint64_t popped_tail = SeqPoppedTail_.load(std::memory_order_acquire);
+    uint32_t num_popped = 0;
+    while (popped_tail < min_tail)
+    {
+        if (SeqPoppedTail_.compare_exchange_weak(popped_tail, popped_tail + 1,
+                                                 std::memory_order_acq_rel))
+        {
+            ++popped_tail;
+            ++num_popped;
+        }
+    }
+
+    for (uint32_t i=0; i<num_popped; i++)
+    {
+        ImageProducer_->releaseReadSlotCallback();
+    }
+}
+
+void SharedImageBuffer::dropOverrunSlotsLockFree()
+{
+    const uint64_t write_head = SeqWriteHead_.load(std::memory_order_relaxed);
+    if ((write_head + 2) <= NumSlots_)
+    {
+        // The buffer has not wrapped yet.
+        return;
+    }
+    // Every tail must be at least here for the next write to succeed.
+    const uint64_t min_tail = std::min<uint64_t>(write_head + 2 - NumSlots_,
+                                                 SeqWriteTail_.load(std::memory_order_relaxed));
+
+    bool dropped = false;
+    const uint32_t num_indices = NumConsumerIndices_.load(std::memory_order_acquire);
+    for (uint32_t i=0; i<num_indices; i++)
+    {
+        ConsumerCursor& c = Cursors_[i];
+        if (!c.Active.load(std::memory_order_acquire) ||
+            (c.Policy.load(std::memory_order_relaxed) == OVERFLOW_LOSSLESS))
+        {
+            continue;
+        }
+
+        uint64_t read_tail = c.ReadTail.load(std::memory_order_acquire);
+        while (read_tail < min_tail)
+        {
+            uint64_t read_head = read_tail;
+            if (c.ReadHead.compare_exchange_strong(read_head, read_tail + 1,
+                                                   std::memory_order_acq_rel, std::memory_order_acquire))
+            {
+                c.NumDropped.fetch_add(1, std::memory_order_relaxed);
+                read_tail = c.ReadTail.fetch_add(1, std::memory_order_acq_rel) + 1;
+                dropped = true;
+            } else
+            {
+                // Either the consumer holds the oldest slot, or it
+                // has just released one and moved its tail.
+                const uint64_t new_tail = c.ReadTail.load(std::memory_order_acquire);
+                if (new_tail == read_tail)
+                {
+                    break;
+                }
+                read_tail = new_tail;
+            }
+        }
+    }
+
+    CachedMinReadTail_ = scanMinReadTail();
+    if (dropped)
+    {
+        reportPoppedSlots();
+    }
+}
+
+void SharedImageBuffer::notifyWaiters(SlotEvent event)
+{
+    std::condition_variable& condition = (event==SLOT_READABLE) ? ReadableCondition_ : WritableCondition_;
+    const std::atomic<uint32_t>& num_waiters = (event==SLOT_READABLE) ? NumReadWaiters_ : NumWriteWaiters_;
+
+    // Pairs with the fence in the wait functions: either the waiter
+    // sees the new buffer state or we see the waiter.
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if (num_waiters.load(std::memory_order_relaxed) != 0)
+    {
+        // Taking the mutex ensures that a waiter that has just checked
+        // the old state is already blocked before it is notified.
+        {
+            std::lock_guard<std::mutex> waitLock(WaitMutex_);
+        }
+        condition.notify_all();
+    }
+
+    if (NumSlotListeners_.load(std::memory_order_relaxed) != 0)
+    {
+        std::lock_guard<std::mutex> listenerLock(ListenerMutex_);
+        for (const SlotListenerEntry& entry : SlotListeners_)
+        {
+            if (entry.Event==event)
+            {
+                entry.Listener();
+            }
+        }
+    }
+}
+
+void SharedImageBuffer::addSlotListener(SlotEvent event, const void* owner, SlotListener listener)
+{
+    std::lock_guard<std::mutex> listenerLock(ListenerMutex_);
+    SlotListenerEntry entry;
+    entry.Event = event;
+    entry.Owner = owner;
+    entry.Listener = listener;
+    SlotListeners_.push_back(entry);
+    NumSlotListeners_.store(uint32_t(SlotListeners_.size()));
+}
+
+void SharedImageBuffer::removeSlotListeners(const void* owner)
+{
+    std::lock_guard<std::mutex> listenerLock(ListenerMutex_);
+    std::vector<SlotListenerEntry>::iterator it = SlotListeners_.begin();
+    while (it != SlotListeners_.end())
+    {
+        if (it->Owner==owner)
+        {
+            it = SlotListeners_.erase(it);
+        } else
+        {
+            ++it;
+        }
+    }
+    NumSlotListeners_.store(uint32_t(SlotListeners_.size()));
+}
+
+bool SharedImageBuffer::addConsumer(ImageConsumer& consumer, OverflowPolicy overflow_policy)
 {
     std::lock_guard<std::mutex> scopedLock(BufferMutex_);
 
+    if (SyncMode_==SYNC_LOCK_FREE_SPMC)
+    {
+        // Registration is rare, so the mutex only serialises
+        // add/remove against each other. Reuse a free cursor index if
+        // one is available to keep the scanned range dense.
+        const uint32_t num_indices = NumConsumerIndices_.load(std::memory_order_relaxed);
+        uint32_t index = num_indices;
+        bool any_active = false;
+        for (uint32_t i=0; i<num_indices; i++)
+        {
+            if (Cursors_[i].Active.load(std::memory_order_relaxed))
+            {
+                any_active = true;
+            } else if (index == num_indices)
+            {
+                index = i;
+            }
+        }
+        if (index >= FLITR_SHARED_BUFFER_MAX_LOCK_FREE_CONSUMERS)
+        {
+            logMessage(LOG_CRITICAL) << "SharedImageBuffer: Too many consumers for the lock-free mode.\n";
+            return false;
+        }
+
+        // init both to the current write tail
+        const uint64_t write_tail = SeqWriteTail_.load(std::memory_order_acquire);
+        ConsumerCursor& c = Cursors_[index];
+        c.ReadHead.store(write_tail, std::memory_order_relaxed);
+        c.ReadTail.store(write_tail, std::memory_order_relaxed);
+        c.NumDropped.store(0, std::memory_order_relaxed);
+        c.NumReadReserved.store(0, std::memory_order_relaxed);
+        c.Policy.store(overflow_policy, std::memory_order_relaxed);
+        if (!any_active)
+        {
+            // Slots written while nobody was listening are never reported as popped.
+            SeqPoppedTail_.store(write_tail, std::memory_order_relaxed);
+        }
+        c.Active.store(true, std::memory_order_release);
+        if (index == num_indices)
+        {
+            NumConsumerIndices_.store(num_indices + 1, std::memory_order_release);
+        }
+
+        consumer.SharedImageBufferIndex_ = index;
+        consumer.setSharedImageBuffer(*this);
+        return true;
+    }
+
     // init both to the current write tail
     ReadTails_[&consumer] = WriteTail_;
 	ReadHeads_[&consumer] = WriteTail_;
+    NumReadReserved_[&consumer] = 0;
+    OverflowPolicies_[&consumer] = overflow_policy;
+    NumDropped_[&consumer] = 0;
 
 	consumer.setSharedImageBuffer(*this);
 
@@ -155,65 +481,299 @@ bool SharedImageBuffer::addConsumer(ImageConsumer& consumer)
 }
 
 bool SharedImageBuffer::removeConsumer(ImageConsumer& consumer) {
+    {
+        std::lock_guard<std::mutex> scopedLock(BufferMutex_);
+
+        if (SyncMode_==SYNC_LOCK_FREE_SPMC)
+        {
+            if (consumer.SharedImageBufferIndex_ < 0)
+            {
+                return false;
+            }
+            cursor(consumer).Active.store(false, std::memory_order_release);
+            consumer.SharedImageBufferIndex_ = -1;
+        } else
+        {
+            int numErased;
+            numErased  = ReadTails_.erase(&consumer);
+            numErased += ReadHeads_.erase(&consumer);
+            NumReadReserved_.erase(&consumer);
+            OverflowPolicies_.erase(&consumer);
+            NumDropped_.erase(&consumer);
+            if(numErased == 0)
+            {
+                return false;
+            }
+        }
+    }
+
+    // The removed consumer may have been the one holding up the producer.
+    // Notify without BufferMutex_ held, as notifyWaiters() takes WaitMutex_.
+    notifyWaiters(SLOT_WRITABLE);
+    return true;
+}
+
+SharedImageBuffer::OverflowPolicy SharedImageBuffer::getOverflowPolicy(const ImageConsumer& consumer)
+{
+    if (SyncMode_==SYNC_LOCK_FREE_SPMC)
+    {
+        return (OverflowPolicy)cursor(consumer).Policy.load(std::memory_order_relaxed);
+    }
+
     std::lock_guard<std::mutex> scopedLock(BufferMutex_);
+    return OverflowPolicies_[&consumer];
+}
 
-    int numErased;
-    numErased  = ReadTails_.erase(&consumer);
-    numErased += ReadHeads_.erase(&consumer);
-    if(numErased == 0)
+uint64_t SharedImageBuffer::getNumDroppedSlots(const ImageConsumer& consumer)
+{
+    if (SyncMode_==SYNC_LOCK_FREE_SPMC)
     {
-        return false;
+        return cursor(consumer).NumDropped.load(std::memory_order_relaxed);
     }
-    return true;
+
+    std::lock_guard<std::mutex> scopedLock(BufferMutex_);
+    return NumDropped_[&consumer];
 }
 
 uint32_t SharedImageBuffer::getNumWriteSlotsAvailable() const
 {
-    //OpenThreads::ScopedLock<OpenThreads::Mutex> buflock(BufferMutex_);
+    if (SyncMode_==SYNC_LOCK_FREE_SPMC)
+    {
+        // Leave CachedMinReadTail_ to reserveWriteSlot() so that this may be
+        // called from threads other than the producer's, e.g. by waiters.
+        const uint64_t fill = SeqWriteHead_.load(std::memory_order_relaxed) - scanMinReadTail();
+        return (uint32_t)((NumSlots_ - 1) - fill);
+    }
+
+    std::lock_guard<std::mutex> scopedLock(BufferMutex_);
     // only allow up to -1, to diff between full and empty cases
    return std::max<int32_t>( ( ((int32_t)NumSlots_) - 1 ) - getFill(), 0);
 }
 
 uint32_t SharedImageBuffer::getNumWriteSlotsReserved()
 {
+    if (SyncMode_==SYNC_LOCK_FREE_SPMC)
+    {
+        return SeqNumWriteReserved_.load(std::memory_order_relaxed);
+    }
+
     std::lock_guard<std::mutex> scopedLock(BufferMutex_);
     return NumWriteReserved_;
 }
 
 std::vector<Image**> SharedImageBuffer::reserveWriteSlot()
 {
-    std::lock_guard<std::mutex> scopedLock(BufferMutex_);
-	
-	std::vector<Image**> v;
-	
-	if (isFull())
+    std::vector<Image**> v;
+    uint32_t slot = 0;
+
+    if (SyncMode_==SYNC_LOCK_FREE_SPMC)
     {
-		// we cannot write more, dropping images
-		return v;
-	}
-	
-	for (uint32_t i=0; i<ImagesPerSlot_; i++)
+        if (!reserveWriteSlotLockFree(slot))
+        {
+            // we cannot write more, dropping images
+            return v;
+        }
+    } else
     {
-		v.push_back(&(Buffer_[WriteHead_][i]));
-	}
-	
-	WriteHead_ = (WriteHead_ + 1)  % NumSlots_;
-	NumWriteReserved_++;
-	
+        uint32_t num_popped = 0;
+        {
+            std::lock_guard<std::mutex> scopedLock(BufferMutex_);
+            if (!reserveWriteSlotLocked(slot, num_popped))
+            {
+                // we cannot write more, dropping images
+                return v;
+            }
+        }
+        makeWritable(slot);
+
+        for (uint32_t i=0; i<num_popped; i++)
+        {
+            ImageProducer_->releaseReadSlotCallback();
+        }
+    }
+
+    for (uint32_t i=0; i<ImagesPerSlot_; i++)
+    {
+        v.push_back(&(Buffer_[slot][i]));
+    }
 	return v;
 }
 
+SlotSpan SharedImageBuffer::reserveWriteSlots(uint32_t max_slots)
+{
+    SlotSpan span;
+    span.ImagesPerSlot_ = ImagesPerSlot_;
+    max_slots = std::min<uint32_t>(max_slots, FLITR_SLOT_SPAN_CAPACITY);
+    uint32_t slot = 0;
+
+    if (SyncMode_==SYNC_LOCK_FREE_SPMC)
+    {
+        while ((span.NumSlots_ < max_slots) && reserveWriteSlotLockFree(slot))
+        {
+            span.Slots_[span.NumSlots_++] = &(Buffer_[slot][0]);
+        }
+        return span;
+    }
+
+    uint32_t slots[FLITR_SLOT_SPAN_CAPACITY];
+    uint32_t num_popped = 0;
+    {
+        std::lock_guard<std::mutex> scopedLock(BufferMutex_);
+        while ((span.NumSlots_ < max_slots) && reserveWriteSlotLocked(slots[span.NumSlots_], num_popped))
+        {
+            ++span.NumSlots_;
+        }
+    }
+
+    for (uint32_t s=0; s<span.NumSlots_; s++)
+    {
+        makeWritable(slots[s]);
+        span.Slots_[s] = &(Buffer_[slots[s]][0]);
+    }
+
+    for (uint32_t i=0; i<num_popped; i++)
+    {
+        ImageProducer_->releaseReadSlotCallback();
+    }
+    return span;
+}
+
+bool SharedImageBuffer::reserveWriteSlotLocked(uint32_t& slot, uint32_t& num_popped)
+{
+    if (isFull())
+    {
+        return false;
+    }
+
+    slot = WriteHead_;
+    WriteHead_ = (WriteHead_ + 1)  % NumSlots_;
+    NumWriteReserved_++;
+
+    // Make space for the next write at the expense of the
+    // consumers that allow dropping, so they never stop it.
+    num_popped += dropOverrunSlots();
+    return true;
+}
+
+bool SharedImageBuffer::reserveWriteSlotLockFree(uint32_t& slot)
+{
+    const uint64_t write_head = SeqWriteHead_.load(std::memory_order_relaxed);
+    if ((write_head - CachedMinReadTail_) >= (NumSlots_ - 1))
+    {
+        // Only rescan the consumers when the cached tail says we are full.
+        CachedMinReadTail_ = scanMinReadTail();
+        if ((write_head - CachedMinReadTail_) >= (NumSlots_ - 1))
+        {
+            return false;
+        }
+    }
+
+    slot = (uint32_t)(write_head % NumSlots_);
+    SeqWriteHead_.store(write_head + 1, std::memory_order_relaxed);
+    SeqNumWriteReserved_.fetch_add(1, std::memory_order_relaxed);
+    makeWritable(slot);
+
+    // Make space for the next write at the expense of the
+    // consumers that allow dropping, so they never stop it.
+    if ((write_head + 1 - CachedMinReadTail_) >= (NumSlots_ - 1))
+    {
+        dropOverrunSlotsLockFree();
+    }
+    return true;
+}
+
+void SharedImageBuffer::makeWritable(uint32_t slot)
+{
+    if (!HasStorage_)
+    {
+        // The images belong to another buffer.
+        return;
+    }
+
+    // Images still referred to by a downstream slot get new storage.
+    for (uint32_t i=0; i<ImagesPerSlot_; i++)
+    {
+        Buffer_[slot][i]->makeWritable();
+    }
+}
+
 void SharedImageBuffer::releaseWriteSlot()
 {
-    std::lock_guard<std::mutex> scopedLock(BufferMutex_);
-	// assert !filled
-	// assert NumWriteReserved_>0
-	WriteTail_ = (WriteTail_ + 1)  % NumSlots_;
-	NumWriteReserved_--;
+    SharedImageBuffer::releaseWriteSlots(1);
+}
+
+void SharedImageBuffer::releaseWriteSlots(uint32_t num_slots)
+{
+    if (num_slots==0)
+    {
+        return;
+    }
+
+    if (SyncMode_==SYNC_LOCK_FREE_SPMC)
+    {
+        // Publish the written images to the consumers.
+        SeqWriteTail_.store(SeqWriteTail_.load(std::memory_order_relaxed) + num_slots, std::memory_order_release);
+        SeqNumWriteReserved_.fetch_sub(num_slots, std::memory_order_relaxed);
+    } else
+    {
+        std::lock_guard<std::mutex> scopedLock(BufferMutex_);
+        // assert !filled
+        // assert NumWriteReserved_>=num_slots
+        WriteTail_ = (WriteTail_ + num_slots)  % NumSlots_;
+        NumWriteReserved_ -= num_slots;
+    }
+
+    notifyWaiters(SLOT_READABLE);
+}
+
+bool SharedImageBuffer::waitForWriteSlot(uint32_t timeout_us)
+{
+    auto writable = [this]() {
+        if (SyncMode_==SYNC_LOCK_FREE_SPMC)
+        {
+            return getNumWriteSlotsAvailable() > 0;
+        }
+        std::lock_guard<std::mutex> scopedLock(BufferMutex_);
+        return !isFull();
+    };
+
+    if (writable())
+    {
+        return true;
+    }
+
+    std::unique_lock<std::mutex> waitLock(WaitMutex_);
+    NumWriteWaiters_.fetch_add(1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+
+    const bool available = WritableCondition_.wait_for(waitLock, std::chrono::microseconds(timeout_us), writable);
+
+    NumWriteWaiters_.fetch_sub(1, std::memory_order_relaxed);
+    return available;
 }
 
 uint32_t SharedImageBuffer::getLeastNumReadSlotsAvailable()
 {
+    if (SyncMode_==SYNC_LOCK_FREE_SPMC)
+    {
+        const uint64_t write_tail = SeqWriteTail_.load(std::memory_order_acquire);
+        uint32_t least_num = NumSlots_;
+        const uint32_t num_indices = NumConsumerIndices_.load(std::memory_order_acquire);
+        for (uint32_t i=0; i<num_indices; i++)
+        {
+            const ConsumerCursor& c = Cursors_[i];
+            if (c.Active.load(std::memory_order_acquire))
+            {
+                const uint32_t num_avail = (uint32_t)(write_tail - c.ReadHead.load(std::memory_order_relaxed));
+                if (num_avail < least_num)
+                {
+                    least_num = num_avail;
+                }
+            }
+        }
+        return least_num;
+    }
+
     std::lock_guard<std::mutex> scopedLock(BufferMutex_);
     typedef std::map< const ImageConsumer*, uint32_t >::iterator map_it;
 	uint32_t least_num = NumSlots_;
@@ -231,53 +791,258 @@ uint32_t SharedImageBuffer::getLeastNumReadSlotsAvailable()
 
 uint32_t SharedImageBuffer::getNumReadSlotsAvailable(const ImageConsumer& consumer)
 {
+    if (SyncMode_==SYNC_LOCK_FREE_SPMC)
+    {
+        return numAvailable(consumer);
+    }
+
     std::lock_guard<std::mutex> scopedLock(BufferMutex_);
 	return numAvailable(consumer);
 }
 
 uint32_t SharedImageBuffer::getNumReadSlotsReserved(const ImageConsumer& consumer)
 {
+    if (SyncMode_==SYNC_LOCK_FREE_SPMC)
+    {
+        return cursor(consumer).NumReadReserved.load(std::memory_order_relaxed);
+    }
+
     std::lock_guard<std::mutex> scopedLock(BufferMutex_);
     return NumReadReserved_[&consumer];
 }
 
 std::vector<Image**> SharedImageBuffer::reserveReadSlot(const ImageConsumer& consumer)
 {
-    std::lock_guard<std::mutex> scopedLock(BufferMutex_);
-	
-	std::vector<Image**> v;
+    std::vector<Image**> v;
+    uint32_t slot = 0;
 
-	if (numAvailable(consumer) == 0)
+    if (SyncMode_==SYNC_LOCK_FREE_SPMC)
     {
-		return v;
-	}
-	
-	uint32_t read_head = ReadHeads_[&consumer];
-	for (uint32_t i=0; i<ImagesPerSlot_; i++)
+        uint32_t num_skipped = 0;
+        if (!reserveReadSlotLockFree(consumer, slot, num_skipped))
+        {
+            return v;
+        }
+        if (num_skipped > 0)
+        {
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+            reportPoppedSlots();
+            notifyWaiters(SLOT_WRITABLE);
+        }
+    } else
     {
-		v.push_back(&(Buffer_[read_head][i]));
-	}
-	
-	ReadHeads_[&consumer] = (ReadHeads_[&consumer] + 1)  % NumSlots_;
-	NumReadReserved_[&consumer]++;
+        uint32_t num_popped = 0;
+        {
+            std::lock_guard<std::mutex> scopedLock(BufferMutex_);
+            if (!reserveReadSlotLocked(consumer, slot, num_popped))
+            {
+                return v;
+            }
+        }
 
+        if (num_popped > 0)
+        {
+            for (uint32_t i=0; i<num_popped; i++)
+            {
+                ImageProducer_->releaseReadSlotCallback();
+            }
+            notifyWaiters(SLOT_WRITABLE);
+        }
+    }
+
+    for (uint32_t i=0; i<ImagesPerSlot_; i++)
+    {
+        v.push_back(&(Buffer_[slot][i]));
+    }
 	return v;
 }
 
-void SharedImageBuffer::releaseReadSlot(const ImageConsumer& consumer)
+SlotSpan SharedImageBuffer::reserveReadSlots(const ImageConsumer& consumer, uint32_t max_slots)
 {
-	// assert readreserved > 0
-	bool do_notify = false;
-	{
+    SlotSpan span;
+    span.ImagesPerSlot_ = ImagesPerSlot_;
+    max_slots = std::min<uint32_t>(max_slots, FLITR_SLOT_SPAN_CAPACITY);
+    uint32_t slot = 0;
+
+    if (SyncMode_==SYNC_LOCK_FREE_SPMC)
+    {
+        uint32_t num_skipped = 0;
+        while ((span.NumSlots_ < max_slots) && reserveReadSlotLockFree(consumer, slot, num_skipped))
+        {
+            span.Slots_[span.NumSlots_++] = &(Buffer_[slot][0]);
+        }
+        if (num_skipped > 0)
+        {
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+            reportPoppedSlots();
+            notifyWaiters(SLOT_WRITABLE);
+        }
+        return span;
+    }
+
+    uint32_t num_popped = 0;
+    {
         std::lock_guard<std::mutex> scopedLock(BufferMutex_);
-		// assert numAvailable > 0
-		ReadTails_[&consumer] = (ReadTails_[&consumer] + 1) % NumSlots_;
-		NumReadReserved_[&consumer]--;
-		do_notify = tailPopped(consumer);
-	}
-    
-	if (do_notify)
+        while ((span.NumSlots_ < max_slots) && reserveReadSlotLocked(consumer, slot, num_popped))
+        {
+            span.Slots_[span.NumSlots_++] = &(Buffer_[slot][0]);
+        }
+    }
+
+    if (num_popped > 0)
     {
-		ImageProducer_->releaseReadSlotCallback();
-	}
+        for (uint32_t i=0; i<num_popped; i++)
+        {
+            ImageProducer_->releaseReadSlotCallback();
+        }
+        notifyWaiters(SLOT_WRITABLE);
+    }
+    return span;
+}
+
+bool SharedImageBuffer::reserveReadSlotLocked(const ImageConsumer& consumer, uint32_t& slot, uint32_t& num_popped)
+{
+    uint32_t num_avail = numAvailable(consumer);
+    if (num_avail == 0)
+    {
+        return false;
+    }
+
+    if ((OverflowPolicies_[&consumer] == OVERFLOW_LATEST_ONLY) && (NumReadReserved_[&consumer] == 0) &&
+        (num_avail > 1))
+    {
+        // Skip to the newest slot.
+        const uint32_t gap_before = getMaxReadGap();
+        ReadTails_[&consumer] = (ReadTails_[&consumer] + num_avail - 1) % NumSlots_;
+        ReadHeads_[&consumer] = ReadTails_[&consumer];
+        NumDropped_[&consumer] += num_avail - 1;
+        num_popped += gap_before - getMaxReadGap();
+    }
+
+    slot = ReadHeads_[&consumer];
+    ReadHeads_[&consumer] = (ReadHeads_[&consumer] + 1)  % NumSlots_;
+    NumReadReserved_[&consumer]++;
+    return true;
+}
+
+bool SharedImageBuffer::reserveReadSlotLockFree(const ImageConsumer& consumer, uint32_t& slot, uint32_t& num_skipped)
+{
+    ConsumerCursor& c = cursor(consumer);
+    const uint32_t policy = c.Policy.load(std::memory_order_relaxed);
+    if (policy == OVERFLOW_LOSSLESS)
+    {
+        const uint64_t read_head = c.ReadHead.load(std::memory_order_relaxed);
+        if (SeqWriteTail_.load(std::memory_order_acquire) == read_head)
+        {
+            return false;
+        }
+
+        slot = (uint32_t)(read_head % NumSlots_);
+        c.ReadHead.store(read_head + 1, std::memory_order_relaxed);
+        c.NumReadReserved.fetch_add(1, std::memory_order_relaxed);
+        return true;
+    }
+
+    // The producer may be dropping our oldest slot, so claim the
+    // slot with a compare-exchange.
+    uint64_t read_head = c.ReadHead.load(std::memory_order_acquire);
+    uint64_t next_head = 0;
+    do
+    {
+        const uint64_t write_tail = SeqWriteTail_.load(std::memory_order_acquire);
+        if (write_tail == read_head)
+        {
+            return false;
+        }
+        next_head = read_head + 1;
+        if ((policy == OVERFLOW_LATEST_ONLY) && (c.NumReadReserved.load(std::memory_order_relaxed) == 0))
+        {
+            // Skip to the newest slot.
+            next_head = write_tail;
+        }
+    } while (!c.ReadHead.compare_exchange_weak(read_head, next_head,
+                                               std::memory_order_acq_rel, std::memory_order_acquire));
+
+    const uint64_t skipped = next_head - 1 - read_head;
+    if (skipped > 0)
+    {
+        c.ReadTail.fetch_add(skipped, std::memory_order_acq_rel);
+        c.NumDropped.fetch_add(skipped, std::memory_order_relaxed);
+        num_skipped += uint32_t(skipped);
+    }
+    c.NumReadReserved.fetch_add(1, std::memory_order_relaxed);
+
+    slot = (uint32_t)((next_head - 1) % NumSlots_);
+    return true;
+}
+
+void SharedImageBuffer::releaseReadSlot(const ImageConsumer& consumer)
+{
+    SharedImageBuffer::releaseReadSlots(consumer, 1);
+}
+
+void SharedImageBuffer::releaseReadSlots(const ImageConsumer& consumer, uint32_t num_slots)
+{
+    if (num_slots==0)
+    {
+        return;
+    }
+
+    if (SyncMode_==SYNC_LOCK_FREE_SPMC)
+    {
+        ConsumerCursor& c = cursor(consumer);
+        c.NumReadReserved.fetch_sub(num_slots, std::memory_order_relaxed);
+        // Release: our reads of the slot complete before the producer
+        // may reuse it. The producer may also be moving the tail to
+        // drop a slot, hence the read-modify-write.
+        c.ReadTail.fetch_add(num_slots, std::memory_order_acq_rel);
+        // Order the store before the scan. Without this two consumers
+        // releasing together may each miss the other's new tail and
+        // leave the slot unreported.
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+
+        reportPoppedSlots();
+    } else
+    {
+        // assert readreserved >= num_slots
+        uint32_t num_popped = 0;
+        {
+            std::lock_guard<std::mutex> scopedLock(BufferMutex_);
+            for (uint32_t i=0; i<num_slots; i++)
+            {
+                // assert numAvailable > 0
+                ReadTails_[&consumer] = (ReadTails_[&consumer] + 1) % NumSlots_;
+                NumReadReserved_[&consumer]--;
+                if (tailPopped(consumer))
+                {
+                    ++num_popped;
+                }
+            }
+        }
+
+        for (uint32_t i=0; i<num_popped; i++)
+        {
+            ImageProducer_->releaseReadSlotCallback();
+        }
+    }
+
+    notifyWaiters(SLOT_WRITABLE);
+}
+
+bool SharedImageBuffer::waitForReadSlot(const ImageConsumer& consumer, uint32_t timeout_us)
+{
+    if (getNumReadSlotsAvailable(consumer) > 0)
+    {
+        return true;
+    }
+
+    std::unique_lock<std::mutex> waitLock(WaitMutex_);
+    NumReadWaiters_.fetch_add(1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+
+    const bool available = ReadableCondition_.wait_for(waitLock, std::chrono::microseconds(timeout_us),
+                                                       [this, &consumer]() { return getNumReadSlotsAvailable(consumer) > 0; });
+
+    NumReadWaiters_.fetch_sub(1, std::memory_order_relaxed);
+    return available;
 }
@@ -1,5 +1,9 @@
 #include <flitr/v4l2_producer.h>
 
+extern "C" {
+#include <libavutil/imgutils.h>
+}
+
 #define CLEAR(x) memset (&(x), 0, sizeof (x))
 
 flitr::V4L2Producer::V4L2Producer(ImageFormat::PixelFormat out_pix_fmt,
@@ -13,6 +17,7 @@ flitr::V4L2Producer::V4L2Producer(ImageFormat::PixelFormat out_pix_fmt,
     DeviceWidth_(width_to_set),
     DeviceHeight_(height_to_set),
     DeviceChannel_(channel_to_set),
+    DeviceBytesPerLine_(0),
     ShouldExit_(false),
     buffer_size_(buffer_size)
 {
@@ -173,6 +178,8 @@ bool flitr::V4L2Producer::init_device()
         }
         DeviceWidth_ = cap_fmt.fmt.pix.width;
         DeviceHeight_ = cap_fmt.fmt.pix.height;
+    // the driver may pad the rows
+    DeviceBytesPerLine_ = cap_fmt.fmt.pix.bytesperline;
     }
 
     // Set image format.
@@ -372,6 +379,9 @@ bool flitr::V4L2Producer::get_frame(void)
             InputFFmpegPixelFormat_,
             DeviceWidth_,
             DeviceHeight_);
+    if (DeviceBytesPerLine_ > 0) {
+        InputV42LFrame_->linesize[0] = DeviceBytesPerLine_;
+    }
     
     // convert to the final format
     // \todo deinterlace here
@@ -388,12 +398,19 @@ bool flitr::V4L2Producer::get_frame(void)
 
     Image& out_image = *(*(imvec[0]));
     // Point final frame to sharedImageBuffer data
-    FinalFrame_->data[0] = out_image.data();
+    fillFFmpegFrame(FinalFrame_, out_image.data(), *out_image.format());
 
-    //Convert image to final format
-    sws_scale(ConvertInToFinalCtx_,
-              InputV42LFrame_->data, InputV42LFrame_->linesize, 0, DeviceHeight_,
-              FinalFrame_->data, FinalFrame_->linesize);
+    if (FinalFFmpegPixelFormat_ == InputFFmpegPixelFormat_) {
+        // Already in the final format, only the row padding may differ.
+        av_image_copy(FinalFrame_->data, FinalFrame_->linesize,
+                      (const uint8_t **)InputV42LFrame_->data, InputV42LFrame_->linesize,
+                      InputFFmpegPixelFormat_, DeviceWidth_, DeviceHeight_);
+    } else {
+        //Convert image to final format
+        sws_scale(ConvertInToFinalCtx_,
+                  InputV42LFrame_->data, InputV42LFrame_->linesize, 0, DeviceHeight_,
+                  FinalFrame_->data, FinalFrame_->linesize);
+    }
 
     /*
     // timestamp
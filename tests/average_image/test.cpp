@@ -0,0 +1,220 @@
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include <flitr/image_consumer.h>
+#include <flitr/image_producer.h>
+#include <flitr/modules/flitr_image_processors/average_image/fip_average_image.h>
+
+using std::shared_ptr;
+using namespace flitr;
+
+void checkCondition(bool condition, std::string message)
+{
+    if (!condition) {
+        std::cerr << message;
+        exit(-1);
+    }
+}
+
+// Producer of frames in a given format, whose pixels are written by the test.
+class TestProducer : public ImageProducer {
+  public:
+    TestProducer(const ImageFormat& imf)
+    {
+        ImageFormat_.push_back(imf);
+    }
+    bool init()
+    {
+        // Allocate storage
+        SharedImageBuffer_ = shared_ptr<SharedImageBuffer>(new SharedImageBuffer(*this, 4, 1));
+        SharedImageBuffer_->initWithStorage();
+
+        return true;
+    }
+    Image* reserveFrame()
+    {
+        std::vector<Image**> iv = reserveWriteSlot();
+        return (iv.size()==0) ? 0 : *iv[0];
+    }
+    void releaseFrame()
+    {
+        releaseWriteSlot();
+    }
+};
+
+// Component values of frame t: index i of the image, in [0, 2^bits).
+uint32_t varying8(size_t i, size_t t) { return uint32_t((i*37 + t*101 + (t*t) % 13) % 256); }
+uint32_t varying16(size_t i, size_t t) { return uint32_t((i*4099 + t*7919 + (t*t) % 251) % 65536); }
+uint32_t fullScale8(size_t, size_t) { return 255; }
+uint32_t fullScale16(size_t, size_t) { return 65535; }
+
+// Feed numFrames frames of component values value(i, t) and check that every
+// output component is the mean of the last window rounded to nearest, with
+// frames before the first counting as zero. P is the type of a component.
+template<typename P>
+void checkIntegerAverage(const ImageFormat& imf, uint8_t base2WindowLength, size_t numFrames,
+                         uint32_t (*value)(size_t, size_t), const std::string& name)
+{
+    TestProducer tp(imf);
+    tp.init();
+    FIPAverageImage average(tp, 1, base2WindowLength);
+    checkCondition(average.init(), name + ": Expected init OK\n");
+    ImageProducer& dsProducer = average;
+    ImageConsumer ic(dsProducer);
+    ic.init();
+
+    const size_t windowLength = size_t(1) << base2WindowLength;
+    const size_t rowLength = imf.getWidth()*imf.getComponentsPerPixel();
+    const size_t height = imf.getHeight();
+    std::vector<uint64_t> sums(rowLength*height, 0);
+
+    for (size_t t=0; t<numFrames; t++) {
+        Image * const imIn = tp.reserveFrame();
+        checkCondition(imIn!=0, name + ": Expected write OK\n");
+        for (size_t y=0; y<height; y++) {
+            P * const line = (P *)imIn->line(uint32_t(y));
+            for (size_t x=0; x<rowLength; x++) {
+                const size_t i = y*rowLength + x;
+                line[x] = P(value(i, t));
+                sums[i] += value(i, t);
+                if (t>=windowLength) sums[i] -= value(i, t - windowLength);
+            }
+        }
+        tp.releaseFrame();
+
+        checkCondition(average.trigger(), name + ": Expected trigger OK\n");
+        std::vector<Image**> iv = ic.reserveReadSlot();
+        checkCondition(iv.size()==1, name + ": Expected an average frame\n");
+        for (size_t y=0; y<height; y++) {
+            P const * const line = (P const *)(*iv[0])->line(uint32_t(y));
+            for (size_t x=0; x<rowLength; x++) {
+                const uint64_t expected = (sums[y*rowLength + x] + windowLength/2) >> base2WindowLength;
+                checkCondition(line[x]==expected, name + ": Expected the rounded mean\n");
+            }
+        }
+        ic.releaseReadSlot();
+    }
+}
+
+// 8 bit windows of up to 2^8 frames sum in 16 bits, which must still be
+// exact for full scale input over the longest of them.
+void testAverageUint16Sums()
+{
+    ImageFormat rgb(5, 3, ImageFormat::FLITR_PIX_FMT_RGB_8);
+    rgb.setRowAlignment();
+    checkIntegerAverage<uint8_t>(rgb, 0, 5, varying8, "testAverageUint16Sums");
+    checkIntegerAverage<uint8_t>(rgb, 3, 8*3 + 5, varying8, "testAverageUint16Sums");
+    checkIntegerAverage<uint8_t>(rgb, 8, 256*3 + 5, varying8, "testAverageUint16Sums");
+    checkIntegerAverage<uint8_t>(ImageFormat(3, 2, ImageFormat::FLITR_PIX_FMT_Y_8), 8, 256 + 5, fullScale8,
+                                 "testAverageUint16Sums");
+}
+
+// Longer 8 bit windows and Y_16 sum in 32 bits. A Y_16 window of 2^16 frames
+// of full scale input is the largest sum that fits.
+void testAverageUint32Sums()
+{
+    checkIntegerAverage<uint8_t>(ImageFormat(5, 3, ImageFormat::FLITR_PIX_FMT_BGRA), 9, 512*2 + 5, varying8,
+                                 "testAverageUint32Sums");
+    checkIntegerAverage<uint8_t>(ImageFormat(3, 2, ImageFormat::FLITR_PIX_FMT_Y_8), 9, 512 + 5, fullScale8,
+                                 "testAverageUint32Sums");
+    checkIntegerAverage<uint16_t>(ImageFormat(7, 3, ImageFormat::FLITR_PIX_FMT_Y_16), 4, 16*3 + 5, varying16,
+                                  "testAverageUint32Sums");
+    checkIntegerAverage<uint16_t>(ImageFormat(2, 1, ImageFormat::FLITR_PIX_FMT_Y_16), 16, 65536 + 5, fullScale16,
+                                  "testAverageUint32Sums");
+}
+
+// init() must accept the longest windows whose sums fit in 32 bits and
+// reject windows one step longer, and formats it cannot average.
+void testAverageWindowLimits()
+{
+    TestProducer grey(ImageFormat(1, 1, ImageFormat::FLITR_PIX_FMT_Y_8));
+    grey.init();
+    FIPAverageImage grey24(grey, 1, 24);
+    checkCondition(grey24.init(), "testAverageWindowLimits: Expected an 8 bit window of 2^24 to init\n");
+    FIPAverageImage grey25(grey, 1, 25);
+    checkCondition(!grey25.init(), "testAverageWindowLimits: Expected an 8 bit window of 2^25 to fail init\n");
+
+    TestProducer deep(ImageFormat(1, 1, ImageFormat::FLITR_PIX_FMT_Y_16));
+    deep.init();
+    FIPAverageImage deep16(deep, 1, 16);
+    checkCondition(deep16.init(), "testAverageWindowLimits: Expected a Y_16 window of 2^16 to init\n");
+    FIPAverageImage deep17(deep, 1, 17);
+    checkCondition(!deep17.init(), "testAverageWindowLimits: Expected a Y_16 window of 2^17 to fail init\n");
+
+    TestProducer yuv(ImageFormat(4, 2, ImageFormat::FLITR_PIX_FMT_YUYV));
+    yuv.init();
+    FIPAverageImage yuvAverage(yuv, 1, 2);
+    checkCondition(!yuvAverage.init(), "testAverageWindowLimits: Expected YUYV to fail init\n");
+}
+
+// Component values of float frame t. Large values come and go, so that the
+// running float sum loses low bits on every frame.
+float varyingF32(size_t i, size_t t)
+{
+    return (((i*7 + t*13) % 5)==0 ? 4096.0f : 0.0f) + float((i*31 + t*17) % 1000)/999.0f;
+}
+
+// The float sums must stay close to the mean of the window over a long run,
+// as their recompute removes the rounding errors they build up.
+void testAverageF32()
+{
+    const uint8_t base2WindowLength = 4;
+    const size_t windowLength = size_t(1) << base2WindowLength;
+    const size_t numFrames = 20000;
+
+    ImageFormat rgb(6, 40, ImageFormat::FLITR_PIX_FMT_RGB_F32);
+    rgb.setRowAlignment();
+    TestProducer tp(rgb);
+    tp.init();
+    FIPAverageImage average(tp, 1, base2WindowLength);
+    checkCondition(average.getRecomputeInterval()==windowLength*16, "testAverageF32: Expected the default recompute interval\n");
+    checkCondition(average.init(), "testAverageF32: Expected init OK\n");
+    ImageProducer& dsProducer = average;
+    ImageConsumer ic(dsProducer);
+    ic.init();
+
+    const size_t rowLength = rgb.getWidth()*rgb.getComponentsPerPixel();
+    const size_t height = rgb.getHeight();
+    std::vector<double> sums(rowLength*height, 0.0);
+    float maxError = 0.0f;
+
+    for (size_t t=0; t<numFrames; t++) {
+        Image * const imIn = tp.reserveFrame();
+        checkCondition(imIn!=0, "testAverageF32: Expected write OK\n");
+        for (size_t y=0; y<height; y++) {
+            float * const line = (float *)imIn->line(uint32_t(y));
+            for (size_t x=0; x<rowLength; x++) {
+                const size_t i = y*rowLength + x;
+                line[x] = varyingF32(i, t);
+                sums[i] += varyingF32(i, t);
+                if (t>=windowLength) sums[i] -= varyingF32(i, t - windowLength);
+            }
+        }
+        tp.releaseFrame();
+
+        checkCondition(average.trigger(), "testAverageF32: Expected trigger OK\n");
+        std::vector<Image**> iv = ic.reserveReadSlot();
+        checkCondition(iv.size()==1, "testAverageF32: Expected an average frame\n");
+        for (size_t y=0; y<height; y++) {
+            float const * const line = (float const *)(*iv[0])->line(uint32_t(y));
+            for (size_t x=0; x<rowLength; x++) {
+                maxError = std::max(maxError, float(std::fabs(line[x] - sums[y*rowLength + x]/windowLength)));
+            }
+        }
+        ic.releaseReadSlot();
+    }
+    checkCondition(maxError<=0.005f, "testAverageF32: Expected the mean within 0.005\n");
+}
+
+int main(void)
+{
+    testAverageUint16Sums();
+    testAverageUint32Sums();
+    testAverageWindowLimits();
+    testAverageF32();
+
+    return 0;
+}
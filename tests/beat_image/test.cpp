@@ -0,0 +1,157 @@
+#include <cmath>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include <flitr/image_consumer.h>
+#include <flitr/image_producer.h>
+#include <flitr/modules/flitr_image_processors/beat_image/fip_beat_image.h>
+
+using std::shared_ptr;
+using namespace flitr;
+
+void checkCondition(bool condition, std::string message)
+{
+    if (!condition) {
+        std::cerr << message;
+        exit(-1);
+    }
+}
+
+const double pi = 3.14159265358979;
+
+// Value of component c of pixel (x, y) of image imgNum in frame t: a sinusoid
+// whose frequency, in cycles per window, varies from pixel to pixel and is not
+// always a whole number. Frames before the first are zero, like the history.
+double signal(size_t imgNum, size_t c, size_t x, size_t y, long t, size_t windowLength)
+{
+    if (t<0) return 0.0;
+    const double cycles = ((x + 2*y + 3*c + imgNum) % 7) * 0.75;
+    const double phase = (x*5 + y*3 + c) * 0.4;
+    return 0.5 + 0.3*cos(2.0*pi*cycles*t/windowLength + phase);
+}
+
+// Producer of a Y_F32 and a padded RGB_F32 image of sinusoids in every slot.
+class TestProducer : public ImageProducer {
+  public:
+    TestProducer(uint32_t width, uint32_t height, size_t windowLength) :
+        WindowLength_(windowLength),
+        Frame_(0)
+    {
+        ImageFormat_.push_back(ImageFormat(width, height, ImageFormat::FLITR_PIX_FMT_Y_F32));
+        ImageFormat rgb(width, height, ImageFormat::FLITR_PIX_FMT_RGB_F32);
+        rgb.setRowAlignment();
+        ImageFormat_.push_back(rgb);
+    }
+    bool init()
+    {
+        // Allocate storage
+        SharedImageBuffer_ = shared_ptr<SharedImageBuffer>(new SharedImageBuffer(*this, 4, 2));
+        SharedImageBuffer_->initWithStorage();
+
+        return true;
+    }
+    bool writeFrame()
+    {
+        std::vector<Image**> iv = reserveWriteSlot();
+        if (iv.size()==0) return false;
+        for (size_t imgNum=0; imgNum<2; imgNum++) {
+            const ImageFormat imf = getFormat(uint32_t(imgNum));
+            const size_t components = imf.getComponentsPerPixel();
+            for (size_t y=0; y<imf.getHeight(); y++) {
+                float *line = (float *)(*iv[imgNum])->line(uint32_t(y));
+                for (size_t x=0; x<imf.getWidth(); x++) {
+                    for (size_t c=0; c<components; c++) {
+                        line[x*components + c] = float(signal(imgNum, c, x, y, Frame_, WindowLength_));
+                    }
+                }
+            }
+        }
+        releaseWriteSlot();
+        Frame_++;
+        return true;
+    }
+  private:
+    const size_t WindowLength_;
+    long Frame_;
+};
+
+// Every configured bin of every component must match the power of a direct
+// DFT of the last window of frames. The run wraps around the history several
+// times, and every frame recomputes some rows, so both the sliding update and
+// the resync rows are covered. The second image is RGB_F32.
+void testBeatImageMatchesDFT()
+{
+    const uint32_t width = 11, height = 19;
+    const uint8_t base2WindowLength = 3;
+    const size_t windowLength = size_t(1) << base2WindowLength;
+    std::vector<size_t> beatBins;
+    beatBins.push_back(1);
+    beatBins.push_back(2);
+    beatBins.push_back(5);
+
+    TestProducer tp(width, height, windowLength);
+    tp.init();
+    FIPBeatImage beat(tp, 2, base2WindowLength, beatBins);
+    checkCondition(beat.init(), "testBeatImageMatchesDFT: Expected init OK\n");
+    ImageProducer& dsProducer = beat;
+    ImageConsumer ic(dsProducer);
+    ic.init();
+
+    checkCondition(beat.getBeatImageIndex(1, 2)==5, "testBeatImageMatchesDFT: Expected the bins of an image together\n");
+
+    for (long t=0; t<long(windowLength)*6 + 3; t++) {
+        checkCondition(tp.writeFrame(), "testBeatImageMatchesDFT: Expected write OK\n");
+        checkCondition(beat.trigger(), "testBeatImageMatchesDFT: Expected trigger OK\n");
+        std::vector<Image**> iv = ic.reserveReadSlot();
+        checkCondition(iv.size()==2*beatBins.size(), "testBeatImageMatchesDFT: Expected a beat frame\n");
+
+        for (size_t imgNum=0; imgNum<2; imgNum++) {
+            for (size_t binIndex=0; binIndex<beatBins.size(); binIndex++) {
+                const Image& im = **iv[beat.getBeatImageIndex(imgNum, binIndex)];
+                const size_t components = im.format()->getComponentsPerPixel();
+                checkCondition(im.format()->getPixelFormat()==tp.getFormat(uint32_t(imgNum)).getPixelFormat(),
+                               "testBeatImageMatchesDFT: Expected the upstream pixel format\n");
+
+                for (size_t y=0; y<height; y++) {
+                    float const * const line = (float const *)im.line(uint32_t(y));
+                    for (size_t x=0; x<width; x++) {
+                        for (size_t c=0; c<components; c++) {
+                            double real = 0.0, imag = 0.0;
+                            for (size_t n=0; n<windowLength; n++) {
+                                const double v = signal(imgNum, c, x, y, t + 1 - long(windowLength) + long(n), windowLength);
+                                const double theta = 2.0*pi*double(beatBins[binIndex]*n)/windowLength;
+                                real += v*cos(theta);
+                                imag -= v*sin(theta);
+                            }
+                            const double expected = (real*real + imag*imag)*2.625 + 0.5;
+                            checkCondition(std::fabs(line[x*components + c] - expected) <= 1e-4*(1.0 + expected),
+                                           "testBeatImageMatchesDFT: Expected the power of the DFT bin\n");
+                        }
+                    }
+                }
+            }
+        }
+        ic.releaseReadSlot();
+    }
+}
+
+// Bins outside the window and formats other than float must fail init().
+void testBeatImageInit()
+{
+    TestProducer tp(4, 4, 8);
+    tp.init();
+    std::vector<size_t> beatBins(1, 8);
+    FIPBeatImage outside(tp, 2, 3, beatBins);
+    checkCondition(!outside.init(), "testBeatImageInit: Expected a bin of the window length to fail init\n");
+    FIPBeatImage none(tp, 2, 3, std::vector<size_t>());
+    checkCondition(!none.init(), "testBeatImageInit: Expected no bins to fail init\n");
+}
+
+int main(void)
+{
+    testBeatImageMatchesDFT();
+    testBeatImageInit();
+
+    return 0;
+}
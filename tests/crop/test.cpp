@@ -0,0 +1,93 @@
+#include <cstring>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include <flitr/image_consumer.h>
+#include <flitr/image_producer.h>
+#include <flitr/modules/flitr_image_processors/crop/fip_crop.h>
+
+using std::shared_ptr;
+using namespace flitr;
+
+void checkCondition(bool condition, std::string message)
+{
+    if (!condition) {
+        std::cerr << message;
+        exit(-1);
+    }
+}
+
+// Producer of frames in a given format whose bytes count up from a seed.
+class TestProducer : public ImageProducer {
+  public:
+    TestProducer(const ImageFormat& imf)
+    {
+        ImageFormat_.push_back(imf);
+    }
+    bool init()
+    {
+        // Allocate storage
+        SharedImageBuffer_ = shared_ptr<SharedImageBuffer>(new SharedImageBuffer(*this, 4, 1));
+        SharedImageBuffer_->initWithStorage();
+
+        return true;
+    }
+    // Write the next frame and return the image it was written to.
+    Image* writeFrame(uint8_t seed)
+    {
+        std::vector<Image**> iv = reserveWriteSlot();
+        if (iv.size()==0) return 0;
+        Image* image = *iv[0];
+        for (uint32_t i=0; i<getFormat().getBytesPerImage(); i++) image->data()[i] = uint8_t(seed + i*7);
+        releaseWriteSlot();
+        return image;
+    }
+};
+
+// An off-centre crop must refer to the upstream rows rather than copy them,
+// for packed and padded upstream rows.
+void testCropSharesRows()
+{
+    const size_t startX = 13, startY = 7, width = 21, height = 17;
+    for (int padded=0; padded<2; padded++) {
+        ImageFormat imf(64, 48, ImageFormat::FLITR_PIX_FMT_RGB_8);
+        if (padded) imf.setRowAlignment();
+        TestProducer tp(imf);
+        tp.init();
+        FIPCrop crop(tp, 1, startX, startY, width, height);
+        checkCondition(crop.init(), "testCropSharesRows: Expected init OK\n");
+        ImageProducer& dsProducer = crop;
+        ImageConsumer ic(dsProducer);
+        ic.init();
+
+        const ImageFormat dsFormat = dsProducer.getFormat();
+        checkCondition((dsFormat.getWidth()==width) && (dsFormat.getHeight()==height) &&
+                       (dsFormat.getBytesPerLine()==imf.getBytesPerLine()),
+                       "testCropSharesRows: Expected the crop size with the upstream line size\n");
+
+        for (uint8_t frame=0; frame<6; frame++) {
+            Image const * const imRead = tp.writeFrame(frame);
+            checkCondition(imRead!=0, "testCropSharesRows: Expected write OK\n");
+            checkCondition(crop.trigger(), "testCropSharesRows: Expected trigger OK\n");
+
+            std::vector<Image**> iv = ic.reserveReadSlot();
+            checkCondition(iv.size()==1, "testCropSharesRows: Expected a cropped frame\n");
+            Image const * const imWrite = *iv[0];
+            const size_t offset = startY*imf.getBytesPerLine() + startX*imf.getBytesPerPixel();
+            checkCondition(imWrite->data()==imRead->data() + offset, "testCropSharesRows: Expected the upstream rows\n");
+            for (size_t y=0; y<height; y++) {
+                checkCondition(memcmp(imWrite->line(y), imRead->line(startY + y) + startX*3, width*3)==0,
+                               "testCropSharesRows: Expected the cropped pixels\n");
+            }
+            ic.releaseReadSlot();
+        }
+    }
+}
+
+int main(void)
+{
+    testCropSharesRows();
+
+    return 0;
+}
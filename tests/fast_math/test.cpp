@@ -0,0 +1,37 @@
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+#include <string>
+
+#include <flitr/fast_math.h>
+
+using namespace flitr;
+
+void checkCondition(bool condition, std::string message)
+{
+    if (!condition) {
+        std::cerr << message;
+        exit(-1);
+    }
+}
+
+// fastLog2 must follow log2 from the smallest to the largest floats, and must
+// not give infinities or NaNs for zero and negative values.
+void testFastLog2()
+{
+    double maxError = 0.0;
+    for (float x = 1.0e-37f; x < 1.0e37f; x *= 1.01f)
+    {
+        maxError = std::max(maxError, std::fabs(double(fastLog2(x)) - std::log2(double(x))));
+    }
+    checkCondition(maxError < 4.0e-6, "testFastLog2: Expected log2 to within 4e-6\n");
+    checkCondition((fastLog2(1.0f) == 0.0f) && (fastLog2(8.0f) == 3.0f), "testFastLog2: Expected exact powers of two\n");
+    checkCondition((fastLog2(0.0f) == -126.0f) && (fastLog2(-1.0f) == -126.0f), "testFastLog2: Expected -126 for zero and negative values\n");
+}
+
+int main(void)
+{
+    testFastLog2();
+
+    return 0;
+}
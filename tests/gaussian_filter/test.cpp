@@ -0,0 +1,142 @@
+#include <cmath>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include <flitr/cpu_features.h>
+#include <flitr/image_processor_utils.h>
+
+using namespace flitr;
+
+void checkCondition(bool condition, std::string message)
+{
+    if (!condition) {
+        std::cerr << message;
+        exit(-1);
+    }
+}
+
+// Filters the interior of a packed image the slow way, in double precision.
+std::vector<double> gaussianReference(const std::vector<double>& in, size_t width, size_t height, size_t channels,
+                                      const std::vector<double>& kernel)
+{
+    const size_t half = kernel.size()/2;
+    std::vector<double> h(in.size(), 0.0), out(in.size(), 0.0);
+    for (size_t y=0; y<height; y++) for (size_t x=half; x<width-half; x++) for (size_t c=0; c<channels; c++) {
+        for (size_t j=0; j<kernel.size(); j++) h[(y*width + x)*channels + c] += in[(y*width + x + j - half)*channels + c] * kernel[j];
+    }
+    for (size_t y=half; y<height-half; y++) for (size_t x=half; x<width-half; x++) for (size_t c=0; c<channels; c++) {
+        for (size_t j=0; j<kernel.size(); j++) out[(y*width + x)*channels + c] += h[((y + j - half)*width + x)*channels + c] * kernel[j];
+    }
+    return out;
+}
+
+// Every SIMD level must match a plain convolution in the interior, in place and
+// with padded rows, and must leave the border alone.
+void testGaussianFilter()
+{
+    const size_t width = 157, height = 61, kernelWidth = 9, half = kernelWidth/2;
+
+    // The impulse response is the outer product of the kernel with itself, and its
+    // centre column sums to the centre weight.
+    const size_t n = 2*kernelWidth - 1, c = kernelWidth - 1;
+    std::vector<float> impulse(n*n, 0.0f), response(n*n, 0.0f);
+    impulse[c*n + c] = 1.0f;
+    GaussianFilter(3.0f, kernelWidth).filter(&response[0], &impulse[0], n, n, nullptr);
+    double centre = 0.0, kernelSum = 0.0;
+    for (size_t j=0; j<kernelWidth; j++) centre += response[(c + j - half)*n + c];
+    std::vector<double> kernel(kernelWidth);
+    for (size_t j=0; j<kernelWidth; j++) {
+        kernel[j] = response[c*n + c + j - half] / centre;
+        kernelSum += kernel[j];
+    }
+    checkCondition(std::abs(kernelSum - 1.0) < 1e-3, "testGaussianFilter: Expected a normalised kernel\n");
+
+    for (size_t channels=1; channels<=3; channels+=2) {
+        const size_t values = width*channels, stride = values + 13;
+        std::vector<double> in(width*height*channels);
+        for (size_t i=0; i<in.size(); i++) in[i] = double((i*37 + (i/values)*11) % 251);
+        const std::vector<double> expected = gaussianReference(in, width, height, channels, kernel);
+
+        for (int level=FLITR_SIMD_SCALAR; level<=FLITR_SIMD_NEON; level++) {
+            setSimdLevel(SimdLevel(level));
+            if (getSimdLevel()!=level) continue;
+            GaussianFilter gaussian(3.0f, kernelWidth);
+
+            std::vector<float> inF(stride*height, -1.0f), outF(stride*height, -1.0f);
+            std::vector<uint8_t> in8(stride*height, 7), out8(stride*height, 7);
+            for (size_t y=0; y<height; y++) for (size_t x=0; x<values; x++) {
+                inF[y*stride + x] = float(in[y*values + x]);
+                in8[y*stride + x] = uint8_t(in[y*values + x]);
+            }
+            std::vector<float> inPlaceF(inF);
+            std::vector<uint8_t> inPlace8(in8);
+
+            if (channels==1) {
+                gaussian.filter(&outF[0], &inF[0], width, height, nullptr, stride);
+                gaussian.filter(&inPlaceF[0], &inPlaceF[0], width, height, nullptr, stride);
+                gaussian.filter(&out8[0], &in8[0], width, height, nullptr, stride);
+                gaussian.filter(&inPlace8[0], &inPlace8[0], width, height, nullptr, stride);
+            } else {
+                gaussian.filterRGB(&outF[0], &inF[0], width, height, nullptr, stride);
+                gaussian.filterRGB(&inPlaceF[0], &inPlaceF[0], width, height, nullptr, stride);
+                gaussian.filterRGB(&out8[0], &in8[0], width, height, nullptr, stride);
+                gaussian.filterRGB(&inPlace8[0], &inPlace8[0], width, height, nullptr, stride);
+            }
+
+            for (size_t y=0; y<height; y++) for (size_t x=0; x<values; x++) {
+                const size_t i = y*stride + x;
+                const bool interior = (y>=half) && (y<height-half) && (x>=half*channels) && (x<values-half*channels);
+                if (interior) {
+                    const double e = expected[y*values + x];
+                    checkCondition(std::abs(outF[i] - e) < 1e-3, "testGaussianFilter: Expected the float convolution\n");
+                    checkCondition(std::abs(double(out8[i]) - e) <= 1.0, "testGaussianFilter: Expected the 8 bit convolution\n");
+                } else {
+                    checkCondition((outF[i]==-1.0f) && (out8[i]==7), "testGaussianFilter: Expected the border to be left alone\n");
+                }
+                checkCondition((inPlaceF[i]==(interior ? outF[i] : inF[i])) && (inPlace8[i]==(interior ? out8[i] : in8[i])),
+                               "testGaussianFilter: Expected in place filtering to match\n");
+            }
+        }
+        setSimdLevel(detectSimdLevel());
+    }
+}
+
+// The pixels must not depend on how the rows are split into bands, also on one core.
+void testGaussianFilterBands()
+{
+    const size_t width = 131, height = 113, stride = 3*width + 7;
+    std::vector<float> inF(stride*height, 0.0f);
+    std::vector<uint8_t> in8(stride*height, 0);
+    for (size_t i=0; i<inF.size(); i++) {
+        in8[i] = uint8_t((i*37 + (i/stride)*11) % 251);
+        inF[i] = float(in8[i]);
+    }
+
+    std::vector<float> singleF(inF.size(), 0.0f), bandsF(inF.size(), 0.0f);
+    std::vector<uint8_t> single8(in8.size(), 0), bands8(in8.size(), 0);
+    for (size_t channels=1; channels<=3; channels+=2) {
+        for (uint32_t numBands=1; numBands<=5; numBands+=4) {
+            GaussianFilter gaussian(3.0f, 9);
+            gaussian.setMaxRowBands(numBands);
+            std::vector<float>& outF = (numBands==1) ? singleF : bandsF;
+            std::vector<uint8_t>& out8 = (numBands==1) ? single8 : bands8;
+            if (channels==1) {
+                gaussian.filter(&outF[0], &inF[0], width, height, nullptr, stride);
+                gaussian.filter(&out8[0], &in8[0], width, height, nullptr, stride);
+            } else {
+                gaussian.filterRGB(&outF[0], &inF[0], width, height, nullptr, stride);
+                gaussian.filterRGB(&out8[0], &in8[0], width, height, nullptr, stride);
+            }
+        }
+        checkCondition((singleF==bandsF) && (single8==bands8), "testGaussianFilterBands: Expected the same pixels in bands\n");
+    }
+}
+
+int main(void)
+{
+    testGaussianFilter();
+    testGaussianFilterBands();
+
+    return 0;
+}
@@ -0,0 +1,106 @@
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include <flitr/gaussian_pyramid.h>
+#include <flitr/image_processor_utils.h>
+
+using namespace flitr;
+
+void checkCondition(bool condition, std::string message)
+{
+    if (!condition) {
+        std::cerr << message;
+        exit(-1);
+    }
+}
+
+// The levels must match a double precision reference that repeats the edges, and the
+// gradients the Scharr operator with a zero border.
+void testGaussianPyramid()
+{
+    const size_t width = 203, height = 77;
+    checkCondition(GaussianPyramid::getMaxLevels(1920, 1080)==10, "testGaussianPyramid: Expected 10 levels for 1080p\n");
+
+    GaussianPyramid pyramid(width, height);
+    checkCondition((pyramid.getNumLevels()==6) && pyramid.hasGradients(), "testGaussianPyramid: Expected 6 levels with gradients\n");
+    const std::vector<float> kernel = GaussianPyramid::binomialKernel();
+    const ptrdiff_t k = ptrdiff_t(kernel.size());
+
+    std::vector<double> level(width*height);
+    for (size_t y=0; y<height; y++) for (size_t x=0; x<width; x++) {
+        level[y*width + x] = double((x*37 + y*11)%151 + ((x/20 + y/20)%2)*100);
+        pyramid.getLevel(0)[y*width + x] = float(level[y*width + x]);
+    }
+    pyramid.update();
+
+    for (size_t l=0; l<pyramid.getNumLevels(); l++) {
+        const ptrdiff_t w = ptrdiff_t(pyramid.getLevelWidth(l)), h = ptrdiff_t(pyramid.getLevelHeight(l));
+        checkCondition((w==ptrdiff_t(width>>l)) && (h==ptrdiff_t(height>>l)), "testGaussianPyramid: Expected halved level sizes\n");
+        if (l>0) {
+            const ptrdiff_t wHR = ptrdiff_t(pyramid.getLevelWidth(l-1)), hHR = ptrdiff_t(pyramid.getLevelHeight(l-1));
+            std::vector<double> down(w*h, 0.0);
+            for (ptrdiff_t y=0; y<h; y++) for (ptrdiff_t x=0; x<w; x++) for (ptrdiff_t j=0; j<k; j++) for (ptrdiff_t i=0; i<k; i++) {
+                const ptrdiff_t yHR = std::min(std::max(2*y + 1 - k/2 + j, ptrdiff_t(0)), hHR - 1);
+                const ptrdiff_t xHR = std::min(std::max(2*x + 1 - k/2 + i, ptrdiff_t(0)), wHR - 1);
+                down[y*w + x] += kernel[j]*kernel[i]*level[yHR*wHR + xHR];
+            }
+            level.swap(down);
+        }
+        float const * const data = pyramid.getLevel(l);
+        for (ptrdiff_t i=0; i<w*h; i++) {
+            checkCondition(std::abs(data[i] - level[i]) < 1e-3, "testGaussianPyramid: Expected the downsampled level\n");
+        }
+        for (ptrdiff_t y=0; y<h; y++) for (ptrdiff_t x=0; x<w; x++) {
+            double dx = 0.0, dy = 0.0;
+            if ((y>0) && (y<h-1) && (x>0) && (x<w-1)) {
+                const double* v = &level[y*w + x];
+                dx = ((v[-w+1] - v[-w-1]) * 3.0 + (v[1] - v[-1]) * 10.0 + (v[w+1] - v[w-1]) * 3.0) / 32.0;
+                dy = ((v[w-1] - v[-w-1]) * 3.0 + (v[w] - v[-w]) * 10.0 + (v[w+1] - v[-w+1]) * 3.0) / 32.0;
+            }
+            checkCondition((std::abs(pyramid.getDx(l)[y*w + x] - dx) < 1e-3) && (std::abs(pyramid.getDy(l)[y*w + x] - dy) < 1e-3),
+                           "testGaussianPyramid: Expected the Scharr gradients\n");
+        }
+    }
+
+    // GaussianDownsample uses the same code, so it keeps a flat image flat up to the edges.
+    std::vector<float> flat(width*height, 42.0f), flatDS((width/2)*(height/2), 0.0f);
+    GaussianDownsample(2.0f, 8).downsample(&flatDS[0], &flat[0], width, height, nullptr);
+    for (size_t i=0; i<flatDS.size(); i++) {
+        checkCondition(std::abs(flatDS[i] - 42.0f) < 1e-3f, "testGaussianPyramid: Expected GaussianDownsample to keep a flat image flat\n");
+    }
+}
+
+// The levels and gradients must not depend on how the rows are split into bands,
+// also on one core.
+void testGaussianPyramidBands()
+{
+    const size_t width = 331, height = 257;
+    GaussianPyramid single(width, height), bands(width, height);
+    for (size_t i=0; i<width*height; i++) {
+        const float v = float((i*37 + (i/width)*11) % 151);
+        single.getLevel(0)[i] = v;
+        bands.getLevel(0)[i] = v;
+    }
+
+    single.update(1);
+    bands.update(5);
+
+    for (size_t l=0; l<single.getNumLevels(); l++) {
+        const size_t n = single.getLevelWidth(l)*single.getLevelHeight(l);
+        checkCondition(std::equal(single.getLevel(l), single.getLevel(l) + n, bands.getLevel(l)) &&
+                       std::equal(single.getDx(l), single.getDx(l) + n, bands.getDx(l)) &&
+                       std::equal(single.getDy(l), single.getDy(l) + n, bands.getDy(l)),
+                       "testGaussianPyramidBands: Expected the same levels in bands\n");
+    }
+}
+
+int main(void)
+{
+    testGaussianPyramid();
+    testGaussianPyramidBands();
+
+    return 0;
+}
@@ -0,0 +1,75 @@
+#include <iostream>
+#include <string>
+
+#include <flitr/image.h>
+
+using namespace flitr;
+
+void checkCondition(bool condition, std::string message)
+{
+    if (!condition) {
+        std::cerr << message;
+        exit(-1);
+    }
+}
+
+// Padded rows must be reflected in the line size, the row pointers and
+// the bounds of images that refer to a rectangle of another image.
+void testRowStride()
+{
+    ImageFormat imf(1023, 4);
+    checkCondition(imf.isPacked() && (imf.getBytesPerLine()==1023), "testRowStride: Expected packed rows by default\n");
+    imf.setRowAlignment();
+    checkCondition((imf.getBytesPerLine()==1024) && !imf.isPacked() && (imf.getBytesPerImage()==4*1024),
+                   "testRowStride: Expected rows padded to the alignment\n");
+    imf.setBytesPerLine(2000);
+    checkCondition(imf.getBytesPerLine()==2000, "testRowStride: Expected fixed line size\n");
+    imf.setBytesPerLine(0);
+    checkCondition(imf.getBytesPerLine()==1024, "testRowStride: Expected aligned line size again\n");
+
+    Image a(imf);
+    checkCondition((a.line(3) - a.line(0))==3*1024, "testRowStride: Expected rows a line apart\n");
+
+    // a 100x2 rectangle at (900,2) ends on the last row of a
+    ImageFormat roi(100, 2);
+    roi.setBytesPerLine(imf.getBytesPerLine());
+    Image b(roi);
+    checkCondition(b.shareDataFrom(a, 2*1024 + 900) && (b.line(1)==a.line(3) + 900),
+                   "testRowStride: Expected view of the rectangle\n");
+    checkCondition(!b.shareDataFrom(a, 2*1024 + 1000), "testRowStride: Expected view past the end to fail\n");
+}
+
+// The planes of YUV formats must follow each other, and the Y plane must
+// be usable as a Y8 image.
+void testPlanarFormats()
+{
+    ImageFormat i420(641, 481, ImageFormat::FLITR_PIX_FMT_YUV420P);
+    checkCondition((i420.getNumPlanes()==3) && (i420.getPlaneOffset(1)==641*481) &&
+                   (i420.getPlaneOffset(2)==641*481 + 321*241) && (i420.getBytesPerImage()==641*481 + 2*321*241),
+                   "testPlanarFormats: Expected I420 planes\n");
+
+    ImageFormat nv12(640, 480, ImageFormat::FLITR_PIX_FMT_NV12);
+    nv12.setRowAlignment();
+    checkCondition((nv12.getNumPlanes()==2) && (nv12.getPlaneBytesPerLine(1)==640) &&
+                   (nv12.getBytesPerImage()==640*480 + 640*240), "testPlanarFormats: Expected NV12 planes\n");
+
+    ImageFormat yuyv(640, 480, ImageFormat::FLITR_PIX_FMT_YUYV);
+    checkCondition(!yuyv.isPlanar() && (yuyv.getBytesPerImage()==640*480*2), "testPlanarFormats: Expected packed YUYV\n");
+
+    Image frame(i420);
+    checkCondition(frame.plane(2)==frame.data() + i420.getPlaneOffset(2), "testPlanarFormats: Expected plane pointers\n");
+    Image luma(i420.getLumaFormat());
+    checkCondition((luma.format()->getPixelFormat()==ImageFormat::FLITR_PIX_FMT_Y_8) &&
+                   luma.shareDataFrom(frame) && (luma.line(1)==frame.line(1)),
+                   "testPlanarFormats: Expected Y plane view\n");
+    Image chroma(i420);
+    checkCondition(!chroma.shareDataFrom(frame, 1), "testPlanarFormats: Expected planes past the end to fail\n");
+}
+
+int main(void)
+{
+    testRowStride();
+    testPlanarFormats();
+
+    return 0;
+}
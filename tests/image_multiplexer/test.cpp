@@ -0,0 +1,149 @@
+#include <cstring>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include <flitr/image_consumer.h>
+#include <flitr/image_multiplexer.h>
+#include <flitr/image_producer.h>
+#include <flitr/image_resampler.h>
+
+using std::shared_ptr;
+using namespace flitr;
+
+void checkCondition(bool condition, std::string message)
+{
+    if (!condition) {
+        std::cerr << message;
+        exit(-1);
+    }
+}
+
+// Producer of 1024x2048 grey frames that start with a frame number.
+class TestProducer : public ImageProducer {
+  public:
+    bool init()
+    {
+        ImageFormat imf(1024,2048);
+        ImageFormat_.push_back(imf);
+
+        // Allocate storage
+        SharedImageBuffer_ = shared_ptr<SharedImageBuffer>(new SharedImageBuffer(*this, 10, 1));
+        SharedImageBuffer_->initWithStorage();
+
+        return true;
+    }
+    // Write a frame number into the first bytes of the next slot.
+    bool writeFrame(uint32_t frame)
+    {
+        std::vector<Image**> iv = reserveWriteSlot();
+        if (iv.size()==0) return false;
+        memcpy((*iv[0])->data(), &frame, sizeof(frame));
+        releaseWriteSlot();
+        return true;
+    }
+};
+
+// The multiplexer resamples to the downstream size and converts whole rows.
+void testMultiplexerConversion()
+{
+    TestProducer tp;
+    tp.init();
+    ImageMultiplexer mux(512, 1024, ImageFormat::FLITR_PIX_FMT_RGBA, 1, 2);
+    mux.addUpstreamProducer(tp);
+    mux.init();
+    ImageConsumer ic(mux);
+    ic.init();
+
+    tp.writeFrame(0x04030201);
+    mux.trigger();
+    std::vector<Image**> iv = ic.reserveReadSlot();
+    checkCondition(iv.size()==1, "testMultiplexerConversion: Expected a converted frame\n");
+    uint8_t const * const p = (*iv[0])->data();
+    checkCondition((p[0]==1) && (p[2]==1) && (p[3]==255) && (p[4]==3) && (p[6]==3),
+                   "testMultiplexerConversion: Expected every second grey pixel as RGBA\n");
+    ic.releaseReadSlot();
+}
+
+// The filters must give the expected pixels, and the result must not depend
+// on how the rows are split into bands.
+void testImageResampler()
+{
+    ImageFormat small(4, 4);
+    Image a(small);
+    for (size_t y=0; y<4; y++) for (size_t x=0; x<4; x++) a.line(y)[x] = uint8_t(y*40 + x*10);
+
+    ImageFormat half(2, 2);
+    Image b(half);
+    ImageResampler(small, half, ImageResampler::FILTER_AREA).resample(a, b);
+    checkCondition((b.line(0)[0]==25) && (b.line(0)[1]==45) && (b.line(1)[0]==105) && (b.line(1)[1]==125),
+                   "testImageResampler: Expected means of 2x2 blocks\n");
+
+    Image c(small);
+    ImageResampler(small, small, ImageResampler::FILTER_BILINEAR).resample(a, c);
+    checkCondition(memcmp(a.data(), c.data(), 16)==0, "testImageResampler: Expected bilinear copy at the same size\n");
+
+    ImageFormat wide(7, 4);
+    Image d(wide);
+    ImageResampler(small, wide, ImageResampler::FILTER_BILINEAR).resample(a, d);
+    checkCondition((d.line(0)[0]==0) && (d.line(0)[6]==30) && (d.line(3)[3]>=135) && (d.line(3)[3]<=136),
+                   "testImageResampler: Expected linear interpolation between columns\n");
+
+    ImageFormat in(301, 203, ImageFormat::FLITR_PIX_FMT_RGB_8);
+    in.setRowAlignment();
+    ImageFormat out(123, 77, ImageFormat::FLITR_PIX_FMT_BGRA);
+    Image e(in), f(out), g(out);
+    for (size_t y=0; y<203; y++) for (size_t x=0; x<301*3; x++) e.line(y)[x] = uint8_t(x*7 + y*3);
+    const ImageResampler::Filter filters[] = { ImageResampler::FILTER_NEAREST, ImageResampler::FILTER_BILINEAR, ImageResampler::FILTER_AREA };
+    for (size_t i=0; i<3; i++) {
+        ImageResampler resampler(in, out, filters[i]);
+        resampler.resample(e, f, 1);
+        resampler.resample(e, g, 5);
+        checkCondition(memcmp(f.data(), g.data(), out.getBytesPerImage())==0, "testImageResampler: Expected the same pixels in bands\n");
+    }
+}
+
+// Frames must come out in timestamp order rather than by source.
+void testMultiplexerTimestamps()
+{
+    TestProducer tp0, tp1;
+    tp0.init();
+    tp1.init();
+    ImageMultiplexer mux(1024, 2048, ImageFormat::FLITR_PIX_FMT_Y_8, 1, 4);
+    mux.addUpstreamProducer(tp0);
+    mux.addUpstreamProducer(tp1);
+    mux.init();
+    ImageConsumer ic(mux);
+    ic.init();
+    mux.setTimestampSelection([](const Image& image) {
+        uint32_t frame;
+        memcpy(&frame, image.data(), sizeof(frame));
+        return uint64_t(frame);
+    }, 1000000);
+
+    tp0.writeFrame(5);
+    tp0.writeFrame(7);
+    mux.trigger();
+    checkCondition(ic.getNumReadSlotsAvailable()==0, "testMultiplexerTimestamps: Expected to wait for the other source\n");
+
+    tp1.writeFrame(3);
+    tp1.writeFrame(6);
+    const uint32_t expected[] = { 3, 5, 6 };
+    for (size_t i=0; i<3; i++) {
+        mux.trigger();
+        std::vector<Image**> iv = ic.reserveReadSlot();
+        uint32_t frame = 0;
+        if (iv.size()==1) memcpy(&frame, (*iv[0])->data(), sizeof(frame));
+        checkCondition(frame==expected[i], "testMultiplexerTimestamps: Expected frames in timestamp order\n");
+        ic.releaseReadSlot();
+    }
+}
+
+int main(void)
+{
+    testMultiplexerConversion();
+    testMultiplexerTimestamps();
+    testImageResampler();
+
+    return 0;
+}
@@ -0,0 +1,111 @@
+#include <cstring>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include <flitr/image_processor_utils.h>
+
+using namespace flitr;
+
+void checkCondition(bool condition, std::string message)
+{
+    if (!condition) {
+        std::cerr << message;
+        exit(-1);
+    }
+}
+
+// The integer integral images must be exact, and the box filters built on them
+// must match the double precision ones.
+void testIntegralImage()
+{
+    const size_t width = 203, height = 77, stride = 3*width + 9;
+    std::vector<uint8_t> in8(stride*height, 0);
+    std::vector<uint16_t> in16(width*height);
+    for (size_t y=0; y<height; y++) for (size_t x=0; x<3*width; x++) in8[y*stride + x] = uint8_t((x*13 + y*29 + x*y) % 256);
+    for (size_t i=0; i<width*height; i++) in16[i] = uint16_t(i*2654435761u >> 16);
+
+    IntegralImage integralImage;
+    std::vector<uint32_t> ii32(width*height*3);
+    std::vector<uint64_t> ii64(width*height);
+    for (size_t channels=1; channels<=3; channels+=2) {
+        if (channels==1) integralImage.process(&ii32[0], &in8[0], width, height, stride);
+        else integralImage.processRGB(&ii32[0], &in8[0], width, height, stride);
+
+        // Sum over the rows so far of the row sums up to x.
+        std::vector<uint64_t> expected(width*channels, 0);
+        for (size_t y=0; y<height; y++) {
+            std::vector<uint64_t> rowSum(channels, 0);
+            for (size_t x=0; x<width*channels; x++) {
+                rowSum[x%channels] += in8[y*stride + x];
+                expected[x] += rowSum[x%channels];
+                checkCondition(ii32[y*width*channels + x]==expected[x], "testIntegralImage: Expected exact 8 bit sums\n");
+            }
+        }
+    }
+
+    integralImage.process(&ii64[0], &in16[0], width, height);
+    uint64_t total = 0;
+    for (size_t i=0; i<width*height; i++) total += in16[i];
+    checkCondition(ii64[width*height - 1]==total, "testIntegralImage: Expected the 16 bit total\n");
+
+    BoxFilterII box(9);
+    std::vector<double> iiDouble(width*height*3);
+    std::vector<uint8_t> packed(width*height*3), outDouble(width*height*3, 0), out32(width*height*3, 0);
+    for (size_t y=0; y<height; y++) memcpy(&packed[y*width*3], &in8[y*stride], width*3);
+    box.filterRGB(&outDouble[0], &packed[0], width, height, &iiDouble[0], true);
+    box.filterRGB(&out32[0], &packed[0], width, height, &ii32[0], true);
+    checkCondition(outDouble==out32, "testIntegralImage: Expected the same RGB box filter from 32 bit sums\n");
+    box.filter(&outDouble[0], &packed[0], width, height, &iiDouble[0], true);
+    box.filter(&out32[0], &packed[0], width, height, &ii32[0], true);
+    checkCondition(outDouble==out32, "testIntegralImage: Expected the same box filter from 32 bit sums\n");
+
+    // The box filter writes the mean of the 9x9 box centred on each interior pixel.
+    const size_t x = 50, y = 30;
+    uint32_t sum = 0;
+    for (size_t j=0; j<9; j++) for (size_t i=0; i<9; i++) sum += packed[(y - 4 + j)*width + x - 4 + i];
+    checkCondition(out32[y*width + x]==uint8_t(sum/81.0f + 0.5f), "testIntegralImage: Expected the box mean\n");
+}
+
+// The sums carried from band to band, and the box filters on them, must not depend
+// on how the rows are split into bands, also on one core.
+void testIntegralImageBands()
+{
+    const size_t width = 151, height = 131;
+    std::vector<uint8_t> in8(width*height*3);
+    std::vector<uint16_t> in16(width*height);
+    for (size_t i=0; i<in8.size(); i++) in8[i] = uint8_t((i*13 + (i/width)*29) % 256);
+    for (size_t i=0; i<in16.size(); i++) in16[i] = uint16_t(i*2654435761u >> 16);
+
+    IntegralImage integralImage;
+    BoxFilterII box(9);
+    std::vector<uint32_t> single32(width*height*3), bands32(width*height*3);
+    std::vector<uint64_t> single64(width*height), bands64(width*height);
+    std::vector<uint8_t> singleBox(width*height*3, 0), bandsBox(width*height*3, 0);
+    for (size_t channels=1; channels<=3; channels+=2) {
+        for (uint32_t numBands=1; numBands<=5; numBands+=4) {
+            integralImage.setMaxRowBands(numBands);
+            box.setMaxRowBands(numBands);
+            std::vector<uint32_t>& ii32 = (numBands==1) ? single32 : bands32;
+            std::vector<uint8_t>& out = (numBands==1) ? singleBox : bandsBox;
+            if (channels==1) {
+                integralImage.process(&ii32[0], &in8[0], width, height);
+                box.filter(&out[0], &in8[0], width, height, &ii32[0], true);
+            } else {
+                integralImage.processRGB(&ii32[0], &in8[0], width, height);
+                box.filterRGB(&out[0], &in8[0], width, height, &ii32[0], true);
+            }
+            integralImage.process((numBands==1) ? &single64[0] : &bands64[0], &in16[0], width, height);
+        }
+        checkCondition((single32==bands32) && (single64==bands64), "testIntegralImageBands: Expected the same sums in bands\n");
+        checkCondition(singleBox==bandsBox, "testIntegralImageBands: Expected the same box filter in bands\n");
+    }
+}
+
+int main(void)
+{
+    testIntegralImage();
+    testIntegralImageBands();
+
+    return 0;
+}
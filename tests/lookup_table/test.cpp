@@ -0,0 +1,132 @@
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include <flitr/cpu_features.h>
+#include <flitr/image.h>
+#include <flitr/lookup_table.h>
+#include <flitr/point_op_chain.h>
+
+using namespace flitr;
+
+void checkCondition(bool condition, std::string message)
+{
+    if (!condition) {
+        std::cerr << message;
+        exit(-1);
+    }
+}
+
+// Every kernel must map each value through the table, in place too, and a table
+// built from a chain must give the pixels of the chain.
+void testLookupTable()
+{
+    const size_t width = 203, height = 19; // not a multiple of any vector width
+
+    std::vector<uint8_t> table8(256);
+    for (size_t i=0; i<256; i++) table8[i] = uint8_t(i*167 + (i>>5)*3 + 13);
+    std::vector<uint16_t> table16(65536);
+    for (size_t i=0; i<65536; i++) table16[i] = uint16_t(i*2654435761u >> 7);
+
+    const ImageFormat::PixelFormat formats[] = {
+        ImageFormat::FLITR_PIX_FMT_Y_8, ImageFormat::FLITR_PIX_FMT_RGB_8, ImageFormat::FLITR_PIX_FMT_Y_16 };
+    for (size_t f=0; f<3; f++) {
+        ImageFormat format(uint32_t(width), uint32_t(height), formats[f]);
+        format.setRowAlignment();
+        Image in(format), out(format);
+        const bool is16 = (formats[f]==ImageFormat::FLITR_PIX_FMT_Y_16);
+        for (size_t y=0; y<height; y++) {
+            for (size_t i=0; i<width*format.getBytesPerPixel(); i++) in.line(uint32_t(y))[i] = uint8_t(i*31 + y*101 + i/7);
+        }
+
+        for (int level=FLITR_SIMD_SCALAR; level<=FLITR_SIMD_NEON; level++) {
+            setSimdLevel(SimdLevel(level));
+            if (getSimdLevel()!=level) continue;
+
+            LookupTable lut(formats[f]);
+            checkCondition(lut.isSupported() && (lut.getNumEntries()==(is16 ? 65536u : 256u)),
+                           "testLookupTable: Expected a table\n");
+            checkCondition(is16 ? lut.setTable(table16) : lut.setTable(table8), "testLookupTable: Expected table to be set\n");
+            checkCondition(!(is16 ? lut.setTable(table8) : lut.setTable(table16)), "testLookupTable: Expected wrong table to fail\n");
+            checkCondition(lut.apply(in, out), "testLookupTable: Expected image to be looked up\n");
+
+            Image inPlace(format);
+            for (size_t y=0; y<height; y++) memcpy(inPlace.line(uint32_t(y)), in.line(uint32_t(y)), format.getBytesPerLine());
+            lut.apply(inPlace, inPlace);
+
+            for (size_t y=0; y<height; y++) {
+                for (size_t x=0; x<width*format.getComponentsPerPixel(); x++) {
+                    uint32_t expected, got, gotInPlace;
+                    if (is16) {
+                        expected = table16[((uint16_t const *)in.line(uint32_t(y)))[x]];
+                        got = ((uint16_t const *)out.line(uint32_t(y)))[x];
+                        gotInPlace = ((uint16_t const *)inPlace.line(uint32_t(y)))[x];
+                    } else {
+                        expected = table8[in.line(uint32_t(y))[x]];
+                        got = out.line(uint32_t(y))[x];
+                        gotInPlace = inPlace.line(uint32_t(y))[x];
+                    }
+                    checkCondition((got==expected) && (gotInPlace==expected),
+                                   std::string("testLookupTable: Value differs from the table with kernel ") +
+                                   lut.getKernelName() + "\n");
+                }
+            }
+        }
+        setSimdLevel(detectSimdLevel());
+
+        PointOpChain chain(formats[f], formats[f]);
+        chain.addPower(0.45f);
+        chain.addGainOffset(1.1f, 0.02f);
+        LookupTable fromChain(formats[f]);
+        checkCondition(fromChain.setTable(chain), "testLookupTable: Expected table from chain\n");
+        Image viaChain(format);
+        chain.apply(in, viaChain);
+        fromChain.apply(in, out);
+        for (size_t y=0; y<height; y++) {
+            checkCondition(memcmp(viaChain.line(uint32_t(y)), out.line(uint32_t(y)), width*format.getBytesPerPixel())==0,
+                           "testLookupTable: Expected table from chain to match the chain\n");
+        }
+    }
+
+    // A table from a power chain must hold powf of every value, whatever the build flags.
+    {
+        ImageFormat format8(256, 1, ImageFormat::FLITR_PIX_FMT_Y_8);
+        ImageFormat format16(256, 256, ImageFormat::FLITR_PIX_FMT_Y_16);
+        Image in8(format8), out8(format8), in16(format16), out16(format16);
+        for (size_t i=0; i<256; i++) in8.data()[i] = uint8_t(i);
+        for (size_t i=0; i<65536; i++) ((uint16_t *)in16.data())[i] = uint16_t(i);
+
+        PointOpChain chain8(ImageFormat::FLITR_PIX_FMT_Y_8, ImageFormat::FLITR_PIX_FMT_Y_8);
+        chain8.addPower(0.45f);
+        LookupTable lut8(ImageFormat::FLITR_PIX_FMT_Y_8);
+        checkCondition(lut8.setTable(chain8) && lut8.apply(in8, out8), "testLookupTable: Expected 8 bit power table\n");
+        for (size_t i=0; i<256; i++) {
+            const int expected = std::min(int(std::pow(float(i) / 256.0f, 0.45f) * 256.0f + 0.5f), 255);
+            checkCondition(std::abs(int(out8.data()[i]) - expected) <= 1, "testLookupTable: Expected 8 bit table to match powf\n");
+        }
+
+        PointOpChain chain16(ImageFormat::FLITR_PIX_FMT_Y_16, ImageFormat::FLITR_PIX_FMT_Y_16);
+        chain16.addPower(2.2f);
+        LookupTable lut16(ImageFormat::FLITR_PIX_FMT_Y_16);
+        checkCondition(lut16.setTable(chain16) && lut16.apply(in16, out16), "testLookupTable: Expected 16 bit power table\n");
+        for (size_t i=0; i<65536; i++) {
+            const int expected = std::min(int(std::pow(float(i) / 65536.0f, 2.2f) * 65536.0f + 0.5f), 65535);
+            checkCondition(std::abs(int(((uint16_t const *)out16.data())[i]) - expected) <= 1,
+                           "testLookupTable: Expected 16 bit table to match powf\n");
+        }
+    }
+
+    checkCondition(!LookupTable(ImageFormat::FLITR_PIX_FMT_Y_F32).isSupported(), "testLookupTable: Expected float to be unsupported\n");
+    checkCondition(!LookupTable(ImageFormat::FLITR_PIX_FMT_Y_8).setTable(PointOpChain(ImageFormat::FLITR_PIX_FMT_Y_8, ImageFormat::FLITR_PIX_FMT_Y_16)),
+                   "testLookupTable: Expected chain with another output format to fail\n");
+}
+
+int main(void)
+{
+    testLookupTable();
+
+    return 0;
+}
@@ -0,0 +1,105 @@
+#include <algorithm>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include <flitr/image_processor_utils.h>
+
+using namespace flitr;
+
+void checkCondition(bool condition, std::string message)
+{
+    if (!condition) {
+        std::cerr << message;
+        exit(-1);
+    }
+}
+
+// Median of the square around each pixel, with the edge pixels repeated.
+template<typename T>
+T medianReference(const std::vector<T>& in, size_t width, size_t height, size_t stride, int x, int y, int radius)
+{
+    std::vector<T> window;
+    for (int j=y-radius; j<=y+radius; j++) for (int i=x-radius; i<=x+radius; i++) {
+        const int cj = std::min(std::max(j, 0), int(height)-1), ci = std::min(std::max(i, 0), int(width)-1);
+        window.push_back(in[cj*stride + ci]);
+    }
+    std::nth_element(window.begin(), window.begin() + window.size()/2, window.end());
+    return window[window.size()/2];
+}
+
+template<typename T>
+void checkMedian(size_t width, size_t height, size_t radius, T mask)
+{
+    const size_t stride = width + 3;
+    std::vector<T> in(stride*height, 0), out(stride*height, 0);
+    for (size_t i=0; i<in.size(); i++) in[i] = T((i*2654435761u >> 9) & mask);
+    MedianFilter median(radius);
+    median.filter(&out[0], &in[0], width, height, stride);
+    for (size_t y=0; y<height; y++) for (size_t x=0; x<width; x++) {
+        checkCondition(out[y*stride + x]==medianReference(in, width, height, stride, int(x), int(y), int(radius)),
+                       "testMedianFilter: Expected the median of the window\n");
+    }
+
+    // In place gives the same result.
+    median.filter(&in[0], &in[0], width, height, stride);
+    for (size_t y=0; y<height; y++) {
+        checkCondition(std::equal(&in[y*stride], &in[y*stride] + width, &out[y*stride]), "testMedianFilter: Expected the same result in place\n");
+    }
+}
+
+// The sorting networks and both histogram methods must give the true median, also
+// for windows larger than the image.
+void testMedianFilter()
+{
+    const size_t radii[] = {0, 1, 2, 3, 6, 20};
+    for (size_t i=0; i<sizeof(radii)/sizeof(radii[0]); i++) {
+        checkMedian<uint8_t>(97, 41, radii[i], 0xff);
+        checkMedian<uint8_t>(37, 29, radii[i], 0x0f);
+        checkMedian<uint16_t>(61, 35, radii[i], 0xffff);
+        checkMedian<uint16_t>(45, 23, radii[i], 0x3fff);
+    }
+    checkMedian<uint8_t>(3, 2, 1, 0xff);
+    checkMedian<uint16_t>(1, 1, 4, 0xffff);
+
+    // A salt and pepper pixel is removed.
+    std::vector<uint8_t> flat(16*16, 100), out(16*16);
+    flat[8*16 + 8] = 255;
+    MedianFilter(1).filter(&out[0], &flat[0], 16, 16);
+    checkCondition(out==std::vector<uint8_t>(16*16, 100), "testMedianFilter: Expected an impulse to be removed\n");
+}
+
+// The halo rows of each band must give the pixels of a single band, in place too,
+// for windows smaller and larger than a band, also on one core.
+void testMedianFilterBands()
+{
+    const size_t width = 71, height = 131, stride = width + 5;
+    std::vector<uint16_t> in(stride*height, 0), single(in.size(), 0), bands(in.size(), 0);
+    for (size_t i=0; i<in.size(); i++) in[i] = uint16_t((i*2654435761u >> 9) & 0xfff);
+
+    const size_t radii[] = {1, 3, 20};
+    for (size_t i=0; i<3; i++) {
+        MedianFilter median(radii[i]);
+        for (int inPlace=0; inPlace<2; inPlace++) {
+            for (uint32_t numBands=1; numBands<=5; numBands+=4) {
+                median.setMaxRowBands(numBands);
+                std::vector<uint16_t>& out = (numBands==1) ? single : bands;
+                if (inPlace) {
+                    out = in;
+                    median.filter(&out[0], &out[0], width, height, stride);
+                } else {
+                    median.filter(&out[0], &in[0], width, height, stride);
+                }
+            }
+            checkCondition(single==bands, "testMedianFilterBands: Expected the same pixels in bands\n");
+        }
+    }
+}
+
+int main(void)
+{
+    testMedianFilter();
+    testMedianFilterBands();
+
+    return 0;
+}
@@ -0,0 +1,110 @@
+#include <algorithm>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include <flitr/image_processor_utils.h>
+
+using namespace flitr;
+
+void checkCondition(bool condition, std::string message)
+{
+    if (!condition) {
+        std::cerr << message;
+        exit(-1);
+    }
+}
+
+// Minimum or maximum over the square around each pixel, clipped to the image.
+template<typename T>
+void morphologyReference(std::vector<T>& out, const std::vector<T>& in, size_t width, size_t height,
+                         size_t channels, size_t structElemWidth, bool dilate)
+{
+    const int half = int(structElemWidth/2);
+    out.resize(in.size());
+    for (int y=0; y<int(height); y++) for (int x=0; x<int(width); x++) for (size_t c=0; c<channels; c++) {
+        T value = in[(y*width + x)*channels + c];
+        for (int j=std::max(0, y-half); j<=std::min(int(height)-1, y+half); j++) {
+            for (int i=std::max(0, x-half); i<=std::min(int(width)-1, x+half); i++) {
+                const T v = in[(j*width + i)*channels + c];
+                value = dilate ? std::max(value, v) : std::min(value, v);
+            }
+        }
+        out[(y*width + x)*channels + c] = value;
+    }
+}
+
+template<typename T>
+void checkMorphology(size_t width, size_t height, size_t structElemWidth)
+{
+    std::vector<T> in(width*height*3), out(in.size()), scratch(in.size()), expected;
+    for (size_t i=0; i<in.size(); i++) in[i] = T((i*2654435761u >> 7) % 1000) / T(3);
+    MorphologicalFilter morphology;
+
+    for (int dilate=0; dilate<2; dilate++) {
+        morphologyReference(expected, in, width, height, 1, structElemWidth|1, dilate!=0);
+        std::vector<T> grey(in.begin(), in.begin() + width*height);
+        if (dilate) morphology.dilate(&out[0], &grey[0], structElemWidth, width, height, &scratch[0]);
+        else morphology.erode(&out[0], &grey[0], structElemWidth, width, height, &scratch[0]);
+        checkCondition(std::equal(expected.begin(), expected.begin() + width*height, out.begin()),
+                       "testMorphologicalFilter: Expected the brute force result\n");
+
+        // RGB, in place.
+        morphologyReference(expected, in, width, height, 3, structElemWidth|1, dilate!=0);
+        out = in;
+        if (dilate) morphology.dilateRGB(&out[0], &out[0], structElemWidth, width, height, &scratch[0]);
+        else morphology.erodeRGB(&out[0], &out[0], structElemWidth, width, height, &scratch[0]);
+        checkCondition(out==expected, "testMorphologicalFilter: Expected the brute force RGB result\n");
+    }
+}
+
+// Erode and dilate must match the brute force minimum and maximum for any element
+// size, including elements wider than the image.
+void testMorphologicalFilter()
+{
+    const size_t sizes[] = {1, 2, 3, 7, 16, 31};
+    for (size_t i=0; i<sizeof(sizes)/sizeof(sizes[0]); i++) {
+        checkMorphology<uint8_t>(67, 45, sizes[i]);
+        checkMorphology<uint16_t>(40, 71, sizes[i]);
+        checkMorphology<float>(53, 29, sizes[i]);
+    }
+    checkMorphology<uint8_t>(5, 3, 9);
+}
+
+// The halo rows of each band must give the pixels of a single band, for elements
+// smaller and larger than a band, also on one core.
+void testMorphologicalFilterBands()
+{
+    const size_t width = 67, height = 131;
+    std::vector<uint8_t> in(width*height*3), scratch(in.size()), single(in.size()), bands(in.size());
+    for (size_t i=0; i<in.size(); i++) in[i] = uint8_t(i*2654435761u >> 7);
+    MorphologicalFilter morphology;
+
+    const size_t sizes[] = {3, 9, 40};
+    for (size_t i=0; i<3; i++) {
+        for (int dilate=0; dilate<2; dilate++) {
+            for (size_t channels=1; channels<=3; channels+=2) {
+                for (uint32_t numBands=1; numBands<=5; numBands+=4) {
+                    morphology.setMaxRowBands(numBands);
+                    std::vector<uint8_t>& out = (numBands==1) ? single : bands;
+                    if (channels==1) {
+                        if (dilate) morphology.dilate(&out[0], &in[0], sizes[i], width, height, &scratch[0]);
+                        else morphology.erode(&out[0], &in[0], sizes[i], width, height, &scratch[0]);
+                    } else {
+                        if (dilate) morphology.dilateRGB(&out[0], &in[0], sizes[i], width, height, &scratch[0]);
+                        else morphology.erodeRGB(&out[0], &in[0], sizes[i], width, height, &scratch[0]);
+                    }
+                }
+                checkCondition(single==bands, "testMorphologicalFilterBands: Expected the same pixels in bands\n");
+            }
+        }
+    }
+}
+
+int main(void)
+{
+    testMorphologicalFilter();
+    testMorphologicalFilterBands();
+
+    return 0;
+}
@@ -0,0 +1,217 @@
+#include <algorithm>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include <flitr/image_consumer.h>
+#include <flitr/image_producer.h>
+#include <flitr/modules/flitr_image_processors/motion_detect/fip_motion_detect.h>
+
+using std::shared_ptr;
+using namespace flitr;
+
+void checkCondition(bool condition, std::string message)
+{
+    if (!condition) {
+        std::cerr << message;
+        exit(-1);
+    }
+}
+
+const uint32_t imageWidth = 64, imageHeight = 48;
+const uint32_t squareSize = 8, squareTop = 20;
+
+// Producer of a textured background, with a bright square over it on request.
+// The square only changes the second component of colour images.
+class TestProducer : public ImageProducer {
+  public:
+    TestProducer(ImageFormat::PixelFormat pixFormat)
+    {
+        ImageFormat imf(imageWidth, imageHeight, pixFormat);
+        imf.setRowAlignment();
+        ImageFormat_.push_back(imf);
+    }
+    bool init()
+    {
+        // Allocate storage
+        SharedImageBuffer_ = shared_ptr<SharedImageBuffer>(new SharedImageBuffer(*this, 4, 1));
+        SharedImageBuffer_->initWithStorage();
+
+        return true;
+    }
+    // Write a frame with the square at squareLeft, or without it if squareLeft is negative.
+    bool writeFrame(int squareLeft, shared_ptr<ImageMetadata> metadata = shared_ptr<ImageMetadata>())
+    {
+        std::vector<Image**> iv = reserveWriteSlot();
+        if (iv.size()==0) return false;
+        const size_t components = getFormat().getComponentsPerPixel();
+        for (uint32_t y=0; y<imageHeight; y++) {
+            uint8_t *line = (*iv[0])->line(y);
+            for (uint32_t x=0; x<imageWidth; x++) {
+                const bool square = (squareLeft>=0) && (x>=uint32_t(squareLeft)) && (x<uint32_t(squareLeft) + squareSize) &&
+                                    (y>=squareTop) && (y<squareTop + squareSize);
+                for (size_t c=0; c<components; c++) {
+                    line[x*components + c] = uint8_t(40 + (x*3 + y*5 + c*7) % 20);
+                    if (square && (c==components/2)) line[x*components + c] = 220;
+                }
+            }
+        }
+        (*iv[0])->setMetadata(metadata);
+        releaseWriteSlot();
+        return true;
+    }
+};
+
+// Motion metadata of the next downstream frame, or null if there is none.
+shared_ptr<MotionDetectMetadata> readMotion(ImageConsumer& ic)
+{
+    std::vector<Image**> iv = ic.reserveReadSlot();
+    if (iv.size()==0) return shared_ptr<MotionDetectMetadata>();
+    shared_ptr<MotionDetectMetadata> metadata = std::dynamic_pointer_cast<MotionDetectMetadata>((*iv[0])->metadata());
+    ic.releaseReadSlot();
+    checkCondition(metadata!=0, "readMotion: Expected motion metadata\n");
+    return metadata;
+}
+
+// A scene that does not change has no motion.
+void testStaticScene()
+{
+    TestProducer tp(ImageFormat::FLITR_PIX_FMT_Y_8);
+    tp.init();
+    FIPMotionDetect motion(tp, 1, true, false, false, 3.0f, 2);
+    checkCondition(motion.init(), "testStaticScene: Expected init OK\n");
+    ImageProducer& dsProducer = motion;
+    ImageConsumer ic(dsProducer);
+    ic.init();
+
+    for (int frame=0; frame<40; frame++) {
+        checkCondition(tp.writeFrame(-1), "testStaticScene: Expected write OK\n");
+        checkCondition(motion.trigger(), "testStaticScene: Expected trigger OK\n");
+        const shared_ptr<MotionDetectMetadata> metadata = readMotion(ic);
+        checkCondition(metadata!=0, "testStaticScene: Expected every frame downstream\n");
+        checkCondition((metadata->MotionScore_==0.0f) && metadata->Blobs_.empty(), "testStaticScene: Expected no motion\n");
+    }
+}
+
+// A square that appears after the background is learnt, and then moves one
+// pixel to the right every frame, from inside cell (1,1) into cell (2,1).
+// Every pixel of the square moves, and the pixels it leaves do not. A cell
+// is detected once the square has been in it for more than the detection
+// threshold frames in a row. With only motion images, frames before the
+// first detection must not be passed downstream.
+void testMovingSquare(ImageFormat::PixelFormat pixFormat, bool produceOnlyMotionImages)
+{
+    const int detectionThreshold = 3;
+    const int backgroundFrames = 4;
+    const int firstLeft = 18, lastLeft = 40;
+    const uint32_t cellSize = FIPMotionDetect::CellSize;
+
+    TestProducer tp(pixFormat);
+    tp.init();
+    FIPMotionDetect motion(tp, 1, true, produceOnlyMotionImages, false, 3.0f, detectionThreshold);
+    checkCondition(motion.init(), "testMovingSquare: Expected init OK\n");
+    ImageProducer& dsProducer = motion;
+    ImageConsumer ic(dsProducer);
+    ic.init();
+
+    for (int frame=0; frame<backgroundFrames; frame++) {
+        checkCondition(tp.writeFrame(-1), "testMovingSquare: Expected write OK\n");
+        checkCondition(motion.trigger(), "testMovingSquare: Expected trigger OK\n");
+        const shared_ptr<MotionDetectMetadata> metadata = readMotion(ic);
+        checkCondition((metadata!=0)!=produceOnlyMotionImages, "testMovingSquare: Expected still frames only without the filter\n");
+    }
+
+    // Number of frames in a row in which the square was in each cell of its cell row.
+    std::vector<int> cellCounts(imageWidth/cellSize, 0);
+    for (int left=firstLeft; left<=lastLeft; left++) {
+        checkCondition(tp.writeFrame(left), "testMovingSquare: Expected write OK\n");
+        checkCondition(motion.trigger(), "testMovingSquare: Expected trigger OK\n");
+
+        uint32_t detectedLeft = imageWidth, detectedRight = 0, detectedArea = 0;
+        for (uint32_t cellX=0; cellX<cellCounts.size(); cellX++) {
+            const uint32_t begin = std::max(uint32_t(left), cellX*cellSize);
+            const uint32_t end = std::min(uint32_t(left) + squareSize, (cellX + 1)*cellSize);
+            cellCounts[cellX] = (begin<end) ? cellCounts[cellX] + 1 : 0;
+            if (cellCounts[cellX]>detectionThreshold) {
+                detectedLeft = std::min(detectedLeft, cellX*cellSize);
+                detectedRight = std::max(detectedRight, (cellX + 1)*cellSize);
+                detectedArea += (end - begin)*squareSize;
+            }
+        }
+
+        const shared_ptr<MotionDetectMetadata> metadata = readMotion(ic);
+        if (detectedArea==0) {
+            checkCondition((metadata!=0)!=produceOnlyMotionImages, "testMovingSquare: Expected frames without detections only without the filter\n");
+            if (metadata) checkCondition(metadata->Blobs_.empty(), "testMovingSquare: Expected no blobs before the detection threshold\n");
+        } else {
+            checkCondition(metadata!=0, "testMovingSquare: Expected every frame with a detection downstream\n");
+            checkCondition(metadata->Blobs_.size()==1, "testMovingSquare: Expected one blob\n");
+            const MotionBlob& blob = metadata->Blobs_[0];
+            checkCondition((blob.Left==detectedLeft) && (blob.Top==cellSize) &&
+                           (blob.Width==detectedRight - detectedLeft) && (blob.Height==cellSize),
+                           "testMovingSquare: Expected the detected cells as the bounding box\n");
+            checkCondition(blob.Area==detectedArea, "testMovingSquare: Expected the square's pixels in the blob as its area\n");
+        }
+        if (metadata) {
+            checkCondition(metadata->MotionScore_==float(squareSize*squareSize)/float(imageWidth*imageHeight),
+                           "testMovingSquare: Expected the square's pixels as the motion score\n");
+        }
+    }
+    checkCondition(cellCounts[2]>detectionThreshold, "testMovingSquare: Expected the square to be detected in the second cell\n");
+}
+
+// The metadata of a detection, with the metadata of the upstream image inside
+// it, must survive being streamed.
+void testMetadataStream()
+{
+    TestProducer tp(ImageFormat::FLITR_PIX_FMT_Y_8);
+    tp.init();
+    FIPMotionDetect motion(tp, 1, false, true, false, 3.0f, 1);
+    checkCondition(motion.init(), "testMetadataStream: Expected init OK\n");
+    ImageProducer& dsProducer = motion;
+    ImageConsumer ic(dsProducer);
+    ic.init();
+
+    shared_ptr<MotionDetectMetadata> upstream(new MotionDetectMetadata());
+    upstream->MotionScore_ = 0.25f;
+    MotionBlob upstreamBlob = { 1, 2, 3, 4, 5 };
+    upstream->Blobs_.push_back(upstreamBlob);
+
+    for (int frame=0; frame<3; frame++) {
+        checkCondition(tp.writeFrame(-1, upstream), "testMetadataStream: Expected write OK\n");
+        checkCondition(motion.trigger(), "testMetadataStream: Expected trigger OK\n");
+    }
+    shared_ptr<MotionDetectMetadata> metadata;
+    for (int left=0; (left<24) && !metadata; left++) {
+        checkCondition(tp.writeFrame(left, upstream), "testMetadataStream: Expected write OK\n");
+        checkCondition(motion.trigger(), "testMetadataStream: Expected trigger OK\n");
+        metadata = readMotion(ic);
+    }
+    checkCondition((metadata!=0) && !metadata->Blobs_.empty(), "testMetadataStream: Expected a detection\n");
+    checkCondition(metadata->Upstream_==upstream, "testMetadataStream: Expected the upstream metadata inside\n");
+
+    std::stringstream stream;
+    checkCondition(metadata->writeToStream(stream), "testMetadataStream: Expected write to stream OK\n");
+    checkCondition(stream.str().size()==metadata->getSizeInBytes(), "testMetadataStream: Expected the streamed size\n");
+
+    MotionDetectMetadata copy;
+    copy.Upstream_ = shared_ptr<ImageMetadata>(new MotionDetectMetadata());
+    checkCondition(copy.readFromStream(stream), "testMetadataStream: Expected read from stream OK\n");
+    checkCondition(copy.getString()==metadata->getString(), "testMetadataStream: Expected the same metadata after the round trip\n");
+    checkCondition((copy.Blobs_.size()==metadata->Blobs_.size()) && (copy.Blobs_[0].Area==metadata->Blobs_[0].Area) &&
+                   (copy.MotionScore_==metadata->MotionScore_),
+                   "testMetadataStream: Expected the same blobs after the round trip\n");
+}
+
+int main(void)
+{
+    testStaticScene();
+    testMovingSquare(ImageFormat::FLITR_PIX_FMT_Y_8, false);
+    testMovingSquare(ImageFormat::FLITR_PIX_FMT_Y_8, true);
+    testMovingSquare(ImageFormat::FLITR_PIX_FMT_RGB_8, false);
+    testMovingSquare(ImageFormat::FLITR_PIX_FMT_RGB_8, true);
+    testMetadataStream();
+
+    return 0;
+}
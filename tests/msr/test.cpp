@@ -0,0 +1,118 @@
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include <flitr/image_consumer.h>
+#include <flitr/image_producer.h>
+#include <flitr/modules/flitr_image_processors/msr/fip_msr.h>
+
+using std::shared_ptr;
+using namespace flitr;
+
+void checkCondition(bool condition, std::string message)
+{
+    if (!condition) {
+        std::cerr << message;
+        exit(-1);
+    }
+}
+
+// Producer of Y_F32 frames of smooth shapes and fine texture.
+class TestProducer : public ImageProducer {
+  public:
+    TestProducer(uint32_t width, uint32_t height)
+    {
+        ImageFormat_.push_back(ImageFormat(width, height, ImageFormat::FLITR_PIX_FMT_Y_F32));
+    }
+    bool init()
+    {
+        // Allocate storage
+        SharedImageBuffer_ = shared_ptr<SharedImageBuffer>(new SharedImageBuffer(*this, 4, 1));
+        SharedImageBuffer_->initWithStorage();
+
+        return true;
+    }
+    bool writeFrame()
+    {
+        std::vector<Image**> iv = reserveWriteSlot();
+        if (iv.size()==0) return false;
+        const ImageFormat imf = getFormat();
+        for (uint32_t y=0; y<imf.getHeight(); y++) {
+            float *line = (float *)(*iv[0])->line(y);
+            for (uint32_t x=0; x<imf.getWidth(); x++) {
+                const float shapes = 0.5f + 0.3f*sinf(x*0.031f)*cosf(y*0.043f);
+                const float texture = 0.1f*float((x*13 + y*7) % 17)/17.0f;
+                line[x] = 0.05f + shapes + texture;
+            }
+        }
+        releaseWriteSlot();
+        return true;
+    }
+};
+
+// MSR output of one frame in the given mode, with the rows split into at most maxBands bands.
+std::vector<float> filterFrame(FIPMSR::FilterType filterType, uint32_t maxBands)
+{
+    const uint32_t width = 640, height = 480;
+    TestProducer tp(width, height);
+    tp.init();
+    FIPMSR msr(tp, 1, filterType);
+    msr.setMaxRowBands(maxBands);
+    checkCondition(msr.init(), "filterFrame: Expected init OK\n");
+    ImageProducer& dsProducer = msr;
+    ImageConsumer ic(dsProducer);
+    ic.init();
+
+    checkCondition(tp.writeFrame(), "filterFrame: Expected write OK\n");
+    checkCondition(msr.trigger(), "filterFrame: Expected trigger OK\n");
+    std::vector<Image**> iv = ic.reserveReadSlot();
+    checkCondition(iv.size()==1, "filterFrame: Expected an MSR frame\n");
+
+    std::vector<float> out(width*height);
+    for (uint32_t y=0; y<height; y++) {
+        memcpy(&out[y*width], (*iv[0])->line(y), width*sizeof(float));
+    }
+    ic.releaseReadSlot();
+    return out;
+}
+
+// The pyramid surround must stay close to the full resolution recursive
+// surround away from the borders, where both extend the edges differently.
+void testPyramidMatchesGausIIR()
+{
+    const size_t width = 640, height = 480, border = 64;
+    const std::vector<float> pyramid = filterFrame(FIPMSR::FilterType::Pyramid, 0);
+    const std::vector<float> iir = filterFrame(FIPMSR::FilterType::GausIIR, 0);
+
+    float maxDiff = 0.0f;
+    for (size_t y=border; y<height-border; y++) {
+        for (size_t x=border; x<width-border; x++) {
+            maxDiff = std::max(maxDiff, std::fabs(pyramid[y*width + x] - iir[y*width + x]));
+        }
+    }
+    checkCondition(maxDiff<=0.03f, "testPyramidMatchesGausIIR: Expected the outputs within 0.03\n");
+}
+
+// Several row bands must give the same output as one band in every mode.
+void testBandsMatchOneBand()
+{
+    const FIPMSR::FilterType filterTypes[] = {
+        FIPMSR::FilterType::GausXY, FIPMSR::FilterType::BoxII, FIPMSR::FilterType::BoxRS,
+        FIPMSR::FilterType::GausIIR, FIPMSR::FilterType::Pyramid };
+
+    for (size_t i=0; i<sizeof(filterTypes)/sizeof(filterTypes[0]); i++) {
+        checkCondition(filterFrame(filterTypes[i], 1)==filterFrame(filterTypes[i], 5),
+                       "testBandsMatchOneBand: Expected the same output with five bands\n");
+    }
+}
+
+int main(void)
+{
+    testPyramidMatchesGausIIR();
+    testBandsMatchOneBand();
+
+    return 0;
+}
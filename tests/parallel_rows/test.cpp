@@ -0,0 +1,93 @@
+#include <algorithm>
+#include <atomic>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <flitr/parallel_rows.h>
+
+using namespace flitr;
+
+void checkCondition(bool condition, std::string message)
+{
+    if (!condition) {
+        std::cerr << message;
+        exit(-1);
+    }
+}
+
+// Row bands must cover every row exactly once, with halos clipped to
+// the image, also when called concurrently and from inside a band.
+void testParallelRows()
+{
+    ParallelRowsPool pool(3);
+    const size_t height = 1000;
+    const size_t halo = 5;
+
+    for (uint32_t maxBands=0; maxBands<6; maxBands++) {
+        std::vector<std::atomic<uint32_t> > counts(height);
+        for (size_t y=0; y<height; y++) counts[y] = 0;
+        std::atomic<bool> halosOK(true);
+
+        pool.run(height, 8, halo, [&](const RowBand& band) {
+            if ((band.HaloBegin != ((band.Begin > halo) ? band.Begin-halo : 0)) ||
+                (band.HaloEnd != std::min(band.End+halo, height))) halosOK = false;
+            for (size_t y=band.Begin; y<band.End; y++) ++counts[y];
+        }, maxBands);
+
+        checkCondition(halosOK, "testParallelRows: Expected clipped halos\n");
+        for (size_t y=0; y<height; y++) {
+            checkCondition(counts[y]==1, "testParallelRows: Expected each row once\n");
+        }
+    }
+
+    std::atomic<uint32_t> total(0);
+    std::vector<std::thread> threads;
+    for (uint32_t i=0; i<4; i++) {
+        threads.push_back(std::thread([&]() {
+            for (uint32_t r=0; r<100; r++) {
+                pool.run(64, 1, 0, [&](const RowBand& outer) {
+                    pool.run(outer.End-outer.Begin, 1, 0, [&](const RowBand& inner) {
+                        total += uint32_t(inner.End-inner.Begin);
+                    });
+                });
+            }
+        }));
+    }
+    for (size_t i=0; i<threads.size(); i++) threads[i].join();
+    checkCondition(total==4*100*64, "testParallelRows: Expected every nested row once\n");
+}
+
+// A pool without workers must still split the rows into max_bands bands,
+// limited by the grain size.
+void testNumBands()
+{
+    ParallelRowsPool pool(0);
+
+    const uint32_t maxBands[] = { 0, 1, 4, 7 };
+    for (size_t m=0; m<4; m++) {
+        std::vector<RowBand> bands;
+        pool.run(100, 10, 2, [&](const RowBand& band) { bands.push_back(band); }, maxBands[m]);
+
+        const uint32_t expected = (maxBands[m]==0) ? 1 : maxBands[m];
+        checkCondition(bands.size()==expected, "testNumBands: Expected the bands asked for\n");
+        for (size_t b=0; b<bands.size(); b++) {
+            checkCondition((bands[b].Begin==((b==0) ? 0 : bands[b-1].End)) && (bands[b].End>bands[b].Begin),
+                           "testNumBands: Expected bands in order in the calling thread\n");
+        }
+        checkCondition(bands.back().End==100, "testNumBands: Expected every row\n");
+    }
+
+    uint32_t count = 0;
+    pool.run(100, 10, 0, [&](const RowBand&) { ++count; }, 50);
+    checkCondition(count==10, "testNumBands: Expected bands of at least the grain size\n");
+}
+
+int main(void)
+{
+    testParallelRows();
+    testNumBands();
+
+    return 0;
+}
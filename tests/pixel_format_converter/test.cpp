@@ -0,0 +1,165 @@
+#include <cstring>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include <flitr/cpu_features.h>
+#include <flitr/image.h>
+#include <flitr/image_consumer.h>
+#include <flitr/image_producer.h>
+#include <flitr/pixel_format_converter.h>
+#include <flitr/modules/flitr_image_processors/cnvrt_to_8bit/fip_cnvrt_to_rgb_8.h>
+#include <flitr/modules/flitr_image_processors/cnvrt_to_float/fip_cnvrt_to_y_f32.h>
+
+using namespace flitr;
+
+void checkCondition(bool condition, std::string message)
+{
+    if (!condition) {
+        std::cerr << message;
+        exit(-1);
+    }
+}
+
+// Vectorised row kernels must give the same pixels as converting one pixel
+// at a time, which always takes the scalar path, and as the scalar kernels.
+void testPixelFormatConverter()
+{
+    const ImageFormat::PixelFormat formats[] = {
+        ImageFormat::FLITR_PIX_FMT_Y_8, ImageFormat::FLITR_PIX_FMT_RGB_8, ImageFormat::FLITR_PIX_FMT_BGR,
+        ImageFormat::FLITR_PIX_FMT_BGRA, ImageFormat::FLITR_PIX_FMT_RGBA, ImageFormat::FLITR_PIX_FMT_Y_16,
+        ImageFormat::FLITR_PIX_FMT_Y_F32, ImageFormat::FLITR_PIX_FMT_RGB_F32 };
+    const size_t numFormats = sizeof(formats) / sizeof(formats[0]);
+    const size_t width = 67; // not a multiple of any vector width
+
+    for (size_t i=0; i<numFormats; i++) {
+        const ImageFormat inFormat(uint32_t(width), 1, formats[i]);
+        std::vector<uint8_t> in(inFormat.getBytesPerLine());
+        if ((formats[i]==ImageFormat::FLITR_PIX_FMT_Y_F32) || (formats[i]==ImageFormat::FLITR_PIX_FMT_RGB_F32)) {
+            float *f = (float *)&in[0];
+            for (size_t n=0; n<in.size()/4; n++) f[n] = (float(n*37 % 301) - 20.0f) / 256.0f;
+        } else {
+            for (size_t n=0; n<in.size(); n++) in[n] = uint8_t(n*73 + 11);
+        }
+
+        for (size_t o=0; o<numFormats; o++) {
+            const ImageFormat outFormat(uint32_t(width), 1, formats[o]);
+            const size_t inBPP = inFormat.getBytesPerPixel();
+            const size_t outBPP = outFormat.getBytesPerPixel();
+            std::vector<uint8_t> reference(outFormat.getBytesPerLine());
+
+            // Every level this CPU has, starting with the scalar kernels as reference.
+            for (int level=FLITR_SIMD_SCALAR; level<=FLITR_SIMD_NEON; level++) {
+                setSimdLevel(SimdLevel(level));
+                if (getSimdLevel()!=level) continue;
+
+                PixelFormatConverter converter(formats[i], formats[o], 0.75f);
+                checkCondition(converter.isSupported(), "testPixelFormatConverter: Expected all packed pairs\n");
+
+                std::vector<uint8_t> row(outFormat.getBytesPerLine()), pixels(outFormat.getBytesPerLine());
+                converter.convertRow(&in[0], &row[0], width);
+                for (size_t x=0; x<width; x++) converter.convertRow(&in[x*inBPP], &pixels[x*outBPP], 1);
+                if (level==FLITR_SIMD_SCALAR) reference = row;
+                checkCondition((row==pixels) && (row==reference),
+                               std::string("testPixelFormatConverter: Row differs from pixels with kernel ") +
+                               converter.getKernelName() + "\n");
+            }
+            setSimdLevel(detectSimdLevel());
+        }
+    }
+
+    checkCondition(!PixelFormatConverter(ImageFormat::FLITR_PIX_FMT_YUYV, ImageFormat::FLITR_PIX_FMT_Y_8).isSupported(),
+                   "testPixelFormatConverter: Expected YUV to be unsupported\n");
+
+    // Round trip through float, and the channel order of the colour formats.
+    ImageFormat grey(33, 3);
+    grey.setRowAlignment();
+    Image a(grey), b(ImageFormat(33, 3, ImageFormat::FLITR_PIX_FMT_Y_F32)), c(grey);
+    for (size_t y=0; y<3; y++) for (size_t x=0; x<33; x++) a.line(y)[x] = uint8_t(x*7 + y);
+    checkCondition(PixelFormatConverter(ImageFormat::FLITR_PIX_FMT_Y_8, ImageFormat::FLITR_PIX_FMT_Y_F32).convert(a, b) &&
+                   PixelFormatConverter(ImageFormat::FLITR_PIX_FMT_Y_F32, ImageFormat::FLITR_PIX_FMT_Y_8).convert(b, c),
+                   "testPixelFormatConverter: Expected image conversion\n");
+    for (size_t y=0; y<3; y++) checkCondition(memcmp(a.line(y), c.line(y), 33)==0, "testPixelFormatConverter: Expected round trip\n");
+    checkCondition(!PixelFormatConverter(ImageFormat::FLITR_PIX_FMT_Y_8, ImageFormat::FLITR_PIX_FMT_Y_8).convert(a, b),
+                   "testPixelFormatConverter: Expected format mismatch to fail\n");
+
+    const uint8_t rgba[8] = { 1, 2, 3, 4, 5, 6, 7, 8 };
+    uint8_t bgr[6];
+    PixelFormatConverter(ImageFormat::FLITR_PIX_FMT_RGBA, ImageFormat::FLITR_PIX_FMT_BGR).convertRow(rgba, bgr, 2);
+    checkCondition((bgr[0]==3) && (bgr[2]==1) && (bgr[3]==7) && (bgr[5]==5), "testPixelFormatConverter: Expected BGR order\n");
+}
+
+// Producer of frames in a given format whose bytes count up from a seed.
+class TestProducer : public ImageProducer {
+  public:
+    TestProducer(const ImageFormat& imf)
+    {
+        ImageFormat_.push_back(imf);
+    }
+    bool init()
+    {
+        // Allocate storage
+        SharedImageBuffer_ = std::shared_ptr<SharedImageBuffer>(new SharedImageBuffer(*this, 4, 1));
+        SharedImageBuffer_->initWithStorage();
+
+        return true;
+    }
+    // Write the next frame and return the image it was written to.
+    Image* writeFrame(uint8_t seed)
+    {
+        std::vector<Image**> iv = reserveWriteSlot();
+        if (iv.size()==0) return 0;
+        Image* image = *iv[0];
+        for (uint32_t i=0; i<getFormat().getBytesPerImage(); i++) image->data()[i] = uint8_t(seed + i*7);
+        releaseWriteSlot();
+        return image;
+    }
+};
+
+// The conversion processors must refuse formats they have no converter for
+// in init(), and then convert every frame like the converter of their format.
+void testConvertProcessors()
+{
+    TestProducer yuv(ImageFormat(16, 4, ImageFormat::FLITR_PIX_FMT_YUYV));
+    yuv.init();
+    FIPConvertToRGB8 toRGB(yuv, 1, 1.0f);
+    checkCondition(!toRGB.init(), "testConvertProcessors: Expected YUYV to RGB_8 to fail init\n");
+    FIPConvertToYF32 toYF32(yuv, 1);
+    checkCondition(!toYF32.init(), "testConvertProcessors: Expected YUYV to Y_F32 to fail init\n");
+
+    ImageFormat rgbFormat(21, 5, ImageFormat::FLITR_PIX_FMT_RGB_8);
+    rgbFormat.setRowAlignment();
+    TestProducer rgb(rgbFormat);
+    rgb.init();
+    FIPConvertToYF32 grey(rgb, 1);
+    checkCondition(grey.init(), "testConvertProcessors: Expected RGB_8 to Y_F32 init OK\n");
+    ImageProducer& greyProducer = grey;
+    ImageConsumer ic(greyProducer);
+    ic.init();
+
+    const ImageFormat greyFormat(21, 5, ImageFormat::FLITR_PIX_FMT_Y_F32);
+    const PixelFormatConverter converter(ImageFormat::FLITR_PIX_FMT_RGB_8, ImageFormat::FLITR_PIX_FMT_Y_F32);
+    for (uint8_t frame=0; frame<6; frame++) {
+        Image const * const imRead = rgb.writeFrame(frame);
+        checkCondition(imRead!=0, "testConvertProcessors: Expected write OK\n");
+        checkCondition(grey.trigger(), "testConvertProcessors: Expected trigger OK\n");
+
+        std::vector<Image**> iv = ic.reserveReadSlot();
+        checkCondition(iv.size()==1, "testConvertProcessors: Expected a converted frame\n");
+        Image expected(greyFormat);
+        converter.convert(*imRead, expected);
+        for (size_t y=0; y<5; y++) {
+            checkCondition(memcmp((*iv[0])->line(y), expected.line(y), 21*sizeof(float))==0,
+                           "testConvertProcessors: Expected the converted pixels\n");
+        }
+        ic.releaseReadSlot();
+    }
+}
+
+int main(void)
+{
+    testPixelFormatConverter();
+    testConvertProcessors();
+
+    return 0;
+}
@@ -0,0 +1,99 @@
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include <flitr/image.h>
+#include <flitr/point_op_chain.h>
+
+using namespace flitr;
+
+void checkCondition(bool condition, std::string message)
+{
+    if (!condition) {
+        std::cerr << message;
+        exit(-1);
+    }
+}
+
+// A fused chain must give the pixels of applying its operations one after the
+// other, across tiles and padded rows.
+void testPointOpChain()
+{
+    const size_t width = PointOpChain::TilePixels * 2 + 67, height = 20;
+    ImageFormat inFormat(uint32_t(width), uint32_t(height), ImageFormat::FLITR_PIX_FMT_Y_8);
+    inFormat.setRowAlignment();
+    ImageFormat outFormat(uint32_t(width), uint32_t(height), ImageFormat::FLITR_PIX_FMT_Y_8);
+    outFormat.setRowAlignment();
+    Image in(inFormat), out(outFormat);
+    for (size_t y=0; y<height; y++) for (size_t x=0; x<width; x++) in.line(uint32_t(y))[x] = uint8_t(x*13 + y*7);
+
+    std::vector<float> table;
+    table.push_back(0.0f);
+    table.push_back(0.75f);
+    table.push_back(1.0f);
+
+    PointOpChain chain(ImageFormat::FLITR_PIX_FMT_Y_8, ImageFormat::FLITR_PIX_FMT_Y_8);
+    chain.addGainOffset(1.5f, -0.25f);
+    chain.addPower(0.5f);
+    chain.addLUT(table, 0.0f, 1.0f);
+    chain.addClamp(0.1f, 0.9f);
+    checkCondition(chain.isSupported() && (chain.getNumOps()==4), "testPointOpChain: Expected four operations\n");
+    checkCondition(chain.apply(in, out), "testPointOpChain: Expected image to be processed\n");
+
+    for (size_t y=0; y<height; y++) {
+        for (size_t x=0; x<width; x++) {
+            float v = in.line(uint32_t(y))[x] / 256.0f;
+            v = v * 1.5f - 0.25f;
+            v = (v > 0.0f) ? std::sqrt(v) : 0.0f;
+            const float p = std::min(std::max(v * 2.0f, 0.0f), 2.0f);
+            const size_t k = std::min(size_t(p), size_t(1));
+            v = table[k] + (table[k + 1] - table[k]) * (p - float(k));
+            v = std::min(std::max(v, 0.1f), 0.9f);
+            const int expected = int(v * 256.0f + 0.5f);
+            checkCondition(std::abs(int(out.line(uint32_t(y))[x]) - expected) <= 1,
+                           "testPointOpChain: Pixel differs from the operations applied one by one\n");
+        }
+    }
+
+    // Powers must match powf over the whole range, also when built with -ffast-math.
+    std::vector<float> x, xPower(1000);
+    for (size_t i=0; i<xPower.size(); i++) x.push_back(float(i+1) * 0.01f);
+    const float powers[] = { 0.5f, 2.2f, -1.3f };
+    for (size_t j=0; j<3; j++) {
+        PointOpChain power(ImageFormat::FLITR_PIX_FMT_Y_F32, ImageFormat::FLITR_PIX_FMT_Y_F32);
+        power.addPower(powers[j]);
+        power.applyRow((uint8_t const *)&x[0], (uint8_t *)&xPower[0], x.size());
+        for (size_t i=0; i<x.size(); i++) {
+            const float expected = std::pow(x[i], powers[j]);
+            checkCondition(std::fabs(xPower[i] - expected) <= 1.0e-5f * expected,
+                           "testPointOpChain: Expected power to match powf\n");
+        }
+    }
+
+    // Colour stays colour, channel by channel.
+    uint8_t rgb[6] = { 10, 200, 128, 127, 0, 255 };
+    uint8_t bgr[6];
+    PointOpChain threshold(ImageFormat::FLITR_PIX_FMT_RGB_8, ImageFormat::FLITR_PIX_FMT_BGR);
+    threshold.addThreshold(0.5f, 0.25f, 0.75f);
+    threshold.applyRow(rgb, bgr, 2);
+    checkCondition((bgr[0]==192) && (bgr[1]==192) && (bgr[2]==64) && (bgr[3]==192) && (bgr[4]==64) && (bgr[5]==64),
+                   "testPointOpChain: Expected a threshold per channel\n");
+
+    // Without operations the chain is a conversion.
+    const uint16_t y16[3] = { 0, 32768, 65535 };
+    float f[3];
+    PointOpChain(ImageFormat::FLITR_PIX_FMT_Y_16, ImageFormat::FLITR_PIX_FMT_Y_F32).applyRow((uint8_t const *)y16, (uint8_t *)f, 3);
+    checkCondition((f[0]==0.0f) && (f[1]==0.5f) && (f[2]==65535.0f / 65536.0f), "testPointOpChain: Expected plain conversion\n");
+
+    checkCondition(!PointOpChain(ImageFormat::FLITR_PIX_FMT_Y_16, ImageFormat::FLITR_PIX_FMT_Y_8).apply(in, out),
+                   "testPointOpChain: Expected format mismatch to fail\n");
+}
+
+int main(void)
+{
+    testPointOpChain();
+
+    return 0;
+}
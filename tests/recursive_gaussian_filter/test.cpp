@@ -0,0 +1,98 @@
+#include <cmath>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include <flitr/image_processor_utils.h>
+
+using namespace flitr;
+
+void checkCondition(bool condition, std::string message)
+{
+    if (!condition) {
+        std::cerr << message;
+        exit(-1);
+    }
+}
+
+// The recursive filter must keep flat images flat up to the edges, be close to the
+// FIR filter in the interior, and filter RGB channels like grey images.
+void testRecursiveGaussianFilter()
+{
+    const size_t width = 123, height = 97, stride = 3*width + 5, kernelWidth = 33;
+    const float filterRadius = 8.0f;
+    RecursiveGaussianFilter recursive(filterRadius);
+
+    std::vector<uint8_t> flat8(stride*height, 77), flatOut8(stride*height, 0);
+    recursive.filterRGB(&flatOut8[0], &flat8[0], width, height, stride);
+    for (size_t y=0; y<height; y++) for (size_t x=0; x<width*3; x++) {
+        checkCondition(flatOut8[y*stride + x]==77, "testRecursiveGaussianFilter: Expected a flat image to stay flat\n");
+    }
+
+    std::vector<float> in(width*height), fir(width*height), iir(width*height);
+    std::vector<uint8_t> in8(width*height), iir8(width*height);
+    for (size_t y=0; y<height; y++) for (size_t x=0; x<width; x++) {
+        in8[y*width + x] = uint8_t((x*37 + y*11)%151 + ((x/20 + y/20)%2)*100);
+        in[y*width + x] = in8[y*width + x];
+    }
+    GaussianFilter(filterRadius, kernelWidth).filter(&fir[0], &in[0], width, height, nullptr);
+    recursive.filter(&iir[0], &in[0], width, height);
+    recursive.filter(&iir8[0], &in8[0], width, height);
+    for (size_t y=kernelWidth/2; y<height-kernelWidth/2; y++) for (size_t x=kernelWidth/2; x<width-kernelWidth/2; x++) {
+        checkCondition(std::abs(fir[y*width + x] - iir[y*width + x]) < 5.0f, "testRecursiveGaussianFilter: Expected about the FIR result\n");
+    }
+    for (size_t i=0; i<width*height; i++) {
+        checkCondition(std::abs(float(iir8[i]) - iir[i]) <= 0.5f + 1e-3f, "testRecursiveGaussianFilter: Expected the 8 bit result to be rounded\n");
+    }
+
+    // Padded RGB rows, filtered in place, with a different image per channel.
+    std::vector<float> rgb(stride*height, 0.0f);
+    for (size_t y=0; y<height; y++) for (size_t x=0; x<width; x++) for (size_t c=0; c<3; c++) {
+        rgb[y*stride + x*3 + c] = in[y*width + x] * float(c + 1);
+    }
+    recursive.filterRGB(&rgb[0], &rgb[0], width, height, stride);
+    for (size_t y=0; y<height; y++) for (size_t x=0; x<width; x++) for (size_t c=0; c<3; c++) {
+        checkCondition(std::abs(rgb[y*stride + x*3 + c] - iir[y*width + x] * float(c + 1)) < 1e-2f,
+                       "testRecursiveGaussianFilter: Expected RGB channels to be filtered like grey images\n");
+    }
+}
+
+// The pixels must not depend on how the rows, and the columns, are split into
+// bands, also on one core.
+void testRecursiveGaussianFilterBands()
+{
+    const size_t width = 123, height = 97, stride = 3*width + 5;
+    std::vector<float> inF(stride*height, 0.0f);
+    std::vector<uint8_t> in8(stride*height, 0);
+    for (size_t i=0; i<inF.size(); i++) {
+        in8[i] = uint8_t((i*37 + (i/stride)*11) % 151);
+        inF[i] = float(in8[i]);
+    }
+
+    RecursiveGaussianFilter recursive(8.0f);
+    std::vector<float> singleF(inF.size(), 0.0f), bandsF(inF.size(), 0.0f);
+    std::vector<uint8_t> single8(in8.size(), 0), bands8(in8.size(), 0);
+    for (size_t channels=1; channels<=3; channels+=2) {
+        for (uint32_t numBands=1; numBands<=5; numBands+=4) {
+            recursive.setMaxRowBands(numBands);
+            std::vector<float>& outF = (numBands==1) ? singleF : bandsF;
+            std::vector<uint8_t>& out8 = (numBands==1) ? single8 : bands8;
+            if (channels==1) {
+                recursive.filter(&outF[0], &inF[0], width, height, stride);
+                recursive.filter(&out8[0], &in8[0], width, height, stride);
+            } else {
+                recursive.filterRGB(&outF[0], &inF[0], width, height, stride);
+                recursive.filterRGB(&out8[0], &in8[0], width, height, stride);
+            }
+        }
+        checkCondition((singleF==bandsF) && (single8==bands8), "testRecursiveGaussianFilterBands: Expected the same pixels in bands\n");
+    }
+}
+
+int main(void)
+{
+    testRecursiveGaussianFilter();
+    testRecursiveGaussianFilterBands();
+
+    return 0;
+}
@@ -1,8 +1,16 @@
+#include <algorithm>
+#include <chrono>
+#include <cstring>
 #include <iostream>
+#include <mutex>
 #include <string>
+#include <thread>
+#include <vector>
 
 #include <flitr/image_consumer.h>
 #include <flitr/image_producer.h>
+#include <flitr/image_processor.h>
+#include <flitr/image_processor_executor.h>
 
 using std::shared_ptr;
 using namespace flitr;
@@ -20,9 +28,11 @@ void checkCondition(bool condition, std::string message)
 
 class TestProducer : public ImageProducer {
   public:
-    TestProducer()
+    TestProducer(SharedImageBuffer::SyncMode syncMode = SharedImageBuffer::SYNC_MUTEX) :
+        syncMode_(syncMode)
     {
         bufferSize_ = BUFFER_SZ;
+        notifyCount_ = 0;
     }
     bool init()
     {
@@ -30,7 +40,7 @@ class TestProducer : public ImageProducer {
         ImageFormat_.push_back(imf);
 
         // Allocate storage
-        SharedImageBuffer_ = shared_ptr<SharedImageBuffer>(new SharedImageBuffer(*this, bufferSize_, 1));
+        SharedImageBuffer_ = shared_ptr<SharedImageBuffer>(new SharedImageBuffer(*this, bufferSize_, 1, syncMode_));
         SharedImageBuffer_->initWithStorage();
         
         return true;
@@ -66,23 +76,70 @@ class TestProducer : public ImageProducer {
         releaseWriteSlot();
         return true;
     }
+    // Write a frame number into the first bytes of the next slot.
+    bool writeFrame(uint32_t frame)
+    {
+        std::vector<Image**> iv = reserveWriteSlot();
+        if (iv.size()==0) return false;
+        memcpy((*iv[0])->data(), &frame, sizeof(frame));
+        releaseWriteSlot();
+        return true;
+    }
+    using ImageProducer::reserveWriteSlots;
+    using ImageProducer::releaseWriteSlots;
+    // Write consecutive frame numbers into up to max_frames slots with one reservation.
+    uint32_t writeFrames(uint32_t first, uint32_t max_frames)
+    {
+        SlotSpan span = reserveWriteSlots(max_frames);
+        for (uint32_t s=0; s<span.size(); s++) {
+            const uint32_t frame = first + s;
+            memcpy(span[s][0]->data(), &frame, sizeof(frame));
+        }
+        releaseWriteSlots(span.size());
+        return span.size();
+    }
+    // Pass the next upstream frame on without copying it.
+    bool passFrame(ImageConsumer& upstream)
+    {
+        std::vector<Image**> ivRead = upstream.reserveReadSlot();
+        if (ivRead.size()==0) return false;
+        std::vector<Image**> ivWrite = reserveWriteSlot();
+        if (ivWrite.size()==0) return false;
+        bool shared = (*ivWrite[0])->shareDataFrom(**ivRead[0]);
+        releaseWriteSlot();
+        upstream.releaseReadSlot();
+        return shared;
+    }
+    void addSlotListener(SharedImageBuffer::SlotEvent event, const void* owner, SharedImageBuffer::SlotListener listener)
+    {
+        SharedImageBuffer_->addSlotListener(event, owner, listener);
+    }
+    void removeSlotListeners(const void* owner)
+    {
+        SharedImageBuffer_->removeSlotListeners(owner);
+    }
     void releaseReadSlotCallback() 
     {
         notified_ = true;
+        ++notifyCount_;
     }
     void resetNotified() { notified_ = false; }
     bool getNotified() { return notified_; }
+    uint32_t getNotifyCount() { return notifyCount_; }
 
   private:
+    SharedImageBuffer::SyncMode syncMode_;
     uint32_t bufferSize_;
-    bool notified_;
+    std::atomic<bool> notified_;
+    std::atomic<uint32_t> notifyCount_;
 
 };
 
 class TestConsumer : public ImageConsumer {
   public:
-    TestConsumer(ImageProducer& producer) :
-        ImageConsumer(producer)
+    TestConsumer(ImageProducer& producer,
+                 SharedImageBuffer::OverflowPolicy overflowPolicy = SharedImageBuffer::OVERFLOW_LOSSLESS) :
+        ImageConsumer(producer, overflowPolicy)
     {
         
     }
@@ -101,11 +158,33 @@ class TestConsumer : public ImageConsumer {
         releaseReadSlot();
         return true;
     }
+    // Read the frame number from the next slot. Returns false if none available.
+    bool readFrame(uint32_t& frame)
+    {
+        std::vector<Image**> iv = reserveReadSlot();
+        if (iv.size()==0) return false;
+        memcpy(&frame, (*iv[0])->data(), sizeof(frame));
+        releaseReadSlot();
+        return true;
+    }
+    // Read the frame numbers from up to max_frames slots with one reservation.
+    std::vector<uint32_t> readFrames(uint32_t max_frames)
+    {
+        std::vector<uint32_t> frames;
+        SlotSpan span = reserveReadSlots(max_frames);
+        for (uint32_t s=0; s<span.size(); s++) {
+            uint32_t frame;
+            memcpy(&frame, span[s][0]->data(), sizeof(frame));
+            frames.push_back(frame);
+        }
+        releaseReadSlots(span.size());
+        return frames;
+    }
 };
 
-int main(void)
+void testSemantics(SharedImageBuffer::SyncMode syncMode)
 {
-    shared_ptr<TestProducer> tp(new TestProducer());
+    shared_ptr<TestProducer> tp(new TestProducer(syncMode));
     tp->init();
 
     // just advance writer a bit
@@ -261,3 +340,645 @@ int main(void)
         checkCondition((num_avail == 0), "Expected none available\n");
     }
 }
+
+// Copies the frame number from the upstream slot to the downstream slot.
+class TestPassProcessor : public ImageProcessor {
+  public:
+    TestPassProcessor(ImageProducer& producer, SharedImageBuffer::SyncMode syncMode) :
+        ImageProcessor(producer, 1, BUFFER_SZ)
+    {
+        ImageFormat_.push_back(producer.getFormat());
+        setSharedImageBufferSyncMode(syncMode);
+    }
+    bool trigger()
+    {
+        if ((getNumReadSlotsAvailable()==0) || (getNumWriteSlotsAvailable()==0)) return false;
+        std::vector<Image**> ivRead = reserveReadSlot();
+        std::vector<Image**> ivWrite = reserveWriteSlot();
+        memcpy((*ivWrite[0])->data(), (*ivRead[0])->data(), sizeof(uint32_t));
+        releaseWriteSlot();
+        releaseReadSlot();
+        return true;
+    }
+};
+
+// Processors on a shared executor must deliver every frame in order
+// down a chain and down an independent branch.
+void testExecutor(SharedImageBuffer::SyncMode syncMode)
+{
+    const uint32_t waitTimeoutUS = 1000000;
+    const uint32_t numFrames = 5000;
+
+    shared_ptr<TestProducer> tp(new TestProducer(syncMode));
+    tp->init();
+
+    std::vector<shared_ptr<TestPassProcessor> > chain;
+    for (uint32_t i=0; i<3; i++) {
+        ImageProducer& upstream = chain.empty() ? static_cast<ImageProducer&>(*tp) : *chain.back();
+        chain.push_back(shared_ptr<TestPassProcessor>(new TestPassProcessor(upstream, syncMode)));
+        chain.back()->init();
+    }
+    shared_ptr<TestPassProcessor> branch(new TestPassProcessor(*tp, syncMode));
+    branch->init();
+
+    std::vector<shared_ptr<TestConsumer> > consumers;
+    consumers.push_back(shared_ptr<TestConsumer>(new TestConsumer(*chain.back())));
+    consumers.push_back(shared_ptr<TestConsumer>(new TestConsumer(*branch)));
+
+    shared_ptr<ImageProcessorExecutor> executor(new ImageProcessorExecutor(2));
+    checkCondition(executor->getNumThreads()==2, "testExecutor: Expected two workers\n");
+    for (uint32_t i=0; i<chain.size(); i++) {
+        checkCondition(chain[i]->attachToExecutor(executor), "testExecutor: Expected attach OK\n");
+    }
+    checkCondition(branch->attachToExecutor(executor), "testExecutor: Expected attach OK\n");
+    checkCondition(!branch->attachToExecutor(executor), "testExecutor: Expected second attach to fail\n");
+    checkCondition(!branch->startTriggerThread(), "testExecutor: Expected thread start to fail while attached\n");
+
+    std::vector<std::thread> threads;
+    std::vector<int> results(consumers.size(), 0);
+    for (uint32_t i=0; i<consumers.size(); i++) {
+        threads.push_back(std::thread([&, i]() {
+            uint32_t expected = 0;
+            while (expected < numFrames) {
+                uint32_t frame;
+                if (consumers[i]->readFrame(frame)) {
+                    if (frame != expected) return;
+                    ++expected;
+                } else if (!consumers[i]->waitForReadSlot(waitTimeoutUS)) {
+                    return;
+                }
+            }
+            results[i] = 1;
+        }));
+    }
+
+    for (uint32_t frame=0; frame<numFrames; ) {
+        if (tp->writeFrame(frame)) {
+            ++frame;
+        } else {
+            checkCondition(tp->waitForWriteSlot(waitTimeoutUS), "testExecutor: Write wait timed out\n");
+        }
+    }
+
+    for (uint32_t i=0; i<consumers.size(); i++) {
+        threads[i].join();
+        checkCondition(results[i]==1, "testExecutor: Expected all frames in order\n");
+    }
+
+    for (uint32_t i=0; i<chain.size(); i++) {
+        checkCondition(chain[i]->detachFromExecutor(), "testExecutor: Expected detach OK\n");
+    }
+    checkCondition(chain.back()->getFrameNumber()==numFrames, "testExecutor: Expected one trigger per frame\n");
+    checkCondition(branch->stopTriggerThread(), "testExecutor: Expected stop to detach\n");
+    checkCondition(!branch->isAttachedToExecutor(), "testExecutor: Expected detached\n");
+
+    // consumers go before the producers they are connected to
+    consumers.clear();
+    while (!chain.empty()) chain.pop_back();
+}
+
+// Always has work until it has been triggered numTriggers times.
+class TestBusyProcessor : public ImageProcessor {
+  public:
+    TestBusyProcessor(ImageProducer& producer, uint32_t id, uint32_t numTriggers,
+                      std::atomic<bool>& go, std::mutex& orderMutex, std::vector<uint32_t>& order) :
+        ImageProcessor(producer, 1, BUFFER_SZ),
+        id_(id), numTriggers_(numTriggers), go_(go), orderMutex_(orderMutex), order_(order)
+    {
+        ImageFormat_.push_back(producer.getFormat());
+    }
+    bool trigger()
+    {
+        if (!go_ || (getFrameNumber() >= numTriggers_)) return false;
+        std::lock_guard<std::mutex> orderLock(orderMutex_);
+        order_.push_back(id_);
+        return true;
+    }
+  private:
+    uint32_t id_;
+    uint32_t numTriggers_;
+    std::atomic<bool>& go_;
+    std::mutex& orderMutex_;
+    std::vector<uint32_t>& order_;
+};
+
+// Two processors that always have work must take turns on one worker.
+void testExecutorFairness()
+{
+    const uint32_t numTriggers = 1000;
+
+    shared_ptr<TestProducer> tp(new TestProducer());
+    tp->init();
+
+    std::atomic<bool> go(false);
+    std::mutex orderMutex;
+    std::vector<uint32_t> order;
+    std::vector<shared_ptr<TestBusyProcessor> > processors;
+    for (uint32_t id=0; id<2; id++) {
+        processors.push_back(shared_ptr<TestBusyProcessor>(new TestBusyProcessor(*tp, id, numTriggers, go, orderMutex, order)));
+        processors.back()->init();
+    }
+
+    shared_ptr<ImageProcessorExecutor> executor(new ImageProcessorExecutor(1));
+    for (uint32_t i=0; i<processors.size(); i++) {
+        checkCondition(processors[i]->attachToExecutor(executor), "testExecutorFairness: Expected attach OK\n");
+    }
+
+    // Start both at once so that neither runs alone while the other attaches.
+    go = true;
+    for (uint32_t i=0; i<processors.size(); i++) {
+        executor->schedule(*processors[i]);
+    }
+
+    for (uint32_t i=0; i<10000; i++) {
+        if ((processors[0]->getFrameNumber()==numTriggers) && (processors[1]->getFrameNumber()==numTriggers)) break;
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    for (uint32_t i=0; i<processors.size(); i++) {
+        checkCondition(processors[i]->detachFromExecutor(), "testExecutorFairness: Expected detach OK\n");
+        checkCondition(processors[i]->getFrameNumber()==numTriggers, "testExecutorFairness: Expected all triggers\n");
+    }
+
+    // Find the longest run of triggers of one processor until either is done.
+    uint32_t longestRun = 0;
+    uint32_t run = 0;
+    uint32_t counts[2] = { 0, 0 };
+    for (size_t i=0; (i<order.size()) && (counts[0]<numTriggers) && (counts[1]<numTriggers); i++) {
+        run = ((i > 0) && (order[i]==order[i-1])) ? (run + 1) : 1;
+        longestRun = std::max(longestRun, run);
+        ++counts[order[i]];
+    }
+    checkCondition(longestRun <= 2, "testExecutorFairness: Expected processors to take turns\n");
+}
+
+// Batch reservations must behave as the same number of single ones.
+void testBatchSlots(SharedImageBuffer::SyncMode syncMode)
+{
+    shared_ptr<TestProducer> tp(new TestProducer(syncMode));
+    tp->init();
+    shared_ptr<TestConsumer> tc(new TestConsumer(*tp));
+
+    {
+        SlotSpan span = tp->reserveWriteSlots(0);
+        checkCondition(span.empty(), "testBatchSlots: Expected no slots\n");
+    }
+
+    // A batch stops where the single reserves would have failed.
+    checkCondition(tp->writeFrames(0, 100)==BUFFER_SZ, "testBatchSlots: Expected to fill the buffer\n");
+    checkCondition(tp->getNumWriteSlotsAvailable()==0, "testBatchSlots: Expected full\n");
+    checkCondition(tc->getNumReadSlotsAvailable()==BUFFER_SZ, "testBatchSlots: Expected all readable\n");
+
+    // Batch and single reads see the same frames in order.
+    std::vector<uint32_t> frames = tc->readFrames(4);
+    checkCondition(frames.size()==4, "testBatchSlots: Expected four frames\n");
+    uint32_t frame = 4;
+    checkCondition(tc->readFrame(frame) && frame==4, "testBatchSlots: Expected single read to continue\n");
+    std::vector<uint32_t> rest = tc->readFrames(100);
+    frames.push_back(frame);
+    frames.insert(frames.end(), rest.begin(), rest.end());
+    checkCondition(frames.size()==BUFFER_SZ, "testBatchSlots: Expected all frames\n");
+    for (uint32_t i=0; i<frames.size(); i++) {
+        checkCondition(frames[i]==i, "testBatchSlots: Expected frames in order\n");
+    }
+    checkCondition(tp->getNumWriteSlotsAvailable()==BUFFER_SZ, "testBatchSlots: Expected empty\n");
+
+    // Slots match the single reservation API and are released oldest first.
+    {
+        SlotSpan span = tp->reserveWriteSlots(3);
+        checkCondition(span.size()==3, "testBatchSlots: Expected three slots\n");
+        checkCondition(span.getImagesPerSlot()==1, "testBatchSlots: Expected one image per slot\n");
+        checkCondition(tp->getNumWriteSlotsReserved()==3, "testBatchSlots: Expected three reserved\n");
+        for (uint32_t s=0; s<span.size(); s++) {
+            const uint32_t f = 100 + s;
+            memcpy(span[s][0]->data(), &f, sizeof(f));
+        }
+        tp->releaseWriteSlots(2);
+        checkCondition(tc->getNumReadSlotsAvailable()==2, "testBatchSlots: Expected the oldest two readable\n");
+        tp->releaseOne();
+    }
+    {
+        SlotSpan span = tc->reserveReadSlots(3);
+        checkCondition(span.size()==3, "testBatchSlots: Expected three read slots\n");
+        checkCondition(tc->getNumReadSlotsReserved()==3, "testBatchSlots: Expected three read reserved\n");
+        for (uint32_t s=0; s<span.size(); s++) {
+            uint32_t f;
+            memcpy(&f, span[s][0]->data(), sizeof(f));
+            checkCondition(f==100+s, "testBatchSlots: Expected written frames\n");
+        }
+        tc->releaseReadSlot();
+        tc->releaseReadSlots(2);
+        checkCondition(tc->getNumReadSlotsReserved()==0, "testBatchSlots: Expected none read reserved\n");
+    }
+
+    tc.reset();
+}
+
+// Stateless version of TestPassProcessor that takes longer on some frames.
+class TestFrameProcessor : public TestPassProcessor {
+  public:
+    TestFrameProcessor(ImageProducer& producer, SharedImageBuffer::SyncMode syncMode) :
+        TestPassProcessor(producer, syncMode) {}
+    bool trigger() { return triggerFrame(); }
+    bool isStateless() const { return true; }
+  protected:
+    void processFrame(const std::vector<Image**>& imvRead, const std::vector<Image**>& imvWrite)
+    {
+        uint32_t frame;
+        memcpy(&frame, (*imvRead[0])->data(), sizeof(frame));
+        if ((frame % 7)==0) std::this_thread::sleep_for(std::chrono::microseconds(200));
+        memcpy((*imvWrite[0])->data(), &frame, sizeof(frame));
+    }
+};
+
+// Frame workers finish out of order but must deliver every frame in order.
+void testFrameWorkers(SharedImageBuffer::SyncMode syncMode)
+{
+    const uint32_t waitTimeoutUS = 1000000;
+    const uint32_t numFrames = 2000;
+
+    shared_ptr<TestProducer> tp(new TestProducer(syncMode));
+    tp->init();
+
+    shared_ptr<TestPassProcessor> stateful(new TestPassProcessor(*tp, syncMode));
+    checkCondition(!stateful->setNumFrameWorkers(4), "testFrameWorkers: Expected stateful processor to refuse workers\n");
+    stateful.reset();
+
+    shared_ptr<TestFrameProcessor> fp(new TestFrameProcessor(*tp, syncMode));
+    fp->init();
+    checkCondition(!fp->setNumFrameWorkers(0), "testFrameWorkers: Expected zero workers to fail\n");
+    checkCondition(fp->setNumFrameWorkers(4), "testFrameWorkers: Expected set workers OK\n");
+    checkCondition(fp->getNumFrameWorkers()==4, "testFrameWorkers: Expected four workers\n");
+
+    shared_ptr<TestConsumer> tc(new TestConsumer(*fp));
+
+    checkCondition(fp->startTriggerThread(), "testFrameWorkers: Expected start OK\n");
+    checkCondition(fp->isTriggerThreadStarted(), "testFrameWorkers: Expected started\n");
+    checkCondition(!fp->setNumFrameWorkers(2), "testFrameWorkers: Expected set workers to fail while started\n");
+
+    int result = 0;
+    std::thread reader([&]() {
+        uint32_t expected = 0;
+        while (expected < numFrames) {
+            uint32_t frame;
+            if (tc->readFrame(frame)) {
+                if (frame != expected) return;
+                ++expected;
+            } else if (!tc->waitForReadSlot(waitTimeoutUS)) {
+                return;
+            }
+        }
+        result = 1;
+    });
+
+    for (uint32_t frame=0; frame<numFrames; ) {
+        if (tp->writeFrame(frame)) {
+            ++frame;
+        } else {
+            checkCondition(tp->waitForWriteSlot(waitTimeoutUS), "testFrameWorkers: Write wait timed out\n");
+        }
+    }
+
+    reader.join();
+    checkCondition(result==1, "testFrameWorkers: Expected all frames in order\n");
+
+    checkCondition(fp->stopTriggerThread(), "testFrameWorkers: Expected stop OK\n");
+    checkCondition(!fp->isTriggerThreadStarted(), "testFrameWorkers: Expected stopped\n");
+    checkCondition(fp->getFrameNumber()==numFrames, "testFrameWorkers: Expected one release per frame\n");
+
+    tc.reset();
+    fp.reset();
+}
+
+// Many consumers reading concurrently must each see every frame, in
+// order, and the producer must be notified once per popped slot. When
+// blocking, the threads wait on the buffer instead of yielding; a wait
+// that times out while frames are still flowing is a lost wakeup.
+void testConcurrentConsumers(SharedImageBuffer::SyncMode syncMode, bool blocking)
+{
+    const uint32_t waitTimeoutUS = 1000000;
+    const uint32_t numConsumers = 8;
+    const uint32_t numFrames = 20000;
+
+    shared_ptr<TestProducer> tp(new TestProducer(syncMode));
+    tp->init();
+
+    std::vector<shared_ptr<TestConsumer> > consumers;
+    for (uint32_t i=0; i<numConsumers; i++) {
+        consumers.push_back(shared_ptr<TestConsumer>(new TestConsumer(*tp)));
+        consumers.back()->init();
+    }
+
+    std::vector<std::thread> threads;
+    std::vector<int> results(numConsumers, 0);
+    for (uint32_t i=0; i<numConsumers; i++) {
+        threads.push_back(std::thread([&, i]() {
+            uint32_t expected = 0;
+            while (expected < numFrames) {
+                uint32_t frame;
+                if (consumers[i]->readFrame(frame)) {
+                    if (frame != expected) return;
+                    ++expected;
+                } else if (blocking) {
+                    if (!consumers[i]->waitForReadSlot(waitTimeoutUS)) return;
+                } else {
+                    std::this_thread::yield();
+                }
+            }
+            results[i] = 1;
+        }));
+    }
+
+    for (uint32_t frame=0; frame<numFrames; ) {
+        if (tp->writeFrame(frame)) {
+            ++frame;
+        } else if (blocking) {
+            checkCondition(tp->waitForWriteSlot(waitTimeoutUS), "testConcurrentConsumers: Write wait timed out\n");
+        } else {
+            std::this_thread::yield();
+        }
+    }
+
+    for (uint32_t i=0; i<numConsumers; i++) {
+        threads[i].join();
+        checkCondition(results[i]==1, "testConcurrentConsumers: Expected all frames in order\n");
+    }
+    checkCondition(tp->getNotifyCount()==numFrames, "testConcurrentConsumers: Expected one notify per frame\n");
+}
+
+// Consumers that allow dropping must never hold back the producer
+// unless they are busy with their oldest slot.
+void testOverflowPolicies(SharedImageBuffer::SyncMode syncMode)
+{
+    shared_ptr<TestProducer> tp(new TestProducer(syncMode));
+    tp->init();
+
+    // drop oldest: writing never fails and the newest frames survive
+    {
+        shared_ptr<TestConsumer> tc(new TestConsumer(*tp, SharedImageBuffer::OVERFLOW_DROP_OLDEST));
+        checkCondition(tc->getOverflowPolicy()==SharedImageBuffer::OVERFLOW_DROP_OLDEST, "testOverflowPolicies: Expected drop oldest policy\n");
+        const uint32_t numFrames = 3*BUFFER_SZ;
+        for (uint32_t i=0; i<numFrames; i++) {
+            checkCondition(tp->writeFrame(i), "testOverflowPolicies: Expected write OK with drop oldest consumer\n");
+        }
+        uint32_t num_avail = tc->getNumReadSlotsAvailable();
+        checkCondition((num_avail > 0) && (num_avail < BUFFER_SZ), "testOverflowPolicies: Expected oldest slots dropped\n");
+        checkCondition(tc->getNumDroppedSlots()==numFrames-num_avail, "testOverflowPolicies: Expected drop count\n");
+        uint32_t frame;
+        for (uint32_t i=numFrames-num_avail; i<numFrames; i++) {
+            checkCondition(tc->readFrame(frame) && (frame==i), "testOverflowPolicies: Expected newest frames in order\n");
+        }
+    }
+
+    // a consumer holding its oldest slot holds back the producer
+    {
+        shared_ptr<TestConsumer> tc(new TestConsumer(*tp, SharedImageBuffer::OVERFLOW_DROP_OLDEST));
+        checkCondition(tp->writeFrame(0), "testOverflowPolicies: Expected write OK\n");
+        checkCondition(tc->reserveOne(), "testOverflowPolicies: Expected read reserve OK\n");
+        uint32_t numWritten = 1;
+        while (tp->writeFrame(numWritten)) {
+            numWritten++;
+            checkCondition(numWritten <= BUFFER_SZ, "testOverflowPolicies: Expected reserved slot to block\n");
+        }
+        checkCondition(tp->getNumWriteSlotsAvailable()==0, "testOverflowPolicies: Expected no write slots\n");
+        tc->releaseOne();
+        checkCondition(tp->writeFrame(numWritten), "testOverflowPolicies: Expected write OK after release\n");
+    }
+
+    // latest only: a read skips to the newest frame
+    {
+        shared_ptr<TestConsumer> tc(new TestConsumer(*tp, SharedImageBuffer::OVERFLOW_LATEST_ONLY));
+        for (uint32_t i=0; i<BUFFER_FRAG; i++) {
+            checkCondition(tp->writeFrame(i), "testOverflowPolicies: Expected write OK\n");
+        }
+        uint32_t frame;
+        checkCondition(tc->readFrame(frame) && (frame==BUFFER_FRAG-1), "testOverflowPolicies: Expected newest frame\n");
+        checkCondition(tc->getNumDroppedSlots()==BUFFER_FRAG-1, "testOverflowPolicies: Expected skipped frames counted\n");
+        checkCondition(!tc->readFrame(frame), "testOverflowPolicies: Expected nothing more to read\n");
+    }
+
+    // a lossless consumer still holds back the producer next to a lossy one
+    {
+        shared_ptr<TestConsumer> tcLossy(new TestConsumer(*tp, SharedImageBuffer::OVERFLOW_LATEST_ONLY));
+        shared_ptr<TestConsumer> tcLossless(new TestConsumer(*tp));
+        for (uint32_t i=0; i<BUFFER_SZ; i++) {
+            checkCondition(tp->writeFrame(i), "testOverflowPolicies: Expected write OK\n");
+        }
+        checkCondition(!tp->writeFrame(BUFFER_SZ), "testOverflowPolicies: Expected lossless consumer to block\n");
+        checkCondition(tcLossless->getNumDroppedSlots()==0, "testOverflowPolicies: Expected no drops for lossless consumer\n");
+        uint32_t frame;
+        for (uint32_t i=0; i<BUFFER_SZ; i++) {
+            checkCondition(tcLossless->readFrame(frame) && (frame==i), "testOverflowPolicies: Expected all frames in order\n");
+        }
+    }
+}
+
+// Lossless consumers must see every frame while slow lossy consumers
+// drop frames, and every slot must still be reported popped once.
+void testConcurrentDropping(SharedImageBuffer::SyncMode syncMode)
+{
+    const uint32_t numConsumers = 8;
+    const uint32_t numFrames = 20000;
+
+    shared_ptr<TestProducer> tp(new TestProducer(syncMode));
+    tp->init();
+
+    std::vector<shared_ptr<TestConsumer> > consumers;
+    for (uint32_t i=0; i<numConsumers; i++) {
+        const SharedImageBuffer::OverflowPolicy policy =
+            (i%2==0) ? SharedImageBuffer::OVERFLOW_LOSSLESS :
+            ((i%4==1) ? SharedImageBuffer::OVERFLOW_DROP_OLDEST : SharedImageBuffer::OVERFLOW_LATEST_ONLY);
+        consumers.push_back(shared_ptr<TestConsumer>(new TestConsumer(*tp, policy)));
+    }
+
+    std::vector<std::thread> threads;
+    std::vector<int> results(numConsumers, 0);
+    std::vector<uint32_t> numRead(numConsumers, 0);
+    for (uint32_t i=0; i<numConsumers; i++) {
+        threads.push_back(std::thread([&, i]() {
+            const bool lossless = (consumers[i]->getOverflowPolicy()==SharedImageBuffer::OVERFLOW_LOSSLESS);
+            uint32_t next = 0;
+            while (next < numFrames) {
+                uint32_t frame;
+                if (consumers[i]->readFrame(frame)) {
+                    if (lossless ? (frame != next) : (frame < next)) return;
+                    next = frame + 1;
+                    ++numRead[i];
+                    if (!lossless && (frame % 7 == 0)) std::this_thread::sleep_for(std::chrono::microseconds(50));
+                } else {
+                    std::this_thread::yield();
+                }
+            }
+            results[i] = 1;
+        }));
+    }
+
+    for (uint32_t frame=0; frame<numFrames; ) {
+        if (tp->writeFrame(frame)) {
+            ++frame;
+        } else {
+            std::this_thread::yield();
+        }
+    }
+
+    for (uint32_t i=0; i<numConsumers; i++) {
+        threads[i].join();
+        checkCondition(results[i]==1, "testConcurrentDropping: Expected frames in order\n");
+        checkCondition(numRead[i] + consumers[i]->getNumDroppedSlots() == numFrames,
+                       "testConcurrentDropping: Expected every frame read or dropped\n");
+    }
+    checkCondition(tp->getNotifyCount()==numFrames, "testConcurrentDropping: Expected one notify per frame\n");
+}
+
+// A frame passed on without copying must survive the upstream
+// producer reusing its slot.
+void testSharedStorage(SharedImageBuffer::SyncMode syncMode)
+{
+    shared_ptr<TestProducer> tpUp(new TestProducer(syncMode));
+    tpUp->init();
+    shared_ptr<TestConsumer> tcUp(new TestConsumer(*tpUp));
+    shared_ptr<TestProducer> tpDown(new TestProducer(syncMode));
+    tpDown->init();
+    shared_ptr<TestConsumer> tcDown(new TestConsumer(*tpDown));
+
+    checkCondition(tpUp->writeFrame(1234), "testSharedStorage: Expected write OK\n");
+    checkCondition(tpDown->passFrame(*tcUp), "testSharedStorage: Expected pass OK\n");
+
+    // wrap the upstream buffer so the slot is written again
+    uint32_t frame;
+    for (uint32_t i=0; i<2*BUFFER_SZ; i++) {
+        checkCondition(tpUp->writeFrame(i), "testSharedStorage: Expected write OK\n");
+        checkCondition(tcUp->readFrame(frame) && (frame==i), "testSharedStorage: Expected upstream frames\n");
+    }
+
+    checkCondition(tcDown->readFrame(frame) && (frame==1234), "testSharedStorage: Expected passed frame intact\n");
+
+    // copies do not share
+    {
+        ImageFormat imf(4,4);
+        Image a(imf);
+        a.data()[0] = 7;
+        Image b(a);
+        checkCondition(!a.isDataShared() && (b.data()!=a.data()) && (b.data()[0]==7), "testSharedStorage: Expected deep copy\n");
+        Image c(imf);
+        checkCondition(c.shareDataFrom(a) && a.isDataShared() && (c.data()==a.data()), "testSharedStorage: Expected shared data\n");
+        c.makeWritable();
+        checkCondition(!a.isDataShared() && (c.data()!=a.data()), "testSharedStorage: Expected writable copy\n");
+        checkCondition(!c.shareDataFrom(a, 1), "testSharedStorage: Expected view past the end to fail\n");
+    }
+}
+
+// Waits must return as soon as the condition holds and time out otherwise.
+void testWaitTimeouts(SharedImageBuffer::SyncMode syncMode)
+{
+    shared_ptr<TestProducer> tp(new TestProducer(syncMode));
+    tp->init();
+    shared_ptr<TestConsumer> tc(new TestConsumer(*tp));
+    tc->init();
+
+    checkCondition(!tc->waitForReadSlot(1000), "testWaitTimeouts: Expected read wait to time out\n");
+    checkCondition(tp->waitForWriteSlot(1000), "testWaitTimeouts: Expected write slot available\n");
+
+    for (uint32_t i=0; i<BUFFER_SZ; i++) {
+        checkCondition(tp->writeFrame(i), "testWaitTimeouts: Expected write OK\n");
+    }
+    checkCondition(!tp->waitForWriteSlot(1000), "testWaitTimeouts: Expected write wait to time out\n");
+    checkCondition(tc->waitForReadSlot(1000), "testWaitTimeouts: Expected read slot available\n");
+
+    // A blocked producer is woken by the consumer.
+    std::thread reader([&]() {
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+        uint32_t frame;
+        tc->readFrame(frame);
+    });
+    checkCondition(tp->waitForWriteSlot(1000000), "testWaitTimeouts: Expected write wait to be woken\n");
+    reader.join();
+}
+
+// Removing the consumer that holds up a blocked producer must wake it.
+// The waiters are notified after the buffer is unlocked, as a waiter
+// checking the buffer state holds the wait lock and needs the buffer lock.
+void testRemoveBlockingConsumer(SharedImageBuffer::SyncMode syncMode)
+{
+    shared_ptr<TestProducer> tp(new TestProducer(syncMode));
+    tp->init();
+    shared_ptr<TestConsumer> fast(new TestConsumer(*tp));
+    fast->init();
+    shared_ptr<TestConsumer> slow(new TestConsumer(*tp));
+    slow->init();
+
+    for (uint32_t i=0; i<BUFFER_SZ; i++) {
+        checkCondition(tp->writeFrame(i), "testRemoveBlockingConsumer: Expected write OK\n");
+        uint32_t frame;
+        checkCondition(fast->readFrame(frame), "testRemoveBlockingConsumer: Expected read OK\n");
+    }
+
+    std::atomic<bool> woken(false);
+    std::thread writer([&]() {
+        woken = tp->waitForWriteSlot(10000000);
+    });
+    std::this_thread::sleep_for(std::chrono::milliseconds(20));
+    checkCondition(!woken, "testRemoveBlockingConsumer: Expected producer to block\n");
+
+    // Query the buffer from another thread while waiters are notified.
+    std::atomic<bool> queried(false);
+    std::atomic<bool> lockHeld(false);
+    std::thread query;
+    tp->addSlotListener(SharedImageBuffer::SLOT_WRITABLE, &queried, [&]() {
+        if (query.joinable()) return;
+        query = std::thread([&]() {
+            tp->getNumWriteSlotsAvailable();
+            queried = true;
+        });
+        for (int i=0; i<1000 && !queried; i++) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+        lockHeld = !queried;
+    });
+
+    // Runs removeConsumer() while the producer waits.
+    slow.reset();
+    writer.join();
+    query.join();
+    tp->removeSlotListeners(&queried);
+    checkCondition(woken, "testRemoveBlockingConsumer: Expected producer to be woken\n");
+    checkCondition(!lockHeld, "testRemoveBlockingConsumer: Expected buffer unlocked while notifying\n");
+    checkCondition(tp->writeFrame(BUFFER_SZ), "testRemoveBlockingConsumer: Expected write OK after removal\n");
+}
+
+int main(void)
+{
+    testSemantics(SharedImageBuffer::SYNC_MUTEX);
+    testSemantics(SharedImageBuffer::SYNC_LOCK_FREE_SPMC);
+
+    testConcurrentConsumers(SharedImageBuffer::SYNC_MUTEX, false);
+    testConcurrentConsumers(SharedImageBuffer::SYNC_LOCK_FREE_SPMC, false);
+    testConcurrentConsumers(SharedImageBuffer::SYNC_MUTEX, true);
+    testConcurrentConsumers(SharedImageBuffer::SYNC_LOCK_FREE_SPMC, true);
+
+    testWaitTimeouts(SharedImageBuffer::SYNC_MUTEX);
+    testWaitTimeouts(SharedImageBuffer::SYNC_LOCK_FREE_SPMC);
+
+    testRemoveBlockingConsumer(SharedImageBuffer::SYNC_MUTEX);
+    testRemoveBlockingConsumer(SharedImageBuffer::SYNC_LOCK_FREE_SPMC);
+
+    testBatchSlots(SharedImageBuffer::SYNC_MUTEX);
+    testBatchSlots(SharedImageBuffer::SYNC_LOCK_FREE_SPMC);
+
+    testExecutor(SharedImageBuffer::SYNC_MUTEX);
+    testExecutor(SharedImageBuffer::SYNC_LOCK_FREE_SPMC);
+    testExecutorFairness();
+
+    testFrameWorkers(SharedImageBuffer::SYNC_MUTEX);
+    testFrameWorkers(SharedImageBuffer::SYNC_LOCK_FREE_SPMC);
+
+    testSharedStorage(SharedImageBuffer::SYNC_MUTEX);
+    testSharedStorage(SharedImageBuffer::SYNC_LOCK_FREE_SPMC);
+
+    testOverflowPolicies(SharedImageBuffer::SYNC_MUTEX);
+    testOverflowPolicies(SharedImageBuffer::SYNC_LOCK_FREE_SPMC);
+
+    testConcurrentDropping(SharedImageBuffer::SYNC_MUTEX);
+    testConcurrentDropping(SharedImageBuffer::SYNC_LOCK_FREE_SPMC);
+
+    return 0;
+}